@@ -0,0 +1,407 @@
+#include "aggregate.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// size of each read when warming the page cache by reading through a file
+#define PREFETCH_READ_BYTES ((size_t)8 * 1024 * 1024)
+
+static Aggregate* registered = NULL;
+
+Aggregate* aggregateFind(int ncid)
+{
+	return registered != NULL && registered->ncid == ncid ? registered : NULL;
+}
+
+int aggregateDimLen(int ncid, int dimID, size_t* len)
+{
+	Aggregate* aggregate = aggregateFind(ncid);
+	if (aggregate != NULL && dimID == aggregate->recordDim)
+	{
+		*len = aggregate->records;
+		return NC_NOERR;
+	}
+
+	return nc_inq_dimlen(ncid, dimID, len);
+}
+
+static bool readUnits(int ncid, int varID, char* buffer, size_t size)
+{
+	size_t len;
+	nc_type type;
+	if (nc_inq_att(ncid, varID, "units", &type, &len) != NC_NOERR || type != NC_CHAR || len >= size) return false;
+	if (nc_get_att_text(ncid, varID, "units", buffer) != NC_NOERR) return false;
+	buffer[len] = '\0';
+	return true;
+}
+
+// Compares a member's schema with the first member's and returns its record count
+static bool checkMember(int first, int ncid, const char* path, int recordDim, size_t* records, char* error, size_t errorLen)
+{
+	int nVars, firstVars, unlimDim;
+	if (nc_inq(first, NULL, &firstVars, NULL, NULL) != NC_NOERR || nc_inq(ncid, NULL, &nVars, NULL, &unlimDim) != NC_NOERR)
+	{
+		snprintf(error, errorLen, "cannot read the schema of %s", path);
+		return false;
+	}
+
+	char recordName[NC_MAX_NAME + 1], name[NC_MAX_NAME + 1];
+	nc_inq_dimname(first, recordDim, recordName);
+
+	if (unlimDim < 0 || nc_inq_dimname(ncid, unlimDim, name) != NC_NOERR || strcmp(name, recordName) != 0)
+	{
+		snprintf(error, errorLen, "%s has no unlimited dimension %s", path, recordName);
+		return false;
+	}
+
+	if (nVars != firstVars)
+	{
+		snprintf(error, errorLen, "%s has %d variables where the first file has %d", path, nVars, firstVars);
+		return false;
+	}
+
+	for (int v = 0; v < nVars; ++v)
+	{
+		char firstName[NC_MAX_NAME + 1];
+		nc_type type, firstType;
+		int nDims, firstDims;
+		int dimIDs[NC_MAX_VAR_DIMS], firstDimIDs[NC_MAX_VAR_DIMS];
+
+		if (nc_inq_var(first, v, firstName, &firstType, &firstDims, firstDimIDs, NULL) != NC_NOERR
+			|| nc_inq_var(ncid, v, name, &type, &nDims, dimIDs, NULL) != NC_NOERR
+			|| strcmp(name, firstName) != 0 || type != firstType || nDims != firstDims)
+		{
+			snprintf(error, errorLen, "variable %d of %s differs from the first file's %s", v, path, firstName);
+			return false;
+		}
+
+		for (int d = 0; d < nDims; ++d)
+		{
+			char firstDimName[NC_MAX_NAME + 1];
+			size_t len = 0, firstLen = 0;
+
+			nc_inq_dim(first, firstDimIDs[d], firstDimName, &firstLen);
+			nc_inq_dim(ncid, dimIDs[d], name, &len);
+
+			bool isRecord = firstDimIDs[d] == recordDim;
+			if (strcmp(name, firstDimName) != 0 || isRecord != (dimIDs[d] == unlimDim) || (!isRecord && len != firstLen))
+			{
+				snprintf(error, errorLen, "dimension %s of %s in %s differs from the first file's", firstDimName, firstName, path);
+				return false;
+			}
+		}
+	}
+
+	// concatenated record coordinates only mean anything in the same units
+	int coordVar;
+	if (nc_inq_varid(first, recordName, &coordVar) == NC_NOERR)
+	{
+		char firstUnits[256], units[256];
+		bool hasFirst = readUnits(first, coordVar, firstUnits, sizeof(firstUnits));
+		bool has = readUnits(ncid, coordVar, units, sizeof(units));
+
+		if (has != hasFirst || (has && strcmp(units, firstUnits) != 0))
+		{
+			snprintf(error, errorLen, "%s of %s is in \"%s\", not \"%s\" as in the first file", recordName, path, has ? units : "", hasFirst ? firstUnits : "");
+			return false;
+		}
+	}
+
+	return nc_inq_dimlen(ncid, unlimDim, records) == NC_NOERR;
+}
+
+bool aggregateOpen(int ncid, const char* const* paths, int nPaths, int poolSize, Aggregate** aggregate, char* error, size_t errorLen)
+{
+	*aggregate = NULL;
+
+	int recordDim;
+	if (nc_inq_unlimdim(ncid, &recordDim) != NC_NOERR || recordDim < 0)
+	{
+		snprintf(error, errorLen, "%s has no unlimited dimension to aggregate along", paths[0]);
+		return false;
+	}
+
+	Aggregate* agg = (Aggregate*)calloc(1, sizeof(Aggregate));
+	if (agg == NULL)
+	{
+		snprintf(error, errorLen, "out of memory");
+		return false;
+	}
+
+	agg->ncid = ncid;
+	agg->recordDim = recordDim;
+	agg->nMembers = nPaths;
+	agg->poolSize = poolSize > 0 ? poolSize : 1;
+	agg->prefetchedUpTo = 0;
+	mutexInit(&agg->lock);
+
+	agg->members = (AggregateMember*)calloc(nPaths, sizeof(AggregateMember));
+	agg->pool = (AggregateHandle*)malloc(agg->poolSize * sizeof(AggregateHandle));
+
+	bool ok = agg->members != NULL && agg->pool != NULL;
+	if (!ok) snprintf(error, errorLen, "out of memory");
+
+	for (int i = 0; ok && i < agg->poolSize; ++i)
+		agg->pool[i].member = -1;
+
+	for (int m = 0; ok && m < nPaths; ++m)
+	{
+		AggregateMember* member = &agg->members[m];
+
+		member->path = (char*)malloc(strlen(paths[m]) + 1);
+		if (member->path == NULL)
+		{
+			snprintf(error, errorLen, "out of memory");
+			ok = false;
+			break;
+		}
+		strcpy(member->path, paths[m]);
+		member->first = agg->records;
+
+		if (m == 0)
+		{
+			ok = nc_inq_dimlen(ncid, recordDim, &member->records) == NC_NOERR;
+		}
+		else
+		{
+			int memberNcid;
+			int status = nc_open(member->path, NC_NOWRITE, &memberNcid);
+			if (status != NC_NOERR)
+			{
+				snprintf(error, errorLen, "%s: %s", member->path, nc_strerror(status));
+				ok = false;
+				break;
+			}
+
+			ok = checkMember(ncid, memberNcid, member->path, recordDim, &member->records, error, errorLen);
+			nc_close(memberNcid);
+		}
+
+		agg->records += member->records;
+	}
+
+	if (!ok)
+	{
+		aggregateClose(agg);
+		return false;
+	}
+
+	registered = agg;
+	*aggregate = agg;
+	return true;
+}
+
+void aggregateClose(Aggregate* aggregate)
+{
+	if (aggregate == NULL) return;
+
+	if (aggregate->prefetcherStarted)
+		threadJoin(aggregate->prefetcher);
+
+	if (aggregate->pool)
+	{
+		for (int i = 0; i < aggregate->poolSize; ++i)
+		{
+			if (aggregate->pool[i].member >= 0)
+				nc_close(aggregate->pool[i].ncid);
+		}
+	}
+
+	if (aggregate->members)
+	{
+		for (int m = 0; m < aggregate->nMembers; ++m)
+			free(aggregate->members[m].path);
+	}
+
+	if (registered == aggregate) registered = NULL;
+
+	mutexDestroy(&aggregate->lock);
+	free(aggregate->pool);
+	free(aggregate->members);
+	free(aggregate);
+}
+
+// Warms the page cache with a file without going through libnetcdf, so it
+// needs no lock and never holds up the reader
+static void prefetchMain(void* arg)
+{
+	Aggregate* agg = (Aggregate*)arg;
+	const char* path = agg->members[agg->prefetchedUpTo].path;
+
+#if defined(POSIX_FADV_WILLNEED)
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0)
+	{
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+		close(fd);
+	}
+#else
+	FILE* file = fopen(path, "rb");
+	void* block = malloc(PREFETCH_READ_BYTES);
+	if (file != NULL && block != NULL)
+	{
+		while (fread(block, 1, PREFETCH_READ_BYTES, file) == PREFETCH_READ_BYTES);
+	}
+	free(block);
+	if (file != NULL) fclose(file);
+#endif
+
+	atomicStore(&agg->prefetchBusy, 0);
+}
+
+static void prefetchMember(Aggregate* agg, int member)
+{
+	if (member >= agg->nMembers || member <= agg->prefetchedUpTo) return;
+
+	// one file at a time; a later read asks again
+	if (atomicLoad(&agg->prefetchBusy) != 0) return;
+
+	for (int i = 0; i < agg->poolSize; ++i)
+	{
+		if (agg->pool[i].member == member) return;
+	}
+
+	if (agg->prefetcherStarted)
+	{
+		threadJoin(agg->prefetcher);
+		agg->prefetcherStarted = false;
+	}
+
+	agg->prefetchedUpTo = member;
+	atomicStore(&agg->prefetchBusy, 1);
+
+	if (threadCreate(&agg->prefetcher, prefetchMain, agg) == 0)
+	{
+		agg->prefetcherStarted = true;
+		++agg->prefetches;
+	}
+	else
+	{
+		atomicStore(&agg->prefetchBusy, 0);
+	}
+}
+
+// The member's handle, opening it in place of the least recently used one if need be
+static int acquireMember(Aggregate* agg, int member, int* ncid)
+{
+	if (member == 0)
+	{
+		*ncid = agg->ncid;
+		return NC_NOERR;
+	}
+
+	AggregateHandle* slot = &agg->pool[0];
+
+	for (int i = 0; i < agg->poolSize; ++i)
+	{
+		AggregateHandle* handle = &agg->pool[i];
+		if (handle->member == member)
+		{
+			handle->lastUse = ++agg->clock;
+			++agg->hits;
+			*ncid = handle->ncid;
+			return NC_NOERR;
+		}
+
+		if (slot->member >= 0 && (handle->member < 0 || handle->lastUse < slot->lastUse))
+			slot = handle;
+	}
+
+	if (slot->member >= 0)
+	{
+		nc_close(slot->ncid);
+		slot->member = -1;
+	}
+
+	int status = nc_open(agg->members[member].path, NC_NOWRITE, &slot->ncid);
+	if (status != NC_NOERR) return status;
+
+	slot->member = member;
+	slot->lastUse = ++agg->clock;
+	++agg->opens;
+	*ncid = slot->ncid;
+
+	return NC_NOERR;
+}
+
+// Last member whose first record is at or before record
+static int findMember(const Aggregate* agg, size_t record)
+{
+	int lo = 0, hi = agg->nMembers - 1;
+
+	while (lo < hi)
+	{
+		int mid = (lo + hi + 1) / 2;
+		if (agg->members[mid].first <= record)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+int aggregateRead(const VarInfo* var, const size_t* fileStart, const size_t* count, const ptrdiff_t* fileStride, bool strided, bool toDouble, void* buffer)
+{
+	Aggregate* agg = var->aggregate;
+
+	size_t rowValues = 1;
+	for (int d = 1; d < var->nDims; ++d)
+		rowValues *= count[d];
+
+	size_t rowBytes = rowValues * (toDouble ? sizeof(double) : var->typeSize);
+	ptrdiff_t step = fileStride[0];
+
+	size_t start[NC_MAX_VAR_DIMS], part[NC_MAX_VAR_DIMS];
+	memcpy(start, fileStart, var->nDims * sizeof(size_t));
+	memcpy(part, count, var->nDims * sizeof(size_t));
+
+	int status = NC_NOERR;
+	size_t done = 0;
+
+	mutexLock(&agg->lock);
+
+	while (status == NC_NOERR && done < count[0])
+	{
+		size_t record = fileStart[0] + done * step;
+		if (record >= agg->records)
+		{
+			status = NC_EINVALCOORDS;
+			break;
+		}
+
+		int m = findMember(agg, record);
+		const AggregateMember* member = &agg->members[m];
+
+		size_t n = (member->first + member->records - record - 1) / step + 1;
+		if (n > count[0] - done) n = count[0] - done;
+
+		start[0] = record - member->first;
+		part[0] = n;
+
+		int ncid;
+		status = acquireMember(agg, m, &ncid);
+		if (status != NC_NOERR) break;
+
+		prefetchMember(agg, m + 1);
+
+		void* out = (char*)buffer + done * rowBytes;
+
+		if (toDouble)
+			status = strided ? nc_get_vars_double(ncid, var->varID, start, part, fileStride, (double*)out) : nc_get_vara_double(ncid, var->varID, start, part, (double*)out);
+		else
+			status = strided ? nc_get_vars(ncid, var->varID, start, part, fileStride, out) : nc_get_vara(ncid, var->varID, start, part, out);
+
+		done += n;
+	}
+
+	mutexUnlock(&agg->lock);
+
+	return status;
+}
@@ -0,0 +1,69 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "slab.h"
+#include "threads.h"
+
+// default number of member files kept open at once
+#define AGGREGATE_DEFAULT_POOL 8
+
+typedef struct AggregateMember
+{
+	char* path;
+	size_t first;   // offset of the member's first record in the whole
+	size_t records;
+} AggregateMember;
+
+typedef struct AggregateHandle
+{
+	int member;     // -1 when the slot is free
+	int ncid;
+	unsigned long long lastUse;
+} AggregateHandle;
+
+// Files sharing one schema presented as a single dataset concatenated along
+// the unlimited dimension. ncid is the first member's handle, which carries
+// the metadata; record variables read through it (via getVarInfo and the
+// readSlab family) span every member. Other members are opened on demand
+// into a bounded pool, closing the least recently used, and while one is
+// read the next is prefetched into the OS page cache on a background thread.
+typedef struct Aggregate
+{
+	int ncid;
+	int recordDim;
+	size_t records;                 // total along recordDim
+	int nMembers;
+	AggregateMember* members;
+	int poolSize;
+	AggregateHandle* pool;
+	unsigned long long clock;
+	Mutex lock;
+	Thread prefetcher;
+	bool prefetcherStarted;
+	volatile unsigned long long prefetchBusy;
+	int prefetchedUpTo;             // highest member handed to the prefetcher
+	unsigned long long opens;       // member files opened by the pool
+	unsigned long long hits;        // member reads served by an open handle
+	unsigned long long prefetches;
+} Aggregate;
+
+// Builds the aggregate over paths, whose first entry ncid already has open.
+// Every member must have the first member's variables, types and dimensions,
+// with only the unlimited dimension free to differ in length, and the same
+// units on its record coordinate variable. Only one aggregate is registered
+// at a time. Returns false with a message in error otherwise.
+bool aggregateOpen(int ncid, const char* const* paths, int nPaths, int poolSize, Aggregate** aggregate, char* error, size_t errorLen);
+void aggregateClose(Aggregate* aggregate);
+
+// The aggregate presented through ncid, or NULL
+Aggregate* aggregateFind(int ncid);
+
+// nc_inq_dimlen that sees the aggregated length of the record dimension
+int aggregateDimLen(int ncid, int dimID, size_t* len);
+
+// Reads a block in file coordinates of the whole, splitting it along the
+// leading dimension into one read per member. Called by the readSlab family
+// under the same locking as the nc_get_var* calls it stands in for.
+int aggregateRead(const VarInfo* var, const size_t* fileStart, const size_t* count, const ptrdiff_t* fileStride, bool strided, bool toDouble, void* buffer);
+
+#endif
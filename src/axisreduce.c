@@ -0,0 +1,426 @@
+#include "axisreduce.h"
+#include "chunkcache.h"
+#include "unpack.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// per output cell: count plus two op-dependent accumulators
+// (mean/std: Welford mean and M2, sum: running sum, min/max: extreme)
+typedef struct CellAcc
+{
+	double n;
+	double a;
+	double b;
+} CellAcc;
+
+static const char* opNames[] = { "mean", "min", "max", "sum", "count", "std" };
+static const char* cfMethods[] = { "mean", "minimum", "maximum", "sum", "point", "standard_deviation" };
+
+bool parseReduceOp(const char* name, ReduceOp* op)
+{
+	for (int i = REDUCE_MEAN; i <= REDUCE_STD; ++i)
+	{
+		if (strcmp(name, opNames[i]) == 0)
+		{
+			*op = (ReduceOp)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* reduceOpName(ReduceOp op)
+{
+	return opNames[op];
+}
+
+// Masks and unpacks a buffer of stored values in place, so the cells reduce
+// physical units; anything masked becomes NaN
+static void physicalValues(double* vals, size_t n, const double* fill, const PackInfo* pack)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		double x = vals[i];
+		if (fill && x == *fill)
+		{
+			vals[i] = NAN;
+			continue;
+		}
+
+		if (pack->masked)
+		{
+			bool missing = !(x >= pack->validMin && x <= pack->validMax);
+			for (int m = 0; m < pack->nMissing; ++m)
+				missing |= x == pack->missing[m];
+			if (missing)
+			{
+				vals[i] = NAN;
+				continue;
+			}
+		}
+
+		if (pack->packed) vals[i] = x * pack->scale + pack->offset;
+	}
+}
+
+// Folds one row of physical values into the cells it maps to; outStride is 0
+// when the row runs along a reduced dimension and 1 when it runs along a kept one
+static void accumulateRow(CellAcc* cells, size_t outStride, const double* vals, size_t len, ReduceOp op)
+{
+	switch (op)
+	{
+	case REDUCE_MEAN:
+	case REDUCE_STD:
+		for (size_t i = 0; i < len; ++i)
+		{
+			double x = vals[i];
+			if (x != x) continue;
+			CellAcc* c = cells + i * outStride;
+			c->n += 1.0;
+			double delta = x - c->a;
+			c->a += delta / c->n;
+			c->b += delta * (x - c->a);
+		}
+		break;
+	case REDUCE_MIN:
+		for (size_t i = 0; i < len; ++i)
+		{
+			double x = vals[i];
+			if (x != x) continue;
+			CellAcc* c = cells + i * outStride;
+			if (c->n == 0.0 || x < c->a) c->a = x;
+			c->n += 1.0;
+		}
+		break;
+	case REDUCE_MAX:
+		for (size_t i = 0; i < len; ++i)
+		{
+			double x = vals[i];
+			if (x != x) continue;
+			CellAcc* c = cells + i * outStride;
+			if (c->n == 0.0 || x > c->a) c->a = x;
+			c->n += 1.0;
+		}
+		break;
+	case REDUCE_SUM:
+	case REDUCE_COUNT:
+		for (size_t i = 0; i < len; ++i)
+		{
+			double x = vals[i];
+			if (x != x) continue;
+			CellAcc* c = cells + i * outStride;
+			c->n += 1.0;
+			c->a += x;
+		}
+		break;
+	}
+}
+
+static double finishCell(const CellAcc* c, ReduceOp op)
+{
+	if (op == REDUCE_COUNT) return c->n;
+	if (c->n == 0.0) return NC_FILL_DOUBLE;
+
+	switch (op)
+	{
+	case REDUCE_STD:
+		return c->n > 1.0 ? sqrt(c->b / (c->n - 1.0)) : 0.0;
+	default:
+		return c->a;
+	}
+}
+
+static void copyAttIfPresent(int ncid, int varID, const char* name, int outNcid, int outVarID)
+{
+	if (nc_inq_att(ncid, varID, name, NULL, NULL) == NC_NOERR)
+		nc_copy_att(ncid, varID, name, outNcid, outVarID);
+}
+
+// Defines the kept dimensions, their coordinate variables and the result variable
+static int createOutput(const VarInfo* var, const bool* reduceDim, ReduceOp op, const char* path, int* outNcid, int* outVarID)
+{
+	int ncid;
+	int status = nc_create(path, NC_CLOBBER | NC_NETCDF4, &ncid);
+	if (status != NC_NOERR) return status;
+
+	int outDims[NC_MAX_VAR_DIMS];
+	int coordVars[NC_MAX_VAR_DIMS], outCoordVars[NC_MAX_VAR_DIMS];
+	int nOut = 0;
+	char cellMethods[NC_MAX_VAR_DIMS * (NC_MAX_NAME + 2) + 32] = "";
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		char dimName[NC_MAX_NAME + 1];
+		status = nc_inq_dimname(var->ncid, var->dimIDs[d], dimName);
+		if (status != NC_NOERR) break;
+
+		if (reduceDim[d])
+		{
+			strcat(cellMethods, dimName);
+			strcat(cellMethods, ": ");
+			continue;
+		}
+
+		status = nc_def_dim(ncid, dimName, var->dimLens[d], &outDims[nOut]);
+		if (status != NC_NOERR) break;
+
+		// carry 1D coordinate variables across so the result stays self-describing
+		int cv, cvDims, cvDimID;
+		coordVars[nOut] = -1;
+
+		if (nc_inq_varid(var->ncid, dimName, &cv) == NC_NOERR &&
+			nc_inq_varndims(var->ncid, cv, &cvDims) == NC_NOERR && cvDims == 1 &&
+			nc_inq_vardimid(var->ncid, cv, &cvDimID) == NC_NOERR && cvDimID == var->dimIDs[d])
+		{
+			nc_type cvType;
+			nc_inq_vartype(var->ncid, cv, &cvType);
+
+			if (cvType != NC_CHAR && cvType != NC_STRING &&
+				nc_def_var(ncid, dimName, NC_DOUBLE, 1, &outDims[nOut], &outCoordVars[nOut]) == NC_NOERR)
+			{
+				coordVars[nOut] = cv;
+				copyAttIfPresent(var->ncid, cv, "units", ncid, outCoordVars[nOut]);
+				copyAttIfPresent(var->ncid, cv, "long_name", ncid, outCoordVars[nOut]);
+				copyAttIfPresent(var->ncid, cv, "standard_name", ncid, outCoordVars[nOut]);
+				copyAttIfPresent(var->ncid, cv, "calendar", ncid, outCoordVars[nOut]);
+				copyAttIfPresent(var->ncid, cv, "axis", ncid, outCoordVars[nOut]);
+			}
+		}
+
+		++nOut;
+	}
+
+	int varID = -1;
+
+	if (status == NC_NOERR)
+		status = nc_def_var(ncid, var->name, NC_DOUBLE, nOut, outDims, &varID);
+
+	if (status == NC_NOERR)
+	{
+		double fill = NC_FILL_DOUBLE;
+		status = nc_put_att_double(ncid, varID, "_FillValue", NC_DOUBLE, 1, &fill);
+	}
+
+	if (status == NC_NOERR)
+	{
+		if (op != REDUCE_COUNT)
+		{
+			copyAttIfPresent(var->ncid, var->varID, "units", ncid, varID);
+			copyAttIfPresent(var->ncid, var->varID, "standard_name", ncid, varID);
+		}
+		copyAttIfPresent(var->ncid, var->varID, "long_name", ncid, varID);
+
+		strcat(cellMethods, cfMethods[op]);
+		status = nc_put_att_text(ncid, varID, "cell_methods", strlen(cellMethods), cellMethods);
+	}
+
+	if (status == NC_NOERR)
+		status = nc_enddef(ncid);
+
+	for (int k = 0; status == NC_NOERR && k < nOut; ++k)
+	{
+		if (coordVars[k] < 0) continue;
+
+		size_t len;
+		nc_inq_dimlen(ncid, outDims[k], &len);
+
+		double* coords = (double*)malloc((len > 0 ? len : 1) * sizeof(double));
+		if (coords == NULL)
+		{
+			status = NC_ENOMEM;
+			break;
+		}
+
+		// read through a VarInfo so an aggregated record axis comes from every file
+		VarInfo coord;
+		status = getVarInfo(var->ncid, coordVars[k], &coord);
+		if (status == NC_NOERR)
+		{
+			size_t start = 0;
+			status = readSlabDouble(&coord, &start, &len, coords);
+		}
+
+		if (status == NC_NOERR)
+			status = nc_put_var_double(ncid, outCoordVars[k], coords);
+
+		free(coords);
+	}
+
+	if (status != NC_NOERR)
+	{
+		nc_close(ncid);
+		return status;
+	}
+
+	*outNcid = ncid;
+	*outVarID = varID;
+	return NC_NOERR;
+}
+
+int reduceAxes(const VarInfo* var, const bool* reduceDim, ReduceOp op, const char* outPath, bool raw, size_t memLimit, size_t chunkCache, unsigned long long* cellsWritten)
+{
+	*cellsWritten = 0;
+
+	// the kept dimensions form the output space
+	VarInfo outVar;
+	memset(&outVar, 0, sizeof(VarInfo));
+	outVar.typeSize = sizeof(CellAcc);
+	outVar.valueCount = 1;
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		if (reduceDim[d]) continue;
+		outVar.dimLens[outVar.nDims++] = var->dimLens[d];
+		outVar.valueCount *= var->dimLens[d];
+	}
+
+	// half the budget for accumulators, half for the read buffer
+	SlabPlan tilePlan;
+	slabPlanInit(&tilePlan, &outVar, memLimit / 2);
+
+	size_t tileValues = tilePlan.slabValues > 0 ? (size_t)tilePlan.slabValues : 1;
+	CellAcc* cells = (CellAcc*)malloc(tileValues * sizeof(CellAcc));
+	double* results = (double*)malloc(tileValues * sizeof(double));
+
+	size_t readValues = memLimit / 2 / sizeof(double);
+	if (readValues < 1) readValues = 1;
+	double* vals = (double*)malloc(readValues * sizeof(double));
+
+	int status = NC_NOERR;
+	int outNcid = -1, outVarID = -1;
+	FILE* rawFile = NULL;
+
+	if (cells == NULL || results == NULL || vals == NULL)
+		status = NC_ENOMEM;
+	else if (raw)
+		status = (rawFile = fopen(outPath, "wb")) != NULL ? NC_NOERR : NC_ECANTCREATE;
+	else
+		status = createOutput(var, reduceDim, op, outPath, &outNcid, &outVarID);
+
+	double fillStorage;
+	const double* fill = NULL;
+	if (nc_get_att_double(var->ncid, var->varID, "_FillValue", &fillStorage) == NC_NOERR)
+		fill = &fillStorage;
+
+	// reduced in physical units, which is what the copied units attribute describes
+	PackInfo pack;
+	if (status == NC_NOERR)
+		status = getPackInfo(var->ncid, var->varID, var->type, &pack);
+
+	for (unsigned long long t = 0; status == NC_NOERR && t < tilePlan.slabCount; ++t)
+	{
+		size_t tileStart[NC_MAX_VAR_DIMS], tileCount[NC_MAX_VAR_DIMS];
+		unsigned long long tileCells = slabPlanGet(&tilePlan, t, tileStart, tileCount);
+
+		memset(cells, 0, (size_t)tileCells * sizeof(CellAcc));
+
+		// input region feeding this tile: the tile on kept dims, everything on reduced ones
+		VarInfo region = *var;
+		size_t regionStart[NC_MAX_VAR_DIMS];
+		size_t outStride[NC_MAX_VAR_DIMS];
+		region.typeSize = sizeof(double);
+		region.valueCount = 1;
+		region.chunked = false; // tile edges need not fall on chunk boundaries, and reads must fit vals
+
+		for (int d = 0, k = 0; d < var->nDims; ++d)
+		{
+			regionStart[d] = reduceDim[d] ? 0 : tileStart[k];
+			region.dimLens[d] = reduceDim[d] ? var->dimLens[d] : tileCount[k];
+			region.valueCount *= region.dimLens[d];
+			if (!reduceDim[d]) ++k;
+		}
+
+		size_t stride = 1;
+		for (int d = var->nDims - 1; d >= 0; --d)
+		{
+			outStride[d] = reduceDim[d] ? 0 : stride;
+			if (!reduceDim[d]) stride *= region.dimLens[d];
+		}
+
+		// stream the region in storage (row-major) order
+		SlabPlan readPlan;
+		slabPlanInit(&readPlan, &region, readValues * sizeof(double));
+
+		// these reads do cut through chunks, so size the cache for the real layout
+		VarInfo chunkView = region;
+		chunkView.chunked = var->chunked;
+		SlabPlan viewPlan = readPlan;
+		viewPlan.var = &chunkView;
+
+		ChunkCacheEstimate cache;
+		chunkCachePlan(&viewPlan, chunkCache, &cache);
+		chunkCacheApply(var->ncid, var->varID, &cache);
+
+		for (unsigned long long s = 0; status == NC_NOERR && s < readPlan.slabCount; ++s)
+		{
+			size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+			unsigned long long n = slabPlanGet(&readPlan, s, start, count);
+
+			for (int d = 0; d < var->nDims; ++d)
+				start[d] += regionStart[d];
+
+			status = readSlabDouble(var, start, count, vals);
+			if (status != NC_NOERR) break;
+
+			physicalValues(vals, (size_t)n, fill, &pack);
+
+			if (var->nDims == 0)
+			{
+				accumulateRow(cells, 0, vals, 1, op);
+				continue;
+			}
+
+			int last = var->nDims - 1;
+			size_t rowLen = count[last];
+			size_t pos[NC_MAX_VAR_DIMS] = { 0 };
+
+			for (unsigned long long offset = 0; offset < n; offset += rowLen)
+			{
+				size_t cell = 0;
+				for (int d = 0; d < last; ++d)
+					cell += (start[d] - regionStart[d] + pos[d]) * outStride[d];
+				cell += (start[last] - regionStart[last]) * outStride[last];
+
+				accumulateRow(cells + cell, outStride[last], vals + offset, rowLen, op);
+
+				for (int d = last - 1; d >= 0; --d)
+				{
+					if (++pos[d] < count[d]) break;
+					pos[d] = 0;
+				}
+			}
+		}
+
+		if (status != NC_NOERR) break;
+
+		for (unsigned long long i = 0; i < tileCells; ++i)
+			results[i] = finishCell(&cells[i], op);
+
+		// tiles are contiguous runs of the row-major output, so raw output is a plain append
+		if (raw)
+			status = fwrite(results, sizeof(double), (size_t)tileCells, rawFile) == tileCells ? NC_NOERR : NC_ECANTWRITE;
+		else
+			status = nc_put_vara_double(outNcid, outVarID, tileStart, tileCount, results);
+
+		*cellsWritten += tileCells;
+	}
+
+	if (rawFile && fclose(rawFile) != 0 && status == NC_NOERR)
+		status = NC_ECANTWRITE;
+
+	if (outNcid >= 0)
+	{
+		int closeStatus = nc_close(outNcid);
+		if (status == NC_NOERR) status = closeStatus;
+	}
+
+	free(cells);
+	free(results);
+	free(vals);
+
+	return status;
+}
@@ -0,0 +1,27 @@
+#ifndef AXISREDUCE_H
+#define AXISREDUCE_H
+
+#include "slab.h"
+
+typedef enum ReduceOp
+{
+	REDUCE_MEAN,
+	REDUCE_MIN,
+	REDUCE_MAX,
+	REDUCE_SUM,
+	REDUCE_COUNT,
+	REDUCE_STD
+} ReduceOp;
+
+bool parseReduceOp(const char* name, ReduceOp* op);
+const char* reduceOpName(ReduceOp op);
+
+// Collapses the dimensions flagged in reduceDim (indexed like var->dimIDs) and
+// writes the lower-rank result as double to a new netCDF file, or as native-endian
+// row-major doubles when raw is set. Values are masked and unpacked with the CF
+// attributes first, so the result is in physical units. Cells with no valid
+// input get NC_FILL_DOUBLE.
+// chunkCache overrides the automatically sized chunk cache when non-zero.
+int reduceAxes(const VarInfo* var, const bool* reduceDim, ReduceOp op, const char* outPath, bool raw, size_t memLimit, size_t chunkCache, unsigned long long* cellsWritten);
+
+#endif
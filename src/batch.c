@@ -0,0 +1,916 @@
+#include "batch.h"
+
+#include "procs.h"
+#include "threads.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define PATH_SEPARATOR '\\'
+#else
+#include <dirent.h>
+#include <glob.h>
+#define PATH_SEPARATOR '/'
+#endif
+
+#define BATCH_MAX_PATH 4096
+#define NO_SHAPE 0xFFFFFFFFu
+
+/* ---------------------------------------------------------------------------
+ * Collecting files
+ * ------------------------------------------------------------------------- */
+
+void batchListInit(BatchList* list)
+{
+	list->files = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
+
+static void batchFileFree(BatchFile* file)
+{
+	if (file->vars)
+	{
+		for (int v = 0; v < file->nVars; ++v)
+			free(file->vars[v].shape);
+		free(file->vars);
+	}
+
+	free(file->path);
+}
+
+void batchListFree(BatchList* list)
+{
+	for (int i = 0; i < list->count; ++i)
+		batchFileFree(&list->files[i]);
+
+	free(list->files);
+	batchListInit(list);
+}
+
+static bool addFile(BatchList* list, const char* path, unsigned long long size)
+{
+	if (list->count == list->capacity)
+	{
+		int capacity = list->capacity > 0 ? list->capacity * 2 : 256;
+		BatchFile* files = (BatchFile*)realloc(list->files, capacity * sizeof(BatchFile));
+		if (files == NULL) return false;
+
+		list->files = files;
+		list->capacity = capacity;
+	}
+
+	char* copy = (char*)malloc(strlen(path) + 1);
+	if (copy == NULL) return false;
+	strcpy(copy, path);
+
+	BatchFile* file = &list->files[list->count++];
+	memset(file, 0, sizeof(BatchFile));
+	file->path = copy;
+	file->size = size;
+	file->status = NC_NOERR;
+	file->unlimDim = -1;
+
+	return true;
+}
+
+static bool hasNetcdfExtension(const char* path)
+{
+	static const char* extensions[] = { ".nc", ".nc4", ".cdf", ".netcdf" };
+
+	size_t len = strlen(path);
+	for (int i = 0; i < 4; ++i)
+	{
+		size_t n = strlen(extensions[i]);
+		if (len <= n) continue;
+
+		const char* tail = path + len - n;
+		size_t j = 0;
+		while (j < n && tolower((unsigned char)tail[j]) == extensions[i][j])
+			++j;
+
+		if (j == n) return true;
+	}
+
+	return false;
+}
+
+static bool joinPath(char* buffer, const char* dir, const char* name)
+{
+	size_t len = strlen(dir);
+	bool separated = len > 0 && (dir[len - 1] == '/' || dir[len - 1] == PATH_SEPARATOR);
+
+	int written = separated ? snprintf(buffer, BATCH_MAX_PATH, "%s%s", dir, name) : snprintf(buffer, BATCH_MAX_PATH, "%s%c%s", dir, PATH_SEPARATOR, name);
+	return written > 0 && written < BATCH_MAX_PATH;
+}
+
+#ifdef _WIN32
+
+static unsigned long long findDataSize(const WIN32_FIND_DATAA* data)
+{
+	return ((unsigned long long)data->nFileSizeHigh << 32) | data->nFileSizeLow;
+}
+
+static int walkDirectory(BatchList* list, const char* dir)
+{
+	char pattern[BATCH_MAX_PATH];
+	if (!joinPath(pattern, dir, "*")) return 0;
+
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(pattern, &data);
+	if (find == INVALID_HANDLE_VALUE) return 0;
+
+	int added = 0;
+
+	do
+	{
+		if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0) continue;
+
+		char path[BATCH_MAX_PATH];
+		if (!joinPath(path, dir, data.cFileName)) continue;
+
+		// reparse points can loop back on themselves
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) continue;
+
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			added += walkDirectory(list, path);
+		else if (hasNetcdfExtension(path) && addFile(list, path, findDataSize(&data)))
+			++added;
+	} while (FindNextFileA(find, &data));
+
+	FindClose(find);
+	return added;
+}
+
+bool batchCollect(BatchList* list, const char* pattern)
+{
+	DWORD attributes = GetFileAttributesA(pattern);
+	if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+		return walkDirectory(list, pattern) > 0;
+
+	// a plain file is its own only match
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(pattern, &data);
+	if (find == INVALID_HANDLE_VALUE) return false;
+
+	// wildcards only match in the last component, so matches share the pattern's directory
+	char dir[BATCH_MAX_PATH];
+	const char* slash = strrchr(pattern, '\\');
+	const char* forward = strrchr(pattern, '/');
+	if (forward > slash) slash = forward;
+	size_t dirLen = slash ? (size_t)(slash - pattern) + 1 : 0;
+	if (dirLen >= sizeof(dir))
+	{
+		FindClose(find);
+		return false;
+	}
+	memcpy(dir, pattern, dirLen);
+	dir[dirLen] = '\0';
+
+	int added = 0;
+
+	do
+	{
+		if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0) continue;
+
+		char path[BATCH_MAX_PATH];
+		if (snprintf(path, sizeof(path), "%s%s", dir, data.cFileName) >= (int)sizeof(path)) continue;
+
+		if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			added += walkDirectory(list, path);
+		else if (addFile(list, path, findDataSize(&data)))
+			++added;
+	} while (FindNextFileA(find, &data));
+
+	FindClose(find);
+	return added > 0;
+}
+
+#else
+
+static int walkDirectory(BatchList* list, const char* dir)
+{
+	DIR* handle = opendir(dir);
+	if (handle == NULL) return 0;
+
+	int added = 0;
+	struct dirent* entry;
+
+	while ((entry = readdir(handle)) != NULL)
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+		char path[BATCH_MAX_PATH];
+		if (!joinPath(path, dir, entry->d_name)) continue;
+
+		struct stat st;
+		if (lstat(path, &st) != 0) continue;
+
+		// follow links to files but not to directories, which can loop back on themselves
+		if (S_ISLNK(st.st_mode) && (stat(path, &st) != 0 || !S_ISREG(st.st_mode))) continue;
+
+		if (S_ISDIR(st.st_mode))
+			added += walkDirectory(list, path);
+		else if (S_ISREG(st.st_mode) && hasNetcdfExtension(path) && addFile(list, path, (unsigned long long)st.st_size))
+			++added;
+	}
+
+	closedir(handle);
+	return added;
+}
+
+// Paths named outright or matched by a pattern are taken whatever their extension
+static int collectPath(BatchList* list, const char* path)
+{
+	struct stat st;
+	if (stat(path, &st) != 0) return 0;
+
+	if (S_ISDIR(st.st_mode))
+		return walkDirectory(list, path);
+
+	if (S_ISREG(st.st_mode))
+		return addFile(list, path, (unsigned long long)st.st_size) ? 1 : 0;
+
+	return 0;
+}
+
+bool batchCollect(BatchList* list, const char* pattern)
+{
+	struct stat st;
+	if (stat(pattern, &st) == 0)
+		return collectPath(list, pattern) > 0;
+
+	glob_t matches;
+	if (glob(pattern, 0, NULL, &matches) != 0) return false;
+
+	int added = 0;
+	for (size_t i = 0; i < matches.gl_pathc; ++i)
+		added += collectPath(list, matches.gl_pathv[i]);
+
+	globfree(&matches);
+	return added > 0;
+}
+
+#endif
+
+/* ---------------------------------------------------------------------------
+ * Scanning one file
+ * ------------------------------------------------------------------------- */
+
+// Queues and counters live in memory shared with the worker processes; the
+// items themselves are only read, so every worker has its own copy
+typedef struct BatchDeque
+{
+	int* items;   // indices into the list, largest file first
+	int tail;
+	volatile unsigned long long head;      // next to take, by the owner and thieves alike
+	volatile unsigned long long bytes;     // still queued, for choosing whom to steal from
+	volatile unsigned long long remaining;
+} BatchDeque;
+
+typedef struct BatchCounters
+{
+	volatile unsigned long long idle;   // workers that found nothing left to take
+	volatile unsigned long long steals;
+} BatchCounters;
+
+typedef struct BatchJob
+{
+	BatchList* list;
+	const BatchConfig* config;
+	BatchDeque* deques;
+	BatchCounters* counters;
+	int workers;
+	int done;
+} BatchJob;
+
+static void scanVar(BatchJob* job, BatchFile* file, const VarInfo* var, BatchVar* out)
+{
+	if (simdKernel(var->type) == NULL)
+	{
+		out->status = NC_EBADTYPE;
+		return;
+	}
+
+	// finished workers lend their cores to the files still running
+	unsigned long long idle = atomicLoad(&job->counters->idle);
+	unsigned long long running = (unsigned long long)job->workers > idle ? (unsigned long long)job->workers - idle : 1;
+
+	StatsConfig config = job->config->stats;
+	config.path = file->path;
+	config.threads = 1 + (int)(idle / running);
+
+	VarStats stats;
+	out->status = computeVarStats(var, &config, &stats);
+
+	if (out->status == NC_NOERR)
+	{
+		out->hasStats = true;
+		out->cached = stats.cached;
+		out->count = stats.count;
+
+		if (stats.unpack)
+		{
+			out->valid = stats.physical.valid;
+			out->min = stats.physical.min;
+			out->max = stats.physical.max;
+			out->mean = stats.physical.moments.mean;
+			out->stdDev = sqrt(momentsVariance(&stats.physical.moments));
+		}
+		else
+		{
+			out->valid = stats.validCount;
+			out->min = stats.min;
+			out->max = stats.max;
+			out->mean = stats.moments.mean;
+			out->stdDev = sqrt(momentsVariance(&stats.moments));
+		}
+
+		if (!stats.cached)
+		{
+			unsigned long long records = var->nDims > 0 && var->dimLens[0] > 0 ? var->dimLens[0] : 1;
+			file->bytesRead += var->valueCount / records * (records - stats.cachedRecords) * var->typeSize;
+		}
+	}
+
+	varStatsFree(&stats);
+}
+
+static void scanFile(BatchJob* job, BatchFile* file)
+{
+	double begin = wallClock();
+	int ncid;
+
+	ncLock();
+	file->status = nc_open(file->path, NC_NOWRITE, &ncid);
+	if (file->status == NC_NOERR)
+	{
+		file->status = nc_inq(ncid, &file->nDims, &file->nVars, &file->nAttrs, &file->unlimDim);
+		if (file->status == NC_NOERR) file->status = nc_inq_format(ncid, &file->format);
+		if (file->status != NC_NOERR) nc_close(ncid);
+	}
+	ncUnlock();
+
+	if (file->status != NC_NOERR)
+	{
+		file->nVars = 0;
+		file->seconds = wallClock() - begin;
+		return;
+	}
+
+	if (file->nVars > 0)
+	{
+		file->vars = (BatchVar*)calloc(file->nVars, sizeof(BatchVar));
+		if (file->vars == NULL)
+		{
+			file->status = NC_ENOMEM;
+			file->nVars = 0;
+		}
+	}
+
+	for (int v = 0; v < file->nVars; ++v)
+	{
+		BatchVar* out = &file->vars[v];
+		VarInfo var;
+
+		ncLock();
+		out->status = getVarInfo(ncid, v, &var);
+		if (out->status == NC_NOERR) out->status = nc_inq_type(ncid, var.type, out->typeName, NULL);
+		ncUnlock();
+
+		if (out->status != NC_NOERR)
+		{
+			file->status = out->status;
+			continue;
+		}
+
+		strcpy(out->name, var.name);
+
+		out->shape = (char*)malloc(var.nDims * 21 + 1);
+		if (out->shape == NULL)
+		{
+			file->status = NC_ENOMEM;
+			continue;
+		}
+
+		size_t len = 0;
+		out->shape[0] = '\0';
+		for (int d = 0; d < var.nDims; ++d)
+			len += sprintf(out->shape + len, d > 0 ? "x%zu" : "%zu", var.dimLens[d]);
+
+		if (!job->config->statistics) continue;
+
+		scanVar(job, file, &var, out);
+
+		if (out->status != NC_NOERR && out->status != NC_EBADTYPE)
+			file->status = out->status;
+	}
+
+	if (job->config->visit)
+		job->config->visit(file, ncid, job->config->user);
+
+	ncLock();
+	nc_close(ncid);
+	ncUnlock();
+
+	file->seconds = wallClock() - begin;
+}
+
+/* ---------------------------------------------------------------------------
+ * Scheduling
+ * ------------------------------------------------------------------------- */
+
+// Takes the head of a deque: the largest file queued there. Claiming a slot
+// is one atomic add, so processes need no lock between them; a slot past the
+// tail means the deque was empty.
+static int dequeTake(BatchDeque* deque, const BatchList* list)
+{
+	unsigned long long slot = atomicFetchAdd(&deque->head, 1);
+	if (slot >= (unsigned long long)deque->tail) return -1;
+
+	int index = deque->items[slot];
+	atomicFetchAdd(&deque->bytes, 0ULL - list->files[index].size);
+	atomicFetchAdd(&deque->remaining, 0ULL - 1);
+
+	return index;
+}
+
+static int stealFile(BatchJob* job, int thief)
+{
+	while (true)
+	{
+		// the fullest queue is the one most likely to keep its owner busy to the end
+		int victim = -1;
+		unsigned long long mostBytes = 0, mostFiles = 0;
+
+		for (int w = 0; w < job->workers; ++w)
+		{
+			if (w == thief) continue;
+
+			unsigned long long files = atomicLoad(&job->deques[w].remaining);
+			unsigned long long bytes = atomicLoad(&job->deques[w].bytes);
+			if (files > 0 && (victim < 0 || bytes > mostBytes || (bytes == mostBytes && files > mostFiles)))
+			{
+				victim = w;
+				mostBytes = bytes;
+				mostFiles = files;
+			}
+		}
+
+		if (victim < 0) return -1;
+
+		// the queue may have emptied since it was looked at, so look again
+		int index = dequeTake(&job->deques[victim], job->list);
+		if (index >= 0)
+		{
+			atomicFetchAdd(&job->counters->steals, 1);
+			return index;
+		}
+	}
+}
+
+// A scanned file as a message: its index, the file, its variables, the
+// lengths of their shapes (NO_SHAPE for none), the shapes, then whatever
+// visit left in extra
+static unsigned char* encodeFile(int index, const BatchFile* file, size_t* size)
+{
+	size_t shapes = 0;
+	for (int v = 0; v < file->nVars; ++v)
+		shapes += file->vars[v].shape != NULL ? strlen(file->vars[v].shape) : 0;
+
+	*size = sizeof(int) + sizeof(BatchFile) + file->nVars * (sizeof(BatchVar) + sizeof(unsigned)) + shapes + file->extraSize;
+
+	unsigned char* message = (unsigned char*)malloc(*size);
+	if (message == NULL) return NULL;
+
+	unsigned char* pos = message;
+	memcpy(pos, &index, sizeof(int));
+	pos += sizeof(int);
+	memcpy(pos, file, sizeof(BatchFile));
+	pos += sizeof(BatchFile);
+
+	if (file->nVars > 0)
+	{
+		memcpy(pos, file->vars, file->nVars * sizeof(BatchVar));
+		pos += file->nVars * sizeof(BatchVar);
+	}
+
+	for (int v = 0; v < file->nVars; ++v)
+	{
+		unsigned len = file->vars[v].shape != NULL ? (unsigned)strlen(file->vars[v].shape) : NO_SHAPE;
+		memcpy(pos, &len, sizeof(unsigned));
+		pos += sizeof(unsigned);
+	}
+
+	for (int v = 0; v < file->nVars; ++v)
+	{
+		size_t len = file->vars[v].shape != NULL ? strlen(file->vars[v].shape) : 0;
+		if (len > 0) memcpy(pos, file->vars[v].shape, len);
+		pos += len;
+	}
+
+	if (file->extraSize > 0) memcpy(pos, file->extra, file->extraSize);
+
+	return message;
+}
+
+// Fills the list's entry from a message; its path and size stay as they were
+static int decodeFile(const unsigned char* data, size_t size, BatchFile* file)
+{
+	BatchFile sent;
+	memcpy(&sent, data, sizeof(BatchFile));
+	data += sizeof(BatchFile);
+	size -= sizeof(BatchFile);
+
+	if (sent.nVars < 0 || (size_t)sent.nVars > size / (sizeof(BatchVar) + sizeof(unsigned)))
+		return NC_EIO;
+
+	BatchVar* vars = NULL;
+	if (sent.nVars > 0)
+	{
+		vars = (BatchVar*)calloc(sent.nVars, sizeof(BatchVar));
+		if (vars == NULL) return NC_ENOMEM;
+
+		memcpy(vars, data, sent.nVars * sizeof(BatchVar));
+		data += sent.nVars * sizeof(BatchVar);
+		size -= sent.nVars * sizeof(BatchVar);
+	}
+
+	const unsigned char* lens = data;
+	data += sent.nVars * sizeof(unsigned);
+	size -= sent.nVars * sizeof(unsigned);
+
+	int status = NC_NOERR;
+	for (int v = 0; v < sent.nVars; ++v)
+		vars[v].shape = NULL;
+
+	for (int v = 0; status == NC_NOERR && v < sent.nVars; ++v)
+	{
+		unsigned len;
+		memcpy(&len, lens + v * sizeof(unsigned), sizeof(unsigned));
+		// a variable that failed before its shape was known had none
+		if (len == NO_SHAPE) continue;
+
+		if (len > size)
+		{
+			status = NC_EIO;
+			break;
+		}
+
+		vars[v].shape = (char*)malloc(len + 1);
+		if (vars[v].shape == NULL)
+		{
+			status = NC_ENOMEM;
+			break;
+		}
+
+		memcpy(vars[v].shape, data, len);
+		vars[v].shape[len] = '\0';
+		data += len;
+		size -= len;
+	}
+
+	void* extra = NULL;
+	if (status == NC_NOERR && size != sent.extraSize) status = NC_EIO;
+	if (status == NC_NOERR && size > 0)
+	{
+		extra = malloc(size);
+		if (extra == NULL)
+			status = NC_ENOMEM;
+		else
+			memcpy(extra, data, size);
+	}
+
+	if (status != NC_NOERR)
+	{
+		for (int v = 0; v < sent.nVars; ++v)
+			free(vars[v].shape);
+		free(vars);
+		return status;
+	}
+
+	file->status = sent.status;
+	file->format = sent.format;
+	file->nDims = sent.nDims;
+	file->nVars = sent.nVars;
+	file->nAttrs = sent.nAttrs;
+	file->unlimDim = sent.unlimDim;
+	file->vars = vars;
+	file->bytesRead = sent.bytesRead;
+	file->seconds = sent.seconds;
+	file->extra = extra;
+	file->extraSize = sent.extraSize;
+
+	return NC_NOERR;
+}
+
+// Each worker is a process of its own, so its libnetcdf calls take no lock
+// another worker waits on. A file is scanned into a copy of its entry and
+// sent back whole; the list itself is only written by the caller.
+static void batchProcMain(int id, ProcChannel* channel, void* user)
+{
+	BatchJob* job = (BatchJob*)user;
+
+	while (true)
+	{
+		int index = dequeTake(&job->deques[id], job->list);
+		if (index < 0) index = stealFile(job, id);
+		if (index < 0) break;
+
+		BatchFile file = job->list->files[index];
+		scanFile(job, &file);
+
+		size_t size;
+		unsigned char* message = encodeFile(index, &file, &size);
+		if (message == NULL)
+		{
+			// the file goes back without its variables rather than not at all
+			BatchFile bare = job->list->files[index];
+			bare.status = NC_ENOMEM;
+			message = encodeFile(index, &bare, &size);
+		}
+
+		if (message != NULL) procSend(channel, message, size);
+		free(message);
+
+		if (file.vars)
+		{
+			for (int v = 0; v < file.nVars; ++v)
+				free(file.vars[v].shape);
+			free(file.vars);
+		}
+		free(file.extra);
+	}
+
+	// nothing is ever queued again, so this worker is done for good
+	atomicFetchAdd(&job->counters->idle, 1);
+}
+
+static void batchProcReceive(int id, const void* data, size_t size, void* user)
+{
+	(void)id;
+	BatchJob* job = (BatchJob*)user;
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	int index;
+	if (size < sizeof(int) + sizeof(BatchFile)) return;
+	memcpy(&index, bytes, sizeof(int));
+	if (index < 0 || index >= job->list->count) return;
+
+	BatchFile* file = &job->list->files[index];
+	int status = decodeFile(bytes + sizeof(int), size - sizeof(int), file);
+	if (status != NC_NOERR) file->status = status;
+
+	++job->done;
+	if (job->config->progress)
+		job->config->progress(job->done, job->list->count, file, job->config->user);
+}
+
+static int compareSizeDescending(const void* a, const void* b)
+{
+	unsigned long long x = ((const BatchFile*)a)->size;
+	unsigned long long y = ((const BatchFile*)b)->size;
+	return x < y ? 1 : (x > y ? -1 : strcmp(((const BatchFile*)a)->path, ((const BatchFile*)b)->path));
+}
+
+static int comparePath(const void* a, const void* b)
+{
+	return strcmp(((const BatchFile*)a)->path, ((const BatchFile*)b)->path);
+}
+
+static void dropDuplicates(BatchList* list)
+{
+	if (list->count < 2) return;
+
+	qsort(list->files, list->count, sizeof(BatchFile), comparePath);
+
+	int kept = 1;
+	for (int i = 1; i < list->count; ++i)
+	{
+		if (strcmp(list->files[i].path, list->files[kept - 1].path) == 0)
+			batchFileFree(&list->files[i]);
+		else
+			list->files[kept++] = list->files[i];
+	}
+
+	list->count = kept;
+}
+
+int batchRun(BatchList* list, const BatchConfig* config, BatchResult* result)
+{
+	memset(result, 0, sizeof(BatchResult));
+
+	dropDuplicates(list);
+
+	int workers = config->workers > 0 ? config->workers : cpuCount();
+	if (workers > list->count) workers = list->count > 0 ? list->count : 1;
+	result->workers = workers;
+
+	// largest first, dealt so each queue holds about the same number of bytes
+	qsort(list->files, list->count, sizeof(BatchFile), compareSizeDescending);
+
+	BatchJob job;
+	job.list = list;
+	job.config = config;
+	job.workers = workers;
+	job.done = 0;
+
+	job.deques = (BatchDeque*)procsSharedAlloc(workers * sizeof(BatchDeque));
+	job.counters = (BatchCounters*)procsSharedAlloc(sizeof(BatchCounters));
+	int* owner = (int*)malloc((list->count > 0 ? list->count : 1) * sizeof(int));
+	int* storage = (int*)malloc((list->count > 0 ? list->count : 1) * sizeof(int));
+	int* dealt = (int*)calloc(workers, sizeof(int));
+
+	if (job.deques == NULL || job.counters == NULL || owner == NULL || storage == NULL || dealt == NULL)
+	{
+		procsSharedFree(job.deques, workers * sizeof(BatchDeque));
+		procsSharedFree(job.counters, sizeof(BatchCounters));
+		free(owner);
+		free(storage);
+		free(dealt);
+		return NC_ENOMEM;
+	}
+
+	// greedy partition: each file goes to the queue with the fewest bytes so far
+	for (int i = 0; i < list->count; ++i)
+	{
+		int lightest = 0;
+		for (int w = 1; w < workers; ++w)
+		{
+			if (job.deques[w].bytes < job.deques[lightest].bytes)
+				lightest = w;
+		}
+
+		owner[i] = lightest;
+		job.deques[lightest].bytes += list->files[i].size;
+		++dealt[lightest];
+	}
+
+	// each queue is a contiguous run of storage, still in descending size order
+	int offset = 0;
+	for (int w = 0; w < workers; ++w)
+	{
+		job.deques[w].items = storage + offset;
+		job.deques[w].remaining = (unsigned long long)dealt[w];
+		offset += dealt[w];
+	}
+
+	for (int i = 0; i < list->count; ++i)
+	{
+		BatchDeque* deque = &job.deques[owner[i]];
+		deque->items[deque->tail++] = i;
+
+		// a file whose worker died before sending it back stays failed
+		list->files[i].status = NC_EIO;
+	}
+
+	free(owner);
+	free(dealt);
+
+	double begin = wallClock();
+
+	// a worker that died takes only the file it had with it; the queues it
+	// left are emptied by the others
+	int status = procsRun(workers, batchProcMain, &job, batchProcReceive, &job);
+
+	result->seconds = wallClock() - begin;
+	result->steals = job.counters->steals;
+
+	procsSharedFree(job.deques, workers * sizeof(BatchDeque));
+	procsSharedFree(job.counters, sizeof(BatchCounters));
+	free(storage);
+
+	qsort(list->files, list->count, sizeof(BatchFile), comparePath);
+
+	for (int i = 0; i < list->count; ++i)
+	{
+		const BatchFile* file = &list->files[i];
+
+		++result->files;
+		if (file->status != NC_NOERR) ++result->failed;
+		result->bytes += file->size;
+		result->bytesRead += file->bytesRead;
+
+		for (int v = 0; v < file->nVars; ++v)
+		{
+			++result->vars;
+			if (file->vars[v].hasStats)
+			{
+				++result->varsComputed;
+				if (file->vars[v].cached) ++result->varsCached;
+			}
+		}
+	}
+
+	return status == NC_ENOMEM ? status : NC_NOERR;
+}
+
+/* ---------------------------------------------------------------------------
+ * Report
+ * ------------------------------------------------------------------------- */
+
+const char* batchFormatName(int format)
+{
+	switch (format)
+	{
+	case NC_FORMAT_CLASSIC:
+		return "classic";
+	case NC_FORMAT_64BIT_OFFSET:
+		return "64bit_offset";
+	case NC_FORMAT_CDF5:
+		return "cdf5";
+	case NC_FORMAT_NETCDF4:
+		return "netcdf4";
+	case NC_FORMAT_NETCDF4_CLASSIC:
+		return "netcdf4_classic";
+	default:
+		return "unknown";
+	}
+}
+
+static void writeFileFields(OutWriter* out, const BatchFile* file)
+{
+	outString(out, "path", file->path);
+	outUInt(out, "size", file->size);
+	outString(out, "format", file->format != 0 ? batchFormatName(file->format) : NULL);
+	outString(out, "status", file->status == NC_NOERR ? "ok" : "error");
+	outInt(out, "dims", file->nDims);
+	outInt(out, "vars", file->nVars);
+	outInt(out, "attrs", file->nAttrs);
+	outDouble(out, "seconds", file->seconds);
+	outString(out, "error", file->status == NC_NOERR ? NULL : nc_strerror(file->status));
+}
+
+static void writeVarFields(OutWriter* out, const BatchVar* var)
+{
+	outString(out, "variable", var ? var->name : NULL);
+	outString(out, "type", var ? var->typeName : NULL);
+	outString(out, "shape", var ? var->shape : NULL);
+
+	if (var && var->hasStats)
+	{
+		outUInt(out, "count", var->count);
+		outUInt(out, "valid", var->valid);
+	}
+	else
+	{
+		outNull(out, "count");
+		outNull(out, "valid");
+	}
+
+	if (var && var->hasStats && var->valid > 0)
+	{
+		outDouble(out, "min", var->min);
+		outDouble(out, "max", var->max);
+		outDouble(out, "mean", var->mean);
+		outDouble(out, "std", var->stdDev);
+	}
+	else
+	{
+		outNull(out, "min");
+		outNull(out, "max");
+		outNull(out, "mean");
+		outNull(out, "std");
+	}
+
+	if (var && var->hasStats)
+		outBool(out, "cached", var->cached);
+	else
+		outNull(out, "cached");
+}
+
+bool batchWriteReport(const BatchList* list, OutWriter* out)
+{
+	outBeginTable(out, "report");
+
+	for (int i = 0; i < list->count; ++i)
+	{
+		const BatchFile* file = &list->files[i];
+
+		if (file->nVars == 0)
+		{
+			outBeginRecord(out);
+			writeFileFields(out, file);
+			writeVarFields(out, NULL);
+			outEndRecord(out);
+			continue;
+		}
+
+		for (int v = 0; v < file->nVars; ++v)
+		{
+			outBeginRecord(out);
+			writeFileFields(out, file);
+			writeVarFields(out, &file->vars[v]);
+			outEndRecord(out);
+		}
+	}
+
+	outEndTable(out);
+	return outFlush(out);
+}
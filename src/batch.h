@@ -0,0 +1,105 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "output.h"
+#include "stats.h"
+
+#include <stdio.h>
+
+// Summary statistics of one variable, in physical units when the variable is packed or masked
+typedef struct BatchVar
+{
+	char name[NC_MAX_NAME + 1];
+	char typeName[NC_MAX_NAME + 1];
+	char* shape;                  // "100x360x720", "" for scalars
+	int status;                   // NC_EBADTYPE for variables without statistics
+	bool hasStats;
+	bool cached;
+	unsigned long long count;
+	unsigned long long valid;
+	double min;
+	double max;
+	double mean;
+	double stdDev;
+} BatchVar;
+
+typedef struct BatchFile
+{
+	char* path;
+	unsigned long long size;      // bytes on disk
+	int status;                   // first error met scanning the file
+	int format;                   // NC_FORMAT_*
+	int nDims;
+	int nVars;
+	int nAttrs;
+	int unlimDim;                 // -1 when there is none
+	BatchVar* vars;
+	unsigned long long bytesRead; // values read for statistics, cache hits excluded
+	double seconds;
+	void* extra;                  // set by BatchConfig.visit; the caller takes and frees it
+	size_t extraSize;
+} BatchFile;
+
+typedef struct BatchList
+{
+	BatchFile* files;
+	int count;
+	int capacity;
+} BatchList;
+
+typedef void (*BatchProgress)(int done, int total, const BatchFile* file, void* user);
+
+// Called in a worker with each file still open, after its summary and
+// statistics; netCDF calls must be made under ncLock. Workers are processes
+// of their own, so what the caller is to see goes in file->extra: extraSize
+// bytes from malloc, holding no pointers, copied back to the caller's list.
+typedef void (*BatchVisit)(BatchFile* file, int ncid, void* user);
+
+typedef struct BatchConfig
+{
+	StatsConfig stats;     // template for every variable; path is set per file
+	int workers;           // 0 for one per core
+	bool statistics;       // false to only gather the summaries
+	BatchProgress progress; // optional, called on the calling thread as each file finishes
+	BatchVisit visit;      // optional
+	void* user;
+} BatchConfig;
+
+typedef struct BatchResult
+{
+	int files;
+	int failed;
+	int vars;
+	int varsComputed;
+	int varsCached;
+	unsigned long long bytes;     // on disk
+	unsigned long long bytesRead; // values read
+	unsigned long long steals;    // files taken from another worker's queue
+	int workers;
+	double seconds;
+} BatchResult;
+
+void batchListInit(BatchList* list);
+void batchListFree(BatchList* list);
+
+// Adds pattern to the list: a file, a directory (searched recursively for
+// .nc, .nc4, .cdf and .netcdf files) or a wildcard pattern whose matches are
+// either. Returns false when nothing matched.
+bool batchCollect(BatchList* list, const char* pattern);
+
+// Scans every file on a pool of worker processes (see procsRun), each with
+// its own copy of libnetcdf. Files are dealt largest first into a queue per
+// worker, and a worker whose queue runs dry takes the largest file left in
+// the fullest other queue, so no worker sits idle while work remains. Once
+// nothing is left to take, the cores of finished workers go to the
+// statistics of the files still running. A file that fails, or whose worker
+// dies, is recorded and the scan carries on. The list is left sorted by
+// path, with any path collected twice scanned once.
+int batchRun(BatchList* list, const BatchConfig* config, BatchResult* result);
+
+// One record per variable (or per file, for files that failed or have none)
+bool batchWriteReport(const BatchList* list, OutWriter* out);
+
+const char* batchFormatName(int format);
+
+#endif
@@ -0,0 +1,1398 @@
+#include "catalog.h"
+
+#include "output.h"
+#include "statcache.h"
+#include "threads.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define CATALOG_MAGIC "NCXCATLG"
+#define CATALOG_VERSION 1
+#define CATALOG_BYTE_ORDER 0x01020304u
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+
+/* ---------------------------------------------------------------------------
+ * Storage
+ * ------------------------------------------------------------------------- */
+
+void catalogInit(Catalog* catalog)
+{
+	memset(catalog, 0, sizeof(Catalog));
+}
+
+void catalogFree(Catalog* catalog)
+{
+	free(catalog->files);
+	free(catalog->dims);
+	free(catalog->vars);
+	free(catalog->attrs);
+	free(catalog->terms);
+	free(catalog->postings);
+	free(catalog->strings);
+	free(catalog->intern);
+	catalogInit(catalog);
+}
+
+const char* catalogString(const Catalog* catalog, unsigned offset)
+{
+	return offset < catalog->stringsLen ? catalog->strings + offset : "";
+}
+
+static unsigned long long fnv1a(const void* data, size_t n, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+// Makes room for one more item in a growing array
+static bool reserve(void** data, unsigned* cap, unsigned count, size_t itemSize)
+{
+	if (count < *cap) return true;
+	if (*cap >= 0x7FFFFFFFu) return false;
+
+	unsigned capacity = *cap > 0 ? *cap * 2 : 64;
+	void* grown = realloc(*data, (size_t)capacity * itemSize);
+	if (grown == NULL) return false;
+
+	*data = grown;
+	*cap = capacity;
+	return true;
+}
+
+static bool growIntern(Catalog* catalog)
+{
+	unsigned long long capacity = catalog->internCap > 0 ? catalog->internCap * 2 : 4096;
+	unsigned* slots = (unsigned*)calloc((size_t)capacity, sizeof(unsigned));
+	if (slots == NULL) return false;
+
+	for (unsigned long long i = 0; i < catalog->internCap; ++i)
+	{
+		unsigned entry = catalog->intern[i];
+		if (entry == 0) continue;
+
+		const char* text = catalog->strings + (entry - 1);
+		unsigned long long slot = fnv1a(text, strlen(text), FNV_OFFSET) & (capacity - 1);
+		while (slots[slot] != 0)
+			slot = (slot + 1) & (capacity - 1);
+		slots[slot] = entry;
+	}
+
+	free(catalog->intern);
+	catalog->intern = slots;
+	catalog->internCap = capacity;
+	return true;
+}
+
+// Stores text once however often it is added; returns false when out of memory
+// or past the 4 GiB the offsets can reach
+static bool addString(Catalog* catalog, const char* text, size_t len, unsigned* offset)
+{
+	if ((catalog->internUsed + 1) * 2 > catalog->internCap && !growIntern(catalog))
+		return false;
+
+	unsigned long long mask = catalog->internCap - 1;
+	unsigned long long slot = fnv1a(text, len, FNV_OFFSET) & mask;
+
+	for (; catalog->intern[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const char* stored = catalog->strings + (catalog->intern[slot] - 1);
+		if (strncmp(stored, text, len) == 0 && stored[len] == '\0')
+		{
+			*offset = catalog->intern[slot] - 1;
+			return true;
+		}
+	}
+
+	if (catalog->stringsLen + len + 1 >= 0xFFFFFFFFull) return false;
+
+	if (catalog->stringsLen + len + 1 > catalog->stringsCap)
+	{
+		unsigned long long capacity = catalog->stringsCap > 0 ? catalog->stringsCap : 65536;
+		while (capacity < catalog->stringsLen + len + 1)
+			capacity *= 2;
+
+		char* grown = (char*)realloc(catalog->strings, (size_t)capacity);
+		if (grown == NULL) return false;
+
+		catalog->strings = grown;
+		catalog->stringsCap = capacity;
+	}
+
+	*offset = (unsigned)catalog->stringsLen;
+	memcpy(catalog->strings + catalog->stringsLen, text, len);
+	catalog->strings[catalog->stringsLen + len] = '\0';
+	catalog->stringsLen += len + 1;
+
+	catalog->intern[slot] = *offset + 1;
+	++catalog->internUsed;
+	return true;
+}
+
+static bool addText(Catalog* catalog, const char* text, unsigned* offset)
+{
+	return addString(catalog, text, strlen(text), offset);
+}
+
+/* ---------------------------------------------------------------------------
+ * Reading one file
+ * ------------------------------------------------------------------------- */
+
+typedef struct TextBuffer
+{
+	char text[CATALOG_MAX_VALUE + 1];
+	size_t len;
+	bool truncated;
+} TextBuffer;
+
+static void appendText(TextBuffer* buffer, const char* text, size_t len)
+{
+	if (buffer->len + len > CATALOG_MAX_VALUE)
+	{
+		len = CATALOG_MAX_VALUE - buffer->len;
+		buffer->truncated = true;
+	}
+
+	memcpy(buffer->text + buffer->len, text, len);
+	buffer->len += len;
+	buffer->text[buffer->len] = '\0';
+}
+
+static void appendNumber(TextBuffer* buffer, const char* text, size_t len)
+{
+	if (buffer->len > 0) appendText(buffer, " ", 1);
+	appendText(buffer, text, len);
+}
+
+// The attribute's value as text: characters as they are, numbers in the
+// fewest digits that read back exactly, separated by spaces
+static int readAttribValue(int ncid, int varID, const char* name, nc_type type, size_t len, TextBuffer* value)
+{
+	value->len = 0;
+	value->text[0] = '\0';
+	value->truncated = false;
+
+	if (len == 0) return NC_NOERR;
+
+	int status = NC_NOERR;
+	char number[32];
+
+	switch (type)
+	{
+	case NC_CHAR:
+	{
+		char* text = (char*)malloc(len);
+		if (text == NULL) return NC_ENOMEM;
+		status = nc_get_att_text(ncid, varID, name, text);
+		if (status == NC_NOERR) appendText(value, text, strnlen(text, len));
+		free(text);
+		break;
+	}
+	case NC_STRING:
+	{
+		char** strings = (char**)malloc(len * sizeof(char*));
+		if (strings == NULL) return NC_ENOMEM;
+		status = nc_get_att_string(ncid, varID, name, strings);
+		if (status == NC_NOERR)
+		{
+			for (size_t i = 0; i < len; ++i)
+			{
+				if (i > 0) appendText(value, " ", 1);
+				if (strings[i] != NULL) appendText(value, strings[i], strlen(strings[i]));
+			}
+			nc_free_string(len, strings);
+		}
+		free(strings);
+		break;
+	}
+	case NC_FLOAT:
+	{
+		float* values = (float*)malloc(len * sizeof(float));
+		if (values == NULL) return NC_ENOMEM;
+		status = nc_get_att_float(ncid, varID, name, values);
+		for (size_t i = 0; status == NC_NOERR && i < len && !value->truncated; ++i)
+			appendNumber(value, number, outFormatFloat(number, values[i]));
+		free(values);
+		break;
+	}
+	case NC_DOUBLE:
+	{
+		double* values = (double*)malloc(len * sizeof(double));
+		if (values == NULL) return NC_ENOMEM;
+		status = nc_get_att_double(ncid, varID, name, values);
+		for (size_t i = 0; status == NC_NOERR && i < len && !value->truncated; ++i)
+			appendNumber(value, number, outFormatDouble(number, values[i]));
+		free(values);
+		break;
+	}
+	case NC_UINT64:
+	{
+		unsigned long long* values = (unsigned long long*)malloc(len * sizeof(unsigned long long));
+		if (values == NULL) return NC_ENOMEM;
+		status = nc_get_att_ulonglong(ncid, varID, name, values);
+		for (size_t i = 0; status == NC_NOERR && i < len && !value->truncated; ++i)
+			appendNumber(value, number, outFormatUInt(number, values[i]));
+		free(values);
+		break;
+	}
+	case NC_BYTE:
+	case NC_UBYTE:
+	case NC_SHORT:
+	case NC_USHORT:
+	case NC_INT:
+	case NC_UINT:
+	case NC_INT64:
+	{
+		long long* values = (long long*)malloc(len * sizeof(long long));
+		if (values == NULL) return NC_ENOMEM;
+		status = nc_get_att_longlong(ncid, varID, name, values);
+		for (size_t i = 0; status == NC_NOERR && i < len && !value->truncated; ++i)
+			appendNumber(value, number, outFormatInt(number, values[i]));
+		free(values);
+		break;
+	}
+	default:
+		// user-defined types have no plain text form; they are listed by name and type only
+		break;
+	}
+
+	return status;
+}
+
+static int readAttribs(Catalog* catalog, int ncid, int varID, int nAttrs, TextBuffer* value)
+{
+	for (int a = 0; a < nAttrs; ++a)
+	{
+		char name[NC_MAX_NAME + 1];
+		char typeName[NC_MAX_NAME + 1];
+		nc_type type;
+		size_t len;
+
+		int status = nc_inq_attname(ncid, varID, a, name);
+		if (status == NC_NOERR) status = nc_inq_att(ncid, varID, name, &type, &len);
+		if (status == NC_NOERR) status = nc_inq_type(ncid, type, typeName, NULL);
+		if (status == NC_NOERR) status = readAttribValue(ncid, varID, name, type, len, value);
+		if (status != NC_NOERR) return status;
+
+		if (!reserve((void**)&catalog->attrs, &catalog->attrsCap, catalog->nAttrs, sizeof(CatalogAttr)))
+			return NC_ENOMEM;
+
+		CatalogAttr* attr = &catalog->attrs[catalog->nAttrs];
+		attr->var = varID;
+
+		if (!addText(catalog, name, &attr->name) || !addText(catalog, typeName, &attr->type) ||
+			!addString(catalog, value->text, value->len, &attr->value))
+			return NC_ENOMEM;
+
+		++catalog->nAttrs;
+	}
+
+	return NC_NOERR;
+}
+
+// One file's dimensions, variables and attributes into an empty catalog
+static int readFile(Catalog* catalog, int ncid, const BatchFile* source)
+{
+	int nDims, nVars, nAttrs, format;
+	int status = nc_inq(ncid, &nDims, &nVars, &nAttrs, NULL);
+	if (status == NC_NOERR) status = nc_inq_format(ncid, &format);
+	if (status != NC_NOERR) return status;
+
+	int nUnlimDims, unlimDimIDs[NC_MAX_DIMS];
+	status = nc_inq_unlimdims(ncid, &nUnlimDims, unlimDimIDs);
+	if (status != NC_NOERR) return status;
+
+	if (!reserve((void**)&catalog->files, &catalog->filesCap, 0, sizeof(CatalogFile)))
+		return NC_ENOMEM;
+
+	CatalogFile* file = &catalog->files[0];
+	memset(file, 0, sizeof(CatalogFile));
+	file->format = format;
+	if (!addText(catalog, source->path, &file->path)) return NC_ENOMEM;
+	catalog->nFiles = 1;
+
+	for (int d = 0; d < nDims; ++d)
+	{
+		char name[NC_MAX_NAME + 1];
+		size_t len;
+
+		status = nc_inq_dim(ncid, d, name, &len);
+		if (status != NC_NOERR) return status;
+
+		if (!reserve((void**)&catalog->dims, &catalog->dimsCap, catalog->nDims, sizeof(CatalogDim)))
+			return NC_ENOMEM;
+
+		CatalogDim* dim = &catalog->dims[catalog->nDims];
+		dim->len = len;
+		dim->unlimited = 0;
+		for (int u = 0; u < nUnlimDims; ++u)
+		{
+			if (unlimDimIDs[u] == d)
+				dim->unlimited = 1;
+		}
+
+		if (!addText(catalog, name, &dim->name)) return NC_ENOMEM;
+		++catalog->nDims;
+	}
+
+	TextBuffer* value = (TextBuffer*)malloc(sizeof(TextBuffer));
+	if (value == NULL) return NC_ENOMEM;
+
+	status = readAttribs(catalog, ncid, NC_GLOBAL, nAttrs, value);
+
+	for (int v = 0; status == NC_NOERR && v < nVars; ++v)
+	{
+		char name[NC_MAX_NAME + 1];
+		char typeName[NC_MAX_NAME + 1];
+		int varDims, dimIDs[NC_MAX_VAR_DIMS], varAttrs;
+		nc_type type;
+
+		status = nc_inq_var(ncid, v, name, &type, &varDims, dimIDs, &varAttrs);
+		if (status == NC_NOERR) status = nc_inq_type(ncid, type, typeName, NULL);
+		if (status != NC_NOERR) break;
+
+		// dimension names and lengths, the first into value and the second after it
+		char shape[NC_MAX_VAR_DIMS * 21 + 1];
+		size_t shapeLen = 0;
+		value->len = 0;
+		value->text[0] = '\0';
+		value->truncated = false;
+		shape[0] = '\0';
+
+		for (int d = 0; status == NC_NOERR && d < varDims; ++d)
+		{
+			char dimName[NC_MAX_NAME + 1];
+			size_t len;
+
+			status = nc_inq_dim(ncid, dimIDs[d], dimName, &len);
+			if (status != NC_NOERR) break;
+
+			if (d > 0) appendText(value, " ", 1);
+			appendText(value, dimName, strlen(dimName));
+			shapeLen += sprintf(shape + shapeLen, d > 0 ? "x%zu" : "%zu", len);
+		}
+
+		if (status != NC_NOERR) break;
+
+		if (!reserve((void**)&catalog->vars, &catalog->varsCap, catalog->nVars, sizeof(CatalogVar)))
+		{
+			status = NC_ENOMEM;
+			break;
+		}
+
+		CatalogVar* var = &catalog->vars[catalog->nVars];
+		if (!addText(catalog, name, &var->name) || !addText(catalog, typeName, &var->type) ||
+			!addString(catalog, value->text, value->len, &var->dims) || !addString(catalog, shape, shapeLen, &var->shape))
+		{
+			status = NC_ENOMEM;
+			break;
+		}
+		++catalog->nVars;
+
+		status = readAttribs(catalog, ncid, v, varAttrs, value);
+	}
+
+	free(value);
+
+	file = &catalog->files[0];
+	file->nDims = catalog->nDims;
+	file->nVars = catalog->nVars;
+	file->nAttrs = catalog->nAttrs;
+
+	return status;
+}
+
+// A one-file catalog as visitFile hands it back from a worker: this header,
+// then the file, its dimensions, variables and attributes, then the strings
+typedef struct PackedCatalog
+{
+	unsigned nDims;
+	unsigned nVars;
+	unsigned nAttrs;
+	unsigned reserved;
+	unsigned long long stringsLen;
+} PackedCatalog;
+
+static void* packCatalog(const Catalog* one, size_t* size)
+{
+	PackedCatalog header = { one->nDims, one->nVars, one->nAttrs, 0, one->stringsLen };
+	size_t dims = (size_t)one->nDims * sizeof(CatalogDim);
+	size_t vars = (size_t)one->nVars * sizeof(CatalogVar);
+	size_t attrs = (size_t)one->nAttrs * sizeof(CatalogAttr);
+
+	*size = sizeof(PackedCatalog) + sizeof(CatalogFile) + dims + vars + attrs + (size_t)one->stringsLen;
+
+	unsigned char* packed = (unsigned char*)malloc(*size);
+	if (packed == NULL) return NULL;
+
+	unsigned char* pos = packed;
+	memcpy(pos, &header, sizeof(PackedCatalog));
+	pos += sizeof(PackedCatalog);
+	memcpy(pos, one->files, sizeof(CatalogFile));
+	pos += sizeof(CatalogFile);
+	if (dims > 0) memcpy(pos, one->dims, dims);
+	pos += dims;
+	if (vars > 0) memcpy(pos, one->vars, vars);
+	pos += vars;
+	if (attrs > 0) memcpy(pos, one->attrs, attrs);
+	pos += attrs;
+	if (one->stringsLen > 0) memcpy(pos, one->strings, (size_t)one->stringsLen);
+
+	return packed;
+}
+
+// Points one at a packed catalog, which it reads in place; false when the
+// sizes do not add up. Every section is a multiple of 8 bytes, so the
+// arrays stay aligned.
+static bool unpackCatalog(const void* data, size_t size, Catalog* one)
+{
+	catalogInit(one);
+	if (data == NULL || size < sizeof(PackedCatalog) + sizeof(CatalogFile)) return false;
+
+	const unsigned char* pos = (const unsigned char*)data;
+	PackedCatalog header;
+	memcpy(&header, pos, sizeof(PackedCatalog));
+	pos += sizeof(PackedCatalog);
+	size -= sizeof(PackedCatalog) + sizeof(CatalogFile);
+
+	unsigned long long dims = (unsigned long long)header.nDims * sizeof(CatalogDim);
+	unsigned long long vars = (unsigned long long)header.nVars * sizeof(CatalogVar);
+	unsigned long long attrs = (unsigned long long)header.nAttrs * sizeof(CatalogAttr);
+	if (dims + vars + attrs + header.stringsLen != size) return false;
+
+	one->files = (CatalogFile*)pos;
+	pos += sizeof(CatalogFile);
+	one->dims = (CatalogDim*)pos;
+	pos += dims;
+	one->vars = (CatalogVar*)pos;
+	pos += vars;
+	one->attrs = (CatalogAttr*)pos;
+	pos += attrs;
+	one->strings = (char*)pos;
+
+	one->nFiles = 1;
+	one->nDims = header.nDims;
+	one->nVars = header.nVars;
+	one->nAttrs = header.nAttrs;
+	one->stringsLen = header.stringsLen;
+
+	const CatalogFile* file = &one->files[0];
+	return file->firstDim == 0 && file->nDims == one->nDims && file->firstVar == 0 && file->nVars == one->nVars &&
+		file->firstAttr == 0 && file->nAttrs == one->nAttrs;
+}
+
+// BatchVisit: reads the file into a catalog of its own, left packed in file->extra.
+// It runs in a worker process, so the lock held over the read is that worker's own.
+static void visitFile(BatchFile* file, int ncid, void* user)
+{
+	(void)user;
+
+	Catalog one;
+	catalogInit(&one);
+
+	ncLock();
+	int status = readFile(&one, ncid, file);
+	ncUnlock();
+
+	if (status == NC_NOERR)
+	{
+		file->extra = packCatalog(&one, &file->extraSize);
+		if (file->extra == NULL) status = NC_ENOMEM;
+	}
+
+	if (status != NC_NOERR) file->status = status;
+	catalogFree(&one);
+}
+
+/* ---------------------------------------------------------------------------
+ * Merging and indexing
+ * ------------------------------------------------------------------------- */
+
+typedef struct Stamp
+{
+	char* path; // canonical
+	unsigned long long size;
+	long long mtime;
+	long long mtimeNsec;
+} Stamp;
+
+static int compareStamps(const void* a, const void* b)
+{
+	return strcmp(((const Stamp*)a)->path, ((const Stamp*)b)->path);
+}
+
+// Index of path among the catalog's files, which are sorted by path, or -1
+static int findFile(const Catalog* catalog, const char* path)
+{
+	unsigned lo = 0, hi = catalog->nFiles;
+
+	while (lo < hi)
+	{
+		unsigned mid = lo + (hi - lo) / 2;
+		int order = strcmp(catalogString(catalog, catalog->files[mid].path), path);
+
+		if (order == 0) return (int)mid;
+		if (order < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+static int findScanned(const BatchList* list, const char* path)
+{
+	int lo = 0, hi = list->count;
+
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		int order = strcmp(list->files[mid].path, path);
+
+		if (order == 0) return mid;
+		if (order < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+// Copies file index of src, strings and all, to the end of dst
+static int appendFile(Catalog* dst, const Catalog* src, unsigned index, const Stamp* stamp, int status)
+{
+	const CatalogFile* from = &src->files[index];
+
+	if (!reserve((void**)&dst->files, &dst->filesCap, dst->nFiles, sizeof(CatalogFile)))
+		return NC_ENOMEM;
+
+	CatalogFile file = *from;
+	file.size = stamp->size;
+	file.mtime = stamp->mtime;
+	file.mtimeNsec = stamp->mtimeNsec;
+	file.status = status;
+	file.firstDim = dst->nDims;
+	file.firstVar = dst->nVars;
+	file.firstAttr = dst->nAttrs;
+
+	if (!addText(dst, stamp->path, &file.path)) return NC_ENOMEM;
+
+	for (unsigned d = 0; d < from->nDims; ++d)
+	{
+		if (!reserve((void**)&dst->dims, &dst->dimsCap, dst->nDims, sizeof(CatalogDim)))
+			return NC_ENOMEM;
+
+		CatalogDim dim = src->dims[from->firstDim + d];
+		if (!addText(dst, catalogString(src, dim.name), &dim.name)) return NC_ENOMEM;
+		dst->dims[dst->nDims++] = dim;
+	}
+
+	for (unsigned v = 0; v < from->nVars; ++v)
+	{
+		if (!reserve((void**)&dst->vars, &dst->varsCap, dst->nVars, sizeof(CatalogVar)))
+			return NC_ENOMEM;
+
+		CatalogVar var = src->vars[from->firstVar + v];
+		if (!addText(dst, catalogString(src, var.name), &var.name) || !addText(dst, catalogString(src, var.type), &var.type) ||
+			!addText(dst, catalogString(src, var.dims), &var.dims) || !addText(dst, catalogString(src, var.shape), &var.shape))
+			return NC_ENOMEM;
+		dst->vars[dst->nVars++] = var;
+	}
+
+	for (unsigned a = 0; a < from->nAttrs; ++a)
+	{
+		if (!reserve((void**)&dst->attrs, &dst->attrsCap, dst->nAttrs, sizeof(CatalogAttr)))
+			return NC_ENOMEM;
+
+		CatalogAttr attr = src->attrs[from->firstAttr + a];
+		if (!addText(dst, catalogString(src, attr.name), &attr.name) || !addText(dst, catalogString(src, attr.type), &attr.type) ||
+			!addText(dst, catalogString(src, attr.value), &attr.value))
+			return NC_ENOMEM;
+		dst->attrs[dst->nAttrs++] = attr;
+	}
+
+	dst->files[dst->nFiles++] = file;
+	return NC_NOERR;
+}
+
+// A file that could not be read: kept with its error and nothing else
+static int appendFailed(Catalog* dst, const Stamp* stamp, int status)
+{
+	if (!reserve((void**)&dst->files, &dst->filesCap, dst->nFiles, sizeof(CatalogFile)))
+		return NC_ENOMEM;
+
+	CatalogFile* file = &dst->files[dst->nFiles];
+	memset(file, 0, sizeof(CatalogFile));
+	file->size = stamp->size;
+	file->mtime = stamp->mtime;
+	file->mtimeNsec = stamp->mtimeNsec;
+	file->status = status;
+	file->firstDim = dst->nDims;
+	file->firstVar = dst->nVars;
+	file->firstAttr = dst->nAttrs;
+
+	if (!addText(dst, stamp->path, &file->path)) return NC_ENOMEM;
+
+	++dst->nFiles;
+	return NC_NOERR;
+}
+
+typedef struct TermEntry
+{
+	const char* text;
+	unsigned offset;
+	unsigned file;
+	int var;
+} TermEntry;
+
+static int compareEntries(const void* a, const void* b)
+{
+	const TermEntry* x = (const TermEntry*)a;
+	const TermEntry* y = (const TermEntry*)b;
+
+	int order = x->offset == y->offset ? 0 : strcmp(x->text, y->text);
+	if (order != 0) return order;
+	if (x->file != y->file) return x->file < y->file ? -1 : 1;
+	return x->var < y->var ? -1 : (x->var > y->var ? 1 : 0);
+}
+
+typedef struct EntryList
+{
+	TermEntry* items;
+	unsigned count, cap;
+} EntryList;
+
+// Adds prefix followed by the lower-cased parts as a term of file and var.
+// The parts may point into the strings, which move only once they are copied.
+static bool addTerm(Catalog* catalog, EntryList* entries, const char* prefix, const char* name, const char* value, unsigned file, int var)
+{
+	char text[CATALOG_MAX_TERM + NC_MAX_NAME + 16];
+	size_t len = 0;
+
+	for (const char* c = prefix; *c != '\0'; ++c)
+		text[len++] = *c;
+	for (const char* c = name; *c != '\0'; ++c)
+		text[len++] = (char)tolower((unsigned char)*c);
+
+	if (value != NULL)
+	{
+		text[len++] = '=';
+		for (const char* c = value; *c != '\0'; ++c)
+			text[len++] = (char)tolower((unsigned char)*c);
+	}
+
+	if (!reserve((void**)&entries->items, &entries->cap, entries->count, sizeof(TermEntry)))
+		return false;
+
+	TermEntry* entry = &entries->items[entries->count];
+	if (!addString(catalog, text, len, &entry->offset)) return false;
+
+	entry->file = file;
+	entry->var = var;
+	++entries->count;
+	return true;
+}
+
+// Rebuilds the terms and their postings from every file
+static int buildIndex(Catalog* catalog)
+{
+	EntryList entries = { NULL, 0, 0 };
+	bool ok = true;
+
+	for (unsigned f = 0; ok && f < catalog->nFiles; ++f)
+	{
+		const CatalogFile* file = &catalog->files[f];
+
+		for (unsigned d = 0; ok && d < file->nDims; ++d)
+		{
+			const CatalogDim* dim = &catalog->dims[file->firstDim + d];
+			ok = addTerm(catalog, &entries, "dim:", catalogString(catalog, dim->name), NULL, f, -1);
+		}
+
+		for (unsigned v = 0; ok && v < file->nVars; ++v)
+		{
+			const CatalogVar* var = &catalog->vars[file->firstVar + v];
+			ok = addTerm(catalog, &entries, "var:", catalogString(catalog, var->name), NULL, f, (int)v);
+		}
+
+		for (unsigned a = 0; ok && a < file->nAttrs; ++a)
+		{
+			// long values such as histories are kept but not indexed
+			const CatalogAttr* attr = &catalog->attrs[file->firstAttr + a];
+			const char* value = catalogString(catalog, attr->value);
+
+			ok = addTerm(catalog, &entries, "attr:", catalogString(catalog, attr->name), NULL, f, attr->var);
+			if (ok && strlen(value) <= CATALOG_MAX_TERM)
+				ok = addTerm(catalog, &entries, "value:", catalogString(catalog, attr->name), value, f, attr->var);
+		}
+	}
+
+	if (!ok)
+	{
+		free(entries.items);
+		return NC_ENOMEM;
+	}
+
+	// the strings are final now, so entries can point into them
+	for (unsigned i = 0; i < entries.count; ++i)
+		entries.items[i].text = catalog->strings + entries.items[i].offset;
+
+	qsort(entries.items, entries.count, sizeof(TermEntry), compareEntries);
+
+	free(catalog->terms);
+	free(catalog->postings);
+	catalog->terms = (CatalogTerm*)malloc((entries.count > 0 ? entries.count : 1) * sizeof(CatalogTerm));
+	catalog->postings = (CatalogPosting*)malloc((entries.count > 0 ? entries.count : 1) * sizeof(CatalogPosting));
+	catalog->nTerms = 0;
+	catalog->nPostings = 0;
+
+	if (catalog->terms == NULL || catalog->postings == NULL)
+	{
+		free(entries.items);
+		return NC_ENOMEM;
+	}
+
+	for (unsigned i = 0; i < entries.count; ++i)
+	{
+		const TermEntry* entry = &entries.items[i];
+		bool newTerm = i == 0 || entry->offset != entries.items[i - 1].offset;
+
+		// an attribute named twice in one variable is one posting
+		if (!newTerm && entry->file == entries.items[i - 1].file && entry->var == entries.items[i - 1].var)
+			continue;
+
+		if (newTerm)
+		{
+			CatalogTerm* term = &catalog->terms[catalog->nTerms++];
+			term->text = entry->offset;
+			term->firstPosting = catalog->nPostings;
+			term->nPostings = 0;
+			term->reserved = 0;
+		}
+
+		CatalogPosting* posting = &catalog->postings[catalog->nPostings++];
+		posting->file = entry->file;
+		posting->var = entry->var;
+		++catalog->terms[catalog->nTerms - 1].nPostings;
+	}
+
+	free(entries.items);
+	return NC_NOERR;
+}
+
+int catalogUpdate(const Catalog* old, BatchList* inputs, int workers, Catalog* updated, CatalogUpdate* result)
+{
+	memset(result, 0, sizeof(CatalogUpdate));
+	catalogInit(updated);
+
+	double begin = wallClock();
+
+	// the files already catalogued are checked again along with the inputs
+	for (unsigned f = 0; f < old->nFiles; ++f)
+		batchCollect(inputs, catalogString(old, old->files[f].path));
+
+	Stamp* stamps = (Stamp*)malloc((inputs->count > 0 ? inputs->count : 1) * sizeof(Stamp));
+	FileIdentity* id = (FileIdentity*)malloc(sizeof(FileIdentity));
+	if (stamps == NULL || id == NULL)
+	{
+		free(stamps);
+		free(id);
+		batchListFree(inputs);
+		return NC_ENOMEM;
+	}
+
+	int count = 0;
+	int status = NC_NOERR;
+
+	for (int i = 0; i < inputs->count; ++i)
+	{
+		if (!fileIdentityGet(inputs->files[i].path, id)) continue;
+
+		Stamp* stamp = &stamps[count];
+		stamp->path = (char*)malloc(strlen(id->path) + 1);
+		if (stamp->path == NULL)
+		{
+			status = NC_ENOMEM;
+			break;
+		}
+
+		strcpy(stamp->path, id->path);
+		stamp->size = id->size;
+		stamp->mtime = id->mtime;
+		stamp->mtimeNsec = id->mtimeNsec;
+		++count;
+	}
+
+	free(id);
+	batchListFree(inputs);
+
+	// a file reached by two routes is the same file
+	qsort(stamps, count, sizeof(Stamp), compareStamps);
+
+	int kept = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (kept > 0 && strcmp(stamps[i].path, stamps[kept - 1].path) == 0)
+			free(stamps[i].path);
+		else
+			stamps[kept++] = stamps[i];
+	}
+	count = kept;
+
+	// files new or changed since the last update are opened again; the rest are carried over
+	BatchList scan;
+	batchListInit(&scan);
+	int* previous = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+	if (previous == NULL) status = NC_ENOMEM;
+
+	for (int i = 0; status == NC_NOERR && i < count; ++i)
+	{
+		const Stamp* stamp = &stamps[i];
+		int index = findFile(old, stamp->path);
+
+		if (index >= 0)
+		{
+			const CatalogFile* file = &old->files[index];
+			if (file->size != stamp->size || file->mtime != stamp->mtime || file->mtimeNsec != stamp->mtimeNsec)
+				index = -1;
+		}
+
+		previous[i] = index;
+		if (index < 0 && !batchCollect(&scan, stamp->path))
+			previous[i] = -2; // gone since it was looked at
+	}
+
+	for (unsigned f = 0; f < old->nFiles; ++f)
+	{
+		const char* path = catalogString(old, old->files[f].path);
+		Stamp key = { (char*)path, 0, 0, 0 };
+		if (bsearch(&key, stamps, count, sizeof(Stamp), compareStamps) == NULL)
+			++result->removed;
+	}
+
+	if (status == NC_NOERR && scan.count > 0)
+	{
+		BatchConfig config;
+		memset(&config, 0, sizeof(BatchConfig));
+		config.workers = workers;
+		config.statistics = false;
+		config.visit = visitFile;
+
+		BatchResult batch;
+		status = batchRun(&scan, &config, &batch);
+	}
+
+	for (int i = 0; status == NC_NOERR && i < count; ++i)
+	{
+		const Stamp* stamp = &stamps[i];
+
+		if (previous[i] >= 0)
+		{
+			status = appendFile(updated, old, (unsigned)previous[i], stamp, old->files[previous[i]].status);
+			++result->unchanged;
+			continue;
+		}
+
+		if (previous[i] == -2)
+		{
+			++result->removed;
+			continue;
+		}
+
+		int index = findScanned(&scan, stamp->path);
+		BatchFile* file = index >= 0 ? &scan.files[index] : NULL;
+		Catalog one;
+
+		++result->scanned;
+
+		if (file != NULL && unpackCatalog(file->extra, file->extraSize, &one))
+		{
+			status = appendFile(updated, &one, 0, stamp, NC_NOERR);
+		}
+		else
+		{
+			int failure = file != NULL && file->status != NC_NOERR ? file->status : NC_EIO;
+			status = appendFailed(updated, stamp, failure);
+			++result->failed;
+		}
+	}
+
+	for (int i = 0; i < scan.count; ++i)
+		free(scan.files[i].extra);
+
+	batchListFree(&scan);
+
+	for (int i = 0; i < count; ++i)
+		free(stamps[i].path);
+	free(stamps);
+	free(previous);
+
+	if (status == NC_NOERR) status = buildIndex(updated);
+
+	// only needed while strings are being added
+	free(updated->intern);
+	updated->intern = NULL;
+	updated->internCap = 0;
+	updated->internUsed = 0;
+
+	if (status != NC_NOERR)
+	{
+		catalogFree(updated);
+		return status;
+	}
+
+	result->files = (int)updated->nFiles;
+	result->seconds = wallClock() - begin;
+	return NC_NOERR;
+}
+
+/* ---------------------------------------------------------------------------
+ * Search
+ * ------------------------------------------------------------------------- */
+
+// First term not ordered before key
+static unsigned lowerBound(const Catalog* catalog, const char* key)
+{
+	unsigned lo = 0, hi = catalog->nTerms;
+
+	while (lo < hi)
+	{
+		unsigned mid = lo + (hi - lo) / 2;
+		if (strcmp(catalogString(catalog, catalog->terms[mid].text), key) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+// Calls visit for every posting of the terms key names, exactly or as a prefix
+static void forEachPosting(const Catalog* catalog, const char* key, bool prefix, void (*visit)(const CatalogPosting*, void*), void* user)
+{
+	size_t len = strlen(key);
+
+	for (unsigned t = lowerBound(catalog, key); t < catalog->nTerms; ++t)
+	{
+		const CatalogTerm* term = &catalog->terms[t];
+		const char* text = catalogString(catalog, term->text);
+
+		if (prefix ? strncmp(text, key, len) != 0 : strcmp(text, key) != 0)
+			break;
+
+		for (unsigned p = 0; p < term->nPostings; ++p)
+			visit(&catalog->postings[term->firstPosting + p], user);
+	}
+}
+
+typedef struct SearchState
+{
+	unsigned* matched; // terms matched so far, by file
+	unsigned term;     // 0-based index of the term being applied
+	int* hits;         // (file, var) pairs of variables in files that match every term
+	int nHits, hitsCap;
+	bool failed;
+} SearchState;
+
+static void markFile(const CatalogPosting* posting, void* user)
+{
+	SearchState* state = (SearchState*)user;
+
+	// a file counts once per term, however many postings it has for it
+	if (state->matched[posting->file] == state->term)
+		state->matched[posting->file] = state->term + 1;
+}
+
+static void collectVar(const CatalogPosting* posting, void* user)
+{
+	SearchState* state = (SearchState*)user;
+
+	if (posting->var < 0 || state->matched[posting->file] != state->term) return;
+
+	if (state->nHits + 2 > state->hitsCap)
+	{
+		int capacity = state->hitsCap > 0 ? state->hitsCap * 2 : 256;
+		int* grown = (int*)realloc(state->hits, capacity * sizeof(int));
+		if (grown == NULL)
+		{
+			state->failed = true;
+			return;
+		}
+
+		state->hits = grown;
+		state->hitsCap = capacity;
+	}
+
+	state->hits[state->nHits++] = (int)posting->file;
+	state->hits[state->nHits++] = posting->var;
+}
+
+static int compareHits(const void* a, const void* b)
+{
+	const int* x = (const int*)a;
+	const int* y = (const int*)b;
+	if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+	return x[1] < y[1] ? -1 : (x[1] > y[1] ? 1 : 0);
+}
+
+// The index keys a query term stands for: one, or three for a bare name
+static int expandTerm(const char* term, char keys[3][CATALOG_MAX_TERM + NC_MAX_NAME + 16], bool* prefix)
+{
+	size_t len = strlen(term);
+	*prefix = len > 0 && term[len - 1] == '*';
+	if (*prefix) --len;
+
+	if (len > CATALOG_MAX_TERM + NC_MAX_NAME) return 0;
+
+	char lower[CATALOG_MAX_TERM + NC_MAX_NAME + 1];
+	for (size_t i = 0; i < len; ++i)
+		lower[i] = (char)tolower((unsigned char)term[i]);
+	lower[len] = '\0';
+
+	if (strncmp(lower, "var:", 4) == 0 || strncmp(lower, "dim:", 4) == 0 || strncmp(lower, "attr:", 5) == 0)
+	{
+		strcpy(keys[0], lower);
+		return 1;
+	}
+
+	if (strchr(lower, '=') != NULL)
+	{
+		snprintf(keys[0], sizeof(keys[0]), "value:%s", lower);
+		return 1;
+	}
+
+	snprintf(keys[0], sizeof(keys[0]), "var:%s", lower);
+	snprintf(keys[1], sizeof(keys[1]), "dim:%s", lower);
+	snprintf(keys[2], sizeof(keys[2]), "attr:%s", lower);
+	return 3;
+}
+
+int catalogSearch(const Catalog* catalog, const char* const* terms, int nTerms, CatalogResult* result)
+{
+	memset(result, 0, sizeof(CatalogResult));
+	if (nTerms <= 0) return NC_EINVAL;
+
+	double begin = wallClock();
+
+	SearchState state;
+	memset(&state, 0, sizeof(SearchState));
+	state.matched = (unsigned*)calloc(catalog->nFiles > 0 ? catalog->nFiles : 1, sizeof(unsigned));
+	if (state.matched == NULL) return NC_ENOMEM;
+
+	// a file survives a term only if it matched every term before it
+	char keys[3][CATALOG_MAX_TERM + NC_MAX_NAME + 16];
+	for (int t = 0; t < nTerms; ++t)
+	{
+		bool prefix;
+		int nKeys = expandTerm(terms[t], keys, &prefix);
+
+		state.term = (unsigned)t;
+		for (int k = 0; k < nKeys; ++k)
+			forEachPosting(catalog, keys[k], prefix, markFile, &state);
+	}
+
+	// then the variables any term found in the files left
+	state.term = (unsigned)nTerms;
+	for (int t = 0; t < nTerms; ++t)
+	{
+		bool prefix;
+		int nKeys = expandTerm(terms[t], keys, &prefix);
+
+		for (int k = 0; k < nKeys; ++k)
+			forEachPosting(catalog, keys[k], prefix, collectVar, &state);
+	}
+
+	int nMatches = 0;
+	for (unsigned f = 0; f < catalog->nFiles; ++f)
+	{
+		if (state.matched[f] == (unsigned)nTerms)
+			++nMatches;
+	}
+
+	if (state.nHits > 0)
+		qsort(state.hits, state.nHits / 2, 2 * sizeof(int), compareHits);
+
+	result->matches = (CatalogMatch*)malloc((nMatches > 0 ? nMatches : 1) * sizeof(CatalogMatch));
+	result->varStorage = (int*)malloc((state.nHits > 0 ? state.nHits / 2 : 1) * sizeof(int));
+
+	if (state.failed || result->matches == NULL || result->varStorage == NULL)
+	{
+		free(state.matched);
+		free(state.hits);
+		catalogResultFree(result);
+		return NC_ENOMEM;
+	}
+
+	int hit = 0, stored = 0;
+	for (unsigned f = 0; f < catalog->nFiles; ++f)
+	{
+		if (state.matched[f] != (unsigned)nTerms) continue;
+
+		CatalogMatch* match = &result->matches[result->count++];
+		match->file = f;
+		match->vars = result->varStorage + stored;
+		match->nVars = 0;
+
+		while (hit < state.nHits && state.hits[hit] < (int)f)
+			hit += 2;
+
+		for (; hit < state.nHits && state.hits[hit] == (int)f; hit += 2)
+		{
+			if (match->nVars == 0 || match->vars[match->nVars - 1] != state.hits[hit + 1])
+			{
+				result->varStorage[stored++] = state.hits[hit + 1];
+				++match->nVars;
+			}
+		}
+	}
+
+	free(state.matched);
+	free(state.hits);
+
+	result->seconds = wallClock() - begin;
+	return NC_NOERR;
+}
+
+void catalogResultFree(CatalogResult* result)
+{
+	free(result->matches);
+	free(result->varStorage);
+	memset(result, 0, sizeof(CatalogResult));
+}
+
+/* ---------------------------------------------------------------------------
+ * On disk
+ * ------------------------------------------------------------------------- */
+
+// The header, then the files, dimensions, variables, attributes, terms and
+// postings arrays as they are in memory, then the strings
+typedef struct CatalogHeader
+{
+	char magic[8];
+	unsigned version;
+	unsigned byteOrder;
+	unsigned nFiles;
+	unsigned nDims;
+	unsigned nVars;
+	unsigned nAttrs;
+	unsigned nTerms;
+	unsigned nPostings;
+	unsigned long long stringsLen;
+	unsigned long long checksum;
+} CatalogHeader;
+
+typedef struct Section
+{
+	void* data;
+	size_t size;
+} Section;
+
+static void getSections(const Catalog* catalog, Section sections[7])
+{
+	sections[0].data = catalog->files;
+	sections[0].size = (size_t)catalog->nFiles * sizeof(CatalogFile);
+	sections[1].data = catalog->dims;
+	sections[1].size = (size_t)catalog->nDims * sizeof(CatalogDim);
+	sections[2].data = catalog->vars;
+	sections[2].size = (size_t)catalog->nVars * sizeof(CatalogVar);
+	sections[3].data = catalog->attrs;
+	sections[3].size = (size_t)catalog->nAttrs * sizeof(CatalogAttr);
+	sections[4].data = catalog->terms;
+	sections[4].size = (size_t)catalog->nTerms * sizeof(CatalogTerm);
+	sections[5].data = catalog->postings;
+	sections[5].size = (size_t)catalog->nPostings * sizeof(CatalogPosting);
+	sections[6].data = catalog->strings;
+	sections[6].size = (size_t)catalog->stringsLen;
+}
+
+static bool replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+bool catalogSave(const Catalog* catalog, const char* path)
+{
+	Section sections[7];
+	getSections(catalog, sections);
+
+	CatalogHeader header;
+	memset(&header, 0, sizeof(CatalogHeader));
+	memcpy(header.magic, CATALOG_MAGIC, 8);
+	header.version = CATALOG_VERSION;
+	header.byteOrder = CATALOG_BYTE_ORDER;
+	header.nFiles = catalog->nFiles;
+	header.nDims = catalog->nDims;
+	header.nVars = catalog->nVars;
+	header.nAttrs = catalog->nAttrs;
+	header.nTerms = catalog->nTerms;
+	header.nPostings = catalog->nPostings;
+	header.stringsLen = catalog->stringsLen;
+
+	header.checksum = FNV_OFFSET;
+	for (int s = 0; s < 7; ++s)
+		header.checksum = fnv1a(sections[s].data, sections[s].size, header.checksum);
+
+	size_t pathLen = strlen(path);
+	char* tmpPath = (char*)malloc(pathLen + 32);
+	if (tmpPath == NULL) return false;
+	snprintf(tmpPath, pathLen + 32, "%s.%ld.tmp", path, (long)getpid());
+
+	FILE* file = fopen(tmpPath, "wb");
+	bool ok = file != NULL;
+
+	if (ok)
+	{
+		ok = fwrite(&header, sizeof(CatalogHeader), 1, file) == 1;
+		for (int s = 0; ok && s < 7; ++s)
+			ok = sections[s].size == 0 || fwrite(sections[s].data, 1, sections[s].size, file) == sections[s].size;
+
+		ok = fclose(file) == 0 && ok;
+		ok = ok && replaceFile(tmpPath, path);
+		if (!ok) remove(tmpPath);
+	}
+
+	free(tmpPath);
+	return ok;
+}
+
+static bool inStrings(const Catalog* catalog, unsigned offset)
+{
+	return offset < catalog->stringsLen;
+}
+
+// Every range and offset in bounds, so nothing read later needs checking
+static bool validCatalog(const Catalog* catalog)
+{
+	if (catalog->stringsLen > 0 && catalog->strings[catalog->stringsLen - 1] != '\0') return false;
+
+	for (unsigned f = 0; f < catalog->nFiles; ++f)
+	{
+		const CatalogFile* file = &catalog->files[f];
+		if (!inStrings(catalog, file->path) ||
+			file->firstDim > catalog->nDims || file->nDims > catalog->nDims - file->firstDim ||
+			file->firstVar > catalog->nVars || file->nVars > catalog->nVars - file->firstVar ||
+			file->firstAttr > catalog->nAttrs || file->nAttrs > catalog->nAttrs - file->firstAttr)
+			return false;
+
+		// files must stay in path order for lookups
+		if (f > 0 && strcmp(catalog->strings + catalog->files[f - 1].path, catalog->strings + file->path) >= 0)
+			return false;
+	}
+
+	for (unsigned d = 0; d < catalog->nDims; ++d)
+	{
+		if (!inStrings(catalog, catalog->dims[d].name)) return false;
+	}
+
+	for (unsigned v = 0; v < catalog->nVars; ++v)
+	{
+		const CatalogVar* var = &catalog->vars[v];
+		if (!inStrings(catalog, var->name) || !inStrings(catalog, var->type) || !inStrings(catalog, var->dims) || !inStrings(catalog, var->shape)) return false;
+	}
+
+	for (unsigned a = 0; a < catalog->nAttrs; ++a)
+	{
+		const CatalogAttr* attr = &catalog->attrs[a];
+		if (!inStrings(catalog, attr->name) || !inStrings(catalog, attr->type) || !inStrings(catalog, attr->value)) return false;
+	}
+
+	for (unsigned t = 0; t < catalog->nTerms; ++t)
+	{
+		const CatalogTerm* term = &catalog->terms[t];
+		if (!inStrings(catalog, term->text) || term->firstPosting > catalog->nPostings || term->nPostings > catalog->nPostings - term->firstPosting)
+			return false;
+	}
+
+	for (unsigned p = 0; p < catalog->nPostings; ++p)
+	{
+		const CatalogPosting* posting = &catalog->postings[p];
+		if (posting->file >= catalog->nFiles) return false;
+		if (posting->var >= 0 && (unsigned)posting->var >= catalog->files[posting->file].nVars) return false;
+	}
+
+	return true;
+}
+
+CatalogLoad catalogLoad(const char* path, Catalog* catalog)
+{
+	catalogInit(catalog);
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return CATALOG_MISSING;
+
+	CatalogHeader header;
+	bool ok = fread(&header, sizeof(CatalogHeader), 1, file) == 1 &&
+		memcmp(header.magic, CATALOG_MAGIC, 8) == 0 && header.version == CATALOG_VERSION && header.byteOrder == CATALOG_BYTE_ORDER &&
+		header.stringsLen < 0xFFFFFFFFull;
+
+	if (ok)
+	{
+		catalog->nFiles = catalog->filesCap = header.nFiles;
+		catalog->nDims = catalog->dimsCap = header.nDims;
+		catalog->nVars = catalog->varsCap = header.nVars;
+		catalog->nAttrs = catalog->attrsCap = header.nAttrs;
+		catalog->nTerms = header.nTerms;
+		catalog->nPostings = header.nPostings;
+		catalog->stringsLen = catalog->stringsCap = header.stringsLen;
+
+		catalog->files = (CatalogFile*)malloc((size_t)(header.nFiles > 0 ? header.nFiles : 1) * sizeof(CatalogFile));
+		catalog->dims = (CatalogDim*)malloc((size_t)(header.nDims > 0 ? header.nDims : 1) * sizeof(CatalogDim));
+		catalog->vars = (CatalogVar*)malloc((size_t)(header.nVars > 0 ? header.nVars : 1) * sizeof(CatalogVar));
+		catalog->attrs = (CatalogAttr*)malloc((size_t)(header.nAttrs > 0 ? header.nAttrs : 1) * sizeof(CatalogAttr));
+		catalog->terms = (CatalogTerm*)malloc((size_t)(header.nTerms > 0 ? header.nTerms : 1) * sizeof(CatalogTerm));
+		catalog->postings = (CatalogPosting*)malloc((size_t)(header.nPostings > 0 ? header.nPostings : 1) * sizeof(CatalogPosting));
+		catalog->strings = (char*)malloc((size_t)(header.stringsLen > 0 ? header.stringsLen : 1));
+
+		ok = catalog->files != NULL && catalog->dims != NULL && catalog->vars != NULL && catalog->attrs != NULL &&
+			catalog->terms != NULL && catalog->postings != NULL && catalog->strings != NULL;
+	}
+
+	if (ok)
+	{
+		Section sections[7];
+		getSections(catalog, sections);
+
+		unsigned long long checksum = FNV_OFFSET;
+		for (int s = 0; ok && s < 7; ++s)
+		{
+			ok = sections[s].size == 0 || fread(sections[s].data, 1, sections[s].size, file) == sections[s].size;
+			if (ok) checksum = fnv1a(sections[s].data, sections[s].size, checksum);
+		}
+
+		ok = ok && fgetc(file) == EOF && checksum == header.checksum && validCatalog(catalog);
+	}
+
+	fclose(file);
+
+	if (!ok)
+	{
+		catalogFree(catalog);
+		return CATALOG_INVALID;
+	}
+
+	return CATALOG_LOADED;
+}
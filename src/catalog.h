@@ -0,0 +1,148 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "batch.h"
+
+#define CATALOG_MAX_VALUE 1024 // attribute values are stored up to this many bytes
+#define CATALOG_MAX_TERM 256   // and indexed only when no longer than this
+
+// Strings live in one block and are referred to by offset, so a catalog is
+// written and read back as a handful of arrays
+
+typedef struct CatalogDim
+{
+	unsigned name;
+	unsigned unlimited;
+	unsigned long long len;
+} CatalogDim;
+
+typedef struct CatalogVar
+{
+	unsigned name;
+	unsigned type;
+	unsigned dims;  // dimension names separated by spaces
+	unsigned shape; // "100x360x720", "" for scalars
+} CatalogVar;
+
+typedef struct CatalogAttr
+{
+	int var;        // -1 for global attributes
+	unsigned name;
+	unsigned type;
+	unsigned value; // text, or numbers separated by spaces
+} CatalogAttr;
+
+typedef struct CatalogFile
+{
+	unsigned long long size;
+	long long mtime;
+	long long mtimeNsec;
+	unsigned path;
+	int status;     // error met reading the file; it is kept so it is not read again until it changes
+	int format;
+	unsigned firstDim, nDims;
+	unsigned firstVar, nVars;
+	unsigned firstAttr, nAttrs;
+} CatalogFile;
+
+// An indexed term, lower case: "var:sst", "dim:time", "attr:units" or
+// "value:standard_name=sea_surface_temperature", with the files (and where
+// it applies, variables) it occurs in
+typedef struct CatalogTerm
+{
+	unsigned text;
+	unsigned firstPosting;
+	unsigned nPostings;
+	unsigned reserved;
+} CatalogTerm;
+
+typedef struct CatalogPosting
+{
+	unsigned file;
+	int var;        // -1 for dimensions and global attributes
+} CatalogPosting;
+
+// Dimensions, variables and attributes of many files as printVarList and
+// printAttribs read them, with an inverted index over their names and
+// attribute values. Files are kept sorted by path and terms by text, so a
+// search is a few binary searches over arrays read straight from disk.
+typedef struct Catalog
+{
+	CatalogFile* files;
+	unsigned nFiles, filesCap;
+	CatalogDim* dims;
+	unsigned nDims, dimsCap;
+	CatalogVar* vars;
+	unsigned nVars, varsCap;
+	CatalogAttr* attrs;
+	unsigned nAttrs, attrsCap;
+	CatalogTerm* terms;
+	unsigned nTerms;
+	CatalogPosting* postings;
+	unsigned nPostings;
+
+	char* strings;
+	unsigned long long stringsLen, stringsCap;
+	unsigned* intern;           // open addressing over string offsets + 1, while building
+	unsigned long long internCap, internUsed;
+} Catalog;
+
+typedef enum CatalogLoad
+{
+	CATALOG_LOADED,
+	CATALOG_MISSING,
+	CATALOG_INVALID // unreadable, damaged or from another version or byte order
+} CatalogLoad;
+
+typedef struct CatalogUpdate
+{
+	int files;      // in the updated catalog
+	int scanned;    // new or changed since the last update
+	int unchanged;  // carried over without opening
+	int removed;    // no longer on disk
+	int failed;     // could not be read, of those scanned
+	double seconds;
+} CatalogUpdate;
+
+typedef struct CatalogMatch
+{
+	unsigned file;
+	int nVars;
+	const int* vars; // variables a term matched, by index within the file
+} CatalogMatch;
+
+typedef struct CatalogResult
+{
+	CatalogMatch* matches; // in path order
+	int count;
+	int* varStorage;
+	double seconds;
+} CatalogResult;
+
+void catalogInit(Catalog* catalog);
+void catalogFree(Catalog* catalog);
+
+CatalogLoad catalogLoad(const char* path, Catalog* catalog);
+
+// Written beside path and renamed over it, so a reader never sees half a catalog
+bool catalogSave(const Catalog* catalog, const char* path);
+
+// Builds updated from old and the files in inputs (as batchCollect gathers
+// them). Every file is identified by its canonical path, size and
+// modification time; files of old that still match are carried over, and
+// only new or changed ones are opened, by a batchRun pool of worker processes
+// (0 for one per core). Each reads its files with its own copy of libnetcdf
+// and sends them back packed; where fork is unavailable the workers are
+// threads and take turns in the library. Files of old not among the inputs
+// are checked too, and dropped once they are gone. The list is consumed.
+int catalogUpdate(const Catalog* old, BatchList* inputs, int workers, Catalog* updated, CatalogUpdate* result);
+
+// Files holding every term. A term is "name=value" for an attribute value,
+// "var:name", "dim:name" or "attr:name" for one kind of name, or a bare name
+// for any of the three. Case is ignored and a trailing * matches any ending.
+int catalogSearch(const Catalog* catalog, const char* const* terms, int nTerms, CatalogResult* result);
+void catalogResultFree(CatalogResult* result);
+
+const char* catalogString(const Catalog* catalog, unsigned offset);
+
+#endif
@@ -0,0 +1,129 @@
+#include "chunkcache.h"
+
+#include <string.h>
+
+// hash slots as HDF5 recommends: a prime around 100 times the chunks that fit
+static size_t slotCount(size_t chunksThatFit)
+{
+	size_t n = chunksThatFit * 100;
+	if (n < 521) n = 521;
+	if (n > 1000003) n = 1000003;
+
+	for (;; ++n)
+	{
+		bool prime = n % 2 != 0;
+		for (size_t d = 3; prime && d * d <= n; d += 2)
+			prime = n % d != 0;
+		if (prime) return n;
+	}
+}
+
+void chunkCachePlan(const SlabPlan* plan, size_t override, ChunkCacheEstimate* est)
+{
+	const VarInfo* var = plan->var;
+
+	memset(est, 0, sizeof(ChunkCacheEstimate));
+	est->chunked = var->chunked && var->valueCount > 0;
+	if (!est->chunked) return;
+
+	est->chunkBytes = var->typeSize;
+	est->chunks = 1;
+	est->chunkReads = 1;
+
+	// the outermost dimension along which slabs cut through chunks, -1 if none does
+	int cutDim = -1;
+
+	for (int i = 0; i < var->nDims; ++i)
+	{
+		size_t len = var->dimLens[i], chunk = var->chunkLens[i], shape = plan->shape[i];
+		size_t chunksAlong = (len + chunk - 1) / chunk;
+
+		est->chunkBytes *= chunk;
+		est->chunks *= chunksAlong;
+
+		// chunks met by each slab position along this dimension, summed
+		unsigned long long reads = 0;
+		for (size_t start = 0; start < len; start += shape)
+		{
+			size_t end = start + shape < len ? start + shape : len;
+			reads += (end - 1) / chunk - start / chunk + 1;
+		}
+		est->chunkReads *= reads;
+
+		if (cutDim < 0 && shape != len && shape % chunk != 0)
+			cutDim = i;
+	}
+
+	// A chunk cut along cutDim is revisited after every slab inside it, so the
+	// cache has to hold its neighbours: all chunks across the inner dimensions
+	// and the chunks one slab spans on the outer ones.
+	unsigned long long workingChunks = 0;
+
+	if (cutDim >= 0)
+	{
+		workingChunks = 1;
+
+		for (int i = 0; i < var->nDims; ++i)
+		{
+			size_t len = var->dimLens[i], chunk = var->chunkLens[i], shape = plan->shape[i];
+
+			if (i > cutDim || shape == len)
+				workingChunks *= (len + chunk - 1) / chunk;
+			else if (shape % chunk == 0)
+				workingChunks *= shape / chunk;
+			else
+				workingChunks *= (shape + chunk - 2) / chunk + 1; // most an unaligned run can straddle
+		}
+	}
+
+	est->workingSet = (size_t)(workingChunks * est->chunkBytes);
+
+	if (override > 0)
+	{
+		est->cacheSize = override;
+	}
+	else
+	{
+		// whole-chunk reads only need room for one chunk in flight
+		est->cacheSize = est->workingSet > est->chunkBytes ? est->workingSet + est->workingSet / 4 : est->chunkBytes;
+		if (est->cacheSize > CHUNK_CACHE_MAX_AUTO) est->cacheSize = CHUNK_CACHE_MAX_AUTO;
+	}
+
+	est->slots = slotCount(est->cacheSize / (est->chunkBytes > 0 ? est->chunkBytes : 1) + 1);
+
+	// chunks read whole are done with, so evict them first
+	est->preemption = cutDim < 0 ? 1.0f : 0.75f;
+
+	// a cache the variable already has that is big enough is left alone
+	size_t size, slots;
+	float preemption;
+	bool current = nc_get_var_chunk_cache(var->ncid, var->varID, &size, &slots, &preemption) == NC_NOERR;
+
+	if (current && override == 0 && size >= est->cacheSize)
+	{
+		est->cacheSize = size;
+		est->slots = slots;
+		est->preemption = preemption;
+	}
+
+	est->resized = !current || size != est->cacheSize || slots != est->slots || preemption != est->preemption;
+
+	if (est->cacheSize >= est->workingSet)
+	{
+		est->expectedMisses = est->chunks;
+		est->expectedHits = est->chunkReads - est->chunks;
+	}
+	else
+	{
+		// assume the revisits all miss once the working set no longer fits
+		est->expectedMisses = est->chunkReads;
+		est->expectedHits = 0;
+	}
+}
+
+int chunkCacheApply(int ncid, int varID, const ChunkCacheEstimate* est)
+{
+	if (!est->chunked) return NC_NOERR;
+
+	return nc_set_var_chunk_cache(ncid, varID, est->cacheSize, est->slots, est->preemption);
+}
@@ -0,0 +1,33 @@
+#ifndef CHUNKCACHE_H
+#define CHUNKCACHE_H
+
+#include "slab.h"
+
+// ceiling for an automatically sized per-variable chunk cache (bytes)
+#define CHUNK_CACHE_MAX_AUTO ((size_t)1024 * 1024 * 1024)
+
+// How the HDF5 chunk cache was sized for one pass over a slab plan, and what that should cost
+typedef struct ChunkCacheEstimate
+{
+	bool chunked;                      // false for contiguous/classic variables, where nothing below applies
+	size_t chunkBytes;                 // one uncompressed chunk
+	unsigned long long chunks;         // distinct chunks the pass touches
+	unsigned long long chunkReads;     // slab/chunk intersections, i.e. chunk lookups
+	size_t workingSet;                 // bytes needed for every chunk to be inflated only once
+	size_t cacheSize;                  // bytes given to the cache
+	size_t slots;                      // hash slots (prime)
+	float preemption;
+	unsigned long long expectedMisses; // chunk inflations
+	unsigned long long expectedHits;
+	bool resized;                      // false when the variable's cache already fits and is kept
+} ChunkCacheEstimate;
+
+// Works out the cache a pass over plan needs; override (bytes) replaces the
+// computed size when non-zero. A current cache at least that big is kept; the
+// plan asks libnetcdf for it, so threads must hold ncLock.
+void chunkCachePlan(const SlabPlan* plan, size_t override, ChunkCacheEstimate* est);
+
+// Applies the estimate to var as opened through ncid
+int chunkCacheApply(int ncid, int varID, const ChunkCacheEstimate* est);
+
+#endif
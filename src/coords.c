@@ -0,0 +1,541 @@
+#include "coords.h"
+#include "aggregate.h"
+#include "selection.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+static CoordAxis* axes = NULL;
+static int nAxes = 0;
+
+static const char* skipSpace(const char* s)
+{
+	while (isspace((unsigned char)*s))
+		++s;
+	return s;
+}
+
+static bool startsWithWord(const char* s, const char* word)
+{
+	size_t n = strlen(word);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (tolower((unsigned char)s[i]) != word[i]) return false;
+	}
+	return !isalpha((unsigned char)s[n]);
+}
+
+// Days from an arbitrary origin, consistent within one calendar
+static long long calendarDays(Calendar calendar, long long y, int m, int d)
+{
+	static const int before[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+	switch (calendar)
+	{
+	case CALENDAR_NOLEAP:
+		return y * 365 + before[m - 1] + d - 1;
+	case CALENDAR_ALL_LEAP:
+		return y * 366 + before[m - 1] + (m > 2 ? 1 : 0) + d - 1;
+	case CALENDAR_360_DAY:
+		return y * 360 + (m - 1) * 30 + d - 1;
+	default:
+	{
+		// proleptic Gregorian, counted in 400-year eras starting in March
+		y -= m <= 2;
+		long long era = (y >= 0 ? y : y - 399) / 400;
+		long long yoe = y - era * 400;
+		long long doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	}
+	}
+}
+
+// Reads exactly n digits, or 1 to n when exact is false
+static const char* parseDigits(const char* s, int n, bool exact, int* value)
+{
+	int i = 0;
+	*value = 0;
+
+	while (i < n && isdigit((unsigned char)s[i]))
+	{
+		*value = *value * 10 + (s[i] - '0');
+		++i;
+	}
+
+	if (i == 0 || (exact && i < n) || isdigit((unsigned char)s[i])) return NULL;
+	return s + i;
+}
+
+// YYYY-MM-DD with an optional [T ]hh[:mm[:ss[.fff]]][Z]. Minutes and seconds
+// must be two digits so that a following ':' can separate two dates.
+static const char* parseDate(const char* s, Calendar calendar, double* seconds)
+{
+	int y, m, d, hh = 0, mm = 0, ss = 0;
+	double frac = 0.0;
+
+	const char* p = parseDigits(s, 4, false, &y);
+	if (p == NULL || *p != '-') return NULL;
+	p = parseDigits(p + 1, 2, false, &m);
+	if (p == NULL || *p != '-') return NULL;
+	p = parseDigits(p + 1, 2, false, &d);
+	if (p == NULL) return NULL;
+
+	if (m < 1 || m > 12 || d < 1 || d > (calendar == CALENDAR_360_DAY ? 30 : 31)) return NULL;
+
+	if ((*p == 'T' || *p == ' ') && isdigit((unsigned char)p[1]))
+	{
+		const char* q = parseDigits(p + 1, 2, false, &hh);
+		if (q != NULL && hh < 24)
+		{
+			p = q;
+			if (*p == ':' && (q = parseDigits(p + 1, 2, true, &mm)) != NULL && mm < 60)
+			{
+				p = q;
+				if (*p == ':' && (q = parseDigits(p + 1, 2, true, &ss)) != NULL && ss <= 60)
+				{
+					p = q;
+					if (*p == '.' && isdigit((unsigned char)p[1]))
+					{
+						char* end;
+						frac = strtod(p, &end);
+						p = end;
+					}
+				}
+			}
+		}
+	}
+
+	if (*p == 'Z') ++p;
+
+	*seconds = (double)calendarDays(calendar, y, m, d) * 86400.0 + hh * 3600.0 + mm * 60.0 + ss + frac;
+	return p;
+}
+
+static bool parseCalendar(const char* name, Calendar* calendar)
+{
+	if (startsWithWord(name, "standard") || startsWithWord(name, "gregorian") || startsWithWord(name, "proleptic_gregorian"))
+		*calendar = CALENDAR_STANDARD;
+	else if (startsWithWord(name, "noleap") || startsWithWord(name, "365_day"))
+		*calendar = CALENDAR_NOLEAP;
+	else if (startsWithWord(name, "all_leap") || startsWithWord(name, "366_day"))
+		*calendar = CALENDAR_ALL_LEAP;
+	else if (startsWithWord(name, "360_day"))
+		*calendar = CALENDAR_360_DAY;
+	else
+		return false;
+
+	return true;
+}
+
+// "<unit> since <date>"; months and years have no fixed length, so they are not accepted
+static bool parseTimeUnits(const char* units, CoordAxis* axis)
+{
+	static const struct { const char* name; double seconds; } unitNames[] = {
+		{ "seconds", 1.0 }, { "second", 1.0 }, { "secs", 1.0 }, { "sec", 1.0 }, { "s", 1.0 },
+		{ "minutes", 60.0 }, { "minute", 60.0 }, { "mins", 60.0 }, { "min", 60.0 },
+		{ "hours", 3600.0 }, { "hour", 3600.0 }, { "hrs", 3600.0 }, { "hr", 3600.0 }, { "h", 3600.0 },
+		{ "days", 86400.0 }, { "day", 86400.0 }, { "d", 86400.0 },
+		{ "weeks", 604800.0 }, { "week", 604800.0 }
+	};
+
+	const char* s = skipSpace(units);
+	double unitSeconds = 0.0;
+
+	for (size_t i = 0; i < sizeof(unitNames) / sizeof(unitNames[0]); ++i)
+	{
+		if (startsWithWord(s, unitNames[i].name))
+		{
+			unitSeconds = unitNames[i].seconds;
+			s = skipSpace(s + strlen(unitNames[i].name));
+			break;
+		}
+	}
+
+	if (unitSeconds == 0.0 || !startsWithWord(s, "since")) return false;
+
+	if (parseDate(skipSpace(s + 5), axis->calendar, &axis->epochSeconds) == NULL) return false;
+
+	axis->unitSeconds = unitSeconds;
+	return true;
+}
+
+static bool readTextAtt(int ncid, int varID, const char* name, char* buffer, size_t size)
+{
+	nc_type type;
+	size_t len;
+
+	if (nc_inq_att(ncid, varID, name, &type, &len) != NC_NOERR || type != NC_CHAR || len >= size) return false;
+	if (nc_get_att_text(ncid, varID, name, buffer) != NC_NOERR) return false;
+
+	buffer[len] = '\0';
+	return true;
+}
+
+static void analyseAxis(CoordAxis* axis)
+{
+	size_t n = axis->len;
+	const double* v = axis->values;
+
+	axis->direction = n > 1 && v[1] < v[0] ? -1 : 1;
+	for (size_t i = 1; i < n; ++i)
+	{
+		if (!(axis->direction * (v[i] - v[i - 1]) > 0.0))
+		{
+			axis->direction = 0;
+			break;
+		}
+	}
+
+	axis->regular = false;
+	if (axis->direction == 0 || n < 2) return;
+
+	axis->first = v[0];
+	axis->step = (v[n - 1] - v[0]) / (double)(n - 1);
+
+	// loose enough for float coordinates; lookups check the neighbours anyway
+	double tolerance = 1e-3 * fabs(axis->step);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (fabs(v[i] - (axis->first + (double)i * axis->step)) > tolerance) return;
+	}
+
+	axis->regular = true;
+}
+
+static int loadAxis(int ncid, int dimID, size_t len, CoordAxis* axis)
+{
+	char name[NC_MAX_NAME + 1];
+	int status = nc_inq_dimname(ncid, dimID, name);
+	if (status != NC_NOERR) return status;
+
+	int varID, nDims, varDim;
+	nc_type type;
+
+	if (nc_inq_varid(ncid, name, &varID) != NC_NOERR) return NC_ENOTVAR;
+	status = nc_inq_var(ncid, varID, NULL, &type, &nDims, NULL, NULL);
+	if (status != NC_NOERR) return status;
+	if (nDims != 1 || type == NC_CHAR || type == NC_STRING || type > NC_STRING) return NC_ENOTVAR;
+	status = nc_inq_vardimid(ncid, varID, &varDim);
+	if (status != NC_NOERR) return status;
+	if (varDim != dimID) return NC_ENOTVAR;
+
+	double* values = (double*)malloc((len > 0 ? len : 1) * sizeof(double));
+	if (values == NULL) return NC_ENOMEM;
+
+	// through a VarInfo, so a record axis of an aggregate spans all its files
+	VarInfo coord;
+	status = getVarInfo(ncid, varID, &coord);
+	if (status == NC_NOERR)
+	{
+		size_t start = 0;
+		status = readSlabDouble(&coord, &start, &len, values);
+	}
+
+	if (status != NC_NOERR)
+	{
+		free(values);
+		return status;
+	}
+
+	free(axis->values);
+	memset(axis, 0, sizeof(CoordAxis));
+	axis->ncid = ncid;
+	axis->dimID = dimID;
+	axis->len = len;
+	axis->values = values;
+	axis->single = type == NC_FLOAT;
+
+	char text[256];
+	axis->calendar = CALENDAR_STANDARD;
+	if (readTextAtt(ncid, varID, "calendar", text, sizeof(text)) && !parseCalendar(text, &axis->calendar))
+		axis->calendar = CALENDAR_STANDARD;
+
+	if (readTextAtt(ncid, varID, "units", text, sizeof(text)))
+	{
+		axis->longitude = startsWithWord(text, "degrees_east") || startsWithWord(text, "degree_east");
+		axis->time = parseTimeUnits(text, axis);
+	}
+
+	if (!axis->longitude && readTextAtt(ncid, varID, "standard_name", text, sizeof(text)))
+		axis->longitude = startsWithWord(text, "longitude");
+
+	analyseAxis(axis);
+
+	return NC_NOERR;
+}
+
+const CoordAxis* coordAxisGet(int ncid, int dimID, int* status)
+{
+	size_t len;
+	*status = aggregateDimLen(ncid, dimID, &len);
+	if (*status != NC_NOERR) return NULL;
+
+	CoordAxis* axis = NULL;
+	for (int i = 0; i < nAxes; ++i)
+	{
+		if (axes[i].ncid == ncid && axes[i].dimID == dimID)
+			axis = &axes[i];
+	}
+
+	// a record dimension that has grown needs its new values
+	if (axis != NULL && axis->len == len) return axis->values != NULL ? axis : NULL;
+
+	if (axis == NULL)
+	{
+		CoordAxis* grown = (CoordAxis*)realloc(axes, (nAxes + 1) * sizeof(CoordAxis));
+		if (grown == NULL)
+		{
+			*status = NC_ENOMEM;
+			return NULL;
+		}
+
+		axes = grown;
+		axis = &axes[nAxes++];
+		memset(axis, 0, sizeof(CoordAxis));
+		axis->ncid = ncid;
+		axis->dimID = dimID;
+	}
+
+	*status = loadAxis(ncid, dimID, len, axis);
+
+	// remember dimensions without a usable coordinate variable too
+	if (*status == NC_ENOTVAR)
+	{
+		free(axis->values);
+		axis->values = NULL;
+		axis->len = len;
+		*status = NC_NOERR;
+		return NULL;
+	}
+
+	return *status == NC_NOERR ? axis : NULL;
+}
+
+void coordCacheFree(void)
+{
+	for (int i = 0; i < nAxes; ++i)
+		free(axes[i].values);
+
+	free(axes);
+	axes = NULL;
+	nAxes = 0;
+}
+
+// Lookups run on keys that increase along the axis: the values, negated when they decrease
+static double axisKey(const CoordAxis* axis, size_t i)
+{
+	return axis->direction * axis->values[i];
+}
+
+// First index whose key is >= x (or > x when strict); len when there is none.
+// Regular axes start from the computed position and only step over rounding.
+static size_t axisBound(const CoordAxis* axis, double x, bool strict)
+{
+	size_t n = axis->len;
+	size_t lo = 0, hi = n;
+
+	if (axis->regular)
+	{
+		double pos = ceil((x - axis->direction * axis->first) / (axis->direction * axis->step));
+		size_t i = pos <= 0.0 ? 0 : (pos >= (double)n ? n : (size_t)pos);
+
+		while (i > 0 && (strict ? axisKey(axis, i - 1) > x : axisKey(axis, i - 1) >= x))
+			--i;
+		while (i < n && (strict ? axisKey(axis, i) <= x : axisKey(axis, i) < x))
+			++i;
+
+		return i;
+	}
+
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (strict ? axisKey(axis, mid) <= x : axisKey(axis, mid) < x)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static double roundToAxis(const CoordAxis* axis, double value)
+{
+	return axis->single ? (double)(float)value : value;
+}
+
+// Indices [first, last] whose values lie in [a, b]; false when none do
+static bool axisRange(const CoordAxis* axis, double a, double b, size_t* first, size_t* last)
+{
+	double ka = axis->direction * roundToAxis(axis, a);
+	double kb = axis->direction * roundToAxis(axis, b);
+	double klo = ka < kb ? ka : kb;
+	double khi = ka < kb ? kb : ka;
+
+	size_t begin = axisBound(axis, klo, false);
+	size_t end = axisBound(axis, khi, true);
+	if (begin >= end) return false;
+
+	*first = begin;
+	*last = end - 1;
+	return true;
+}
+
+static size_t axisNearest(const CoordAxis* axis, double value)
+{
+	double k = axis->direction * roundToAxis(axis, value);
+	size_t i = axisBound(axis, k, false);
+
+	if (i == axis->len) return i - 1;
+	if (i > 0 && k - axisKey(axis, i - 1) <= axisKey(axis, i) - k) return i - 1;
+	return i;
+}
+
+// A number, or a date converted to the axis's time units
+static const char* parseValue(const CoordAxis* axis, const char* s, double* value, bool* isDate)
+{
+	s = skipSpace(s);
+
+	double seconds;
+	const char* end = parseDate(s, axis != NULL ? axis->calendar : CALENDAR_STANDARD, &seconds);
+	*isDate = end != NULL;
+
+	if (end != NULL)
+	{
+		if (axis != NULL && axis->time)
+			*value = (seconds - axis->epochSeconds) / axis->unitSeconds;
+		return skipSpace(end);
+	}
+
+	char* numberEnd;
+	*value = strtod(s, &numberEnd);
+	return numberEnd == s ? NULL : skipSpace(numberEnd);
+}
+
+bool coordSelectionApply(VarInfo* var, const char* text, bool ignoreMissing, char* error, size_t errorLen)
+{
+	const char* s = skipSpace(text);
+
+	while (*s != '\0')
+	{
+		const char* item = s;
+		const char* key = s;
+		while (*s != '\0' && *s != '=' && *s != ',' && !isspace((unsigned char)*s))
+			++s;
+		size_t keyLen = (size_t)(s - key);
+		int itemLen = (int)strcspn(item, ",");
+
+		s = skipSpace(s);
+		if (keyLen == 0 || *s != '=')
+		{
+			snprintf(error, errorLen, "expected dim=lo:hi or dim=value at \"%.*s\"", itemLen, item);
+			return false;
+		}
+
+		int d = selectionFindDim(var, key, keyLen);
+		const CoordAxis* axis = NULL;
+
+		if (d < 0)
+		{
+			if (!ignoreMissing)
+			{
+				snprintf(error, errorLen, "%s has no dimension %.*s", var->name, (int)keyLen, key);
+				return false;
+			}
+		}
+		else
+		{
+			int status;
+			axis = coordAxisGet(var->ncid, var->dimIDs[d], &status);
+
+			if (axis == NULL)
+			{
+				snprintf(error, errorLen, "dimension %.*s has no numeric coordinate variable%s%s", (int)keyLen, key, status != NC_NOERR ? ": " : "", status != NC_NOERR ? nc_strerror(status) : "");
+				return false;
+			}
+		}
+
+		double lo, hi;
+		bool loDate, hiDate = false, range = false;
+
+		s = parseValue(axis, s + 1, &lo, &loDate);
+		if (s != NULL && *s == ':')
+		{
+			range = true;
+			s = parseValue(axis, s + 1, &hi, &hiDate);
+		}
+
+		if (s == NULL || (*s != ',' && *s != '\0'))
+		{
+			snprintf(error, errorLen, "cannot read the values in \"%.*s\"", itemLen, item);
+			return false;
+		}
+		if (*s == ',') s = skipSpace(s + 1);
+
+		if (axis == NULL) continue;
+
+		// nothing to look a value up in, and no first or last value to quote
+		if (axis->len == 0)
+		{
+			snprintf(error, errorLen, "dimension %.*s is empty, so no coordinates can be selected", (int)keyLen, key);
+			return false;
+		}
+
+		if ((loDate || hiDate) && !axis->time)
+		{
+			snprintf(error, errorLen, "dimension %.*s is not a time axis with \"<unit> since <date>\" units", (int)keyLen, key);
+			return false;
+		}
+
+		if (axis->direction == 0)
+		{
+			snprintf(error, errorLen, "coordinates of %.*s are not monotonic", (int)keyLen, key);
+			return false;
+		}
+
+		// file indices first, then mapped into whatever view var already has
+		size_t first, last;
+
+		if (!range)
+		{
+			double low = axis->values[axis->direction > 0 ? 0 : axis->len - 1];
+			if (axis->longitude && lo < low) lo += 360.0;
+			if (axis->longitude && lo >= low + 360.0) lo -= 360.0;
+
+			first = last = axisNearest(axis, lo);
+		}
+		else
+		{
+			bool found = axisRange(axis, lo, hi, &first, &last);
+
+			// -80:-60 on a 0..360 axis (or the reverse) means the same longitudes
+			for (int shift = -1; !found && axis->longitude && shift <= 1; shift += 2)
+				found = axisRange(axis, lo + 360.0 * shift, hi + 360.0 * shift, &first, &last);
+
+			if (!found)
+			{
+				snprintf(error, errorLen, "no %.*s coordinates in \"%.*s\" (the axis runs from %g to %g)", (int)keyLen, key, itemLen, item, axis->values[0], axis->values[axis->len - 1]);
+				return false;
+			}
+		}
+
+		size_t offset = var->offset[d];
+		size_t step = (size_t)var->step[d];
+		size_t begin = first <= offset ? 0 : (first - offset + step - 1) / step;
+		size_t end = last < offset ? 0 : (last - offset) / step + 1;
+		if (end > var->dimLens[d]) end = var->dimLens[d];
+
+		if (last < offset || begin >= end)
+		{
+			snprintf(error, errorLen, "\"%.*s\" falls outside the current selection of %.*s", itemLen, item, (int)keyLen, key);
+			return false;
+		}
+
+		selectionNarrow(var, d, begin, end - begin, 1);
+	}
+
+	return true;
+}
@@ -0,0 +1,45 @@
+#ifndef COORDS_H
+#define COORDS_H
+
+#include "slab.h"
+
+typedef enum Calendar
+{
+	CALENDAR_STANDARD, // also gregorian and proleptic_gregorian
+	CALENDAR_NOLEAP,   // 365_day
+	CALENDAR_ALL_LEAP, // 366_day
+	CALENDAR_360_DAY
+} Calendar;
+
+// A 1D coordinate variable (named after its dimension), read once and kept
+// so repeated subsetting never goes back to the file
+typedef struct CoordAxis
+{
+	int ncid;
+	int dimID;
+	size_t len;
+	double* values;
+	bool single;       // stored as float, so typed values are rounded to float before comparing
+	int direction;     // 1 increasing, -1 decreasing, 0 not monotonic
+	bool regular;      // values[i] is first + i * step to within rounding
+	double first;
+	double step;
+	bool longitude;    // degrees_east, so ranges may be shifted by 360 to fit the axis
+	bool time;         // units are "<unit> since <date>"
+	Calendar calendar;
+	double unitSeconds;
+	double epochSeconds; // reference date in calendar seconds from an arbitrary origin
+} CoordAxis;
+
+// The cached axis for a dimension, reading it on first use or when the
+// dimension has grown. NULL when the dimension has no numeric coordinate variable.
+const CoordAxis* coordAxisGet(int ncid, int dimID, int* status);
+void coordCacheFree(void);
+
+// Restricts var by coordinate values written as comma-separated dim=lo:hi
+// items (inclusive), or dim=value for the nearest index. Values are numbers
+// or, on time axes, dates such as 2019-01-01 or 2019-01-01T06:00. Composes
+// with any selection already on var; error and ignoreMissing as in selectionApply.
+bool coordSelectionApply(VarInfo* var, const char* text, bool ignoreMissing, char* error, size_t errorLen);
+
+#endif
@@ -1,41 +1,195 @@
 #include "netcdf.h"
+#include "netcdf_mem.h"
+#include "aggregate.h"
+#include "axisreduce.h"
+#include "batch.h"
+#include "catalog.h"
+#include "coords.h"
+#include "preload.h"
+#include "progressive.h"
+#include "output.h"
+#include "query.h"
+#include "selection.h"
+#include "simd.h"
+#include "slab.h"
+#include "statcache.h"
+#include "stats.h"
+#include "timeseries.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
+#include <signal.h>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 
 #define ERR_CODE 2
 #define ERR(e) { if (e != NC_NOERR) { printf("Error: %s\n", nc_strerror(e)); exit(ERR_CODE); } }
 
+typedef struct Options
+{
+	const char* fileName;
+	size_t memLimit; // ceiling for slab buffers when reducing variable data
+	int threads;     // reduction workers, 0 for one per core
+	SimdLevel simd;  // highest instruction set the kernels may use
+	bool quantiles;  // report sketch-based quantiles with the statistics
+	int histBins;    // bins in the text histogram, 0 to skip it
+	const char* cacheDir; // statistics cache location, NULL when disabled
+	size_t chunkCache;    // HDF5 chunk cache bytes per variable, 0 to size automatically
+	bool pipeline;        // overlap reads with reduction through a reader thread
+	bool preload;         // read the whole file into memory before opening it
+	size_t preloadLimit;  // largest file --preload will load
+	bool progressive;     // show refining estimates while statistics are computed
+	const char* select;   // hyperslab applied to every variable that has the named dimensions
+	const char* where;    // coordinate-value ranges, applied before select
+	bool zoneMap;         // build per-block zone maps during statistics passes
+	const char* commandFile; // run the commands in this file ("-" for stdin) instead of the menu
+	int commandArgc;      // command given after the file name, run instead of the menu
+	char** commandArgv;
+	bool batch;           // scan every file, directory or pattern given instead of opening one file
+	int jobs;             // batch workers, 0 for one per core
+	const char* report;   // batch report, CSV or JSON by extension
+	bool noStats;         // batch summaries only
+	bool aggregate;       // treat every file given as one dataset concatenated along the record dimension
+	int pool;             // aggregate member files kept open at once
+	const char* catalog;  // metadata catalog to update from the inputs, or to search
+	bool search;          // the arguments are search terms for the catalog
+	OutFormat format;     // text for people, or JSON or CSV records for tools
+} Options;
+
+#define MAX_COMMAND_ARGS 64
+
+static char defaultCacheDir[STATS_CACHE_MAX_PATH];
+
+static Options opts;
+static Preload preload;
+static Aggregate* aggregate = NULL;
+static OutWriter out; // structured output, when opts.format is not text
+static volatile sig_atomic_t interrupted = 0;
+
+bool parseArgs(int argc, char* argv[], Options* options);
 void printUsage(char* argv[]);
 void printSummary(int ncid);
 void printVarList(int ncid, int dimFilter);
+void printVarTable(int ncid, int dimFilter, bool* indexFilter);
 void printDims(int ncid, int varID);
 void printAttribs(int ncid, int varID);
 void getNCTypeName(nc_type type, char* buffer);
+void formatBytes(size_t bytes, char* buffer, size_t size);
 void printAttribValue(int ncid, int varID, char* attribName, nc_type type, size_t len);
-void printVarData(int ncid, int varID);
+bool printVarData(int ncid, int varID, const char* selection);
+void writeSummary(int ncid);
+void writeDims(int ncid, int varID);
+void writeVarTable(int ncid, int dimFilter, bool* indexFilter);
+void writeAttribs(int ncid, int varID);
+void writeAttribValue(int ncid, int varID, const char* attribName, nc_type type, size_t len);
+bool writeVarStats(const VarInfo* var);
+bool applySelection(VarInfo* var, const char* selection);
+void initStatsConfig(StatsConfig* config);
+int progressiveStats(const VarInfo* var, const StatsConfig* config, VarStats* stats, bool* complete);
+void reduceVariable(int ncid);
+void queryValues(int ncid);
+void extractTimeSeries(int ncid);
+void enterCommands(int ncid);
+int promptVarID(int ncid, const char* action);
+int findVar(int ncid, const char* key);
+bool runReduce(int ncid, int varID, const char* dims, const char* opName, const char* path);
+bool runQuery(int ncid, int varID, const char* condition, const char* path);
+bool runSeries(int ncid, int varID, const char* pointText, const char* path);
+int splitCommand(char* line, char** args, int maxArgs);
+bool runCommand(int ncid, int argc, char** args);
+bool runCommandFile(int ncid, const char* path);
+void printCommands(void);
+bool readLine(char* buffer, int size);
+int runBatch(void);
+int openAggregate(void);
+int runCatalog(void);
+int runSearch(void);
 
 int main(int argc, char* argv[])
 {
 	int status = NC_NOERR;
 	int ncid;
 
-	if (argc < 2)
+	if (!parseArgs(argc, argv, &opts))
 	{
 		printUsage(argv);
 		exit(EXIT_FAILURE);
 	}
 
-	const char* fName = argv[1];
+	const char* fName = opts.fileName;
 
-	status = nc_open(fName, NC_NOWRITE, &ncid);
-	ERR(status);
+	simdSetLevel(opts.simd);
+
+	if (!outInit(&out, stdout, opts.format))
+		ERR(NC_ENOMEM);
+
+	// also the default for every handle opened later, including the workers'
+	if (opts.chunkCache > 0)
+		nc_set_chunk_cache(opts.chunkCache, 1009, 0.75f);
+
+	if (opts.catalog)
+		return opts.search ? runSearch() : runCatalog();
+
+	if (opts.batch)
+		return runBatch();
+
+	if (opts.aggregate && opts.preload)
+	{
+		printf("ERROR: --preload cannot be combined with --aggregate\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (opts.preload)
+	{
+		status = preloadFile(fName, opts.preloadLimit, &preload);
+		if (status == NC_ENOMEM)
+			printf("ERROR: %s is larger than the %.1f MiB preload limit (see --preload-limit)\n", fName, opts.preloadLimit / (1024.0 * 1024.0));
+		ERR(status);
+
+		status = nc_open_mem(fName, NC_NOWRITE, preload.size, preload.data, &ncid);
+		ERR(status);
 
-	printf("Opened netCDF file %s\n", fName);
+		double mb = preload.size / (1024.0 * 1024.0);
+		printf("Preloaded %.1f MiB in %.3f s (%.1f MiB/s)\n", mb, preload.seconds, preload.seconds > 0.0 ? mb / preload.seconds : 0.0);
+	}
+	else if (opts.aggregate)
+	{
+		ncid = openAggregate();
+	}
+	else
+	{
+		status = nc_open(fName, NC_NOWRITE, &ncid);
+		ERR(status);
+	}
+
+	bool scripted = opts.commandArgc > 0 || opts.commandFile != NULL;
+	bool succeeded = true;
 
-	bool running = true;
+	if (scripted)
+	{
+		if (opts.commandArgc > 0)
+			succeeded = runCommand(ncid, opts.commandArgc, opts.commandArgv);
+		if (opts.commandFile)
+			succeeded = runCommandFile(ncid, opts.commandFile) && succeeded;
+	}
+	else
+	{
+		if (aggregate != NULL)
+			printf("Opened %d netCDF files, %s to %s, as one dataset\n", aggregate->nMembers, aggregate->members[0].path, aggregate->members[aggregate->nMembers - 1].path);
+		else
+			printf("Opened netCDF file %s\n", fName);
+	}
+
+	bool running = !scripted;
 	while (running)
 	{
 		printf("\nMain Options:\n");
@@ -49,12 +203,19 @@ int main(int argc, char* argv[])
 		printf("\t7: 2D Variables\n");
 		printf("\t8: 3D Variables\n");
 		printf("\t9: 4D Variables\n");
+		printf("\t10: Reduce Variable Along Dimensions\n");
+		printf("\t11: Query Variable Values\n");
+		printf("\t12: Extract Point Time Series\n");
+		printf("\t13: Enter Commands\n");
 
 		printf("\nEnter choice: ");
 
+		// the end of input ends the menu rather than spinning on it
 		int choice = NC_MIN_INT;
-		scanf("%d", &choice);
-		while (getchar() != '\n');
+		if (scanf("%d", &choice) == EOF) break;
+
+		int c;
+		while ((c = getchar()) != '\n' && c != EOF);
 
 		switch (choice)
 		{
@@ -88,36 +249,288 @@ int main(int argc, char* argv[])
 		case 9:
 			printVarList(ncid, 4);
 			break;
+		case 10:
+			reduceVariable(ncid);
+			break;
+		case 11:
+			queryValues(ncid);
+			break;
+		case 12:
+			extractTimeSeries(ncid);
+			break;
+		case 13:
+			enterCommands(ncid);
+			break;
 		default:
 			printf("ERROR: Invalid choice\n");
 			break;
 		}
 	}
 
+	aggregateClose(aggregate);
+
 	status = nc_close(ncid);
 	ERR(status);
 
-	return EXIT_SUCCESS;
+	coordCacheFree();
+	preloadFree(&preload);
+	outFree(&out);
+
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool parseArgs(int argc, char* argv[], Options* options)
+{
+	options->fileName = NULL;
+	options->memLimit = SLAB_DEFAULT_MEM_LIMIT;
+	options->threads = 1;
+	options->simd = SIMD_AVX512;
+	options->quantiles = false;
+	options->histBins = 0;
+	options->chunkCache = 0;
+	options->pipeline = false;
+	options->preload = false;
+	options->progressive = false;
+	options->select = NULL;
+	options->where = NULL;
+	options->zoneMap = false;
+	options->commandFile = NULL;
+	options->commandArgc = 0;
+	options->commandArgv = NULL;
+	options->batch = false;
+	options->jobs = 0;
+	options->report = NULL;
+	options->noStats = false;
+	options->aggregate = false;
+	options->pool = AGGREGATE_DEFAULT_POOL;
+	options->catalog = NULL;
+	options->search = false;
+	options->format = OUT_TEXT;
+	options->preloadLimit = preloadDefaultBudget();
+	options->cacheDir = statsCacheDefaultDir(defaultCacheDir, sizeof(defaultCacheDir)) ? defaultCacheDir : NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-m") == 0 || strcmp(argv[i], "--mem-limit") == 0)
+		{
+			if (++i >= argc) return false;
+			long mb = atol(argv[i]);
+			if (mb <= 0) return false;
+			options->memLimit = (size_t)mb * 1024 * 1024;
+		}
+		else if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0)
+		{
+			if (++i >= argc) return false;
+			options->threads = atoi(argv[i]);
+			if (options->threads < 0) return false;
+		}
+		else if (strcmp(argv[i], "--simd") == 0)
+		{
+			if (++i >= argc) return false;
+			if (!simdParseLevel(argv[i], &options->simd)) return false;
+		}
+		else if (strcmp(argv[i], "-q") == 0 || strcmp(argv[i], "--quantiles") == 0)
+		{
+			options->quantiles = true;
+		}
+		else if (strcmp(argv[i], "--histogram") == 0)
+		{
+			if (++i >= argc) return false;
+			options->histBins = atoi(argv[i]);
+			if (options->histBins <= 0) return false;
+		}
+		else if (strcmp(argv[i], "--cache-dir") == 0)
+		{
+			if (++i >= argc) return false;
+			options->cacheDir = argv[i];
+		}
+		else if (strcmp(argv[i], "--chunk-cache") == 0)
+		{
+			if (++i >= argc) return false;
+			long mb = atol(argv[i]);
+			if (mb <= 0) return false;
+			options->chunkCache = (size_t)mb * 1024 * 1024;
+		}
+		else if (strcmp(argv[i], "--pipeline") == 0)
+		{
+			options->pipeline = true;
+		}
+		else if (strcmp(argv[i], "--preload") == 0)
+		{
+			options->preload = true;
+		}
+		else if (strcmp(argv[i], "--preload-limit") == 0)
+		{
+			if (++i >= argc) return false;
+			long mb = atol(argv[i]);
+			if (mb <= 0) return false;
+			options->preloadLimit = (size_t)mb * 1024 * 1024;
+		}
+		else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--select") == 0)
+		{
+			if (++i >= argc) return false;
+			options->select = argv[i];
+		}
+		else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--where") == 0)
+		{
+			if (++i >= argc) return false;
+			options->where = argv[i];
+		}
+		else if (strcmp(argv[i], "--zone-map") == 0)
+		{
+			options->zoneMap = true;
+		}
+		else if (strcmp(argv[i], "--progressive") == 0)
+		{
+			options->progressive = true;
+		}
+		else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--commands") == 0)
+		{
+			if (++i >= argc) return false;
+			options->commandFile = argv[i];
+		}
+		else if (strcmp(argv[i], "--batch") == 0)
+		{
+			options->batch = true;
+		}
+		else if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--jobs") == 0)
+		{
+			if (++i >= argc) return false;
+			options->jobs = atoi(argv[i]);
+			if (options->jobs < 0) return false;
+		}
+		else if (strcmp(argv[i], "--report") == 0)
+		{
+			if (++i >= argc) return false;
+			options->report = argv[i];
+		}
+		else if (strcmp(argv[i], "--no-stats") == 0)
+		{
+			options->noStats = true;
+		}
+		else if (strcmp(argv[i], "--aggregate") == 0)
+		{
+			options->aggregate = true;
+		}
+		else if (strcmp(argv[i], "--pool") == 0)
+		{
+			if (++i >= argc) return false;
+			options->pool = atoi(argv[i]);
+			if (options->pool <= 0) return false;
+		}
+		else if (strcmp(argv[i], "--catalog") == 0)
+		{
+			if (++i >= argc) return false;
+			options->catalog = argv[i];
+		}
+		else if (strcmp(argv[i], "--search") == 0)
+		{
+			options->search = true;
+		}
+		else if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--format") == 0)
+		{
+			if (++i >= argc) return false;
+			if (!outParseFormat(argv[i], &options->format)) return false;
+		}
+		else if (strcmp(argv[i], "--no-cache") == 0)
+		{
+			options->cacheDir = NULL;
+		}
+		else if (argv[i][0] == '-')
+		{
+			printf("ERROR: Unknown option %s\n", argv[i]);
+			return false;
+		}
+		else
+		{
+			// everything after the file name is a command (or, with --batch, --aggregate or --catalog, another input)
+			options->fileName = argv[i];
+			options->commandArgc = argc - i - 1;
+			options->commandArgv = argv + i + 1;
+			break;
+		}
+	}
+
+	if (options->search && options->catalog == NULL) return false;
+
+	// a catalog can be refreshed without naming any inputs
+	return options->fileName != NULL || (options->catalog != NULL && !options->search);
 }
 
 void printUsage(char* argv[])
 {
-	printf("\nUsage:\n\t%s <NetCDF File>\n", argv[0]);
+	printf("\nUsage:\n\t%s [options] <NetCDF File> [command [arguments]]\n", argv[0]);
+	printf("\t%s --batch [options] <file, directory or pattern>...\n", argv[0]);
+	printf("\t%s --aggregate [options] <file, directory or pattern>... [--] [command [arguments]]\n", argv[0]);
+	printf("\t%s --catalog <index> [options] [file, directory or pattern]...\n", argv[0]);
+	printf("\t%s --catalog <index> --search <term>...\n", argv[0]);
+	printf("\nWithout a command or --commands the interactive menu runs.\n");
+	printf("\nOptions:\n");
+	printf("\t-m, --mem-limit <MiB>\tmemory ceiling for variable reads (default %d)\n", (int)(SLAB_DEFAULT_MEM_LIMIT / (1024 * 1024)));
+	printf("\t-t, --threads <N>\tworkers for variable statistics, each a process reading its own slabs, 0 for one per core (default 1)\n");
+	printf("\t--simd <level>\t\tcap the statistics kernels at scalar, sse2, avx2 or avx512 (default: best available)\n");
+	printf("\t-q, --quantiles\t\tadd approximate percentiles from a streaming quantile sketch\n");
+	printf("\t--histogram <bins>\tadd a text histogram with up to this many bins\n");
+	printf("\t--cache-dir <dir>\tkeep computed statistics here (default: per-user cache directory)\n");
+	printf("\t--no-cache\t\talways recompute statistics and never save them\n");
+	printf("\t--pipeline\t\tread slabs on one thread while the -t threads reduce them\n");
+	printf("\t--chunk-cache <MiB>\tHDF5 chunk cache per variable (default: sized from the chunk layout)\n");
+	printf("\t-s, --select <slab>\tonly read dim=start[:count[:stride]],... of each variable, e.g. time=0,lat=100:50:2\n");
+	printf("\t-w, --where <ranges>\tonly read coordinate values dim=lo:hi,... e.g. lat=30:45,time=2019-01-01:2019-02-01\n");
+	printf("\t--zone-map\t\tsave per-chunk min/max with the cached statistics so threshold queries skip blocks\n");
+	printf("\t--progressive\t\tshow estimates with confidence intervals while statistics are computed; Ctrl-C stops early\n");
+	printf("\t--preload\t\tread the whole file into memory first and work from that copy\n");
+	printf("\t--preload-limit <MiB>\tlargest file --preload will load (default: half of physical memory)\n");
+	printf("\t-c, --commands <file>\trun one command per line from file (- for stdin) against the open file\n");
+	printf("\t-f, --format <fmt>\tprint summaries, dimensions, variables, attributes, statistics and batch, catalog and search results as text, json or csv\n");
+	printf("\t--batch\t\t\tsummarise every file found (directories are searched for .nc files) and report throughput\n");
+	printf("\t-j, --jobs <N>\t\tbatch worker processes, 0 for one per core (default 0)\n");
+	printf("\t--report <file>\t\twrite the batch results, one record per variable (JSON for .json, CSV otherwise)\n");
+	printf("\t--no-stats\t\tbatch summaries only, without variable statistics\n");
+	printf("\t--aggregate\t\texplore the files, in path order, as one dataset joined along the unlimited dimension\n");
+	printf("\t--pool <N>\t\taggregate member files kept open at once (default %d)\n", AGGREGATE_DEFAULT_POOL);
+	printf("\t--catalog <index>\tadd the files found to a metadata catalog, rereading only new or changed files\n");
+	printf("\t--search\t\tlist the catalogued files holding every term: name, var:name, dim:name, attr:name\n");
+	printf("\t\t\t\tor attribute=value, ignoring case, with a trailing * matching any ending\n");
+	printCommands();
+}
+
+void printCommands(void)
+{
+	printf("\nCommands (VAR is a name or ID; OUT as in the menu):\n");
+	printf("\tsummary\n");
+	printf("\tattrs [VAR]\t\t\tglobal or variable attributes\n");
+	printf("\tdims [VAR]\t\t\tfile or variable dimensions\n");
+	printf("\tvars [NDIMS]\t\t\tlist variables, optionally only those with NDIMS dimensions\n");
+	printf("\tvar VAR [SELECTION]\t\tdimensions, attributes and statistics\n");
+	printf("\tstats VAR [SELECTION]\t\tstatistics; SELECTION as typed at the menu's hyperslab prompt\n");
+	printf("\treduce VAR DIMS OP -o OUT\treduce the comma-separated DIMS with mean, min, max, sum, count or std\n");
+	printf("\tquery VAR CONDITION [-o OUT]\tcount (and write) values matching > x, < x, between a b, fill or nonfinite\n");
+	printf("\tseries VAR POINTS -o OUT\textract ';'-separated points along the leading dimension\n");
+	printf("\thelp\n");
 }
 
 void printSummary(int ncid)
 {
+	if (opts.format != OUT_TEXT)
+	{
+		writeSummary(ncid);
+		return;
+	}
+
 	int nDims, nVars, nAttribs;
 	int status = nc_inq(ncid, &nDims, &nVars, &nAttribs, NULL);
 	ERR(status);
 
-	size_t titleLen;
+	size_t titleLen = 0;
 
 	status = nc_inq_attlen(ncid, NC_GLOBAL, "title", &titleLen);
+	if (status != NC_NOERR) titleLen = 0;
 
 	char* title = (char*) malloc(sizeof(char) * (titleLen + 1));
 	
-	status = nc_get_att_text(ncid, NC_GLOBAL, "title", title);
+	if (titleLen > 0)
+		status = nc_get_att_text(ncid, NC_GLOBAL, "title", title);
 
 	title[titleLen] = '\0'; // must manually null-terminate the string
 
@@ -131,10 +544,26 @@ void printSummary(int ncid)
 	printf("\t%d dimensions (%d unlimited)\n", nDims, nUnlimDims);
 	printf("\t%d variables\n", nVars);
 	printf("\t%d global attributes\n", nAttribs);
+
+	const Aggregate* agg = aggregateFind(ncid);
+	if (agg != NULL)
+	{
+		char recordName[NC_MAX_NAME + 1];
+		nc_inq_dimname(ncid, agg->recordDim, recordName);
+
+		printf("\t%d files aggregated along %s (%zu records; metadata from %s)\n", agg->nMembers, recordName, agg->records, agg->members[0].path);
+		printf("\t%d of them kept open at once: %llu opens, %llu reads from open files, %llu prefetched\n", agg->poolSize, agg->opens, agg->hits, agg->prefetches);
+	}
 }
 
 void printDims(int ncid, int varID)
 {
+	if (opts.format != OUT_TEXT)
+	{
+		writeDims(ncid, varID);
+		return;
+	}
+
 	int status = NC_NOERR;
 	int nDims;
 	int dimIDs[NC_MAX_DIMS];
@@ -168,7 +597,9 @@ void printDims(int ncid, int varID)
 		char dimName[NC_MAX_NAME + 1];
 		size_t dimLen;
 
-		int status = nc_inq_dim(ncid, dimIDs[i], dimName, &dimLen);
+		int status = nc_inq_dimname(ncid, dimIDs[i], dimName);
+		ERR(status);
+		status = aggregateDimLen(ncid, dimIDs[i], &dimLen);
 		ERR(status);
 
 		printf("%5d%20s%6zd", dimIDs[i], dimName, dimLen);
@@ -189,14 +620,83 @@ void printVarList(int ncid, int dimFilter)
 	int status = nc_inq_nvars(ncid, &nVars);
 	ERR(status);
 
+	bool* indexFilter = (bool*)malloc(sizeof(bool) * (nVars > 0 ? nVars : 1));
+
+	printVarTable(ncid, dimFilter, indexFilter);
+
+	if (nVars == 0)
+	{
+		free(indexFilter);
+		return;
+	}
+
+	while (true)
+	{
+		printf("\nEnter a variable ID for detailed information or -1 to go back: ");
+		
+		// the end of input ends the menu rather than spinning on it
+		int choice = NC_MIN_INT;
+		if (scanf("%d", &choice) == EOF) break;
+
+		int c;
+		while ((c = getchar()) != '\n' && c != EOF);
+
+		if (choice == -1)
+		{
+			break;
+		}
+		else if (choice < -1 || choice > nVars - 1 || !indexFilter[choice])
+		{
+			printf("ERROR: Invalid selection\n");
+			continue;
+		}
+
+		printDims(ncid, choice);
+
+		printAttribs(ncid, choice);
+
+		char selection[1024] = "";
+
+		int varDims = 0;
+		nc_inq_varndims(ncid, choice, &varDims);
+
+		if (varDims > 0)
+		{
+			printf("\nEnter a hyperslab as dim=start[:count[:stride]],... or coordinate ranges as where dim=lo:hi,...\n");
+			if (opts.select || opts.where)
+				printf("or press Enter for the command line selection: ");
+			else
+				printf("or press Enter for the whole variable: ");
+
+			if (!readLine(selection, sizeof(selection)))
+				selection[0] = '\0';
+		}
+
+		printVarData(ncid, choice, selection);
+	}
+
+	free(indexFilter);
+}
+
+// indexFilter, when given, records which variables passed the filter
+void printVarTable(int ncid, int dimFilter, bool* indexFilter)
+{
+	if (opts.format != OUT_TEXT)
+	{
+		writeVarTable(ncid, dimFilter, indexFilter);
+		return;
+	}
+
+	int nVars;
+	int status = nc_inq_nvars(ncid, &nVars);
+	ERR(status);
+
 	printf("\nnetCDF file contains %d variables:\n", nVars);
 
 	if (nVars == 0) return;
 
 	printf("%5s%20s%8s%12s%12s%13s\n", "VarID", "Name", "Type", "Dimensions", "Attributes", "Description");
 
-	bool* indexFilter = (bool*)malloc(sizeof(bool) * nVars);
-
 	for (int i = 0; i < nVars; ++i)
 	{
 		char varName[NC_MAX_NAME + 1];
@@ -207,15 +707,9 @@ void printVarList(int ncid, int dimFilter)
 		nc_inq_var(ncid, i, varName, &varType, &nDims, dims, &nAttribs);
 		ERR(status);
 
-		if (dimFilter != -1 && nDims != dimFilter)
-		{
-			indexFilter[i] = false;
-			continue;
-		}
-		else
-		{
-			indexFilter[i] = true;
-		}
+		bool shown = dimFilter == -1 || nDims == dimFilter;
+		if (indexFilter) indexFilter[i] = shown;
+		if (!shown) continue;
 
 		char typeName[NC_MAX_NAME + 1];
 		getNCTypeName(varType, typeName);
@@ -239,37 +733,16 @@ void printVarList(int ncid, int dimFilter)
 
 		free(desc);
 	}
-
-	while (true)
-	{
-		printf("\nEnter a variable ID for detailed information or -1 to go back: ");
-		
-		int choice = NC_MIN_INT;
-		scanf("%d", &choice);
-		while (getchar() != '\n');
-
-		if (choice == -1)
-		{
-			break;
-		}
-		else if (choice < -1 || choice > nVars - 1 || !indexFilter[choice])
-		{
-			printf("ERROR: Invalid selection\n");
-			continue;
-		}
-
-		printDims(ncid, choice);
-
-		printAttribs(ncid, choice);
-
-		printVarData(ncid, choice);
-	}
-
-	free(indexFilter);
 }
 
 void printAttribs(int ncid, int varID)
 {
+	if (opts.format != OUT_TEXT)
+	{
+		writeAttribs(ncid, varID);
+		return;
+	}
+
 	int nAttribs;
 
 	int status = nc_inq_varnatts(ncid, varID, &nAttribs);
@@ -359,6 +832,14 @@ void getNCTypeName(nc_type type, char* buffer)
 	}
 }
 
+void formatBytes(size_t bytes, char* buffer, size_t size)
+{
+	if (bytes < 1024 * 1024)
+		snprintf(buffer, size, "%.1f KiB", bytes / 1024.0);
+	else
+		snprintf(buffer, size, "%.1f MiB", bytes / (1024.0 * 1024.0));
+}
+
 void printAttribValue(int ncid, int varID, char* attribName, nc_type type, size_t len)
 {
 	int status = NC_NOERR;
@@ -420,177 +901,1630 @@ void printAttribValue(int ncid, int varID, char* attribName, nc_type type, size_
 	}
 }
 
-void printVarData(int ncid, int varID)
+bool printVarData(int ncid, int varID, const char* selection)
 {
-	char varName[NC_MAX_NAME];
-	nc_type varType;
-	int nDims, dimIDs[NC_MAX_VAR_DIMS], dimLens[NC_MAX_VAR_DIMS], nAtts;
-	int status = nc_inq_var(ncid, varID, varName, &varType, &nDims, dimIDs, &nAtts);
+	// pick up records a writer has appended since the file was opened
+	nc_sync(ncid);
+
+	VarInfo var;
+	int status = getVarInfo(ncid, varID, &var);
 	ERR(status);
-	
-	unsigned valuecount = 1;
 
-	for (int i = 0; i < nDims; ++i)
+	if (!applySelection(&var, selection)) return false;
+
+	if (opts.format != OUT_TEXT)
+		return writeVarStats(&var);
+
+	printf("\nSUMMARY:\n\n   Size: %d (%zu", var.nDims, var.nDims > 0 ? var.dimLens[0] : (size_t)1);
+	for (int i = 1; i < var.nDims; ++i)
+		printf("x%zu", var.dimLens[i]);
+	printf(") dimensions\n  Count: %llu values\n", var.valueCount);
+
+	if (var.subset)
 	{
-		nc_inq_dimlen(ncid, dimIDs[i], &dimLens[i]);
-		valuecount *= (unsigned)dimLens[i];
+		char slabText[1024];
+		selectionFormat(&var, slabText, sizeof(slabText));
+		printf("   Slab: %s\n", slabText);
 	}
 
-	float val_offset = 0.f;
-	float val_scale = 1.f;
+	printf("\n");
+
+	StatsConfig config;
+	initStatsConfig(&config);
+
+	VarStats stats;
+	bool complete = true;
+
+	if (opts.progressive)
+		status = progressiveStats(&var, &config, &stats, &complete);
+	else
+		status = computeVarStats(&var, &config, &stats);
 
-	for (int i = 0; i < nAtts; ++i)
+	if (status == NC_NOERR && !complete)
 	{
-		char attrName[NC_MAX_NAME + 1];
-		nc_type attrType;
-		size_t attrLen;
+		printf("Stopped after %.1f%% of the values; the last estimate stands\n\n", 100.0 * stats.count / (double)var.valueCount);
+		varStatsFree(&stats);
+		return true;
+	}
 
-		nc_inq_attname(ncid, varID, i, attrName);
-		ERR(status);
+	if (status == NC_EBADTYPE)
+	{
+		printf("\n");
+		return true;
+	}
 
-		if (strcmp(attrName, "add_offset") == 0)
-		{
-			status = nc_get_att(ncid, varID, attrName, &val_offset);
-			ERR(status);
-		}
+	ERR(status);
 
-		if (strcmp(attrName, "scale_factor") == 0)
-		{
-			status = nc_get_att(ncid, varID, attrName, &val_scale);
-			ERR(status);
-		}
+	if (stats.validCount == 0)
+	{
+		printf("No valid (non-fill) values\n\n");
+		varStatsFree(&stats);
+		return true;
 	}
 
-	printf("\nSUMMARY:\n\n   Size: %d (%d", nDims, dimLens[0]);
-	for (int i = 1; i < nDims; ++i)
-		printf("x%d", dimLens[i]);
-	printf(") dimensions\n  Count: %d values\n\n", valuecount);
+	if (stats.cached)
+		printf("(from statistics cache)\n");
+	else if (stats.cachedRecords > 0)
+		printf("(%llu records from statistics cache, %llu new records read)\n", stats.cachedRecords, (unsigned long long)var.dimLens[0] - stats.cachedRecords);
 
-	switch (varType)
+	double avgVal = stats.moments.mean;
+
+	switch (var.type)
 	{
 	case NC_FLOAT:
-	{
-		float* vals = (float*)malloc(valuecount * sizeof(float));
+	case NC_DOUBLE:
+		printf("Raw Min: %f\nRaw Max: %f\n  Range: %f\nAverage: %f\n", stats.min, stats.max, stats.max - stats.min, avgVal);
+		break;
+	case NC_INT64:
+		printf("Raw Min: %lld\nRaw Max: %lld\n  Range: %llu\nAverage: %f\n", stats.minExact.s, stats.maxExact.s, (unsigned long long)stats.maxExact.s - (unsigned long long)stats.minExact.s, avgVal);
+		break;
+	case NC_UINT64:
+		printf("Raw Min: %llu\nRaw Max: %llu\n  Range: %llu\nAverage: %f\n", stats.minExact.u, stats.maxExact.u, stats.maxExact.u - stats.minExact.u, avgVal);
+		break;
+	default:
+		printf("Raw Min: %lld\nRaw Max: %lld\n  Range: %lld\nAverage: %f\n", (long long)stats.min, (long long)stats.max, (long long)stats.max - (long long)stats.min, avgVal);
+		break;
+	}
 
-		float fillval;
-		bool isfillval = nc_get_att(ncid, varID, "_FillValue", &fillval) == NC_NOERR;
+	double variance = momentsVariance(&stats.moments);
 
-		status = nc_get_var_float(ncid, varID, vals);
-		ERR(status);
+	printf("Std Dev: %f\n    Var: %f\n   Skew: %f\nEx Kurt: %f\n", sqrt(variance), variance, momentsSkewness(&stats.moments), momentsKurtosis(&stats.moments));
 
-		float minVal = NC_MAX_FLOAT;
-		float maxVal = NC_MIN_FLOAT;
+	if (stats.unpack)
+	{
+		const UnpackedStats* phys = &stats.physical;
 
-		long double avgVal = 0; // this could overflow
+		printf("\nPHYSICAL (x * %g + %g", stats.pack.scale, stats.pack.offset);
+		if (stats.pack.masked) printf(", CF valid range/missing values masked");
+		printf("):\n\n");
 
-		for (unsigned i = 0; i < valuecount; ++i)
+		if (phys->valid == 0)
 		{
-			if (isfillval && vals[i] == fillval) continue;
-			if (vals[i] < minVal) minVal = vals[i];
-			if (vals[i] > maxVal) maxVal = vals[i];
-			avgVal += (long double)vals[i];
-			//printf("%lf ", val[i]);
+			printf("No values inside the valid range\n");
 		}
+		else
+		{
+			double physVariance = momentsVariance(&phys->moments);
 
-		printf("Raw Min: %f\nRaw Max: %f\n  Range: %f\nAverage: %f\n", minVal, maxVal, maxVal - minVal, avgVal / (float)valuecount);
-
-		free(vals);
-
-		break;
+			printf("  Valid: %llu values\n    Min: %f\n    Max: %f\n  Range: %f\nAverage: %f\n", phys->valid, phys->min, phys->max, phys->max - phys->min, phys->moments.mean);
+			printf("Std Dev: %f\n    Var: %f\n   Skew: %f\nEx Kurt: %f\n", sqrt(physVariance), physVariance, momentsSkewness(&phys->moments), momentsKurtosis(&phys->moments));
+		}
 	}
-	case NC_DOUBLE:
-	{
-		double* vals = (double*)malloc(valuecount * sizeof(double));
-		
-		double fillval;
-		bool isfillval = nc_get_att(ncid, varID, "_FillValue", &fillval) == NC_NOERR;
 
-		status = nc_get_var_double(ncid, varID, vals);
-		ERR(status);
-
-		double minVal = NC_MAX_DOUBLE;
-		double maxVal = NC_MIN_DOUBLE;
-
-		long double avgVal = 0; // this could overflow
+	if (stats.sketch)
+	{
+		const double qs[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+		const char* labels[] = { "     P1", "     P5", "    P25", " Median", "    P75", "    P95", "    P99" };
+		double values[7];
 
-		for (unsigned i = 0; i < valuecount; ++i)
+		if (kllQuantiles(stats.sketch, qs, 7, values))
 		{
-			if (isfillval && vals[i] == fillval) continue;
-			if (vals[i] < minVal) minVal = vals[i];
-			if (vals[i] > maxVal) maxVal = vals[i];
-			avgVal += (long double)vals[i];
-			//printf("%lf ", val[i]);
+			printf("\nQUANTILES (%sapproximate, +/-%.2f%% rank):\n\n", stats.unpack ? "physical, " : "", 100.0 * kllRankError(stats.sketch));
+			for (int i = 0; i < 7; ++i)
+				printf("%s: %f\n", labels[i], values[i]);
 		}
+	}
 
-		printf("Raw Min: %f\nRaw Max: %f\n  Range: %f\nAverage: %f\n", minVal, maxVal, maxVal - minVal, avgVal / (double)valuecount);
-
-		free(vals);
+	if (stats.hist)
+	{
+		printf(stats.unpack ? "\nHISTOGRAM (physical):\n\n" : "\nHISTOGRAM:\n\n");
+		histogramPrint(stats.hist, 40);
+	}
 
-		break;
+	// only worth a mention when the pass changed the cache the variable already had
+	if (stats.chunkCache.chunked && stats.chunkCache.resized)
+	{
+		const ChunkCacheEstimate* cc = &stats.chunkCache;
+		char cacheSize[32], workingSet[32], chunkBytes[32];
+		formatBytes(cc->cacheSize, cacheSize, sizeof(cacheSize));
+		formatBytes(cc->workingSet, workingSet, sizeof(workingSet));
+		formatBytes(cc->chunkBytes, chunkBytes, sizeof(chunkBytes));
+
+		printf("\nCHUNK CACHE:\n\n");
+		printf("   Size: %s, %zu slots (working set %s, chunk %s)\n", cacheSize, cc->slots, workingSet, chunkBytes);
+		printf("  Reads: %llu chunk lookups, est. %llu inflations and %llu hits\n", cc->chunkReads, cc->expectedMisses, cc->expectedHits);
 	}
-	case NC_INT:
+
+	varStatsFree(&stats);
+	
+	printf("\n");
+
+	return true;
+}
+
+// Structured counterparts of the print functions: one table per call, flushed
+// at the end so it never interleaves with prompts or messages
+
+void writeSummary(int ncid)
+{
+	int nDims, nVars, nAttribs, format;
+	int status = nc_inq(ncid, &nDims, &nVars, &nAttribs, NULL);
+	ERR(status);
+	status = nc_inq_format(ncid, &format);
+	ERR(status);
+
+	int nUnlimDims, unlimDimIDs[NC_MAX_DIMS];
+	status = nc_inq_unlimdims(ncid, &nUnlimDims, unlimDimIDs);
+	ERR(status);
+
+	const Aggregate* agg = aggregateFind(ncid);
+
+	outBeginObjectTable(&out, "summary");
+	outBeginRecord(&out);
+
+	size_t titleLen;
+	nc_type titleType;
+	if (nc_inq_att(ncid, NC_GLOBAL, "title", &titleType, &titleLen) == NC_NOERR && titleType == NC_CHAR)
+	{
+		char* title = (char*)malloc(titleLen + 1);
+		if (title == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_text(ncid, NC_GLOBAL, "title", title);
+		ERR(status);
+		outStringN(&out, "title", title, strnlen(title, titleLen));
+		free(title);
+	}
+	else
 	{
-		int* vals = (int*)malloc(valuecount * sizeof(int));
+		outNull(&out, "title");
+	}
+
+	outString(&out, "format", batchFormatName(format));
+	outInt(&out, "dims", nDims);
+	outInt(&out, "unlimited_dims", nUnlimDims);
+	outInt(&out, "vars", nVars);
+	outInt(&out, "global_attributes", nAttribs);
+	outInt(&out, "files", agg != NULL ? agg->nMembers : 1);
 
-		int fillval;
-		bool isfillval = nc_get_att(ncid, varID, "_FillValue", &fillval) == NC_NOERR;
+	outEndRecord(&out);
+	outEndTable(&out);
+	outFlush(&out);
+}
+
+void writeDims(int ncid, int varID)
+{
+	int nDims;
+	int dimIDs[NC_MAX_DIMS];
+	char varName[NC_MAX_NAME + 1];
+	int status;
 
-		status = nc_get_var_int(ncid, varID, vals);
+	if (varID == NC_GLOBAL)
+	{
+		status = nc_inq_ndims(ncid, &nDims);
+		ERR(status);
+		for (int i = 0; i < nDims; ++i)
+			dimIDs[i] = i;
+	}
+	else
+	{
+		status = nc_inq_var(ncid, varID, varName, NULL, &nDims, dimIDs, NULL);
 		ERR(status);
+	}
+
+	int nUnlimDims, unlimDimIDs[NC_MAX_DIMS];
+	status = nc_inq_unlimdims(ncid, &nUnlimDims, unlimDimIDs);
+	ERR(status);
 
-		int minVal = NC_MAX_INT;
-		int maxVal = NC_MIN_INT;
+	outBeginTable(&out, "dims");
 
-		long long avgVal = 0;
+	for (int i = 0; i < nDims; ++i)
+	{
+		char dimName[NC_MAX_NAME + 1];
+		size_t dimLen;
 
-		for (unsigned i = 0; i < valuecount; ++i)
+		status = nc_inq_dimname(ncid, dimIDs[i], dimName);
+		ERR(status);
+		status = aggregateDimLen(ncid, dimIDs[i], &dimLen);
+		ERR(status);
+
+		bool unlimited = false;
+		for (int j = 0; j < nUnlimDims; ++j)
 		{
-			if (isfillval && vals[i] == fillval) continue;
-			if (vals[i] < minVal) minVal = vals[i];
-			if (vals[i] > maxVal) maxVal = vals[i];
-			avgVal += (long long)vals[i];
-			//printf("%d ", vals[i]);
+			if (dimIDs[i] == unlimDimIDs[j])
+				unlimited = true;
 		}
 
-		printf("Raw Min: %d\nRaw Max: %d\n  Range: %d\nAverage: %f\n", minVal, maxVal, maxVal - minVal, (float)avgVal / (float)valuecount);
+		outBeginRecord(&out);
+		outString(&out, "variable", varID == NC_GLOBAL ? NULL : varName);
+		outInt(&out, "id", dimIDs[i]);
+		outString(&out, "name", dimName);
+		outUInt(&out, "size", dimLen);
+		outBool(&out, "unlimited", unlimited);
+		outEndRecord(&out);
+	}
 
-		free(vals);
+	outEndTable(&out);
+	outFlush(&out);
+}
 
-		break;
-	}
-	case NC_SHORT:
+void writeVarTable(int ncid, int dimFilter, bool* indexFilter)
+{
+	int nVars;
+	int status = nc_inq_nvars(ncid, &nVars);
+	ERR(status);
+
+	outBeginTable(&out, "vars");
+
+	for (int i = 0; i < nVars; ++i)
 	{
-		short* vals = (short*)malloc(valuecount * sizeof(short));
+		VarInfo var;
+		int nAttribs;
+
+		status = getVarInfo(ncid, i, &var);
+		ERR(status);
+		status = nc_inq_varnatts(ncid, i, &nAttribs);
+		ERR(status);
 
-		short fillval;
-		bool isfillval = nc_get_att(ncid, varID, "_FillValue", &fillval) == NC_NOERR;
+		bool shown = dimFilter == -1 || var.nDims == dimFilter;
+		if (indexFilter) indexFilter[i] = shown;
+		if (!shown) continue;
 
-		status = nc_get_var_short(ncid, varID, vals);
+		char typeName[NC_MAX_NAME + 1];
+		status = nc_inq_type(ncid, var.type, typeName, NULL);
 		ERR(status);
 
-		short minVal = NC_MAX_SHORT;
-		short maxVal = NC_MIN_SHORT;
+		outBeginRecord(&out);
+		outInt(&out, "id", i);
+		outString(&out, "name", var.name);
+		outString(&out, "type", typeName);
+
+		outBeginList(&out, "dims");
+		for (int d = 0; d < var.nDims; ++d)
+		{
+			char dimName[NC_MAX_NAME + 1];
+			status = nc_inq_dimname(ncid, var.dimIDs[d], dimName);
+			ERR(status);
+			outString(&out, NULL, dimName);
+		}
+		outEndList(&out);
+
+		outBeginList(&out, "shape");
+		for (int d = 0; d < var.nDims; ++d)
+			outUInt(&out, NULL, var.dimLens[d]);
+		outEndList(&out);
 
-		long long avgVal = 0;
+		outInt(&out, "attributes", nAttribs);
 
-		for (unsigned i = 0; i < valuecount; ++i)
+		size_t descLen;
+		nc_type descType;
+		if (nc_inq_att(ncid, i, "long_name", &descType, &descLen) == NC_NOERR && descType == NC_CHAR)
+		{
+			char* desc = (char*)malloc(descLen + 1);
+			if (desc == NULL) ERR(NC_ENOMEM);
+			status = nc_get_att_text(ncid, i, "long_name", desc);
+			ERR(status);
+			outStringN(&out, "long_name", desc, strnlen(desc, descLen));
+			free(desc);
+		}
+		else
 		{
-			if (isfillval && vals[i] == fillval) continue;
-			if (vals[i] < minVal) minVal = vals[i];
-			if (vals[i] > maxVal) maxVal = vals[i];
-			avgVal += (long long)vals[i];
-			//printf("%hi ", val[i]);
+			outNull(&out, "long_name");
 		}
 
-		printf("Raw Min: %hi\nRaw Max: %hi\n  Range: %hi\nAverage: %f\n", minVal, maxVal, maxVal - minVal, (float)avgVal / (float)valuecount);
+		outEndRecord(&out);
+	}
+
+	outEndTable(&out);
+	outFlush(&out);
+}
+
+void writeAttribs(int ncid, int varID)
+{
+	int nAttribs;
+	int status = nc_inq_varnatts(ncid, varID, &nAttribs);
+	ERR(status);
+
+	char varName[NC_MAX_NAME + 1];
+	if (varID != NC_GLOBAL)
+	{
+		status = nc_inq_varname(ncid, varID, varName);
+		ERR(status);
+	}
+
+	outBeginTable(&out, "attributes");
+
+	for (int i = 0; i < nAttribs; ++i)
+	{
+		char attrName[NC_MAX_NAME + 1];
+		nc_type attrType;
+		size_t attrLen;
+
+		status = nc_inq_attname(ncid, varID, i, attrName);
+		ERR(status);
+		status = nc_inq_att(ncid, varID, attrName, &attrType, &attrLen);
+		ERR(status);
+
+		char typeName[NC_MAX_NAME + 1];
+		status = nc_inq_type(ncid, attrType, typeName, NULL);
+		ERR(status);
+
+		outBeginRecord(&out);
+		outString(&out, "variable", varID == NC_GLOBAL ? NULL : varName);
+		outInt(&out, "id", i);
+		outString(&out, "name", attrName);
+		outString(&out, "type", typeName);
+		outUInt(&out, "length", attrLen);
+		writeAttribValue(ncid, varID, attrName, attrType, attrLen);
+		outEndRecord(&out);
+	}
+
+	outEndTable(&out);
+	outFlush(&out);
+}
 
-		free(vals);
+// Text attributes are one string; everything else is a list, even of one value
+void writeAttribValue(int ncid, int varID, const char* attribName, nc_type type, size_t len)
+{
+	int status = NC_NOERR;
+	size_t count = len > 0 ? len : 1;
 
+	switch (type)
+	{
+	case NC_CHAR:
+	{
+		char* val = (char*)malloc(count);
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_text(ncid, varID, attribName, val);
+		ERR(status);
+		outStringN(&out, "value", val, strnlen(val, len));
+		free(val);
+		break;
+	}
+	case NC_STRING:
+	{
+		char** val = (char**)malloc(count * sizeof(char*));
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_string(ncid, varID, attribName, val);
+		ERR(status);
+		outBeginList(&out, "value");
+		for (size_t i = 0; i < len; ++i)
+			outString(&out, NULL, val[i]);
+		outEndList(&out);
+		nc_free_string(len, val);
+		free(val);
+		break;
+	}
+	case NC_FLOAT:
+	{
+		float* val = (float*)malloc(count * sizeof(float));
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_float(ncid, varID, attribName, val);
+		ERR(status);
+		outBeginList(&out, "value");
+		for (size_t i = 0; i < len; ++i)
+			outFloat(&out, NULL, val[i]);
+		outEndList(&out);
+		free(val);
+		break;
+	}
+	case NC_DOUBLE:
+	{
+		double* val = (double*)malloc(count * sizeof(double));
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_double(ncid, varID, attribName, val);
+		ERR(status);
+		outBeginList(&out, "value");
+		for (size_t i = 0; i < len; ++i)
+			outDouble(&out, NULL, val[i]);
+		outEndList(&out);
+		free(val);
+		break;
+	}
+	case NC_UINT64:
+	{
+		unsigned long long* val = (unsigned long long*)malloc(count * sizeof(unsigned long long));
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_ulonglong(ncid, varID, attribName, val);
+		ERR(status);
+		outBeginList(&out, "value");
+		for (size_t i = 0; i < len; ++i)
+			outUInt(&out, NULL, val[i]);
+		outEndList(&out);
+		free(val);
+		break;
+	}
+	case NC_BYTE:
+	case NC_UBYTE:
+	case NC_SHORT:
+	case NC_USHORT:
+	case NC_INT:
+	case NC_UINT:
+	case NC_INT64:
+	{
+		long long* val = (long long*)malloc(count * sizeof(long long));
+		if (val == NULL) ERR(NC_ENOMEM);
+		status = nc_get_att_longlong(ncid, varID, attribName, val);
+		ERR(status);
+		outBeginList(&out, "value");
+		for (size_t i = 0; i < len; ++i)
+			outInt(&out, NULL, val[i]);
+		outEndList(&out);
+		free(val);
 		break;
 	}
 	default:
+		outNull(&out, "value");
 		break;
 	}
-	
-	printf("\n");
+}
+
+// Raw extremes in the variable's own type, so 64-bit integers and floats print exactly
+static void writeExtreme(const VarInfo* var, const VarStats* stats, const char* key, bool max)
+{
+	switch (var->type)
+	{
+	case NC_FLOAT:
+		outFloat(&out, key, (float)(max ? stats->max : stats->min));
+		break;
+	case NC_DOUBLE:
+		outDouble(&out, key, max ? stats->max : stats->min);
+		break;
+	case NC_INT64:
+		outInt(&out, key, max ? stats->maxExact.s : stats->minExact.s);
+		break;
+	case NC_UINT64:
+		outUInt(&out, key, max ? stats->maxExact.u : stats->minExact.u);
+		break;
+	default:
+		outInt(&out, key, (long long)(max ? stats->max : stats->min));
+		break;
+	}
+}
+
+static void writeMoments(const Moments* moments, bool valid)
+{
+	double variance = momentsVariance(moments);
+
+	if (valid)
+	{
+		outDouble(&out, "mean", moments->mean);
+		outDouble(&out, "std", sqrt(variance));
+		outDouble(&out, "variance", variance);
+		outDouble(&out, "skewness", momentsSkewness(moments));
+		outDouble(&out, "kurtosis", momentsKurtosis(moments));
+	}
+	else
+	{
+		outNull(&out, "mean");
+		outNull(&out, "std");
+		outNull(&out, "variance");
+		outNull(&out, "skewness");
+		outNull(&out, "kurtosis");
+	}
+}
+
+bool writeVarStats(const VarInfo* var)
+{
+	StatsConfig config;
+	initStatsConfig(&config);
+
+	VarStats stats;
+	int status = computeVarStats(var, &config, &stats);
+
+	if (status == NC_EBADTYPE)
+	{
+		varStatsFree(&stats);
+		return true;
+	}
+
+	ERR(status);
+
+	bool valid = stats.validCount > 0;
+
+	outBeginObjectTable(&out, "stats");
+	outBeginRecord(&out);
+
+	outString(&out, "variable", var->name);
+
+	if (var->subset)
+	{
+		char slabText[1024];
+		selectionFormat(var, slabText, sizeof(slabText));
+		outString(&out, "slab", slabText);
+	}
+	else
+	{
+		outNull(&out, "slab");
+	}
+
+	outBeginList(&out, "shape");
+	for (int d = 0; d < var->nDims; ++d)
+		outUInt(&out, NULL, var->dimLens[d]);
+	outEndList(&out);
+
+	outUInt(&out, "count", stats.count);
+	outUInt(&out, "valid", stats.validCount);
+
+	if (valid)
+	{
+		writeExtreme(var, &stats, "min", false);
+		writeExtreme(var, &stats, "max", true);
+	}
+	else
+	{
+		outNull(&out, "min");
+		outNull(&out, "max");
+	}
+
+	writeMoments(&stats.moments, valid);
+
+	outBool(&out, "cached", stats.cached);
+	outUInt(&out, "cached_records", stats.cachedRecords);
+
+	if (stats.unpack)
+	{
+		const UnpackedStats* phys = &stats.physical;
+		bool physValid = phys->valid > 0;
+
+		outBeginObject(&out, "physical");
+		outDouble(&out, "scale", stats.pack.scale);
+		outDouble(&out, "offset", stats.pack.offset);
+		outBool(&out, "masked", stats.pack.masked);
+		outUInt(&out, "valid", phys->valid);
+		if (physValid)
+		{
+			outDouble(&out, "min", phys->min);
+			outDouble(&out, "max", phys->max);
+		}
+		else
+		{
+			outNull(&out, "min");
+			outNull(&out, "max");
+		}
+		writeMoments(&phys->moments, physValid);
+		outEndObject(&out);
+	}
+
+	if (stats.sketch)
+	{
+		const double qs[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+		const char* keys[] = { "p1", "p5", "p25", "p50", "p75", "p95", "p99" };
+		double values[7];
+		bool have = kllQuantiles(stats.sketch, qs, 7, values);
+
+		outBeginObject(&out, "quantiles");
+		outBool(&out, "physical", stats.unpack);
+		outDouble(&out, "rank_error", kllRankError(stats.sketch));
+		for (int i = 0; i < 7; ++i)
+		{
+			if (have)
+				outDouble(&out, keys[i], values[i]);
+			else
+				outNull(&out, keys[i]);
+		}
+		outEndObject(&out);
+	}
+
+	if (stats.hist)
+	{
+		outBeginObject(&out, "histogram");
+		outBool(&out, "physical", stats.unpack);
+		outDouble(&out, "lo", stats.hist->lo);
+		outDouble(&out, "width", stats.hist->width);
+		outBeginList(&out, "counts");
+		for (int i = 0; i < stats.hist->nBins; ++i)
+			outUInt(&out, NULL, stats.hist->counts[i]);
+		outEndList(&out);
+		outEndObject(&out);
+	}
+
+	outEndRecord(&out);
+	outEndTable(&out);
+	outFlush(&out);
+
+	varStatsFree(&stats);
+	return true;
+}
+
+bool applySelection(VarInfo* var, const char* selection)
+{
+	// a typed selection replaces the command line ones, which skip dimensions this variable lacks
+	char error[256];
+	bool valid = true;
+
+	if (selection != NULL && strncmp(selection, "where ", 6) == 0)
+		valid = coordSelectionApply(var, selection + 6, false, error, sizeof(error));
+	else if (selection != NULL && selection[0] != '\0')
+		valid = selectionApply(var, selection, false, error, sizeof(error));
+	else
+	{
+		if (opts.where) valid = coordSelectionApply(var, opts.where, true, error, sizeof(error));
+		if (valid && opts.select) valid = selectionApply(var, opts.select, true, error, sizeof(error));
+	}
+
+	if (!valid)
+		printf("ERROR: %s\n", error);
+
+	return valid;
+}
+
+void initStatsConfig(StatsConfig* config)
+{
+	// workers and the statistics cache work on single files
+	config->path = aggregate != NULL ? NULL : opts.fileName;
+	config->memLimit = opts.memLimit;
+	config->threads = opts.threads;
+	config->quantiles = opts.quantiles;
+	config->histBins = opts.histBins;
+	config->cacheDir = opts.cacheDir;
+	config->chunkCache = opts.chunkCache;
+	config->pipeline = opts.pipeline;
+	config->image = preload.data;
+	config->imageSize = preload.size;
+	config->zoneMap = opts.zoneMap;
+}
+
+static void onInterrupt(int sig)
+{
+	(void)sig;
+	interrupted = 1;
+}
+
+static bool printEstimate(const StatsEstimate* est, void* user)
+{
+	bool terminal = *(bool*)user;
+
+	char mean[64];
+	if (est->exact)
+		snprintf(mean, sizeof(mean), "%.6g (exact)", est->mean);
+	else
+		snprintf(mean, sizeof(mean), "%.6g +/- %.2g", est->mean, est->meanMargin);
+
+	// rewrite one line in place on a terminal, otherwise log each estimate
+	printf("%s%5.1f%% read  mean %s  min %s%.6g  max %s%.6g  median %.6g [%.6g, %.6g]%s", terminal ? "\r" : "",
+		100.0 * est->fraction, mean, est->exact ? "" : "<= ", est->min, est->exact ? "" : ">= ", est->max,
+		est->qs[1], est->qLow[1], est->qHigh[1], terminal ? "   " : "\n");
+	fflush(stdout);
+
+	return !interrupted;
+}
+
+int progressiveStats(const VarInfo* var, const StatsConfig* config, VarStats* stats, bool* complete)
+{
+	bool terminal = isatty(fileno(stdout)) != 0;
+
+	printf("ESTIMATES (95%% confidence, Ctrl-C to stop):\n\n");
+
+	interrupted = 0;
+	void (*previous)(int) = signal(SIGINT, onInterrupt);
+
+	int status = progressiveVarStats(var, config, 0.25, printEstimate, &terminal, stats, complete);
+
+	signal(SIGINT, previous);
+
+	printf(terminal ? "\n\n" : "\n");
+
+	return status;
+}
+
+bool readLine(char* buffer, int size)
+{
+	if (fgets(buffer, size, stdin) == NULL) return false;
+	buffer[strcspn(buffer, "\r\n")] = '\0';
+	return true;
+}
+
+int promptVarID(int ncid, const char* action)
+{
+	int nVars;
+	int status = nc_inq_nvars(ncid, &nVars);
+	ERR(status);
+
+	printf("\nEnter a variable ID to %s or -1 to go back: ", action);
+
+	int varID = NC_MIN_INT;
+	scanf("%d", &varID);
+
+	int c;
+	while ((c = getchar()) != '\n' && c != EOF);
+
+	if (varID == -1) return -1;
+
+	if (varID < 0 || varID > nVars - 1)
+	{
+		printf("ERROR: Invalid selection\n");
+		return -1;
+	}
+
+	return varID;
+}
+
+int findVar(int ncid, const char* key)
+{
+	int nVars;
+	int status = nc_inq_nvars(ncid, &nVars);
+	ERR(status);
+
+	char* end;
+	long id = strtol(key, &end, 10);
+	if (*key != '\0' && *end == '\0')
+	{
+		if (id >= 0 && id < nVars) return (int)id;
+	}
+	else
+	{
+		int varID;
+		if (nc_inq_varid(ncid, key, &varID) == NC_NOERR) return varID;
+	}
+
+	printf("ERROR: No variable %s\n", key);
+	return -1;
+}
+
+void reduceVariable(int ncid)
+{
+	int varID = promptVarID(ncid, "reduce");
+	if (varID < 0) return;
+
+	int nDims;
+	int status = nc_inq_varndims(ncid, varID, &nDims);
+	ERR(status);
+
+	if (nDims == 0)
+	{
+		printf("ERROR: Variable has no dimensions to reduce\n");
+		return;
+	}
+
+	printDims(ncid, varID);
+
+	char dims[1024], op[64], path[1024];
+
+	printf("\nEnter the DimIDs to reduce, separated by commas: ");
+	if (!readLine(dims, sizeof(dims))) return;
+
+	printf("Enter the operation (mean, min, max, sum, count, std): ");
+	if (!readLine(op, sizeof(op))) return;
+
+	printf("Enter the output path (.nc for netCDF, anything else for raw doubles): ");
+	if (!readLine(path, sizeof(path)) || path[0] == '\0') return;
+
+	runReduce(ncid, varID, dims, op, path);
+}
+
+bool runReduce(int ncid, int varID, const char* dims, const char* opName, const char* path)
+{
+	VarInfo var;
+	int status = getVarInfo(ncid, varID, &var);
+	ERR(status);
+
+	if (var.nDims == 0)
+	{
+		printf("ERROR: Variable has no dimensions to reduce\n");
+		return false;
+	}
+
+	char list[1024];
+	snprintf(list, sizeof(list), "%s", dims);
+
+	bool reduceDim[NC_MAX_VAR_DIMS] = { false };
+	int nReduced = 0;
+
+	// dimensions by DimID or name
+	for (char* tok = strtok(list, ", "); tok != NULL; tok = strtok(NULL, ", "))
+	{
+		int d = selectionFindDim(&var, tok, strlen(tok));
+
+		if (d < 0 || reduceDim[d])
+		{
+			printf("ERROR: %s is not a dimension of this variable\n", tok);
+			return false;
+		}
+
+		reduceDim[d] = true;
+		++nReduced;
+	}
+
+	if (nReduced == 0)
+	{
+		printf("ERROR: No dimensions selected\n");
+		return false;
+	}
+
+	ReduceOp op;
+	if (!parseReduceOp(opName, &op))
+	{
+		printf("ERROR: Unknown operation %s\n", opName);
+		return false;
+	}
+
+	size_t pathLen = strlen(path);
+	bool raw = !(pathLen > 3 && strcmp(path + pathLen - 3, ".nc") == 0);
+
+	unsigned long long cells;
+	status = reduceAxes(&var, reduceDim, op, path, raw, opts.memLimit, opts.chunkCache, &cells);
+
+	if (status != NC_NOERR)
+	{
+		printf("ERROR: %s\n", nc_strerror(status));
+		return false;
+	}
+
+	printf("\nWrote %llu %s values (", cells, reduceOpName(op));
+
+	bool first = true;
+	for (int d = 0; d < var.nDims; ++d)
+	{
+		if (reduceDim[d]) continue;
+		printf(first ? "%zu" : "x%zu", var.dimLens[d]);
+		first = false;
+	}
+
+	printf("%s) to %s%s\n", first ? "scalar" : "", path, raw ? " as raw native-endian doubles" : "");
+
+	return true;
+}
+
+void queryValues(int ncid)
+{
+	int varID = promptVarID(ncid, "query");
+	if (varID < 0) return;
+
+	char condition[1024], path[1024];
+
+	printf("Enter the condition (> x, < x, between a b, fill or nonfinite): ");
+	if (!readLine(condition, sizeof(condition))) return;
+
+	printf("Enter a CSV path for the matching cells (blank for counts only): ");
+	if (!readLine(path, sizeof(path))) return;
+
+	runQuery(ncid, varID, condition, path);
+}
+
+bool runQuery(int ncid, int varID, const char* condition, const char* path)
+{
+	nc_sync(ncid);
+
+	VarInfo var;
+	int status = getVarInfo(ncid, varID, &var);
+	ERR(status);
+
+	if (!applySelection(&var, NULL)) return false;
+
+	Query query;
+	if (!parseQuery(condition, &query))
+	{
+		printf("ERROR: Cannot parse condition %s\n", condition);
+		return false;
+	}
+
+	FILE* matchFile = NULL;
+	if (path != NULL && path[0] != '\0')
+	{
+		matchFile = fopen(path, "w");
+		if (matchFile == NULL)
+		{
+			printf("ERROR: Cannot write %s\n", path);
+			return false;
+		}
+		setvbuf(matchFile, NULL, _IOFBF, 1 << 20);
+	}
+
+	StatsConfig config;
+	initStatsConfig(&config);
+
+	QueryResult result;
+	status = queryVar(&var, &query, &config, matchFile, &result);
+
+	if (matchFile && fclose(matchFile) != 0 && status == NC_NOERR)
+		status = NC_EIO;
+
+	if (status == NC_EBADTYPE)
+	{
+		printf("ERROR: Variable type cannot be queried\n");
+		return false;
+	}
+
+	if (status != NC_NOERR)
+	{
+		printf("ERROR: %s\n", nc_strerror(status));
+		return false;
+	}
+
+	printf("\nMatches: %llu of %llu values (%.4f%%)\n", result.matches, var.valueCount, var.valueCount > 0 ? 100.0 * result.matches / (double)var.valueCount : 0.0);
+
+	if (result.matches > 0 && var.nDims > 0)
+	{
+		// in --select syntax, so the box can be pasted back in
+		printf("  Bounds: ");
+		for (int d = 0; d < var.nDims; ++d)
+		{
+			char name[NC_MAX_NAME + 1];
+			if (nc_inq_dimname(ncid, var.dimIDs[d], name) != NC_NOERR) snprintf(name, sizeof(name), "%d", var.dimIDs[d]);
+			printf("%s%s=%zu:%zu", d > 0 ? "," : "", name, result.boxStart[d], result.boxCount[d]);
+		}
+		printf("\n");
+	}
+
+	if (matchFile)
+		printf("  Wrote: %s\n", path);
+
+	if (result.zoneMapUsed)
+	{
+		printf("  Zones: %llu overlap the selection, %llu skipped, %llu matched whole%s\n", result.zones, result.zonesSkipped, result.zonesFull, result.zoneMapBuilt ? " (zone map built by this query)" : "");
+		printf("   Read: %llu values (%.2f%% of the selection)\n", result.valuesRead, var.valueCount > 0 ? 100.0 * result.valuesRead / (double)var.valueCount : 0.0);
+	}
+	else if (result.zoneMapBuilt)
+	{
+		printf("   Read: %llu values (zone map built by this query for the next ones)\n", result.valuesRead);
+	}
+	else if (config.cacheDir == NULL)
+	{
+		printf("   Read: %llu values (no zone map without the statistics cache)\n", result.valuesRead);
+	}
+	else
+	{
+		printf("   Read: %llu values (no cached zone map; a query of the whole variable builds one)\n", result.valuesRead);
+	}
+
+	return true;
+}
+
+void extractTimeSeries(int ncid)
+{
+	int varID = promptVarID(ncid, "extract from");
+	if (varID < 0) return;
+
+	char points[4096], path[1024];
+
+	printf("Enter the points as dim=index,... or where dim=value,..., separated by ';': ");
+	if (!readLine(points, sizeof(points))) return;
+
+	printf("Enter the output path (.csv for CSV, anything else for raw doubles): ");
+	if (!readLine(path, sizeof(path)) || path[0] == '\0') return;
+
+	runSeries(ncid, varID, points, path);
+}
+
+bool runSeries(int ncid, int varID, const char* pointText, const char* path)
+{
+	nc_sync(ncid);
+
+	VarInfo var;
+	int status = getVarInfo(ncid, varID, &var);
+	ERR(status);
+
+	if (var.nDims == 0)
+	{
+		printf("ERROR: Variable has no dimensions to run along\n");
+		return false;
+	}
+
+	if (!applySelection(&var, NULL)) return false;
+
+	char error[256];
+	SeriesPoint* points;
+	int nPoints;
+	if (!seriesParsePoints(&var, pointText, &points, &nPoints, error, sizeof(error)))
+	{
+		printf("ERROR: %s\n", error);
+		return false;
+	}
+
+	size_t pathLen = strlen(path);
+	bool raw = !(pathLen > 4 && strcmp(path + pathLen - 4, ".csv") == 0);
+
+	SeriesResult result;
+	status = extractSeries(&var, points, nPoints, path, raw, opts.memLimit, &result);
+	free(points);
+
+	if (status != NC_NOERR)
+	{
+		printf("ERROR: %s\n", nc_strerror(status));
+		return false;
+	}
+
+	printf("\nWrote %d point%s x %zu records to %s%s\n", nPoints, nPoints == 1 ? "" : "s", result.records, path, raw ? " as raw native-endian doubles" : "");
+	printf("  %llu reads over %d chunk group%s in %.1f ms (%.2f ms per point)\n", result.reads, result.groups, result.groups == 1 ? "" : "s", 1000.0 * result.seconds, 1000.0 * result.seconds / nPoints);
+
+	return true;
+}
+
+// Splits at whitespace; single or double quotes keep a string together
+int splitCommand(char* line, char** args, int maxArgs)
+{
+	int argc = 0;
+	char* p = line;
+
+	while (argc < maxArgs)
+	{
+		while (*p == ' ' || *p == '\t') ++p;
+		if (*p == '\0') break;
+
+		char quote = (*p == '"' || *p == '\'') ? *p++ : '\0';
+		args[argc++] = p;
+
+		while (*p != '\0' && (quote ? *p != quote : (*p != ' ' && *p != '\t')))
+			++p;
+
+		if (*p != '\0') *p++ = '\0';
+	}
+
+	return argc;
+}
+
+// Joins args[first..] with single spaces, leaving out "-o OUT", which goes to out
+static void joinArgs(int argc, char** args, int first, char* buffer, size_t size, const char** out)
+{
+	buffer[0] = '\0';
+	*out = NULL;
+
+	size_t len = 0;
+	for (int i = first; i < argc; ++i)
+	{
+		if (strcmp(args[i], "-o") == 0 && i + 1 < argc)
+		{
+			*out = args[++i];
+			continue;
+		}
+
+		int n = snprintf(buffer + len, size - len, "%s%s", len > 0 ? " " : "", args[i]);
+		if (n < 0 || (size_t)n >= size - len) break;
+		len += (size_t)n;
+	}
+}
+
+static const char* commandNames[] = { "summary", "attrs", "dims", "vars", "var", "stats", "reduce", "query", "series", "help" };
+
+static bool isCommandName(const char* word)
+{
+	for (size_t i = 0; i < sizeof(commandNames) / sizeof(commandNames[0]); ++i)
+	{
+		if (strcmp(word, commandNames[i]) == 0) return true;
+	}
+
+	return false;
+}
+
+bool runCommand(int ncid, int argc, char** args)
+{
+	if (argc == 0) return true;
+
+	const char* command = args[0];
+	char rest[4096];
+	const char* out;
+
+	int varID = NC_GLOBAL;
+	bool needsVar = strcmp(command, "var") == 0 || strcmp(command, "stats") == 0 || strcmp(command, "reduce") == 0 || strcmp(command, "query") == 0 || strcmp(command, "series") == 0;
+	bool optionalVar = strcmp(command, "attrs") == 0 || strcmp(command, "dims") == 0;
+
+	if ((needsVar && argc < 2) || (optionalVar && argc > 2))
+	{
+		printf("ERROR: Usage: see the help command\n");
+		return false;
+	}
+
+	if (needsVar || (optionalVar && argc == 2))
+	{
+		varID = findVar(ncid, args[1]);
+		if (varID < 0) return false;
+	}
+
+	joinArgs(argc, args, needsVar ? 2 : 1, rest, sizeof(rest), &out);
+
+	if (strcmp(command, "summary") == 0)
+	{
+		printSummary(ncid);
+	}
+	else if (strcmp(command, "attrs") == 0)
+	{
+		printAttribs(ncid, varID);
+	}
+	else if (strcmp(command, "dims") == 0)
+	{
+		printDims(ncid, varID);
+	}
+	else if (strcmp(command, "vars") == 0)
+	{
+		printVarTable(ncid, argc > 1 ? atoi(args[1]) : -1, NULL);
+	}
+	else if (strcmp(command, "var") == 0)
+	{
+		printDims(ncid, varID);
+		printAttribs(ncid, varID);
+		return printVarData(ncid, varID, rest);
+	}
+	else if (strcmp(command, "stats") == 0)
+	{
+		return printVarData(ncid, varID, rest);
+	}
+	else if (strcmp(command, "reduce") == 0)
+	{
+		if (argc < 4 || out == NULL)
+		{
+			printf("ERROR: Usage: reduce VAR DIMS OP -o OUT\n");
+			return false;
+		}
+		return runReduce(ncid, varID, args[2], args[3], out);
+	}
+	else if (strcmp(command, "query") == 0)
+	{
+		return runQuery(ncid, varID, rest, out);
+	}
+	else if (strcmp(command, "series") == 0)
+	{
+		if (out == NULL)
+		{
+			printf("ERROR: Usage: series VAR POINTS -o OUT\n");
+			return false;
+		}
+		return runSeries(ncid, varID, rest, out);
+	}
+	else if (strcmp(command, "help") == 0)
+	{
+		printCommands();
+	}
+	else
+	{
+		printf("ERROR: Unknown command %s (try help)\n", command);
+		return false;
+	}
+
+	return true;
+}
+
+// Runs every line against the one open file, carrying on past failures;
+// blank lines and lines starting with # are skipped
+bool runCommandFile(int ncid, const char* path)
+{
+	FILE* in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+	if (in == NULL)
+	{
+		printf("ERROR: Cannot read %s\n", path);
+		return false;
+	}
+
+	bool succeeded = true;
+	char line[4096];
+
+	while (fgets(line, sizeof(line), in) != NULL)
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char* start = line;
+		while (*start == ' ' || *start == '\t') ++start;
+		if (*start == '\0' || *start == '#') continue;
+
+		if (opts.format == OUT_TEXT)
+			printf("\n> %s\n", start);
+
+		char* args[MAX_COMMAND_ARGS];
+		int argc = splitCommand(start, args, MAX_COMMAND_ARGS);
+
+		if (argc > 0 && (strcmp(args[0], "quit") == 0 || strcmp(args[0], "exit") == 0)) break;
+
+		if (!runCommand(ncid, argc, args))
+			succeeded = false;
+
+		fflush(stdout);
+	}
+
+	if (in != stdin) fclose(in);
+
+	return succeeded;
+}
+
+void enterCommands(int ncid)
+{
+	printCommands();
+
+	char line[4096];
+
+	while (true)
+	{
+		printf("\nEnter a command or press Enter to go back: ");
+		if (!readLine(line, sizeof(line)) || line[0] == '\0') return;
+
+		char* args[MAX_COMMAND_ARGS];
+		int argc = splitCommand(line, args, MAX_COMMAND_ARGS);
+		runCommand(ncid, argc, args);
+	}
+}
+
+static void printBatchProgress(int done, int total, const BatchFile* file, void* user)
+{
+	(void)file;
+	(void)user;
+	printf("\rScanned %d of %d files", done, total);
+	fflush(stdout);
+}
+
+static void writeBatchResult(const BatchList* list, const BatchResult* result)
+{
+	outBeginObjectTable(&out, "batch");
+	outBeginRecord(&out);
+	outInt(&out, "files", result->files);
+	outInt(&out, "failed", result->failed);
+	outInt(&out, "vars", result->vars);
+	outInt(&out, "vars_computed", result->varsComputed);
+	outInt(&out, "vars_cached", result->varsCached);
+	outUInt(&out, "bytes", result->bytes);
+	outUInt(&out, "bytes_read", result->bytesRead);
+	outDouble(&out, "seconds", result->seconds);
+	outInt(&out, "workers", result->workers);
+	outUInt(&out, "steals", result->steals);
+	outEndRecord(&out);
+	outEndTable(&out);
+
+	if (result->failed > 0)
+	{
+		outBeginTable(&out, "failed");
+		for (int i = 0; i < list->count; ++i)
+		{
+			if (list->files[i].status == NC_NOERR) continue;
+			outBeginRecord(&out);
+			outString(&out, "path", list->files[i].path);
+			outString(&out, "error", nc_strerror(list->files[i].status));
+			outEndRecord(&out);
+		}
+		outEndTable(&out);
+	}
+
+	outFlush(&out);
+}
+
+int runBatch(void)
+{
+	BatchList list;
+	batchListInit(&list);
+
+	// the file name and any arguments after it are all inputs
+	for (int i = -1; i < opts.commandArgc; ++i)
+	{
+		const char* input = i < 0 ? opts.fileName : opts.commandArgv[i];
+		if (!batchCollect(&list, input))
+			printf("WARNING: No files match %s\n", input);
+	}
+
+	if (list.count == 0)
+	{
+		printf("ERROR: No files to scan\n");
+		batchListFree(&list);
+		return EXIT_FAILURE;
+	}
+
+	BatchConfig config;
+	initStatsConfig(&config.stats);
+	config.stats.image = NULL;
+	config.stats.imageSize = 0;
+	config.stats.pipeline = false;
+	config.stats.quantiles = false;
+	config.stats.histBins = 0;
+	config.workers = opts.jobs;
+	config.statistics = !opts.noStats;
+	config.progress = isatty(fileno(stdout)) && opts.format == OUT_TEXT ? printBatchProgress : NULL;
+	config.visit = NULL;
+	config.user = NULL;
+
+	BatchResult result;
+	int status = batchRun(&list, &config, &result);
+	ERR(status);
+
+	if (config.progress) printf("\n");
+
+	if (opts.format != OUT_TEXT)
+	{
+		writeBatchResult(&list, &result);
+	}
+	else
+	{
+		double gb = result.bytes / 1e9;
+		double readGb = result.bytesRead / 1e9;
+		double seconds = result.seconds > 0.0 ? result.seconds : 1e-9;
+
+		printf("\nBATCH:\n\n");
+		printf("  Files: %d scanned, %d failed\n", result.files, result.failed);
+		printf("   Vars: %d, statistics for %d (%d from cache)\n", result.vars, result.varsComputed, result.varsCached);
+		printf("   Size: %.3f GB on disk, %.3f GB of values read\n", gb, readGb);
+		printf("   Time: %.3f s on %d workers (%llu files stolen)\n", result.seconds, result.workers, result.steals);
+		printf("   Rate: %.1f files/s, %.3f GB/s on disk, %.3f GB/s of values\n", result.files / seconds, gb / seconds, readGb / seconds);
+
+		if (result.failed > 0)
+		{
+			printf("\nFAILED:\n\n");
+			for (int i = 0; i < list.count; ++i)
+			{
+				if (list.files[i].status != NC_NOERR)
+					printf("%s: %s\n", list.files[i].path, nc_strerror(list.files[i].status));
+			}
+		}
+	}
+
+	bool written = true;
+	if (opts.report)
+	{
+		// the report is JSON when named so, CSV otherwise
+		size_t len = strlen(opts.report);
+		OutFormat format = len >= 5 && strcmp(opts.report + len - 5, ".json") == 0 ? OUT_JSON : OUT_CSV;
+
+		FILE* file = fopen(opts.report, "w");
+		OutWriter report;
+		written = file != NULL && outInit(&report, file, format);
+		if (written)
+		{
+			written = batchWriteReport(&list, &report);
+			outFree(&report);
+		}
+		if (file != NULL) written = fclose(file) == 0 && written;
+
+		if (!written)
+			printf("ERROR: Cannot write %s\n", opts.report);
+		else if (opts.format == OUT_TEXT)
+			printf("\n  Wrote: %s\n", opts.report);
+	}
+
+	int failed = result.failed;
+	batchListFree(&list);
+
+	return failed == 0 && written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int comparePaths(const void* a, const void* b)
+{
+	return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+// Gathers the members from every input the way --batch does and joins them
+// in path order, which is time order for the usual one-file-per-day naming
+int openAggregate(void)
+{
+	BatchList list;
+	batchListInit(&list);
+
+	// the inputs run up to "--", a command name or the first argument that names
+	// no file, and what follows them is the command; a file that happens to share
+	// a command's name can still be given as ./name
+	int next = 0;
+	if (!batchCollect(&list, opts.fileName))
+		printf("WARNING: No files match %s\n", opts.fileName);
+
+	for (; next < opts.commandArgc; ++next)
+	{
+		if (strcmp(opts.commandArgv[next], "--") == 0)
+		{
+			++next;
+			break;
+		}
+
+		if (isCommandName(opts.commandArgv[next]) || !batchCollect(&list, opts.commandArgv[next])) break;
+	}
+
+	opts.commandArgc -= next;
+	opts.commandArgv += next;
+
+	if (list.count == 0)
+	{
+		printf("ERROR: No files to aggregate\n");
+		exit(EXIT_FAILURE);
+	}
+
+	const char** paths = (const char**)malloc(list.count * sizeof(const char*));
+	if (paths == NULL) ERR(NC_ENOMEM);
+
+	for (int i = 0; i < list.count; ++i)
+		paths[i] = list.files[i].path;
+
+	qsort(paths, list.count, sizeof(const char*), comparePaths);
+
+	int nPaths = 1;
+	for (int i = 1; i < list.count; ++i)
+	{
+		if (strcmp(paths[i], paths[nPaths - 1]) != 0)
+			paths[nPaths++] = paths[i];
+	}
+
+	int ncid;
+	int status = nc_open(paths[0], NC_NOWRITE, &ncid);
+	if (status != NC_NOERR) printf("%s: ", paths[0]);
+	ERR(status);
+
+	char error[1024];
+	if (!aggregateOpen(ncid, paths, nPaths, opts.pool, &aggregate, error, sizeof(error)))
+	{
+		printf("ERROR: %s\n", error);
+		exit(EXIT_FAILURE);
+	}
+
+	free(paths);
+	batchListFree(&list);
+
+	return ncid;
+}
+
+static void writeCatalogResult(const Catalog* catalog, const CatalogUpdate* result)
+{
+	outBeginObjectTable(&out, "catalog");
+	outBeginRecord(&out);
+	outInt(&out, "files", result->files);
+	outInt(&out, "scanned", result->scanned);
+	outInt(&out, "unchanged", result->unchanged);
+	outInt(&out, "removed", result->removed);
+	outInt(&out, "failed", result->failed);
+	outUInt(&out, "vars", catalog->nVars);
+	outUInt(&out, "attributes", catalog->nAttrs);
+	outUInt(&out, "dims", catalog->nDims);
+	outUInt(&out, "terms", catalog->nTerms);
+	outUInt(&out, "postings", catalog->nPostings);
+	outUInt(&out, "string_bytes", catalog->stringsLen);
+	outDouble(&out, "seconds", result->seconds);
+	outInt(&out, "workers", opts.jobs > 0 ? opts.jobs : cpuCount());
+	outEndRecord(&out);
+	outEndTable(&out);
+
+	if (result->failed > 0)
+	{
+		outBeginTable(&out, "failed");
+		for (unsigned f = 0; f < catalog->nFiles; ++f)
+		{
+			if (catalog->files[f].status == NC_NOERR) continue;
+			outBeginRecord(&out);
+			outString(&out, "path", catalogString(catalog, catalog->files[f].path));
+			outString(&out, "error", nc_strerror(catalog->files[f].status));
+			outEndRecord(&out);
+		}
+		outEndTable(&out);
+	}
+
+	outFlush(&out);
+}
+
+int runCatalog(void)
+{
+	Catalog old;
+	CatalogLoad load = catalogLoad(opts.catalog, &old);
+	if (load == CATALOG_INVALID)
+		printf("WARNING: %s is not a catalog this version can read, so it is rebuilt\n", opts.catalog);
+
+	BatchList list;
+	batchListInit(&list);
+
+	for (int i = -1; opts.fileName != NULL && i < opts.commandArgc; ++i)
+	{
+		const char* input = i < 0 ? opts.fileName : opts.commandArgv[i];
+		if (!batchCollect(&list, input))
+			printf("WARNING: No files match %s\n", input);
+	}
+
+	if (list.count == 0 && old.nFiles == 0)
+	{
+		printf("ERROR: No files to catalog\n");
+		batchListFree(&list);
+		catalogFree(&old);
+		return EXIT_FAILURE;
+	}
+
+	Catalog catalog;
+	CatalogUpdate result;
+	int status = catalogUpdate(&old, &list, opts.jobs, &catalog, &result);
+	catalogFree(&old);
+	ERR(status);
+
+	bool written = catalogSave(&catalog, opts.catalog);
+
+	if (opts.format != OUT_TEXT)
+	{
+		writeCatalogResult(&catalog, &result);
+	}
+	else
+	{
+		printf("\nCATALOG:\n\n");
+		printf("  Files: %d (%d read, %d unchanged, %d removed, %d failed)\n", result.files, result.scanned, result.unchanged, result.removed, result.failed);
+		printf("   Vars: %u with %u attributes, %u dimensions\n", catalog.nVars, catalog.nAttrs, catalog.nDims);
+		printf("  Index: %u terms, %u postings, %.1f KiB of strings\n", catalog.nTerms, catalog.nPostings, catalog.stringsLen / 1024.0);
+		printf("   Time: %.3f s on %d workers\n", result.seconds, opts.jobs > 0 ? opts.jobs : cpuCount());
+
+		if (result.failed > 0)
+		{
+			printf("\nFAILED:\n\n");
+			for (unsigned f = 0; f < catalog.nFiles; ++f)
+			{
+				if (catalog.files[f].status != NC_NOERR)
+					printf("%s: %s\n", catalogString(&catalog, catalog.files[f].path), nc_strerror(catalog.files[f].status));
+			}
+		}
+	}
+
+	if (!written)
+		printf("ERROR: Cannot write %s\n", opts.catalog);
+	else if (opts.format == OUT_TEXT)
+		printf("\n  Wrote: %s\n", opts.catalog);
+
+	catalogFree(&catalog);
+
+	return result.failed == 0 && written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runSearch(void)
+{
+	double begin = wallClock();
+
+	Catalog catalog;
+	CatalogLoad load = catalogLoad(opts.catalog, &catalog);
+	if (load != CATALOG_LOADED)
+	{
+		printf("ERROR: Cannot read catalog %s\n", opts.catalog);
+		return EXIT_FAILURE;
+	}
+
+	double loaded = wallClock() - begin;
+
+	// the file name and any arguments after it are all terms
+	int nTerms = opts.commandArgc + 1;
+	const char** terms = (const char**)malloc(nTerms * sizeof(const char*));
+	if (terms == NULL) ERR(NC_ENOMEM);
+
+	terms[0] = opts.fileName;
+	for (int i = 0; i < opts.commandArgc; ++i)
+		terms[i + 1] = opts.commandArgv[i];
+
+	CatalogResult result;
+	int status = catalogSearch(&catalog, terms, nTerms, &result);
+	free(terms);
+	ERR(status);
+
+	if (opts.format != OUT_TEXT)
+		outBeginTable(&out, "matches");
+
+	for (int m = 0; m < result.count; ++m)
+	{
+		const CatalogMatch* match = &result.matches[m];
+		const CatalogFile* file = &catalog.files[match->file];
+
+		if (opts.format != OUT_TEXT)
+		{
+			outBeginRecord(&out);
+			outString(&out, "path", catalogString(&catalog, file->path));
+			outBeginList(&out, "variables");
+			for (int v = 0; v < match->nVars; ++v)
+				outString(&out, NULL, catalogString(&catalog, catalog.vars[file->firstVar + match->vars[v]].name));
+			outEndList(&out);
+			outEndRecord(&out);
+			continue;
+		}
+
+		printf("%s\n", catalogString(&catalog, file->path));
+
+		for (int v = 0; v < match->nVars; ++v)
+		{
+			const CatalogVar* var = &catalog.vars[file->firstVar + match->vars[v]];
+			const char* shape = catalogString(&catalog, var->shape);
+			printf("\t%s %s (%s)%s%s\n", catalogString(&catalog, var->type), catalogString(&catalog, var->name),
+				catalogString(&catalog, var->dims), shape[0] != '\0' ? " " : "", shape);
+		}
+	}
+
+	if (opts.format != OUT_TEXT)
+	{
+		outEndTable(&out);
+		outFlush(&out);
+	}
+	else
+	{
+		printf("\n%d of %u files match (catalog read in %.1f ms, searched in %.3f ms)\n", result.count, catalog.nFiles, loaded * 1000.0, result.seconds * 1000.0);
+	}
+
+	int found = result.count;
+	catalogResultFree(&result);
+	catalogFree(&catalog);
+
+	return found > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
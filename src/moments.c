@@ -0,0 +1,102 @@
+#include "moments.h"
+
+#include <math.h>
+
+void momentsInit(Moments* moments)
+{
+	moments->n = 0;
+	moments->mean = 0.0;
+	moments->m2 = 0.0;
+	moments->m3 = 0.0;
+	moments->m4 = 0.0;
+}
+
+// Pairwise combination of central moments (Chan et al. / Pebay 2008)
+void momentsMerge(Moments* dst, const Moments* src)
+{
+	if (src->n == 0) return;
+
+	if (dst->n == 0)
+	{
+		*dst = *src;
+		return;
+	}
+
+	double na = (double)dst->n;
+	double nb = (double)src->n;
+	double n = na + nb;
+	double delta = src->mean - dst->mean;
+	double delta2 = delta * delta;
+	double ab = na * nb;
+
+	double m2 = dst->m2 + src->m2 + delta2 * ab / n;
+
+	double m3 = dst->m3 + src->m3
+		+ delta2 * delta * ab * (na - nb) / (n * n)
+		+ 3.0 * delta * (na * src->m2 - nb * dst->m2) / n;
+
+	double m4 = dst->m4 + src->m4
+		+ delta2 * delta2 * ab * (na * na - ab + nb * nb) / (n * n * n)
+		+ 6.0 * delta2 * (na * na * src->m2 + nb * nb * dst->m2) / (n * n)
+		+ 4.0 * delta * (na * src->m3 - nb * dst->m3) / n;
+
+	dst->mean += delta * nb / n;
+	dst->m2 = m2;
+	dst->m3 = m3;
+	dst->m4 = m4;
+	dst->n += src->n;
+}
+
+double momentsVariance(const Moments* moments)
+{
+	if (moments->n < 2) return 0.0;
+	return moments->m2 / (double)(moments->n - 1);
+}
+
+double momentsSkewness(const Moments* moments)
+{
+	if (moments->n < 2 || moments->m2 <= 0.0) return 0.0;
+	return sqrt((double)moments->n) * moments->m3 / pow(moments->m2, 1.5);
+}
+
+double momentsKurtosis(const Moments* moments)
+{
+	if (moments->n < 2 || moments->m2 <= 0.0) return 0.0;
+	return (double)moments->n * moments->m4 / (moments->m2 * moments->m2) - 3.0;
+}
+
+void momentsFromPowerSums(const double* acc, double shift, Moments* out)
+{
+	momentsInit(out);
+	out->n = (unsigned long long)acc[0];
+	if (out->n == 0) return;
+
+	// move the sums from the shift point to the true mean
+	double count = acc[0];
+	double delta = acc[1] / count;
+
+	out->mean = shift + delta;
+	out->m2 = acc[2] - count * delta * delta;
+	out->m3 = acc[3] - 3.0 * delta * acc[2] + 2.0 * count * delta * delta * delta;
+	out->m4 = acc[4] - 4.0 * delta * acc[3] + 6.0 * delta * delta * acc[2] - 3.0 * count * delta * delta * delta * delta;
+
+	if (out->m2 < 0.0) out->m2 = 0.0;
+	if (out->m4 < 0.0) out->m4 = 0.0;
+}
+
+void compensatedAdd(CompensatedSum* acc, double value)
+{
+	double t = acc->sum + value;
+
+	if (fabs(acc->sum) >= fabs(value))
+		acc->comp += (acc->sum - t) + value;
+	else
+		acc->comp += (value - t) + acc->sum;
+
+	acc->sum = t;
+}
+
+double compensatedValue(const CompensatedSum* acc)
+{
+	return acc->sum + acc->comp;
+}
@@ -0,0 +1,40 @@
+#ifndef MOMENTS_H
+#define MOMENTS_H
+
+#include "netcdf.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Central moments of a set of values in the form used by Welford/Pebay
+// online updates, so partials from slabs and threads merge without a second pass
+typedef struct Moments
+{
+	unsigned long long n;
+	double mean;
+	double m2; // sum of squared deviations from the mean
+	double m3;
+	double m4;
+} Moments;
+
+void momentsInit(Moments* moments);
+void momentsMerge(Moments* dst, const Moments* src);
+
+double momentsVariance(const Moments* moments);  // sample (n - 1) variance
+double momentsSkewness(const Moments* moments);
+double momentsKurtosis(const Moments* moments);  // excess kurtosis
+
+// Central moments from { count, sum d, sum d^2, sum d^3, sum d^4 } with d = x - shift
+void momentsFromPowerSums(const double* acc, double shift, Moments* out);
+
+// Neumaier-compensated running sum
+typedef struct CompensatedSum
+{
+	double sum;
+	double comp;
+} CompensatedSum;
+
+void compensatedAdd(CompensatedSum* acc, double value);
+double compensatedValue(const CompensatedSum* acc);
+
+#endif
@@ -0,0 +1,595 @@
+#include "output.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char digitPairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* ---------------------------------------------------------------------------
+ * Number formatting
+ * ------------------------------------------------------------------------- */
+
+size_t outFormatUInt(char* buffer, unsigned long long value)
+{
+	char digits[20];
+	char* p = digits + sizeof(digits);
+
+	// two digits per division
+	while (value >= 100)
+	{
+		unsigned pair = (unsigned)(value % 100) * 2;
+		value /= 100;
+		*--p = digitPairs[pair + 1];
+		*--p = digitPairs[pair];
+	}
+
+	if (value >= 10)
+	{
+		unsigned pair = (unsigned)value * 2;
+		*--p = digitPairs[pair + 1];
+		*--p = digitPairs[pair];
+	}
+	else
+	{
+		*--p = (char)('0' + value);
+	}
+
+	size_t len = (size_t)(digits + sizeof(digits) - p);
+	memcpy(buffer, p, len);
+	return len;
+}
+
+size_t outFormatInt(char* buffer, long long value)
+{
+	if (value >= 0) return outFormatUInt(buffer, (unsigned long long)value);
+
+	buffer[0] = '-';
+	return 1 + outFormatUInt(buffer + 1, 0ULL - (unsigned long long)value);
+}
+
+// Shortest text that reads back as the same value: the precision grows from one
+// digit until strtod round-trips, which 17 digits always does
+size_t outFormatDouble(char* buffer, double value)
+{
+	if (value == floor(value) && fabs(value) < 1e15)
+	{
+		if (value == 0.0 && signbit(value))
+		{
+			memcpy(buffer, "-0", 2);
+			return 2;
+		}
+		return outFormatInt(buffer, (long long)value);
+	}
+
+	int len = 0;
+	for (int precision = 1; precision <= 17; ++precision)
+	{
+		len = snprintf(buffer, 32, "%.*g", precision, value);
+		if (precision == 17 || strtod(buffer, NULL) == value) break;
+	}
+
+	return (size_t)len;
+}
+
+// The same for float, where 9 digits always round-trip
+size_t outFormatFloat(char* buffer, float value)
+{
+	if (value == floorf(value) && fabsf(value) < 1e7f)
+	{
+		if (value == 0.0f && signbit(value))
+		{
+			memcpy(buffer, "-0", 2);
+			return 2;
+		}
+		return outFormatInt(buffer, (long long)value);
+	}
+
+	int len = 0;
+	for (int precision = 1; precision <= 9; ++precision)
+	{
+		len = snprintf(buffer, 32, "%.*g", precision, (double)value);
+		if (precision == 9 || strtof(buffer, NULL) == value) break;
+	}
+
+	return (size_t)len;
+}
+
+/* ---------------------------------------------------------------------------
+ * Buffering
+ * ------------------------------------------------------------------------- */
+
+bool outInit(OutWriter* w, FILE* file, OutFormat format)
+{
+	memset(w, 0, sizeof(OutWriter));
+	w->file = file;
+	w->format = format;
+	w->buffer = (char*)malloc(OUT_BUFFER_SIZE);
+	return w->buffer != NULL;
+}
+
+bool outFlush(OutWriter* w)
+{
+	if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used)
+		w->failed = true;
+	w->used = 0;
+
+	if (fflush(w->file) != 0) w->failed = true;
+
+	return !w->failed;
+}
+
+void outFree(OutWriter* w)
+{
+	if (w->buffer) outFlush(w);
+
+	free(w->buffer);
+	free(w->header);
+	free(w->row);
+	w->buffer = NULL;
+	w->header = NULL;
+	w->row = NULL;
+}
+
+bool outParseFormat(const char* text, OutFormat* format)
+{
+	if (strcmp(text, "text") == 0)
+		*format = OUT_TEXT;
+	else if (strcmp(text, "json") == 0)
+		*format = OUT_JSON;
+	else if (strcmp(text, "csv") == 0)
+		*format = OUT_CSV;
+	else
+		return false;
+
+	return true;
+}
+
+static bool append(char** data, size_t* len, size_t* cap, const char* s, size_t n)
+{
+	if (*len + n > *cap)
+	{
+		size_t grown = *cap > 0 ? *cap * 2 : 1024;
+		while (grown < *len + n)
+			grown *= 2;
+
+		char* bigger = (char*)realloc(*data, grown);
+		if (bigger == NULL) return false;
+
+		*data = bigger;
+		*cap = grown;
+	}
+
+	memcpy(*data + *len, s, n);
+	*len += n;
+	return true;
+}
+
+static void put(OutWriter* w, const char* s, size_t n)
+{
+	if (w->capturing)
+	{
+		if (!append(&w->row, &w->rowLen, &w->rowCap, s, n)) w->failed = true;
+		return;
+	}
+
+	if (w->used + n > OUT_BUFFER_SIZE)
+	{
+		if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->file) != w->used)
+			w->failed = true;
+		w->used = 0;
+
+		// too big to be worth copying
+		if (n >= OUT_BUFFER_SIZE)
+		{
+			if (fwrite(s, 1, n, w->file) != n) w->failed = true;
+			return;
+		}
+	}
+
+	memcpy(w->buffer + w->used, s, n);
+	w->used += n;
+}
+
+static void putChar(OutWriter* w, char c)
+{
+	if (!w->capturing && w->used < OUT_BUFFER_SIZE)
+		w->buffer[w->used++] = c;
+	else
+		put(w, &c, 1);
+}
+
+static void putText(OutWriter* w, const char* s)
+{
+	put(w, s, strlen(s));
+}
+
+/* ---------------------------------------------------------------------------
+ * Strings
+ * ------------------------------------------------------------------------- */
+
+static void putJsonString(OutWriter* w, const char* s, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	putChar(w, '"');
+
+	size_t run = 0; // characters that need no escaping, written in one go
+	for (size_t i = 0; i < len; ++i)
+	{
+		unsigned char c = (unsigned char)s[i];
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+		put(w, s + run, i - run);
+		run = i + 1;
+
+		char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+		switch (c)
+		{
+		case '"': put(w, "\\\"", 2); break;
+		case '\\': put(w, "\\\\", 2); break;
+		case '\n': put(w, "\\n", 2); break;
+		case '\r': put(w, "\\r", 2); break;
+		case '\t': put(w, "\\t", 2); break;
+		default: put(w, escape, 6); break;
+		}
+	}
+
+	put(w, s + run, len - run);
+	putChar(w, '"');
+}
+
+static bool csvNeedsQuotes(const char* s, size_t len)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (s[i] == ',' || s[i] == '"' || s[i] == '\n' || s[i] == '\r') return true;
+	}
+
+	return len > 0 && (s[0] == ' ' || s[len - 1] == ' ');
+}
+
+// Doubles every quote; the caller supplies the surrounding quotes
+static void putCsvQuoted(OutWriter* w, const char* s, size_t len)
+{
+	size_t run = 0;
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (s[i] != '"') continue;
+		put(w, s + run, i + 1 - run);
+		run = i;
+	}
+
+	put(w, s + run, len - run);
+}
+
+static void putCsvHeader(OutWriter* w, const char* s, size_t len)
+{
+	bool quoted = csvNeedsQuotes(s, len);
+	if (quoted && !append(&w->header, &w->headerLen, &w->headerCap, "\"", 1)) w->failed = true;
+
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (s[i] == '"' && !append(&w->header, &w->headerLen, &w->headerCap, "\"", 1)) w->failed = true;
+		if (!append(&w->header, &w->headerLen, &w->headerCap, s + i, 1)) w->failed = true;
+	}
+
+	if (quoted && !append(&w->header, &w->headerLen, &w->headerCap, "\"", 1)) w->failed = true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Structure
+ * ------------------------------------------------------------------------- */
+
+static void push(OutWriter* w, bool array, char close)
+{
+	if (w->depth + 1 >= OUT_MAX_DEPTH)
+	{
+		w->failed = true;
+		return;
+	}
+
+	++w->depth;
+	w->empty[w->depth] = true;
+	w->array[w->depth] = array;
+	w->close[w->depth] = close;
+}
+
+static void pop(OutWriter* w)
+{
+	if (w->depth == 0) return;
+
+	putChar(w, w->close[w->depth]);
+	--w->depth;
+}
+
+// Separator and key before a value
+static void beginValue(OutWriter* w, const char* key)
+{
+	if (w->format == OUT_JSON)
+	{
+		if (!w->empty[w->depth]) putChar(w, ',');
+		w->empty[w->depth] = false;
+
+		if (!w->array[w->depth] && key != NULL)
+		{
+			putJsonString(w, key, strlen(key));
+			putChar(w, ':');
+		}
+		return;
+	}
+
+	if (w->inList)
+	{
+		if (!w->listEmpty) putChar(w, ' ');
+		w->listEmpty = false;
+		return;
+	}
+
+	if (!w->firstField) putChar(w, ',');
+	w->firstField = false;
+
+	if (w->firstRecord)
+	{
+		if (w->headerLen > 0 && !append(&w->header, &w->headerLen, &w->headerCap, ",", 1)) w->failed = true;
+
+		char column[512];
+		int len = snprintf(column, sizeof(column), "%s%s", w->prefix, key != NULL ? key : "");
+		if (len < 0 || (size_t)len >= sizeof(column)) len = (int)sizeof(column) - 1;
+		putCsvHeader(w, column, (size_t)len);
+	}
+}
+
+void outBeginTable(OutWriter* w, const char* name)
+{
+	if (w->format == OUT_JSON)
+	{
+		putChar(w, '{');
+		putJsonString(w, name, strlen(name));
+		put(w, ":[", 2);
+		push(w, true, ']');
+		return;
+	}
+
+	// the blank line before it waits for a first record, so empty tables leave no trace
+	w->firstRecord = true;
+	w->headerLen = 0;
+}
+
+void outBeginObjectTable(OutWriter* w, const char* name)
+{
+	if (w->format != OUT_JSON)
+	{
+		outBeginTable(w, name);
+		return;
+	}
+
+	putChar(w, '{');
+	putJsonString(w, name, strlen(name));
+	putChar(w, ':');
+
+	// holds the one record, which brings its own braces
+	push(w, true, '\0');
+}
+
+void outEndTable(OutWriter* w)
+{
+	if (w->format == OUT_JSON)
+	{
+		char close = w->close[w->depth];
+		--w->depth;
+		if (close != '\0') putChar(w, close);
+		put(w, "}\n", 2);
+		return;
+	}
+
+	w->firstRecord = false;
+}
+
+void outBeginRecord(OutWriter* w)
+{
+	if (w->format == OUT_JSON)
+	{
+		beginValue(w, NULL);
+		putChar(w, '{');
+		push(w, false, '}');
+		return;
+	}
+
+	w->firstField = true;
+	w->prefix[0] = '\0';
+	w->objectDepth = 0;
+
+	if (w->firstRecord)
+	{
+		w->capturing = true;
+		w->rowLen = 0;
+	}
+}
+
+void outEndRecord(OutWriter* w)
+{
+	if (w->format == OUT_JSON)
+	{
+		pop(w);
+		return;
+	}
+
+	if (w->firstRecord)
+	{
+		w->capturing = false;
+		if (w->tableWritten) putChar(w, '\n');
+		put(w, w->header, w->headerLen);
+		putChar(w, '\n');
+		put(w, w->row, w->rowLen);
+		w->firstRecord = false;
+		w->tableWritten = true;
+	}
+
+	putChar(w, '\n');
+}
+
+void outBeginObject(OutWriter* w, const char* key)
+{
+	if (w->format == OUT_JSON)
+	{
+		beginValue(w, key);
+		putChar(w, '{');
+		push(w, false, '}');
+		return;
+	}
+
+	if (w->objectDepth + 1 >= OUT_MAX_DEPTH)
+	{
+		w->failed = true;
+		return;
+	}
+
+	size_t len = strlen(w->prefix);
+	w->prefixLens[w->objectDepth++] = len;
+	snprintf(w->prefix + len, sizeof(w->prefix) - len, "%s_", key != NULL ? key : "");
+}
+
+void outEndObject(OutWriter* w)
+{
+	if (w->format == OUT_JSON)
+	{
+		pop(w);
+		return;
+	}
+
+	if (w->objectDepth > 0)
+		w->prefix[w->prefixLens[--w->objectDepth]] = '\0';
+}
+
+void outBeginList(OutWriter* w, const char* key)
+{
+	beginValue(w, key);
+
+	if (w->format == OUT_JSON)
+	{
+		putChar(w, '[');
+		push(w, true, ']');
+		return;
+	}
+
+	// always quoted, so string items need no quotes of their own
+	putChar(w, '"');
+	w->inList = true;
+	w->listEmpty = true;
+}
+
+void outEndList(OutWriter* w)
+{
+	if (w->format == OUT_JSON)
+	{
+		pop(w);
+		return;
+	}
+
+	putChar(w, '"');
+	w->inList = false;
+}
+
+/* ---------------------------------------------------------------------------
+ * Values
+ * ------------------------------------------------------------------------- */
+
+void outStringN(OutWriter* w, const char* key, const char* value, size_t len)
+{
+	beginValue(w, key);
+
+	if (w->format == OUT_JSON)
+	{
+		putJsonString(w, value, len);
+	}
+	else if (w->inList)
+	{
+		putCsvQuoted(w, value, len);
+	}
+	else if (csvNeedsQuotes(value, len))
+	{
+		putChar(w, '"');
+		putCsvQuoted(w, value, len);
+		putChar(w, '"');
+	}
+	else
+	{
+		put(w, value, len);
+	}
+}
+
+void outString(OutWriter* w, const char* key, const char* value)
+{
+	if (value == NULL)
+		outNull(w, key);
+	else
+		outStringN(w, key, value, strlen(value));
+}
+
+void outInt(OutWriter* w, const char* key, long long value)
+{
+	char text[32];
+	beginValue(w, key);
+	put(w, text, outFormatInt(text, value));
+}
+
+void outUInt(OutWriter* w, const char* key, unsigned long long value)
+{
+	char text[32];
+	beginValue(w, key);
+	put(w, text, outFormatUInt(text, value));
+}
+
+// JSON has no literal for them, and CSV readers take these spellings
+static bool putNonFinite(OutWriter* w, double value)
+{
+	if (isfinite(value)) return false;
+
+	if (w->format == OUT_JSON)
+		put(w, "null", 4);
+	else if (isnan(value))
+		put(w, "NaN", 3);
+	else
+		putText(w, value > 0 ? "Inf" : "-Inf");
+
+	return true;
+}
+
+void outDouble(OutWriter* w, const char* key, double value)
+{
+	char text[32];
+	beginValue(w, key);
+	if (!putNonFinite(w, value))
+		put(w, text, outFormatDouble(text, value));
+}
+
+void outFloat(OutWriter* w, const char* key, float value)
+{
+	char text[32];
+	beginValue(w, key);
+	if (!putNonFinite(w, value))
+		put(w, text, outFormatFloat(text, value));
+}
+
+void outBool(OutWriter* w, const char* key, bool value)
+{
+	beginValue(w, key);
+	putText(w, value ? "true" : "false");
+}
+
+void outNull(OutWriter* w, const char* key)
+{
+	beginValue(w, key);
+	if (w->format == OUT_JSON) put(w, "null", 4);
+}
@@ -0,0 +1,99 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// bytes held before a write to the underlying stream
+#define OUT_BUFFER_SIZE ((size_t)1 << 20)
+#define OUT_MAX_DEPTH 32
+
+typedef enum OutFormat
+{
+	OUT_TEXT,
+	OUT_JSON, // one JSON object per line for each table
+	OUT_CSV   // a header row then one row per record, tables separated by a blank line
+} OutFormat;
+
+// Streams tables of records as JSON or CSV through a large buffer. Numbers are
+// formatted without stdio where possible, and floating point values in the
+// fewest digits that read back to the same value.
+//
+// A table is written as
+//     outBeginTable(w, "vars");
+//     outBeginRecord(w); outString(w, "name", "sst"); ... outEndRecord(w);
+//     ...
+//     outEndTable(w);
+// In JSON every table becomes {"vars":[{...},...]}; a single-record table
+// started with outBeginObjectTable becomes {"summary":{...}} instead. Records
+// may hold lists (outBeginList) and, in JSON, nested objects (outBeginObject),
+// which CSV flattens into "object_key" columns. A list is one CSV field with its
+// items separated by spaces. Every record of a CSV table must have the fields of
+// the first, in the same order, since they name the columns.
+typedef struct OutWriter
+{
+	FILE* file;
+	OutFormat format;
+	char* buffer;
+	size_t used;
+	bool failed;
+
+	int depth;                     // JSON containers open
+	bool empty[OUT_MAX_DEPTH];     // container has nothing in it yet, so the next item needs no comma
+	bool array[OUT_MAX_DEPTH];     // items take no keys
+	char close[OUT_MAX_DEPTH];
+
+	bool inList;                   // CSV: items go into one field
+	bool listEmpty;
+	char prefix[256];              // CSV: keys of the enclosing objects, for flattened column names
+	size_t prefixLens[OUT_MAX_DEPTH];
+	int objectDepth;
+
+	bool firstRecord;              // CSV: columns are collected from the first record
+	bool firstField;
+	char* header;                  // CSV: column names of the first record
+	size_t headerLen, headerCap;
+	char* row;                     // CSV: the first record's values, held until its header is out
+	size_t rowLen, rowCap;
+	bool capturing;
+	bool tableWritten;             // CSV: a table went out before, so the next needs a blank line
+} OutWriter;
+
+bool outInit(OutWriter* w, FILE* file, OutFormat format);
+bool outFlush(OutWriter* w);       // false if any write failed
+void outFree(OutWriter* w);        // flushes first
+
+bool outParseFormat(const char* text, OutFormat* format);
+
+void outBeginTable(OutWriter* w, const char* name);
+void outBeginObjectTable(OutWriter* w, const char* name);
+void outEndTable(OutWriter* w);
+
+void outBeginRecord(OutWriter* w);
+void outEndRecord(OutWriter* w);
+
+void outBeginObject(OutWriter* w, const char* key);
+void outEndObject(OutWriter* w);
+
+void outBeginList(OutWriter* w, const char* key);
+void outEndList(OutWriter* w);
+
+// key is ignored inside a list
+void outString(OutWriter* w, const char* key, const char* value);
+void outStringN(OutWriter* w, const char* key, const char* value, size_t len);
+void outInt(OutWriter* w, const char* key, long long value);
+void outUInt(OutWriter* w, const char* key, unsigned long long value);
+void outDouble(OutWriter* w, const char* key, double value); // NaN and infinities are null in JSON
+void outFloat(OutWriter* w, const char* key, float value);   // shortest digits for a float, not its double
+void outBool(OutWriter* w, const char* key, bool value);
+void outNull(OutWriter* w, const char* key);
+
+// Shortest round-trip formatting into a buffer of at least 32 bytes, without
+// a terminating nul; returns the length written
+size_t outFormatDouble(char* buffer, double value);
+size_t outFormatFloat(char* buffer, float value);
+size_t outFormatUInt(char* buffer, unsigned long long value);
+size_t outFormatInt(char* buffer, long long value);
+
+#endif
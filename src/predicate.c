@@ -0,0 +1,534 @@
+#include "predicate.h"
+
+#include <float.h>
+#include <math.h>
+
+static unsigned bitCount(unsigned x)
+{
+	x = x - ((x >> 1) & 0x55555555u);
+	x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+	x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+	return (x * 0x01010101u) >> 24;
+}
+
+static unsigned lowestBit(unsigned x)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, x);
+	return (unsigned)i;
+#else
+	return (unsigned)__builtin_ctz(x);
+#endif
+}
+
+static unsigned lowestBit64(unsigned long long x)
+{
+	unsigned low = (unsigned)x;
+	return low != 0 ? lowestBit(low) : 32 + lowestBit((unsigned)(x >> 32));
+}
+
+// Smallest float at or above x (strictly above when open); false when there is none
+static bool floatAbove(double x, bool open, float* f)
+{
+	if (x > FLT_MAX)
+	{
+		*f = INFINITY;
+		return !(open && x == INFINITY);
+	}
+	if (x < -FLT_MAX)
+	{
+		*f = x == -INFINITY && !open ? -INFINITY : -FLT_MAX;
+		return true;
+	}
+
+	*f = (float)x;
+	if ((double)*f < x || (open && (double)*f == x)) *f = nextafterf(*f, INFINITY);
+	return true;
+}
+
+static bool floatBelow(double x, bool open, float* f)
+{
+	if (x < -FLT_MAX)
+	{
+		*f = -INFINITY;
+		return !(open && x == -INFINITY);
+	}
+	if (x > FLT_MAX)
+	{
+		*f = x == INFINITY && !open ? INFINITY : FLT_MAX;
+		return true;
+	}
+
+	*f = (float)x;
+	if ((double)*f > x || (open && (double)*f == x)) *f = nextafterf(*f, -INFINITY);
+	return true;
+}
+
+// The range as closed integer bounds inside [min, max]; false when no integer lies in it
+static bool intRange(const Predicate* pred, double min, double max, long long* low, long long* high)
+{
+	double lo = ceil(pred->low);
+	if (pred->lowOpen && lo == pred->low) lo += 1.0;
+	double hi = floor(pred->high);
+	if (pred->highOpen && hi == pred->high) hi -= 1.0;
+
+	if (lo < min) lo = min;
+	if (hi > max) hi = max;
+	if (!(lo <= hi)) return false;
+
+	*low = (long long)lo;
+	*high = (long long)hi;
+	return true;
+}
+
+void predicatePrepare(Predicate* pred)
+{
+	bool low = floatAbove(pred->low, pred->lowOpen, &pred->lowFloat);
+	bool high = floatBelow(pred->high, pred->highOpen, &pred->highFloat);
+	pred->emptyFloat = !low || !high || pred->lowFloat > pred->highFloat;
+}
+
+bool predicateHolds(const Predicate* pred, double x)
+{
+	if (pred->lowOpen ? !(x > pred->low) : !(x >= pred->low)) return false;
+	if (pred->highOpen ? !(x < pred->high) : !(x <= pred->high)) return false;
+
+	for (int i = 0; i < pred->nMissing; ++i)
+		if (x == pred->missing[i]) return false;
+
+	return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Scalar kernels, one instantiation per atomic type; they also finish the
+ * vector loops' tails and handle everything but plain ranges.
+ * ------------------------------------------------------------------------- */
+
+#define DEFINE_SELECT_KERNEL(NAME, T, FLOATING) \
+static size_t NAME(const void* data, size_t n, const Predicate* pred, unsigned* index) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = pred->fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)pred->fill : (T)0; \
+	size_t hits = 0; \
+	\
+	switch (pred->kind) \
+	{ \
+	case PREDICATE_FILL: \
+		for (size_t i = 0; hasFill && i < n; ++i) \
+			if (vals[i] == fillVal) index[hits++] = (unsigned)i; \
+		break; \
+	case PREDICATE_NONFINITE: \
+		for (size_t i = 0; FLOATING && i < n; ++i) \
+			if (!isfinite((double)vals[i]) && !(hasFill && vals[i] == fillVal)) index[hits++] = (unsigned)i; \
+		break; \
+	default: \
+		for (size_t i = 0; i < n; ++i) \
+			if (!(hasFill && vals[i] == fillVal) && predicateHolds(pred, (double)vals[i])) index[hits++] = (unsigned)i; \
+		break; \
+	} \
+	\
+	return hits; \
+}
+
+DEFINE_SELECT_KERNEL(selectByteScalar, signed char, 0)
+DEFINE_SELECT_KERNEL(selectUByteScalar, unsigned char, 0)
+DEFINE_SELECT_KERNEL(selectShortScalar, short, 0)
+DEFINE_SELECT_KERNEL(selectUShortScalar, unsigned short, 0)
+DEFINE_SELECT_KERNEL(selectIntScalar, int, 0)
+DEFINE_SELECT_KERNEL(selectUIntScalar, unsigned int, 0)
+DEFINE_SELECT_KERNEL(selectInt64Scalar, long long, 0)
+DEFINE_SELECT_KERNEL(selectUInt64Scalar, unsigned long long, 0)
+DEFINE_SELECT_KERNEL(selectFloatScalar, float, 1)
+DEFINE_SELECT_KERNEL(selectDoubleScalar, double, 1)
+
+// Runs the scalar kernel over the tail from i on and shifts its positions into place
+static size_t selectTail(size_t (*kernel)(const void*, size_t, const Predicate*, unsigned*), const char* data, size_t typeSize, size_t i, size_t n, const Predicate* pred, unsigned* index)
+{
+	size_t hits = kernel(data + i * typeSize, n - i, pred, index);
+	for (size_t j = 0; j < hits; ++j)
+		index[j] += (unsigned)i;
+	return hits;
+}
+
+#ifdef SIMD_X86
+
+/* ---------------------------------------------------------------------------
+ * Vector kernels for plain ranges, comparing on the stored type. Both ends are
+ * made closed (the float bounds by predicatePrepare, the double ones with
+ * nextafter, the integer ones by intRange) so one compare per end does; NaN
+ * fails both.
+ * ------------------------------------------------------------------------- */
+
+SIMD_TARGET("sse2")
+static size_t selectFloatSSE2(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const float* vals = (const float*)data;
+	const __m128 lo = _mm_set1_ps(pred->lowFloat);
+	const __m128 hi = _mm_set1_ps(pred->highFloat);
+	const __m128 vfill = _mm_set1_ps(pred->fill ? *(const float*)pred->fill : 0.f);
+	const __m128 noFill = _mm_castsi128_ps(_mm_set1_epi32(pred->fill ? 0 : -1));
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(vals + i);
+		__m128 in = _mm_and_ps(_mm_cmpge_ps(v, lo), _mm_cmple_ps(v, hi));
+		in = _mm_and_ps(in, _mm_or_ps(_mm_cmpneq_ps(v, vfill), noFill));
+
+		for (unsigned bits = (unsigned)_mm_movemask_ps(in); bits != 0; bits &= bits - 1)
+			index[hits++] = (unsigned)i + lowestBit(bits);
+	}
+
+	return hits + selectTail(selectFloatScalar, (const char*)data, sizeof(float), i, n, pred, index + hits);
+}
+
+SIMD_TARGET("sse2")
+static size_t selectDoubleSSE2(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const double* vals = (const double*)data;
+	const __m128d lo = _mm_set1_pd(pred->lowOpen ? nextafter(pred->low, INFINITY) : pred->low);
+	const __m128d hi = _mm_set1_pd(pred->highOpen ? nextafter(pred->high, -INFINITY) : pred->high);
+	const __m128d vfill = _mm_set1_pd(pred->fill ? *(const double*)pred->fill : 0.0);
+	const __m128d noFill = _mm_castsi128_pd(_mm_set1_epi32(pred->fill ? 0 : -1));
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d v = _mm_loadu_pd(vals + i);
+		__m128d in = _mm_and_pd(_mm_cmpge_pd(v, lo), _mm_cmple_pd(v, hi));
+		in = _mm_and_pd(in, _mm_or_pd(_mm_cmpneq_pd(v, vfill), noFill));
+
+		for (unsigned bits = (unsigned)_mm_movemask_pd(in); bits != 0; bits &= bits - 1)
+			index[hits++] = (unsigned)i + lowestBit(bits);
+	}
+
+	return hits + selectTail(selectDoubleScalar, (const char*)data, sizeof(double), i, n, pred, index + hits);
+}
+
+// A lane mask per value of the compare result, bit i for lane i
+SIMD_TARGET("sse2")
+static unsigned sse2Mask8(__m128i v)
+{
+	return (unsigned)_mm_movemask_epi8(v);
+}
+
+SIMD_TARGET("sse2")
+static unsigned sse2Mask16(__m128i v)
+{
+	return (unsigned)_mm_movemask_epi8(_mm_packs_epi16(v, _mm_setzero_si128()));
+}
+
+SIMD_TARGET("sse2")
+static unsigned sse2Mask32(__m128i v)
+{
+	return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(v));
+}
+
+SIMD_TARGET("avx2")
+static unsigned avx2Mask8(__m256i v)
+{
+	return (unsigned)_mm256_movemask_epi8(v);
+}
+
+SIMD_TARGET("avx2")
+static unsigned avx2Mask16(__m256i v)
+{
+	// packing works within 128-bit halves, so bring the two packed quarters together
+	__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(v, v), 0xD8);
+	return (unsigned)_mm256_movemask_epi8(packed) & 0xFFFFu;
+}
+
+SIMD_TARGET("avx2")
+static unsigned avx2Mask32(__m256i v)
+{
+	return (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(v));
+}
+
+// SSE2 and AVX2 only compare signed lanes, so unsigned values and their bounds
+// are flipped into signed order by xor with the sign bit (FLIP)
+#define DEFINE_SELECT_INT(NAME, ISA, T, TMIN, TMAX, FLIP, VEC, LANES, LOAD, SET1, XOR, OR, AND, CMPGT, CMPEQ, MASK, SCALAR) \
+SIMD_TARGET(ISA) \
+static size_t NAME(const void* data, size_t n, const Predicate* pred, unsigned* index) \
+{ \
+	const T* vals = (const T*)data; \
+	long long low, high; \
+	if (!intRange(pred, TMIN, TMAX, &low, &high)) return 0; \
+	\
+	const VEC flip = SET1(FLIP); \
+	const VEC lo = SET1(low ^ FLIP); \
+	const VEC hi = SET1(high ^ FLIP); \
+	const VEC vfill = SET1(pred->fill ? (long long)*(const T*)pred->fill ^ FLIP : 0); \
+	const VEC hasFill = SET1(pred->fill ? -1 : 0); \
+	const unsigned all = ~0u >> (32 - LANES); \
+	size_t hits = 0; \
+	size_t i = 0; \
+	\
+	for (; i + LANES <= n; i += LANES) \
+	{ \
+		VEC v = XOR(LOAD((const VEC*)(vals + i)), flip); \
+		VEC out = OR(OR(CMPGT(lo, v), CMPGT(v, hi)), AND(CMPEQ(v, vfill), hasFill)); \
+		\
+		for (unsigned bits = ~MASK(out) & all; bits != 0; bits &= bits - 1) \
+			index[hits++] = (unsigned)i + lowestBit(bits); \
+	} \
+	\
+	return hits + selectTail(SCALAR, (const char*)data, sizeof(T), i, n, pred, index + hits); \
+}
+
+#define DEFINE_SELECT_INT_SSE2(NAME, T, TMIN, TMAX, FLIP, W, SCALAR) \
+	DEFINE_SELECT_INT(NAME, "sse2", T, TMIN, TMAX, FLIP, __m128i, 128 / W, _mm_loadu_si128, _mm_set1_epi##W, \
+		_mm_xor_si128, _mm_or_si128, _mm_and_si128, _mm_cmpgt_epi##W, _mm_cmpeq_epi##W, sse2Mask##W, SCALAR)
+
+#define DEFINE_SELECT_INT_AVX2(NAME, T, TMIN, TMAX, FLIP, W, SCALAR) \
+	DEFINE_SELECT_INT(NAME, "avx2", T, TMIN, TMAX, FLIP, __m256i, 256 / W, _mm256_loadu_si256, _mm256_set1_epi##W, \
+		_mm256_xor_si256, _mm256_or_si256, _mm256_and_si256, _mm256_cmpgt_epi##W, _mm256_cmpeq_epi##W, avx2Mask##W, SCALAR)
+
+DEFINE_SELECT_INT_SSE2(selectByteSSE2, signed char, -128.0, 127.0, 0, 8, selectByteScalar)
+DEFINE_SELECT_INT_SSE2(selectUByteSSE2, unsigned char, 0.0, 255.0, 0x80, 8, selectUByteScalar)
+DEFINE_SELECT_INT_SSE2(selectShortSSE2, short, -32768.0, 32767.0, 0, 16, selectShortScalar)
+DEFINE_SELECT_INT_SSE2(selectUShortSSE2, unsigned short, 0.0, 65535.0, 0x8000, 16, selectUShortScalar)
+DEFINE_SELECT_INT_SSE2(selectIntSSE2, int, -2147483648.0, 2147483647.0, 0, 32, selectIntScalar)
+DEFINE_SELECT_INT_SSE2(selectUIntSSE2, unsigned int, 0.0, 4294967295.0, 0x80000000LL, 32, selectUIntScalar)
+
+DEFINE_SELECT_INT_AVX2(selectByteAVX2, signed char, -128.0, 127.0, 0, 8, selectByteScalar)
+DEFINE_SELECT_INT_AVX2(selectUByteAVX2, unsigned char, 0.0, 255.0, 0x80, 8, selectUByteScalar)
+DEFINE_SELECT_INT_AVX2(selectShortAVX2, short, -32768.0, 32767.0, 0, 16, selectShortScalar)
+DEFINE_SELECT_INT_AVX2(selectUShortAVX2, unsigned short, 0.0, 65535.0, 0x8000, 16, selectUShortScalar)
+DEFINE_SELECT_INT_AVX2(selectIntAVX2, int, -2147483648.0, 2147483647.0, 0, 32, selectIntScalar)
+DEFINE_SELECT_INT_AVX2(selectUIntAVX2, unsigned int, 0.0, 4294967295.0, 0x80000000LL, 32, selectUIntScalar)
+
+SIMD_TARGET("avx2")
+static size_t selectFloatAVX2(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const float* vals = (const float*)data;
+	const __m256 lo = _mm256_set1_ps(pred->lowFloat);
+	const __m256 hi = _mm256_set1_ps(pred->highFloat);
+	const __m256 vfill = _mm256_set1_ps(pred->fill ? *(const float*)pred->fill : 0.f);
+	const __m256 noFill = _mm256_castsi256_ps(_mm256_set1_epi32(pred->fill ? 0 : -1));
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(vals + i);
+		__m256 in = _mm256_and_ps(_mm256_cmp_ps(v, lo, _CMP_GE_OQ), _mm256_cmp_ps(v, hi, _CMP_LE_OQ));
+		in = _mm256_and_ps(in, _mm256_or_ps(_mm256_cmp_ps(v, vfill, _CMP_NEQ_UQ), noFill));
+
+		for (unsigned bits = (unsigned)_mm256_movemask_ps(in); bits != 0; bits &= bits - 1)
+			index[hits++] = (unsigned)i + lowestBit(bits);
+	}
+
+	return hits + selectTail(selectFloatScalar, (const char*)data, sizeof(float), i, n, pred, index + hits);
+}
+
+SIMD_TARGET("avx2")
+static size_t selectDoubleAVX2(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const double* vals = (const double*)data;
+	const __m256d lo = _mm256_set1_pd(pred->lowOpen ? nextafter(pred->low, INFINITY) : pred->low);
+	const __m256d hi = _mm256_set1_pd(pred->highOpen ? nextafter(pred->high, -INFINITY) : pred->high);
+	const __m256d vfill = _mm256_set1_pd(pred->fill ? *(const double*)pred->fill : 0.0);
+	const __m256d noFill = _mm256_castsi256_pd(_mm256_set1_epi32(pred->fill ? 0 : -1));
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d v = _mm256_loadu_pd(vals + i);
+		__m256d in = _mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GE_OQ), _mm256_cmp_pd(v, hi, _CMP_LE_OQ));
+		in = _mm256_and_pd(in, _mm256_or_pd(_mm256_cmp_pd(v, vfill, _CMP_NEQ_UQ), noFill));
+
+		for (unsigned bits = (unsigned)_mm256_movemask_pd(in); bits != 0; bits &= bits - 1)
+			index[hits++] = (unsigned)i + lowestBit(bits);
+	}
+
+	return hits + selectTail(selectDoubleScalar, (const char*)data, sizeof(double), i, n, pred, index + hits);
+}
+
+#ifdef SIMD_HAVE_AVX512
+
+SIMD_TARGET("avx512f")
+static size_t selectFloatAVX512(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const float* vals = (const float*)data;
+	const __m512 lo = _mm512_set1_ps(pred->lowFloat);
+	const __m512 hi = _mm512_set1_ps(pred->highFloat);
+	const __m512 vfill = _mm512_set1_ps(pred->fill ? *(const float*)pred->fill : 0.f);
+	const __mmask16 noFill = pred->fill ? 0 : 0xFFFF;
+	const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16)
+	{
+		__m512 v = _mm512_loadu_ps(vals + i);
+		__mmask16 k = _mm512_cmp_ps_mask(v, lo, _CMP_GE_OQ) & _mm512_cmp_ps_mask(v, hi, _CMP_LE_OQ);
+		k &= _mm512_cmp_ps_mask(v, vfill, _CMP_NEQ_UQ) | noFill;
+
+		_mm512_mask_compressstoreu_epi32(index + hits, k, _mm512_add_epi32(lanes, _mm512_set1_epi32((int)i)));
+		hits += bitCount((unsigned)k);
+	}
+
+	return hits + selectTail(selectFloatScalar, (const char*)data, sizeof(float), i, n, pred, index + hits);
+}
+
+SIMD_TARGET("avx512f")
+static size_t selectDoubleAVX512(const void* data, size_t n, const Predicate* pred, unsigned* index)
+{
+	const double* vals = (const double*)data;
+	const __m512d lo = _mm512_set1_pd(pred->lowOpen ? nextafter(pred->low, INFINITY) : pred->low);
+	const __m512d hi = _mm512_set1_pd(pred->highOpen ? nextafter(pred->high, -INFINITY) : pred->high);
+	const __m512d vfill = _mm512_set1_pd(pred->fill ? *(const double*)pred->fill : 0.0);
+	const __mmask8 noFill = pred->fill ? 0 : 0xFF;
+	const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0);
+	size_t hits = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m512d v = _mm512_loadu_pd(vals + i);
+		__mmask8 k = _mm512_cmp_pd_mask(v, lo, _CMP_GE_OQ) & _mm512_cmp_pd_mask(v, hi, _CMP_LE_OQ);
+		k &= _mm512_cmp_pd_mask(v, vfill, _CMP_NEQ_UQ) | noFill;
+
+		_mm512_mask_compressstoreu_epi32(index + hits, (__mmask16)k, _mm512_add_epi32(lanes, _mm512_set1_epi32((int)i)));
+		hits += bitCount((unsigned)k);
+	}
+
+	return hits + selectTail(selectDoubleScalar, (const char*)data, sizeof(double), i, n, pred, index + hits);
+}
+
+
+// AVX-512 compares unsigned lanes directly and hands back the lane mask
+#define DEFINE_SELECT_INT_AVX512(NAME, T, TMIN, TMAX, W, SIGN, SCALAR) \
+SIMD_TARGET("avx512f,avx512bw") \
+static size_t NAME(const void* data, size_t n, const Predicate* pred, unsigned* index) \
+{ \
+	const T* vals = (const T*)data; \
+	long long low, high; \
+	if (!intRange(pred, TMIN, TMAX, &low, &high)) return 0; \
+	\
+	const __m512i lo = _mm512_set1_epi##W(low); \
+	const __m512i hi = _mm512_set1_epi##W(high); \
+	const __m512i vfill = _mm512_set1_epi##W(pred->fill ? (long long)*(const T*)pred->fill : 0); \
+	const unsigned long long noFill = pred->fill ? 0 : ~0ULL; \
+	size_t hits = 0; \
+	size_t i = 0; \
+	\
+	for (; i + 512 / W <= n; i += 512 / W) \
+	{ \
+		__m512i v = _mm512_loadu_si512(vals + i); \
+		unsigned long long k = (unsigned long long)_mm512_cmp_##SIGN##W##_mask(v, lo, _MM_CMPINT_NLT); \
+		k &= (unsigned long long)_mm512_cmp_##SIGN##W##_mask(v, hi, _MM_CMPINT_LE); \
+		k &= (unsigned long long)_mm512_cmp_##SIGN##W##_mask(v, vfill, _MM_CMPINT_NE) | noFill; \
+		\
+		for (; k != 0; k &= k - 1) \
+			index[hits++] = (unsigned)i + lowestBit64(k); \
+	} \
+	\
+	return hits + selectTail(SCALAR, (const char*)data, sizeof(T), i, n, pred, index + hits); \
+}
+
+DEFINE_SELECT_INT_AVX512(selectByteAVX512, signed char, -128.0, 127.0, 8, epi, selectByteScalar)
+DEFINE_SELECT_INT_AVX512(selectUByteAVX512, unsigned char, 0.0, 255.0, 8, epu, selectUByteScalar)
+DEFINE_SELECT_INT_AVX512(selectShortAVX512, short, -32768.0, 32767.0, 16, epi, selectShortScalar)
+DEFINE_SELECT_INT_AVX512(selectUShortAVX512, unsigned short, 0.0, 65535.0, 16, epu, selectUShortScalar)
+DEFINE_SELECT_INT_AVX512(selectIntAVX512, int, -2147483648.0, 2147483647.0, 32, epi, selectIntScalar)
+DEFINE_SELECT_INT_AVX512(selectUIntAVX512, unsigned int, 0.0, 4294967295.0, 32, epu, selectUIntScalar)
+
+#endif // SIMD_HAVE_AVX512
+#endif // SIMD_X86
+
+typedef size_t (*SelectKernel)(const void* data, size_t n, const Predicate* pred, unsigned* index);
+
+// The vector kernels handle plain ranges; missing values go through the scalar test.
+// 64-bit integers stay scalar.
+static SelectKernel selectKernel(nc_type type, bool range)
+{
+#ifdef SIMD_X86
+	SimdLevel level = range ? simdGetLevel() : SIMD_SCALAR;
+
+#ifdef SIMD_HAVE_AVX512
+	if (level >= SIMD_AVX512)
+	{
+		switch (type)
+		{
+		case NC_BYTE: return selectByteAVX512;
+		case NC_UBYTE: return selectUByteAVX512;
+		case NC_SHORT: return selectShortAVX512;
+		case NC_USHORT: return selectUShortAVX512;
+		case NC_INT: return selectIntAVX512;
+		case NC_UINT: return selectUIntAVX512;
+		case NC_FLOAT: return selectFloatAVX512;
+		case NC_DOUBLE: return selectDoubleAVX512;
+		default: break;
+		}
+	}
+#endif
+
+	if (level >= SIMD_AVX2)
+	{
+		switch (type)
+		{
+		case NC_BYTE: return selectByteAVX2;
+		case NC_UBYTE: return selectUByteAVX2;
+		case NC_SHORT: return selectShortAVX2;
+		case NC_USHORT: return selectUShortAVX2;
+		case NC_INT: return selectIntAVX2;
+		case NC_UINT: return selectUIntAVX2;
+		case NC_FLOAT: return selectFloatAVX2;
+		case NC_DOUBLE: return selectDoubleAVX2;
+		default: break;
+		}
+	}
+
+	if (level >= SIMD_SSE2)
+	{
+		switch (type)
+		{
+		case NC_BYTE: return selectByteSSE2;
+		case NC_UBYTE: return selectUByteSSE2;
+		case NC_SHORT: return selectShortSSE2;
+		case NC_USHORT: return selectUShortSSE2;
+		case NC_INT: return selectIntSSE2;
+		case NC_UINT: return selectUIntSSE2;
+		case NC_FLOAT: return selectFloatSSE2;
+		case NC_DOUBLE: return selectDoubleSSE2;
+		default: break;
+		}
+	}
+#else
+	(void)range;
+#endif
+
+	switch (type)
+	{
+	case NC_BYTE: return selectByteScalar;
+	case NC_UBYTE: return selectUByteScalar;
+	case NC_SHORT: return selectShortScalar;
+	case NC_USHORT: return selectUShortScalar;
+	case NC_INT: return selectIntScalar;
+	case NC_UINT: return selectUIntScalar;
+	case NC_INT64: return selectInt64Scalar;
+	case NC_UINT64: return selectUInt64Scalar;
+	case NC_FLOAT: return selectFloatScalar;
+	case NC_DOUBLE: return selectDoubleScalar;
+	default: return NULL;
+	}
+}
+
+size_t predicateSelect(nc_type type, const void* vals, size_t n, const Predicate* pred, unsigned* index)
+{
+	bool range = pred->kind == PREDICATE_RANGE && pred->nMissing == 0;
+
+	if (range && type == NC_FLOAT && pred->emptyFloat) return 0;
+
+	// nothing lies beyond an infinite open end, which nextafter cannot express
+	if (range && type == NC_DOUBLE && ((pred->lowOpen && pred->low == INFINITY) || (pred->highOpen && pred->high == -INFINITY))) return 0;
+
+	SelectKernel kernel = selectKernel(type, range);
+	return kernel != NULL ? kernel(vals, n, pred, index) : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef PREDICATE_H
+#define PREDICATE_H
+
+#include "simd.h"
+
+typedef enum PredicateKind
+{
+	PREDICATE_RANGE,    // low < x < high, each end open or closed
+	PREDICATE_FILL,     // x is the _FillValue
+	PREDICATE_NONFINITE // x is NaN or infinite
+} PredicateKind;
+
+// A test on stored (packed) values. Fill values never satisfy a range, and
+// neither do the missing values, which are compared one by one.
+typedef struct Predicate
+{
+	PredicateKind kind;
+	double low;
+	double high;
+	bool lowOpen;
+	bool highOpen;
+	const void* fill;      // of the variable's type, NULL when it has none
+	int nMissing;
+	const double* missing;
+	// the range as closed float bounds, set by predicatePrepare for the float kernels
+	float lowFloat;
+	float highFloat;
+	bool emptyFloat;
+} Predicate;
+
+// Call once the fields above are set
+void predicatePrepare(Predicate* pred);
+
+// Whether a valid (non-fill) value satisfies a range predicate
+bool predicateHolds(const Predicate* pred, double x);
+
+// Compare-and-compress: writes the positions of the matching values in vals
+// to index, which must have room for n entries, and returns how many there
+// are. n must fit in 32 bits. Follows the level set with simdSetLevel.
+size_t predicateSelect(nc_type type, const void* vals, size_t n, const Predicate* pred, unsigned* index);
+
+#endif
@@ -0,0 +1,110 @@
+#include "preload.h"
+
+#include "threads.h"
+#include "netcdf.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// size of each sequential read
+#define PRELOAD_READ_BYTES ((size_t)8 * 1024 * 1024)
+
+size_t preloadDefaultBudget(void)
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (!GlobalMemoryStatusEx(&status)) return 0;
+	return (size_t)(status.ullTotalPhys / 2);
+#else
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if (pages <= 0 || pageSize <= 0) return 0;
+	return (size_t)((unsigned long long)pages * (unsigned long long)pageSize / 2);
+#endif
+}
+
+static long long fileSize(FILE* file)
+{
+#ifdef _WIN32
+	if (_fseeki64(file, 0, SEEK_END) != 0) return -1;
+	long long size = _ftelli64(file);
+	return _fseeki64(file, 0, SEEK_SET) == 0 ? size : -1;
+#else
+	if (fseeko(file, 0, SEEK_END) != 0) return -1;
+	long long size = (long long)ftello(file);
+	return fseeko(file, 0, SEEK_SET) == 0 ? size : -1;
+#endif
+}
+
+int preloadFile(const char* path, size_t budget, Preload* preload)
+{
+	preload->data = NULL;
+	preload->size = 0;
+	preload->seconds = 0.0;
+
+	double begin = wallClock();
+
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return NC_ENOTNC;
+
+	// no point double-buffering in the C library for reads this size; setvbuf
+	// is only valid before any other operation on the stream
+	setvbuf(file, NULL, _IONBF, 0);
+
+	long long size = fileSize(file);
+	if (size <= 0)
+	{
+		fclose(file);
+		return NC_ENOTNC;
+	}
+
+	if (budget > 0 && (unsigned long long)size > budget)
+	{
+		fclose(file);
+		return NC_ENOMEM;
+	}
+
+	char* data = (char*)malloc((size_t)size);
+	if (data == NULL)
+	{
+		fclose(file);
+		return NC_ENOMEM;
+	}
+
+	size_t done = 0;
+	while (done < (size_t)size)
+	{
+		size_t want = (size_t)size - done < PRELOAD_READ_BYTES ? (size_t)size - done : PRELOAD_READ_BYTES;
+		size_t got = fread(data + done, 1, want, file);
+		if (got == 0) break;
+		done += got;
+	}
+
+	fclose(file);
+
+	if (done != (size_t)size)
+	{
+		free(data);
+		return NC_EIO;
+	}
+
+	preload->data = data;
+	preload->size = (size_t)size;
+	preload->seconds = wallClock() - begin;
+
+	return NC_NOERR;
+}
+
+void preloadFree(Preload* preload)
+{
+	free(preload->data);
+	preload->data = NULL;
+	preload->size = 0;
+}
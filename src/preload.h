@@ -0,0 +1,24 @@
+#ifndef PRELOAD_H
+#define PRELOAD_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// A whole netCDF file held in RAM, for opening with nc_open_mem
+typedef struct Preload
+{
+	void* data;
+	size_t size;
+	double seconds; // wall time the load took
+} Preload;
+
+// Half of physical memory, or 0 when it cannot be determined
+size_t preloadDefaultBudget(void);
+
+// Reads path into memory with large sequential reads. Fails with NC_ENOMEM
+// without reading anything when the file is larger than budget bytes;
+// a budget of 0 means no limit.
+int preloadFile(const char* path, size_t budget, Preload* preload);
+void preloadFree(Preload* preload);
+
+#endif
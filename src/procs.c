@@ -0,0 +1,372 @@
+#include "procs.h"
+
+#include "netcdf.h"
+#include "threads.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+struct ProcChannel
+{
+	int index;
+	int fd;                // write end of the worker's pipe, -1 when the worker is a thread
+	Mutex* receiveLock;    // threads: receive is called directly, one at a time
+	ProcReceive receive;
+	void* receiveUser;
+	bool failed;
+};
+
+#ifndef _WIN32
+
+static bool writeAll(int fd, const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+
+	while (size > 0)
+	{
+		ssize_t written = write(fd, bytes, size);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) return false;
+
+		bytes += written;
+		size -= (size_t)written;
+	}
+
+	return true;
+}
+
+#endif
+
+bool procSend(ProcChannel* channel, const void* data, size_t size)
+{
+	if (channel->failed) return false;
+
+#ifndef _WIN32
+	if (channel->fd >= 0)
+	{
+		// each message is its length followed by its bytes
+		unsigned long long length = size;
+		channel->failed = !writeAll(channel->fd, &length, sizeof(length)) || !writeAll(channel->fd, data, size);
+		return !channel->failed;
+	}
+#endif
+
+	mutexLock(channel->receiveLock);
+	channel->receive(channel->index, data, size, channel->receiveUser);
+	mutexUnlock(channel->receiveLock);
+	return true;
+}
+
+typedef struct ProcThread
+{
+	ProcMain main;
+	void* user;
+	ProcChannel channel;
+} ProcThread;
+
+static void procThreadMain(void* arg)
+{
+	ProcThread* thread = (ProcThread*)arg;
+	thread->main(thread->channel.index, &thread->channel, thread->user);
+}
+
+#ifdef _WIN32
+
+// The fallback: every worker a thread of this process
+static int runThreads(int count, ProcMain main, void* user, ProcReceive receive, void* receiveUser)
+{
+	ProcThread* threads = (ProcThread*)malloc(count * sizeof(ProcThread));
+	Thread* handles = (Thread*)malloc(count * sizeof(Thread));
+	if (threads == NULL || handles == NULL)
+	{
+		free(threads);
+		free(handles);
+		return NC_ENOMEM;
+	}
+
+	Mutex lock;
+	mutexInit(&lock);
+
+	for (int i = 0; i < count; ++i)
+	{
+		threads[i].main = main;
+		threads[i].user = user;
+		threads[i].channel.index = i;
+		threads[i].channel.fd = -1;
+		threads[i].channel.receiveLock = &lock;
+		threads[i].channel.receive = receive;
+		threads[i].channel.receiveUser = receiveUser;
+		threads[i].channel.failed = false;
+	}
+
+	int started = 0;
+	for (; started < count; ++started)
+	{
+		if (threadCreate(&handles[started], procThreadMain, &threads[started]) != 0)
+			break;
+	}
+
+	// whatever could not be handed to a thread runs here
+	for (int i = started; i < count; ++i)
+		procThreadMain(&threads[i]);
+
+	for (int i = 0; i < started; ++i)
+		threadJoin(handles[i]);
+
+	mutexDestroy(&lock);
+	free(threads);
+	free(handles);
+
+	return NC_NOERR;
+}
+
+int procsRun(int count, ProcMain main, void* user, ProcReceive receive, void* receiveUser)
+{
+	return runThreads(count, main, user, receive, receiveUser);
+}
+
+void* procsSharedAlloc(size_t size)
+{
+	return calloc(1, size);
+}
+
+void procsSharedFree(void* memory, size_t size)
+{
+	(void)size;
+	free(memory);
+}
+
+#else
+
+typedef struct ProcState
+{
+	pid_t pid;
+	int fd;                // read end, -1 once closed
+	unsigned char* buffer; // bytes received and not yet handed to receive
+	size_t used;
+	size_t allocated;
+} ProcState;
+
+// Hands every whole message in the worker's buffer to receive
+static void deliver(ProcState* proc, int index, ProcReceive receive, void* receiveUser)
+{
+	size_t pos = 0;
+
+	while (proc->used - pos >= sizeof(unsigned long long))
+	{
+		unsigned long long length;
+		memcpy(&length, proc->buffer + pos, sizeof(length));
+		if (proc->used - pos - sizeof(length) < length) break;
+
+		receive(index, proc->buffer + pos + sizeof(length), (size_t)length, receiveUser);
+		pos += sizeof(length) + (size_t)length;
+	}
+
+	memmove(proc->buffer, proc->buffer + pos, proc->used - pos);
+	proc->used -= pos;
+}
+
+// Reads what the worker has written so far, closing the pipe at its end
+static int readSome(ProcState* proc)
+{
+	if (proc->allocated - proc->used < 65536)
+	{
+		size_t allocated = proc->allocated > 0 ? proc->allocated * 2 : 131072;
+		unsigned char* grown = (unsigned char*)realloc(proc->buffer, allocated);
+		if (grown == NULL) return NC_ENOMEM;
+
+		proc->buffer = grown;
+		proc->allocated = allocated;
+	}
+
+	ssize_t got;
+	do
+	{
+		got = read(proc->fd, proc->buffer + proc->used, proc->allocated - proc->used);
+	} while (got < 0 && errno == EINTR);
+
+	// a read error ends the worker's stream like its exit does; waitpid tells them apart
+	if (got <= 0)
+	{
+		close(proc->fd);
+		proc->fd = -1;
+		return NC_NOERR;
+	}
+
+	proc->used += (size_t)got;
+	return NC_NOERR;
+}
+
+int procsRun(int count, ProcMain main, void* user, ProcReceive receive, void* receiveUser)
+{
+	if (count <= 0) return NC_NOERR;
+
+	ProcState* procs = (ProcState*)calloc(count, sizeof(ProcState));
+	struct pollfd* polls = (struct pollfd*)malloc(count * sizeof(struct pollfd));
+	int* owners = (int*)malloc(count * sizeof(int));
+	if (procs == NULL || polls == NULL || owners == NULL)
+	{
+		free(procs);
+		free(polls);
+		free(owners);
+		return NC_ENOMEM;
+	}
+
+	// anything buffered would otherwise be written once by each worker as well
+	fflush(NULL);
+
+	int status = NC_NOERR;
+	int started = 0;
+
+	for (; started < count; ++started)
+	{
+		int fds[2];
+		if (pipe(fds) != 0) break;
+
+		// holding the lock over the fork means no other thread is inside
+		// libnetcdf, so the worker gets its state whole and the lock free
+		ncLock();
+		pid_t pid = fork();
+		ncUnlock();
+
+		if (pid < 0)
+		{
+			close(fds[0]);
+			close(fds[1]);
+			break;
+		}
+
+		if (pid == 0)
+		{
+			close(fds[0]);
+			for (int i = 0; i < started; ++i)
+				close(procs[i].fd);
+
+			// a parent gone early must not leave the worker killed half way through a write
+			signal(SIGPIPE, SIG_IGN);
+
+			ProcChannel channel;
+			channel.index = started;
+			channel.fd = fds[1];
+			channel.receiveLock = NULL;
+			channel.receive = NULL;
+			channel.receiveUser = NULL;
+			channel.failed = false;
+
+			main(started, &channel, user);
+
+			// skip the exit handlers, which belong to the parent's libraries and files
+			_exit(channel.failed ? 1 : 0);
+		}
+
+		close(fds[1]);
+		procs[started].pid = pid;
+		procs[started].fd = fds[0];
+	}
+
+	// workers that could not be started run here once the others are done;
+	// running them now would leave the started ones blocked on full pipes
+	int open = started;
+	while (open > 0 && status == NC_NOERR)
+	{
+		int nPolls = 0;
+		for (int i = 0; i < started; ++i)
+		{
+			if (procs[i].fd < 0) continue;
+
+			polls[nPolls].fd = procs[i].fd;
+			polls[nPolls].events = POLLIN;
+			polls[nPolls].revents = 0;
+			owners[nPolls++] = i;
+		}
+
+		if (poll(polls, nPolls, -1) < 0)
+		{
+			if (errno == EINTR) continue;
+			status = NC_EIO;
+			break;
+		}
+
+		for (int p = 0; p < nPolls; ++p)
+		{
+			if (polls[p].revents == 0) continue;
+
+			ProcState* proc = &procs[owners[p]];
+			status = readSome(proc);
+
+			deliver(proc, owners[p], receive, receiveUser);
+			if (proc->fd < 0) --open;
+		}
+	}
+
+	for (int i = 0; i < started; ++i)
+	{
+		if (procs[i].fd >= 0)
+		{
+			kill(procs[i].pid, SIGTERM);
+			close(procs[i].fd);
+		}
+
+		int exitStatus = -1;
+		while (waitpid(procs[i].pid, &exitStatus, 0) < 0 && errno == EINTR)
+			;
+
+		// a worker that died also left its results unsent
+		bool ok = WIFEXITED(exitStatus) && WEXITSTATUS(exitStatus) == 0 && procs[i].used == 0;
+		if (!ok && status == NC_NOERR) status = NC_EIO;
+
+		free(procs[i].buffer);
+	}
+
+	free(procs);
+	free(polls);
+	free(owners);
+
+	if (status != NC_NOERR || started == count) return status;
+
+	// the rest run here, one after another
+	Mutex lock;
+	mutexInit(&lock);
+
+	for (int i = started; i < count; ++i)
+	{
+		ProcThread thread;
+		thread.main = main;
+		thread.user = user;
+		thread.channel.index = i;
+		thread.channel.fd = -1;
+		thread.channel.receiveLock = &lock;
+		thread.channel.receive = receive;
+		thread.channel.receiveUser = receiveUser;
+		thread.channel.failed = false;
+		procThreadMain(&thread);
+	}
+
+	mutexDestroy(&lock);
+
+	return NC_NOERR;
+}
+
+void* procsSharedAlloc(size_t size)
+{
+	void* memory = mmap(NULL, size > 0 ? size : 1, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	return memory == MAP_FAILED ? NULL : memory;
+}
+
+void procsSharedFree(void* memory, size_t size)
+{
+	if (memory != NULL) munmap(memory, size > 0 ? size : 1);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef PROCS_H
+#define PROCS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Worker processes for work that calls into libnetcdf. Every call into the
+// library is serialised within a process (see ncLock), so reading and
+// inflating in parallel takes separate processes, each opening the file with
+// its own copy of the library's state. Workers report back through messages
+// on a pipe; where fork is unavailable they run as threads of the caller and
+// their netCDF calls share the one lock.
+
+typedef struct ProcChannel ProcChannel;
+
+typedef void (*ProcMain)(int index, ProcChannel* channel, void* user);
+typedef void (*ProcReceive)(int index, const void* data, size_t size, void* user);
+
+// Runs main(index) for every index below count and calls receive on the
+// calling thread, one call at a time, for each message a worker sends, in the
+// order each worker sent them. Returns NC_NOERR, NC_ENOMEM, or NC_EIO when a
+// worker process ended abnormally.
+int procsRun(int count, ProcMain main, void* user, ProcReceive receive, void* receiveUser);
+
+bool procSend(ProcChannel* channel, const void* data, size_t size);
+
+// Zeroed memory every worker sees and writes, for counters updated with the
+// atomic* functions of threads.h
+void* procsSharedAlloc(size_t size);
+void procsSharedFree(void* memory, size_t size);
+
+#endif
@@ -0,0 +1,404 @@
+#include "progressive.h"
+#include "statcache.h"
+#include "threads.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+// values in the strided preview
+#define PREVIEW_VALUES ((unsigned long long)1 << 20)
+// keep at least this many samples along each strided dimension
+#define PREVIEW_MIN_PER_DIM 16
+// split the variable into about this many blocks so the intervals tighten early
+#define PROGRESSIVE_BLOCKS 1024
+#define MIN_BLOCK_BYTES ((size_t)1024 * 1024)
+#define Z95 1.959963984540054
+
+static const double estimateQs[ESTIMATE_QUANTILES] = { 0.05, 0.5, 0.95 };
+
+static unsigned long long splitMix(unsigned long long* state)
+{
+	unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static double clampUnit(double p)
+{
+	return p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+}
+
+// Quantile bounds from the binomial spread of a sample of nEff independent
+// values, widened by the sketch's own rank error
+static void estimateQuantiles(const KllSketch* sketch, double nEff, double fpc, StatsEstimate* est)
+{
+	double rankError = kllRankError(sketch);
+
+	for (int i = 0; i < ESTIMATE_QUANTILES; ++i)
+	{
+		double p = estimateQs[i];
+		double h = rankError;
+		if (nEff > 0.0) h += Z95 * sqrt(p * (1.0 - p) / nEff) * fpc;
+
+		double ps[3] = { clampUnit(p - h), p, clampUnit(p + h) };
+		double out[3];
+
+		if (!kllQuantiles(sketch, ps, 3, out))
+		{
+			out[0] = est->min;
+			out[1] = est->mean;
+			out[2] = est->max;
+		}
+
+		est->qLow[i] = out[0];
+		est->qs[i] = out[1];
+		est->qHigh[i] = out[2];
+	}
+}
+
+// Packed or masked variables are estimated in physical units, which is what
+// their sketch holds
+static unsigned long long estimateValid(const VarStats* stats)
+{
+	return stats->unpack ? stats->physical.valid : stats->validCount;
+}
+
+static const Moments* estimateMoments(const VarStats* stats)
+{
+	return stats->unpack ? &stats->physical.moments : &stats->moments;
+}
+
+static double estimateSum(const VarStats* stats)
+{
+	return stats->unpack ? compensatedValue(&stats->physical.sum) : varStatsSum(stats);
+}
+
+static double estimateMin(const VarStats* stats)
+{
+	return stats->unpack ? stats->physical.min : stats->min;
+}
+
+static double estimateMax(const VarStats* stats)
+{
+	return stats->unpack ? stats->physical.max : stats->max;
+}
+
+// Every value has been reduced, so only the sketch's rank error is left
+static void exactEstimate(const VarStats* stats, StatsEstimate* est)
+{
+	est->fraction = 1.0;
+	est->valid = estimateValid(stats);
+	est->mean = estimateMoments(stats)->mean;
+	est->meanMargin = 0.0;
+	est->min = estimateMin(stats);
+	est->max = estimateMax(stats);
+	est->exact = true;
+
+	if (stats->sketch) estimateQuantiles(stats->sketch, 0.0, 0.0, est);
+}
+
+// The preview is treated as a simple random sample
+static void previewEstimate(const VarInfo* var, const VarStats* preview, StatsEstimate* est)
+{
+	est->fraction = (double)preview->count / (double)var->valueCount;
+	est->valid = estimateValid(preview);
+	est->mean = estimateMoments(preview)->mean;
+	est->meanMargin = Z95 * sqrt(momentsVariance(estimateMoments(preview)) / (double)est->valid * (1.0 - est->fraction));
+	est->min = estimateMin(preview);
+	est->max = estimateMax(preview);
+	est->exact = false;
+
+	estimateQuantiles(preview->sketch, (double)est->valid, sqrt(1.0 - est->fraction), est);
+}
+
+// Blocks are clusters drawn without replacement, so the mean is a ratio
+// estimator (block sums over block valid counts) and its variance comes from
+// the spread of the block residuals. The ratio of that variance to what
+// independent values would give is the design effect, which shrinks the
+// sample size the quantile bounds are built on.
+static bool blockEstimate(const VarInfo* var, const VarStats* stats, const VarStats* preview, const double* blockValid, const double* blockSum, unsigned long long n, unsigned long long blocks, StatsEstimate* est)
+{
+	unsigned long long valid = estimateValid(stats);
+	if (n < 2 || valid < 2) return false;
+
+	// until the blocks hold more values than the preview, the preview is the better guess
+	if (preview != NULL && valid < estimateValid(preview)) return false;
+
+	double ratio = estimateMoments(stats)->mean;
+	double residuals = 0.0;
+	double totalValid = 0.0;
+
+	for (unsigned long long i = 0; i < n; ++i)
+	{
+		double r = blockSum[i] - ratio * blockValid[i];
+		residuals += r * r;
+		totalValid += blockValid[i];
+	}
+
+	double meanValid = totalValid / (double)n;
+	double blockFpc = 1.0 - (double)n / (double)blocks;
+	double ratioVariance = blockFpc * residuals / (double)(n - 1) / ((double)n * meanValid * meanValid);
+
+	est->fraction = (double)stats->count / (double)var->valueCount;
+	est->valid = valid;
+	est->mean = ratio;
+	est->meanMargin = Z95 * sqrt(ratioVariance);
+	est->min = estimateMin(stats);
+	est->max = estimateMax(stats);
+	est->exact = false;
+
+	if (preview != NULL && estimateValid(preview) > 0)
+	{
+		if (estimateMin(preview) < est->min) est->min = estimateMin(preview);
+		if (estimateMax(preview) > est->max) est->max = estimateMax(preview);
+	}
+
+	double valueFpc = 1.0 - est->fraction;
+	double srsVariance = valueFpc * momentsVariance(estimateMoments(stats)) / (double)valid;
+	double designEffect = srsVariance > 0.0 ? ratioVariance / srsVariance : 1.0;
+	if (designEffect < 1.0) designEffect = 1.0;
+
+	estimateQuantiles(stats->sketch, (double)valid / designEffect, sqrt(valueFpc), est);
+
+	return true;
+}
+
+// One nc_get_vars read, strided along the outer dimensions first so each
+// sampled row stays contiguous on disk
+static int stridedPreview(const VarInfo* var, const void* fillval, VarStats* preview)
+{
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+	ptrdiff_t stride[NC_MAX_VAR_DIMS];
+
+	unsigned long long factor = (var->valueCount + PREVIEW_VALUES - 1) / PREVIEW_VALUES;
+	unsigned long long n = 1;
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		size_t len = var->dimLens[d];
+		size_t step = 1;
+
+		if (factor > 1)
+		{
+			size_t most = len / PREVIEW_MIN_PER_DIM > 0 ? len / PREVIEW_MIN_PER_DIM : 1;
+			step = factor < most ? (size_t)factor : most;
+			factor = (factor + step - 1) / step;
+		}
+
+		start[d] = 0;
+		stride[d] = (ptrdiff_t)step;
+		count[d] = (len + step - 1) / step;
+		n *= count[d];
+	}
+
+	void* vals = malloc((size_t)n * var->typeSize);
+	if (vals == NULL) return NC_ENOMEM;
+
+	ncLock();
+	int status = readSlabStrided(var, start, count, stride, vals);
+	ncUnlock();
+
+	if (status == NC_NOERR)
+		status = reduceSlab(var, vals, n, fillval, preview);
+
+	free(vals);
+
+	return status;
+}
+
+int progressiveVarStats(const VarInfo* var, const StatsConfig* config, double interval, EstimateCallback report, void* user, VarStats* stats, bool* complete)
+{
+	*complete = false;
+
+	// the estimates are built on the sketch, so quantiles are always on
+	StatsConfig sketched = *config;
+	sketched.quantiles = true;
+
+	varStatsInit(stats, var->type);
+
+	if (simdKernel(var->type) == NULL)
+		return NC_EBADTYPE;
+
+	if (!varStatsEnableSketches(stats, true, config->histBins, 1))
+		return NC_ENOMEM;
+
+	PackInfo pack;
+	int status = getPackInfo(var->ncid, var->varID, var->type, &pack);
+	if (status != NC_NOERR) return status;
+
+	stats->unpack = packInfoActive(&pack);
+	stats->pack = pack;
+
+	StatsEstimate est;
+
+	FileIdentity id;
+	bool cacheable = config->cacheDir != NULL && config->path != NULL && !var->subset && fileIdentityGet(config->path, &id);
+
+	if (cacheable)
+	{
+		unsigned long long records;
+		CacheLookup lookup = statsCacheLoad(config->cacheDir, &id, var, &sketched, stats, &records);
+
+		// only appended records need reading, which is quick enough to do exactly
+		if (lookup == CACHE_PARTIAL)
+		{
+			varStatsFree(stats);
+			status = computeVarStats(var, &sketched, stats);
+			if (status != NC_NOERR) return status;
+		}
+		else if (lookup == CACHE_HIT)
+		{
+			stats->cached = true;
+		}
+
+		if (lookup != CACHE_MISS)
+		{
+			*complete = true;
+			if (estimateValid(stats) > 0)
+			{
+				exactEstimate(stats, &est);
+				report(&est, user);
+			}
+			return NC_NOERR;
+		}
+	}
+
+	long long fillStorage;
+	const void* fillval = varFillValue(var, &fillStorage);
+
+	// chunked variables skip the preview: a strided read would inflate nearly every chunk
+	VarStats preview;
+	varStatsInit(&preview, var->type);
+	bool havePreview = false;
+
+	if (!var->chunked && var->valueCount > 4 * PREVIEW_VALUES)
+	{
+		if (!varStatsEnableSketches(&preview, true, 0, 2))
+		{
+			varStatsFree(&preview);
+			return NC_ENOMEM;
+		}
+		preview.unpack = stats->unpack;
+		preview.pack = pack;
+
+		status = stridedPreview(var, fillval, &preview);
+		if (status != NC_NOERR)
+		{
+			varStatsFree(&preview);
+			return status;
+		}
+
+		havePreview = estimateValid(&preview) > 1;
+		if (havePreview)
+		{
+			previewEstimate(var, &preview, &est);
+			if (!report(&est, user))
+			{
+				varStatsFree(&preview);
+				return NC_NOERR;
+			}
+		}
+	}
+
+	size_t memLimit = config->memLimit;
+	unsigned long long share = var->valueCount * var->typeSize / PROGRESSIVE_BLOCKS;
+	if (share < MIN_BLOCK_BYTES) share = MIN_BLOCK_BYTES;
+	if (share < memLimit) memLimit = (size_t)share;
+
+	SlabPlan plan;
+	slabPlanInit(&plan, var, memLimit);
+	ncLock();
+	chunkCachePlan(&plan, config->chunkCache, &stats->chunkCache);
+	ncUnlock();
+
+	unsigned long long* order = (unsigned long long*)malloc(plan.slabCount * sizeof(unsigned long long));
+	double* blockValid = (double*)malloc(plan.slabCount * sizeof(double));
+	double* blockSum = (double*)malloc(plan.slabCount * sizeof(double));
+	void* vals = malloc((size_t)plan.slabValues * var->typeSize);
+
+	if (order == NULL || blockValid == NULL || blockSum == NULL || vals == NULL)
+	{
+		free(order);
+		free(blockValid);
+		free(blockSum);
+		free(vals);
+		varStatsFree(&preview);
+		return NC_ENOMEM;
+	}
+
+	// a fixed seed keeps the sequence of estimates reproducible
+	unsigned long long rng = 0x6E63786CULL;
+	for (unsigned long long i = 0; i < plan.slabCount; ++i)
+		order[i] = i;
+	for (unsigned long long i = plan.slabCount; i > 1; --i)
+	{
+		unsigned long long j = splitMix(&rng) % i;
+		unsigned long long t = order[i - 1];
+		order[i - 1] = order[j];
+		order[j] = t;
+	}
+
+	ncLock();
+	chunkCacheApply(var->ncid, var->varID, &stats->chunkCache);
+	ncUnlock();
+
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+	double lastReport = wallClock();
+	bool stopped = false;
+
+	for (unsigned long long b = 0; b < plan.slabCount; ++b)
+	{
+		unsigned long long n = slabPlanGet(&plan, order[b], start, count);
+
+		ncLock();
+		status = readSlab(var, start, count, vals);
+		ncUnlock();
+
+		if (status != NC_NOERR) break;
+
+		unsigned long long validBefore = estimateValid(stats);
+		double sumBefore = estimateSum(stats);
+
+		status = reduceSlab(var, vals, n, fillval, stats);
+		if (status != NC_NOERR) break;
+
+		blockValid[b] = (double)(estimateValid(stats) - validBefore);
+		blockSum[b] = estimateSum(stats) - sumBefore;
+
+		double now = wallClock();
+		if (b + 1 < plan.slabCount && now - lastReport >= interval)
+		{
+			if (blockEstimate(var, stats, havePreview ? &preview : NULL, blockValid, blockSum, b + 1, plan.slabCount, &est))
+			{
+				lastReport = now;
+				if (!report(&est, user))
+				{
+					stopped = true;
+					break;
+				}
+			}
+		}
+	}
+
+	free(order);
+	free(blockValid);
+	free(blockSum);
+	free(vals);
+	varStatsFree(&preview);
+
+	if (status != NC_NOERR || stopped) return status;
+
+	*complete = true;
+
+	if (estimateValid(stats) > 0)
+	{
+		exactEstimate(stats, &est);
+		report(&est, user);
+	}
+
+	if (cacheable)
+		statsCacheStore(config->cacheDir, &id, var, stats);
+
+	return NC_NOERR;
+}
@@ -0,0 +1,37 @@
+#ifndef PROGRESSIVE_H
+#define PROGRESSIVE_H
+
+#include "stats.h"
+
+#define ESTIMATE_QUANTILES 3
+
+// What the data read so far says about the whole variable, in physical units
+// for packed or masked variables and in stored units otherwise.
+// Margins are half-widths of 95% confidence intervals; min and max are the
+// extremes seen so far, so the true ones can only lie further out.
+typedef struct StatsEstimate
+{
+	double fraction;          // share of the variable's values read
+	unsigned long long valid; // valid values behind the estimate
+	double mean;
+	double meanMargin;
+	double min;
+	double max;
+	double qs[ESTIMATE_QUANTILES];     // P5, median, P95
+	double qLow[ESTIMATE_QUANTILES];
+	double qHigh[ESTIMATE_QUANTILES];
+	bool exact;               // everything has been read; the estimate is the answer
+} StatsEstimate;
+
+// Called with each refined estimate; return false to stop reading
+typedef bool (*EstimateCallback)(const StatsEstimate* estimate, void* user);
+
+// Computes the same statistics as computeVarStats, but reports estimates while
+// it works: first from an nc_get_vars strided preview (contiguous variables),
+// then from blocks of the variable reduced in random order, each estimate
+// tighter than the last, ending with the exact result. Reports come at most
+// every interval seconds. When the callback stops the run, stats holds what
+// was reduced so far and complete is false.
+int progressiveVarStats(const VarInfo* var, const StatsConfig* config, double interval, EstimateCallback report, void* user, VarStats* stats, bool* complete);
+
+#endif
@@ -0,0 +1,527 @@
+#include "query.h"
+#include "predicate.h"
+#include "statcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// positions per predicateSelect call, bounding the index buffer whatever the slab size
+#define QUERY_PIECE ((size_t)1 << 20)
+
+// Where the matches of one query go as blocks are evaluated
+typedef struct MatchSink
+{
+	const VarInfo* var;
+	const Predicate* pred;
+	const PackInfo* pack;
+	FILE* out;
+	unsigned* index;
+	QueryResult* result;
+	size_t boxLow[NC_MAX_VAR_DIMS];
+	size_t boxHigh[NC_MAX_VAR_DIMS];
+} MatchSink;
+
+bool parseQuery(const char* text, Query* query)
+{
+	while (*text == ' ' || *text == '\t') ++text;
+
+	char* end = (char*)text;
+	query->low = -INFINITY;
+	query->high = INFINITY;
+
+	if (*text == '>' || *text == '<')
+	{
+		query->op = *text == '>' ? QUERY_GREATER : QUERY_LESS;
+		double x = strtod(text + 1, &end);
+		if (end == text + 1) return false;
+
+		if (query->op == QUERY_GREATER) query->low = x;
+		else query->high = x;
+	}
+	else if (strncmp(text, "between", 7) == 0)
+	{
+		query->op = QUERY_BETWEEN;
+		query->low = strtod(text + 7, &end);
+		if (end == text + 7) return false;
+
+		const char* next = end;
+		query->high = strtod(next, &end);
+		if (end == next || query->low > query->high) return false;
+	}
+	else if (strncmp(text, "is-fill", 7) == 0 || strncmp(text, "fill", 4) == 0)
+	{
+		query->op = QUERY_FILL;
+		end += text[0] == 'i' ? 7 : 4;
+	}
+	else if (strncmp(text, "non-finite", 10) == 0 || strncmp(text, "nonfinite", 9) == 0)
+	{
+		query->op = QUERY_NONFINITE;
+		end += text[3] == '-' ? 10 : 9;
+	}
+	else
+	{
+		return false;
+	}
+
+	while (*end == ' ' || *end == '\t') ++end;
+	return *end == '\0' && !isnan(query->low) && !isnan(query->high);
+}
+
+// The query as a test on stored values, narrowed to the CF valid range
+static void buildPredicate(const Query* query, const PackInfo* pack, const void* fill, Predicate* pred)
+{
+	pred->kind = query->op == QUERY_FILL ? PREDICATE_FILL : (query->op == QUERY_NONFINITE ? PREDICATE_NONFINITE : PREDICATE_RANGE);
+	pred->low = query->low;
+	pred->high = query->high;
+	pred->lowOpen = query->op == QUERY_GREATER;
+	pred->highOpen = query->op == QUERY_LESS;
+	pred->fill = fill;
+	pred->nMissing = 0;
+	pred->missing = NULL;
+
+	if (pred->kind == PREDICATE_RANGE)
+	{
+		// x * scale + offset > t is x > (t - offset) / scale, flipped when the scale is negative
+		if (pack->packed && pack->scale != 0.0)
+		{
+			double low = (pred->low - pack->offset) / pack->scale;
+			double high = (pred->high - pack->offset) / pack->scale;
+
+			if (pack->scale < 0.0)
+			{
+				bool open = pred->lowOpen;
+				pred->low = high;
+				pred->high = low;
+				pred->lowOpen = pred->highOpen;
+				pred->highOpen = open;
+			}
+			else
+			{
+				pred->low = low;
+				pred->high = high;
+			}
+		}
+
+		if (pack->masked)
+		{
+			if (pack->validMin > pred->low || (pack->validMin == pred->low && !pred->lowOpen))
+			{
+				pred->low = pack->validMin;
+				pred->lowOpen = false;
+			}
+			if (pack->validMax < pred->high || (pack->validMax == pred->high && !pred->highOpen))
+			{
+				pred->high = pack->validMax;
+				pred->highOpen = false;
+			}
+
+			pred->nMissing = pack->nMissing;
+			pred->missing = pack->missing;
+		}
+	}
+
+	predicatePrepare(pred);
+}
+
+static bool zoneMayMatch(const Predicate* pred, const Zone* zone)
+{
+	switch (pred->kind)
+	{
+	case PREDICATE_FILL:
+		return zone->count > zone->valid;
+	case PREDICATE_NONFINITE:
+		return zone->nonFinite != 0;
+	default:
+		if (zone->valid == 0) return false;
+		if (pred->lowOpen ? zone->max <= pred->low : zone->max < pred->low) return false;
+		if (pred->highOpen ? zone->min >= pred->high : zone->min > pred->high) return false;
+		return true;
+	}
+}
+
+// Every value lies in [min, max], so a zone without fill values matches
+// throughout when both ends do, unless NaN or a missing value could be hiding in between
+static bool zoneAllMatch(const Predicate* pred, const Zone* zone)
+{
+	switch (pred->kind)
+	{
+	case PREDICATE_FILL:
+		return zone->count > 0 && zone->valid == 0;
+	case PREDICATE_NONFINITE:
+		return false;
+	default:
+		return zone->valid > 0 && zone->valid == zone->count && !zone->nonFinite && pred->nMissing == 0 && predicateHolds(pred, zone->min) && predicateHolds(pred, zone->max);
+	}
+}
+
+static void boxAdd(MatchSink* sink, const size_t* low, const size_t* high)
+{
+	bool first = sink->result->matches == 0;
+
+	for (int d = 0; d < sink->var->nDims; ++d)
+	{
+		if (first || low[d] < sink->boxLow[d]) sink->boxLow[d] = low[d];
+		if (first || high[d] > sink->boxHigh[d]) sink->boxHigh[d] = high[d];
+	}
+}
+
+static void writeMatch(FILE* out, const MatchSink* sink, const size_t* file, const void* value)
+{
+	const VarInfo* var = sink->var;
+
+	for (int d = 0; d < var->nDims; ++d)
+		fprintf(out, "%zu,", file[d]);
+
+	// fill values are written as stored; unpacking them means nothing
+	bool unpack = sink->pack->packed && sink->pred->kind != PREDICATE_FILL;
+	double x = 0.0;
+
+	switch (var->type)
+	{
+	case NC_BYTE: x = *(const signed char*)value; break;
+	case NC_UBYTE: x = *(const unsigned char*)value; break;
+	case NC_SHORT: x = *(const short*)value; break;
+	case NC_USHORT: x = *(const unsigned short*)value; break;
+	case NC_INT: x = *(const int*)value; break;
+	case NC_UINT: x = *(const unsigned int*)value; break;
+	case NC_INT64:
+		if (!unpack) { fprintf(out, "%lld\n", *(const long long*)value); return; }
+		x = (double)*(const long long*)value;
+		break;
+	case NC_UINT64:
+		if (!unpack) { fprintf(out, "%llu\n", *(const unsigned long long*)value); return; }
+		x = (double)*(const unsigned long long*)value;
+		break;
+	case NC_FLOAT: x = *(const float*)value; break;
+	default: x = *(const double*)value; break;
+	}
+
+	if (unpack)
+		fprintf(out, "%.17g\n", x * sink->pack->scale + sink->pack->offset);
+	else
+		fprintf(out, var->type == NC_FLOAT ? "%.9g\n" : (var->type == NC_DOUBLE ? "%.17g\n" : "%.0f\n"), x);
+}
+
+// Evaluates one slab or block read at start/count (selection coordinates),
+// turning each match's position back into file indices
+static void collectMatches(MatchSink* sink, const void* vals, const size_t* start, const size_t* count, unsigned long long n)
+{
+	const VarInfo* var = sink->var;
+	const char* bytes = (const char*)vals;
+	size_t file[NC_MAX_VAR_DIMS];
+
+	for (unsigned long long base = 0; base < n; base += QUERY_PIECE)
+	{
+		size_t len = n - base < QUERY_PIECE ? (size_t)(n - base) : QUERY_PIECE;
+		size_t hits = predicateSelect(var->type, bytes + base * var->typeSize, len, sink->pred, sink->index);
+
+		for (size_t h = 0; h < hits; ++h)
+		{
+			unsigned long long flat = base + sink->index[h];
+
+			for (int d = var->nDims - 1; d >= 0; --d)
+			{
+				file[d] = var->offset[d] + (start[d] + (size_t)(flat % count[d])) * (size_t)var->step[d];
+				flat /= count[d];
+			}
+
+			boxAdd(sink, file, file);
+			++sink->result->matches;
+
+			if (sink->out)
+				writeMatch(sink->out, sink, file, bytes + (base + sink->index[h]) * var->typeSize);
+		}
+	}
+
+	sink->result->valuesRead += n;
+}
+
+// The part of a file block the selection reaches, in selection coordinates.
+// whole is cleared unless the selection takes every value of the block.
+static bool blockInSelection(const VarInfo* var, const size_t* blockStart, const size_t* blockCount, size_t* start, size_t* count, bool* whole)
+{
+	*whole = true;
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		size_t offset = var->offset[d];
+		size_t step = (size_t)var->step[d];
+		size_t first = blockStart[d];
+		size_t last = blockStart[d] + blockCount[d] - 1;
+
+		if (var->dimLens[d] == 0 || blockCount[d] == 0 || last < offset) return false;
+
+		size_t lo = first <= offset ? 0 : (first - offset + step - 1) / step;
+		size_t hi = (last - offset) / step;
+		if (hi > var->dimLens[d] - 1) hi = var->dimLens[d] - 1;
+		if (lo > hi) return false;
+
+		start[d] = lo;
+		count[d] = hi - lo + 1;
+
+		if (step != 1 || count[d] != blockCount[d]) *whole = false;
+	}
+
+	return true;
+}
+
+static int scanSelection(MatchSink* sink, size_t memLimit)
+{
+	const VarInfo* var = sink->var;
+
+	SlabPlan plan;
+	slabPlanInit(&plan, var, memLimit);
+
+	void* vals = malloc((size_t)plan.slabValues * var->typeSize);
+	if (vals == NULL) return NC_ENOMEM;
+
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+	int status = NC_NOERR;
+
+	for (unsigned long long s = 0; s < plan.slabCount && status == NC_NOERR; ++s)
+	{
+		unsigned long long n = slabPlanGet(&plan, s, start, count);
+
+		status = readSlab(var, start, count, vals);
+		if (status != NC_NOERR) break;
+
+		collectMatches(sink, vals, start, count, n);
+	}
+
+	free(vals);
+
+	return status;
+}
+
+static int scanZones(MatchSink* sink, const ZoneMap* map)
+{
+	const VarInfo* var = sink->var;
+	QueryResult* result = sink->result;
+
+	unsigned long long blockValues = 1;
+	for (int d = 0; d < map->nDims; ++d)
+		blockValues *= map->block[d];
+
+	void* vals = malloc((size_t)blockValues * var->typeSize);
+	if (vals == NULL) return NC_ENOMEM;
+
+	size_t blockStart[NC_MAX_VAR_DIMS], blockCount[NC_MAX_VAR_DIMS];
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+	int status = NC_NOERR;
+
+	result->zoneMapUsed = true;
+
+	for (unsigned long long z = 0; z < map->nZones; ++z)
+	{
+		zoneMapBlock(map, z, blockStart, blockCount);
+
+		bool whole;
+		if (!blockInSelection(var, blockStart, blockCount, start, count, &whole)) continue;
+
+		const Zone* zone = &map->zones[z];
+		++result->zones;
+
+		if (!zoneMayMatch(sink->pred, zone))
+		{
+			++result->zonesSkipped;
+			continue;
+		}
+
+		// a streamed query needs every match's value, so it reads even these
+		if (whole && sink->out == NULL && zoneAllMatch(sink->pred, zone))
+		{
+			size_t blockHigh[NC_MAX_VAR_DIMS];
+			for (int d = 0; d < var->nDims; ++d)
+				blockHigh[d] = blockStart[d] + blockCount[d] - 1;
+
+			boxAdd(sink, blockStart, blockHigh);
+			++result->zonesFull;
+			result->matches += sink->pred->kind == PREDICATE_FILL ? zone->count : zone->valid;
+			continue;
+		}
+
+		unsigned long long n = 1;
+		for (int d = 0; d < var->nDims; ++d)
+			n *= count[d];
+
+		status = readSlab(var, start, count, vals);
+		if (status != NC_NOERR) break;
+
+		collectMatches(sink, vals, start, count, n);
+	}
+
+	free(vals);
+
+	return status;
+}
+
+// One pass over the whole variable that collects the matches and builds the
+// statistics and zone map computeVarStats would, caching both, so the first
+// query inflates every chunk once rather than once for the map and again for the scan
+static int scanBuildingZones(MatchSink* sink, const StatsConfig* config, const FileIdentity* id)
+{
+	const VarInfo* var = sink->var;
+	const void* fill = sink->pred->fill;
+
+	VarStats stats;
+	varStatsInit(&stats, var->type);
+	stats.unpack = packInfoActive(sink->pack);
+	stats.pack = *sink->pack;
+
+	stats.zones = (ZoneMap*)calloc(1, sizeof(ZoneMap));
+	if (stats.zones == NULL || !zoneMapInit(stats.zones, var) || !varStatsEnableSketches(&stats, config->quantiles, config->histBins, 1))
+	{
+		varStatsFree(&stats);
+		return NC_ENOMEM;
+	}
+
+	SlabPlan plan;
+	slabPlanInit(&plan, var, config->memLimit);
+	chunkCachePlan(&plan, config->chunkCache, &stats.chunkCache);
+	chunkCacheApply(var->ncid, var->varID, &stats.chunkCache);
+
+	void* vals = malloc((size_t)plan.slabValues * var->typeSize);
+	if (vals == NULL)
+	{
+		varStatsFree(&stats);
+		return NC_ENOMEM;
+	}
+
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+	int status = NC_NOERR;
+
+	for (unsigned long long s = 0; s < plan.slabCount && status == NC_NOERR; ++s)
+	{
+		unsigned long long n = slabPlanGet(&plan, s, start, count);
+
+		status = readSlab(var, start, count, vals);
+		if (status == NC_NOERR) status = reduceSlab(var, vals, n, fill, &stats);
+		if (status != NC_NOERR) break;
+
+		zoneMapAdd(stats.zones, var, start, count, vals, fill);
+		collectMatches(sink, vals, start, count, n);
+	}
+
+	free(vals);
+
+	if (status == NC_NOERR)
+	{
+		statsCacheStore(config->cacheDir, id, var, &stats);
+		sink->result->zoneMapBuilt = zoneMapCacheStore(config->cacheDir, id, var, stats.zones);
+	}
+
+	varStatsFree(&stats);
+
+	return status;
+}
+
+// The whole variable's zone map from the cache, topping it up with a statistics
+// pass over appended records. Returns false when the query should scan instead;
+// build is then set when that scan should make the map.
+static bool loadZoneMap(const VarInfo* var, const StatsConfig* config, ZoneMap* map, FileIdentity* id, bool* build, int* status)
+{
+	*build = false;
+	*status = NC_NOERR;
+
+	if (config->cacheDir == NULL || config->path == NULL || !fileIdentityGet(config->path, id)) return false;
+
+	VarInfo whole;
+	*status = getVarInfo(var->ncid, var->varID, &whole);
+	if (*status != NC_NOERR) return false;
+
+	CacheLookup lookup = zoneMapCacheLoad(config->cacheDir, id, &whole, map);
+	if (lookup == CACHE_HIT) return true;
+
+	zoneMapFree(map);
+
+	// a full pass for a small hyperslab would cost more than it saves
+	if (lookup == CACHE_MISS)
+	{
+		*build = !var->subset;
+		return false;
+	}
+
+	// topping up appended records is cheap
+	StatsConfig building = *config;
+	building.zoneMap = true;
+
+	VarStats stats;
+	*status = computeVarStats(&whole, &building, &stats);
+
+	bool ok = *status == NC_NOERR && stats.zones != NULL;
+	if (ok)
+	{
+		*map = *stats.zones;
+		free(stats.zones);
+		stats.zones = NULL;
+	}
+
+	varStatsFree(&stats);
+
+	return ok;
+}
+
+int queryVar(const VarInfo* var, const Query* query, const StatsConfig* config, FILE* out, QueryResult* result)
+{
+	memset(result, 0, sizeof(QueryResult));
+
+	if (simdKernel(var->type) == NULL)
+		return NC_EBADTYPE;
+
+	PackInfo pack;
+	int status = getPackInfo(var->ncid, var->varID, var->type, &pack);
+	if (status != NC_NOERR) return status;
+
+	long long fillStorage;
+	const void* fill = varFillValue(var, &fillStorage);
+
+	Predicate pred;
+	buildPredicate(query, &pack, fill, &pred);
+
+	MatchSink sink;
+	sink.var = var;
+	sink.pred = &pred;
+	sink.pack = &pack;
+	sink.out = out;
+	sink.result = result;
+	sink.index = (unsigned*)malloc(QUERY_PIECE * sizeof(unsigned));
+	if (sink.index == NULL) return NC_ENOMEM;
+
+	if (out)
+	{
+		char name[NC_MAX_NAME + 1];
+		for (int d = 0; d < var->nDims; ++d)
+		{
+			if (nc_inq_dimname(var->ncid, var->dimIDs[d], name) != NC_NOERR) snprintf(name, sizeof(name), "dim%d", d);
+			fprintf(out, "%s,", name);
+		}
+		fprintf(out, "%s\n", var->name);
+	}
+
+	ZoneMap map;
+	memset(&map, 0, sizeof(map));
+	FileIdentity id;
+	bool build;
+
+	if (loadZoneMap(var, config, &map, &id, &build, &status))
+		status = scanZones(&sink, &map);
+	else if (status == NC_NOERR && build)
+		status = scanBuildingZones(&sink, config, &id);
+	else if (status == NC_NOERR)
+		status = scanSelection(&sink, config->memLimit);
+
+	zoneMapFree(&map);
+	free(sink.index);
+
+	if (result->matches > 0)
+	{
+		for (int d = 0; d < var->nDims; ++d)
+		{
+			result->boxStart[d] = sink.boxLow[d];
+			result->boxCount[d] = sink.boxHigh[d] - sink.boxLow[d] + 1;
+		}
+	}
+
+	return status;
+}
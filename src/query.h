@@ -0,0 +1,52 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "stats.h"
+
+#include <stdio.h>
+
+typedef enum QueryOp
+{
+	QUERY_GREATER,  // x > low
+	QUERY_LESS,     // x < high
+	QUERY_BETWEEN,  // low <= x <= high
+	QUERY_FILL,     // x is the _FillValue
+	QUERY_NONFINITE // x is NaN or infinite
+} QueryOp;
+
+// Thresholds are in physical units; packed variables are compared after unpacking
+typedef struct Query
+{
+	QueryOp op;
+	double low;
+	double high;
+} Query;
+
+typedef struct QueryResult
+{
+	unsigned long long matches;
+	size_t boxStart[NC_MAX_VAR_DIMS]; // file indices bounding every match, when there are any
+	size_t boxCount[NC_MAX_VAR_DIMS];
+	unsigned long long zones;        // blocks overlapping the selection
+	unsigned long long zonesSkipped; // ruled out by their extremes without reading
+	unsigned long long zonesFull;    // known to match throughout, counted without reading
+	unsigned long long valuesRead;
+	bool zoneMapUsed;
+	bool zoneMapBuilt;               // no map was cached, so this query's scan made and cached one
+} QueryResult;
+
+// Parses "> x", "< x", "between a b", "fill" or "nonfinite"; returns false on anything else
+bool parseQuery(const char* text, Query* query);
+
+// Counts the values of var (through its selection) that satisfy the query and
+// bounds them. Fill values only ever match QUERY_FILL, and CF-masked values
+// never match a threshold. With out set, each match is streamed to it as a CSV
+// row of its file indices and physical value, so the hits never pile up in memory.
+// With config->cacheDir set, the variable's zone map comes from the cache and
+// only blocks whose extremes leave the answer open are read. When there is no
+// map yet, a whole variable query builds and caches it, with the statistics,
+// from the same pass that finds the matches, while a hyperslab query just
+// scans its slab.
+int queryVar(const VarInfo* var, const Query* query, const StatsConfig* config, FILE* out, QueryResult* result);
+
+#endif
@@ -0,0 +1,181 @@
+#include "selection.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char* skipSpace(const char* s)
+{
+	while (isspace((unsigned char)*s))
+		++s;
+	return s;
+}
+
+// Parses an unsigned number; an empty field leaves value alone and returns s
+static const char* parseNumber(const char* s, unsigned long long* value, bool* present)
+{
+	s = skipSpace(s);
+	*present = isdigit((unsigned char)*s) != 0;
+	if (!*present) return s;
+
+	char* end;
+	*value = strtoull(s, &end, 10);
+	return skipSpace(end);
+}
+
+int selectionFindDim(const VarInfo* var, const char* key, size_t keyLen)
+{
+	char* end;
+	long id = strtol(key, &end, 10);
+	bool numeric = keyLen > 0 && (size_t)(end - key) == keyLen;
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		if (numeric)
+		{
+			if (var->dimIDs[d] == id) return d;
+			continue;
+		}
+
+		char name[NC_MAX_NAME + 1];
+		if (nc_inq_dimname(var->ncid, var->dimIDs[d], name) == NC_NOERR && strlen(name) == keyLen && strncmp(name, key, keyLen) == 0)
+			return d;
+	}
+
+	return -1;
+}
+
+bool selectionApply(VarInfo* var, const char* text, bool ignoreMissing, char* error, size_t errorLen)
+{
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS], stride[NC_MAX_VAR_DIMS];
+	bool named[NC_MAX_VAR_DIMS] = { false };
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		start[d] = 0;
+		count[d] = var->dimLens[d];
+		stride[d] = 1;
+	}
+
+	const char* s = skipSpace(text);
+
+	while (*s != '\0')
+	{
+		const char* item = s;
+		const char* key = s;
+		while (*s != '\0' && *s != '=' && *s != ',' && !isspace((unsigned char)*s))
+			++s;
+		size_t keyLen = (size_t)(s - key);
+
+		s = skipSpace(s);
+		if (keyLen == 0 || *s != '=')
+		{
+			snprintf(error, errorLen, "expected dim=start[:count[:stride]] at \"%s\"", item);
+			return false;
+		}
+
+		unsigned long long a = 0, b = 0, c = 1;
+		bool hasA, hasB = false, hasC = false, range = false;
+
+		s = parseNumber(s + 1, &a, &hasA);
+		if (*s == ':')
+		{
+			range = true;
+			s = parseNumber(s + 1, &b, &hasB);
+			if (*s == ':') s = parseNumber(s + 1, &c, &hasC);
+		}
+
+		if (*s != ',' && *s != '\0')
+		{
+			snprintf(error, errorLen, "unexpected \"%s\"", s);
+			return false;
+		}
+		if (*s == ',') s = skipSpace(s + 1);
+
+		int d = selectionFindDim(var, key, keyLen);
+		if (d < 0)
+		{
+			if (ignoreMissing) continue;
+			snprintf(error, errorLen, "%s has no dimension %.*s", var->name, (int)keyLen, key);
+			return false;
+		}
+
+		if (named[d])
+		{
+			snprintf(error, errorLen, "dimension %.*s is selected twice", (int)keyLen, key);
+			return false;
+		}
+		named[d] = true;
+
+		size_t len = var->dimLens[d];
+
+		if ((!hasA && !range) || (hasC && c == 0) || (hasB && b == 0))
+		{
+			snprintf(error, errorLen, "dimension %.*s: start must be given, count and stride must be at least 1", (int)keyLen, key);
+			return false;
+		}
+
+		if (a >= len)
+		{
+			snprintf(error, errorLen, "dimension %.*s: start %llu is past its length %zu", (int)keyLen, key, a, len);
+			return false;
+		}
+
+		// an empty count takes every stride-th index to the end
+		if (!range) b = 1;
+		else if (!hasB) b = (len - a + c - 1) / c;
+
+		if (b > len || (b > 1 && c >= len) || a + (b - 1) * c >= len)
+		{
+			snprintf(error, errorLen, "dimension %.*s: %llu indices from %llu with stride %llu run past its length %zu", (int)keyLen, key, b, a, c, len);
+			return false;
+		}
+
+		start[d] = (size_t)a;
+		count[d] = (size_t)b;
+		stride[d] = (size_t)c;
+	}
+
+	for (int d = 0; d < var->nDims; ++d)
+	{
+		if (named[d])
+			selectionNarrow(var, d, start[d], count[d], stride[d]);
+	}
+
+	return true;
+}
+
+void selectionNarrow(VarInfo* var, int dim, size_t start, size_t count, size_t stride)
+{
+	var->offset[dim] += start * var->step[dim];
+	var->step[dim] *= (ptrdiff_t)stride;
+	var->dimLens[dim] = count;
+	var->subset = true;
+
+	var->valueCount = 1;
+	for (int d = 0; d < var->nDims; ++d)
+		var->valueCount *= (unsigned long long)var->dimLens[d];
+}
+
+void selectionFormat(const VarInfo* var, char* buffer, size_t len)
+{
+	size_t used = 0;
+	buffer[0] = '\0';
+
+	for (int d = 0; d < var->nDims && used < len; ++d)
+	{
+		char name[NC_MAX_NAME + 1];
+		if (nc_inq_dimname(var->ncid, var->dimIDs[d], name) != NC_NOERR)
+			snprintf(name, sizeof(name), "%d", var->dimIDs[d]);
+
+		int n;
+		if (var->step[d] == 1)
+			n = snprintf(buffer + used, len - used, "%s%s=%zu:%zu", d > 0 ? "," : "", name, var->offset[d], var->dimLens[d]);
+		else
+			n = snprintf(buffer + used, len - used, "%s%s=%zu:%zu:%td", d > 0 ? "," : "", name, var->offset[d], var->dimLens[d], var->step[d]);
+
+		if (n < 0) break;
+		used += (size_t)n;
+	}
+}
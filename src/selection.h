@@ -0,0 +1,27 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "slab.h"
+
+// Restricts var to a hyperslab written as comma-separated dim=spec items,
+// where dim is a dimension name or DimID and spec is one of
+//   i                    the single index i
+//   start:count          count indices from start
+//   start:count:stride   every stride-th index
+// An empty count runs to the end of the dimension; dimensions that are not
+// named stay whole. Selections compose: indices refer to the current view.
+// Unless ignoreMissing is set, naming a dimension the variable lacks is an
+// error. Returns false with a message in error when the text does not parse
+// or falls outside the dimension lengths.
+bool selectionApply(VarInfo* var, const char* text, bool ignoreMissing, char* error, size_t errorLen);
+
+// Index of the variable's dimension with this name or DimID, or -1
+int selectionFindDim(const VarInfo* var, const char* key, size_t keyLen);
+
+// Keeps count indices of dimension dim (in view coordinates) from start on, stride apart
+void selectionNarrow(VarInfo* var, int dim, size_t start, size_t count, size_t stride);
+
+// Writes the current selection back out in the syntax above
+void selectionFormat(const VarInfo* var, char* buffer, size_t len);
+
+#endif
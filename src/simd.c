@@ -0,0 +1,935 @@
+#include "simd.h"
+
+#include <string.h>
+
+static void resultInit(MinMaxSum* out)
+{
+	out->min = NC_MAX_DOUBLE;
+	out->max = NC_MIN_DOUBLE;
+	out->sum = 0.0;
+	out->valid = 0;
+	for (int p = 0; p < 4; ++p)
+		out->powers[p] = 0.0;
+}
+
+// kernel bodies are inlined into a plain and a moments entry point, so each
+// is compiled with the other's work left out
+#if defined(__GNUC__)
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define ALWAYS_INLINE static __forceinline
+#else
+#define ALWAYS_INLINE static
+#endif
+
+#define DEFINE_KERNEL_ENTRIES(NAME, ATTRS) \
+ATTRS \
+static void NAME(const void* data, size_t n, const void* fill, MinMaxSum* out) \
+{ \
+	NAME##Body(data, n, fill, false, 0.0, out); \
+} \
+\
+ATTRS \
+static void NAME##Moments(const void* data, size_t n, const void* fill, double shift, MinMaxSum* out) \
+{ \
+	NAME##Body(data, n, fill, true, shift, out); \
+}
+
+/* ---------------------------------------------------------------------------
+ * Scalar kernels, one instantiation per atomic type. Their loop also mops up
+ * the vector kernels' tails.
+ * ------------------------------------------------------------------------- */
+
+// how the exact extrema of 64-bit integer types are recorded
+#define EXACT_NONE(out, lo, hi)
+#define EXACT_SIGNED(out, lo, hi) { (out)->minExact.s = (long long)(lo); (out)->maxExact.s = (long long)(hi); }
+#define EXACT_UNSIGNED(out, lo, hi) { (out)->minExact.u = (unsigned long long)(lo); (out)->maxExact.u = (unsigned long long)(hi); }
+
+// folds the values from start on into minVal, maxVal, sum and valid, and
+// with moments into the powers of their distance from shift
+#define SCALAR_LOOP(T, ACC, start) \
+	for (size_t k = start; k < n; ++k) \
+	{ \
+		if (hasFill && vals[k] == fillVal) continue; \
+		if (vals[k] < minVal) minVal = vals[k]; \
+		if (vals[k] > maxVal) maxVal = vals[k]; \
+		sum += (ACC)vals[k]; \
+		++valid; \
+		\
+		if (moments) \
+		{ \
+			double d = (double)vals[k] - shift; \
+			double d2 = d * d; \
+			powers[0] += d; \
+			powers[1] += d2; \
+			powers[2] += d2 * d; \
+			powers[3] += d2 * d2; \
+		} \
+	}
+
+#define SCALAR_RESULT(EXACT) \
+	resultInit(out); \
+	if (valid == 0) return; \
+	for (int p = 0; p < 4; ++p) \
+		out->powers[p] = powers[p]; \
+	out->min = (double)minVal; \
+	out->max = (double)maxVal; \
+	out->sum = (double)sum; \
+	out->valid = valid; \
+	EXACT(out, minVal, maxVal)
+
+// T is the element type, ACC the type the running sum is kept in
+#define DEFINE_SCALAR_KERNEL(NAME, T, ACC, TMIN, TMAX, EXACT) \
+ALWAYS_INLINE void NAME##Body(const void* data, size_t n, const void* fill, bool moments, double shift, MinMaxSum* out) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)fill : (T)0; \
+	T minVal = TMAX; \
+	T maxVal = TMIN; \
+	ACC sum = 0; \
+	unsigned long long valid = 0; \
+	double powers[4] = { 0.0, 0.0, 0.0, 0.0 }; \
+	\
+	SCALAR_LOOP(T, ACC, 0) \
+	SCALAR_RESULT(EXACT) \
+} \
+\
+DEFINE_KERNEL_ENTRIES(NAME, )
+
+DEFINE_SCALAR_KERNEL(minMaxSumByteScalar, signed char, long long, NC_MIN_BYTE, NC_MAX_BYTE, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumUByteScalar, unsigned char, unsigned long long, 0, NC_MAX_UBYTE, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumShortScalar, short, long long, NC_MIN_SHORT, NC_MAX_SHORT, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumUShortScalar, unsigned short, unsigned long long, 0, NC_MAX_USHORT, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumIntScalar, int, long long, NC_MIN_INT, NC_MAX_INT, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumUIntScalar, unsigned int, unsigned long long, 0, NC_MAX_UINT, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumInt64Scalar, long long, double, NC_MIN_INT64, NC_MAX_INT64, EXACT_SIGNED)
+DEFINE_SCALAR_KERNEL(minMaxSumUInt64Scalar, unsigned long long, double, 0, NC_MAX_UINT64, EXACT_UNSIGNED)
+DEFINE_SCALAR_KERNEL(minMaxSumFloatScalar, float, double, NC_MIN_FLOAT, NC_MAX_FLOAT, EXACT_NONE)
+DEFINE_SCALAR_KERNEL(minMaxSumDoubleScalar, double, double, NC_MIN_DOUBLE, NC_MAX_DOUBLE, EXACT_NONE)
+
+#ifdef SIMD_X86
+
+// lane operations are inlined even in unoptimised builds
+#if defined(__GNUC__)
+#define LANE_OP(isa) static inline __attribute__((always_inline, target(isa)))
+#elif defined(_MSC_VER)
+#define LANE_OP(isa) static __forceinline
+#else
+#define LANE_OP(isa) static
+#endif
+
+static unsigned popcount32(unsigned x)
+{
+	x = x - ((x >> 1) & 0x55555555u);
+	x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+	x = (x + (x >> 4)) & 0x0F0F0F0Fu;
+	return (x * 0x01010101u) >> 24;
+}
+
+/* ---------------------------------------------------------------------------
+ * Vector kernels: one body for every type and instruction set. Each level
+ * supplies the same lane operations, named by lane kind (8, 16, 32 and 64-bit
+ * signed integers, F32, F64), over one integer register type:
+ *
+ *   Load, Store, Zero, Xor
+ *   Blend(a, b, m)       m ? b : a, lane by lane
+ *   CountBytes(m)        set bytes of a compare result
+ *   Cmpeq##KIND(a, b)    all ones where equal
+ *   Min##KIND(cur, v)    v where it is below cur, so a NaN v never wins
+ *   Max##KIND(cur, v)
+ *   Sum##KIND(acc, s)    adds the lanes of s into acc[2], as 64-bit integers
+ *                        for 8 to 32-bit kinds and as doubles otherwise
+ *   Widen##KIND(v, out)  the lanes of v as doubles, lowest first, over
+ *                        8 / (lane bytes) registers; WidenM64 turns a 64-bit
+ *                        compare result into -1.0 and 0.0 instead
+ *   Powers(acc, x, dropped, adj, one)
+ *                        with d = (x + adj) * (one + dropped), adds d, d^2,
+ *                        d^3 and d^4 into acc[4], all lanes doubles
+ *
+ * Unsigned types are flipped into signed order by toggling their top bit, so
+ * only signed comparisons are needed; the flip is undone on the extrema and
+ * on the sum, which is kept for the flipped values. SSE2 has no 64-bit
+ * compares, and emulating them costs more than the scalar loop, so it leaves
+ * the 64-bit kinds out.
+ * ------------------------------------------------------------------------- */
+
+LANE_OP("sse2")
+__m128i vecSSE2Load(const void* p) { return _mm_loadu_si128((const __m128i*)p); }
+LANE_OP("sse2")
+void vecSSE2Store(void* p, __m128i v) { _mm_storeu_si128((__m128i*)p, v); }
+LANE_OP("sse2")
+__m128i vecSSE2Zero(void) { return _mm_setzero_si128(); }
+LANE_OP("sse2")
+__m128i vecSSE2Xor(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+LANE_OP("sse2")
+__m128i vecSSE2Blend(__m128i a, __m128i b, __m128i m) { return _mm_or_si128(_mm_andnot_si128(m, a), _mm_and_si128(m, b)); }
+LANE_OP("sse2")
+unsigned vecSSE2CountBytes(__m128i m) { return popcount32((unsigned)_mm_movemask_epi8(m)); }
+
+LANE_OP("sse2")
+__m128i vecSSE2Cmpeq8(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+LANE_OP("sse2")
+__m128i vecSSE2Cmpeq16(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+LANE_OP("sse2")
+__m128i vecSSE2Cmpeq32(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+LANE_OP("sse2")
+__m128i vecSSE2CmpeqF32(__m128i a, __m128i b) { return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b))); }
+LANE_OP("sse2")
+__m128i vecSSE2CmpeqF64(__m128i a, __m128i b) { return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b))); }
+
+// only 16-bit signed extrema are native before SSE4.1
+LANE_OP("sse2")
+__m128i vecSSE2Min8(__m128i cur, __m128i v) { return vecSSE2Blend(cur, v, _mm_cmpgt_epi8(cur, v)); }
+LANE_OP("sse2")
+__m128i vecSSE2Max8(__m128i cur, __m128i v) { return vecSSE2Blend(cur, v, _mm_cmpgt_epi8(v, cur)); }
+LANE_OP("sse2")
+__m128i vecSSE2Min16(__m128i cur, __m128i v) { return _mm_min_epi16(cur, v); }
+LANE_OP("sse2")
+__m128i vecSSE2Max16(__m128i cur, __m128i v) { return _mm_max_epi16(cur, v); }
+LANE_OP("sse2")
+__m128i vecSSE2Min32(__m128i cur, __m128i v) { return vecSSE2Blend(cur, v, _mm_cmpgt_epi32(cur, v)); }
+LANE_OP("sse2")
+__m128i vecSSE2Max32(__m128i cur, __m128i v) { return vecSSE2Blend(cur, v, _mm_cmpgt_epi32(v, cur)); }
+LANE_OP("sse2")
+__m128i vecSSE2MinF32(__m128i cur, __m128i v) { return _mm_castps_si128(_mm_min_ps(_mm_castsi128_ps(v), _mm_castsi128_ps(cur))); }
+LANE_OP("sse2")
+__m128i vecSSE2MaxF32(__m128i cur, __m128i v) { return _mm_castps_si128(_mm_max_ps(_mm_castsi128_ps(v), _mm_castsi128_ps(cur))); }
+LANE_OP("sse2")
+__m128i vecSSE2MinF64(__m128i cur, __m128i v) { return _mm_castpd_si128(_mm_min_pd(_mm_castsi128_pd(v), _mm_castsi128_pd(cur))); }
+LANE_OP("sse2")
+__m128i vecSSE2MaxF64(__m128i cur, __m128i v) { return _mm_castpd_si128(_mm_max_pd(_mm_castsi128_pd(v), _mm_castsi128_pd(cur))); }
+
+// SAD against zero sums unsigned bytes, so bytes are offset by 128 and the offset taken back
+LANE_OP("sse2")
+void vecSSE2Sum8(__m128i* acc, __m128i s)
+{
+	__m128i sums = _mm_sad_epu8(_mm_xor_si128(s, _mm_set1_epi8((char)0x80)), _mm_setzero_si128());
+	acc[0] = _mm_add_epi64(acc[0], _mm_sub_epi64(sums, _mm_set1_epi64x(8 * 128)));
+}
+
+LANE_OP("sse2")
+void vecSSE2Sum32(__m128i* acc, __m128i s)
+{
+	__m128i sign = _mm_srai_epi32(s, 31);
+	acc[0] = _mm_add_epi64(acc[0], _mm_unpacklo_epi32(s, sign));
+	acc[1] = _mm_add_epi64(acc[1], _mm_unpackhi_epi32(s, sign));
+}
+
+LANE_OP("sse2")
+void vecSSE2Sum16(__m128i* acc, __m128i s)
+{
+	vecSSE2Sum32(acc, _mm_madd_epi16(s, _mm_set1_epi16(1)));
+}
+
+LANE_OP("sse2")
+void vecSSE2SumF32(__m128i* acc, __m128i s)
+{
+	__m128 f = _mm_castsi128_ps(s);
+	acc[0] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[0]), _mm_cvtps_pd(f)));
+	acc[1] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[1]), _mm_cvtps_pd(_mm_movehl_ps(f, f))));
+}
+
+LANE_OP("sse2")
+void vecSSE2SumF64(__m128i* acc, __m128i s)
+{
+	acc[0] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[0]), _mm_castsi128_pd(s)));
+}
+
+LANE_OP("sse2")
+void vecSSE2Widen32(__m128i v, __m128i* out)
+{
+	out[0] = _mm_castpd_si128(_mm_cvtepi32_pd(v));
+	out[1] = _mm_castpd_si128(_mm_cvtepi32_pd(_mm_shuffle_epi32(v, 0xEE)));
+}
+
+// lanes unpacked against themselves and shifted back down are sign extended
+LANE_OP("sse2")
+void vecSSE2Widen16(__m128i v, __m128i* out)
+{
+	vecSSE2Widen32(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), out);
+	vecSSE2Widen32(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), out + 2);
+}
+
+LANE_OP("sse2")
+void vecSSE2Widen8(__m128i v, __m128i* out)
+{
+	vecSSE2Widen16(_mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8), out);
+	vecSSE2Widen16(_mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8), out + 4);
+}
+
+LANE_OP("sse2")
+void vecSSE2WidenF32(__m128i v, __m128i* out)
+{
+	__m128 f = _mm_castsi128_ps(v);
+	out[0] = _mm_castpd_si128(_mm_cvtps_pd(f));
+	out[1] = _mm_castpd_si128(_mm_cvtps_pd(_mm_movehl_ps(f, f)));
+}
+
+LANE_OP("sse2")
+void vecSSE2WidenF64(__m128i v, __m128i* out) { out[0] = v; }
+LANE_OP("sse2")
+void vecSSE2WidenM64(__m128i v, __m128i* out) { out[0] = _mm_and_si128(v, _mm_castpd_si128(_mm_set1_pd(-1.0))); }
+
+LANE_OP("sse2")
+void vecSSE2Powers(__m128i* acc, __m128i x, __m128i dropped, __m128i adj, __m128i one)
+{
+	__m128d keep = _mm_add_pd(_mm_castsi128_pd(one), _mm_castsi128_pd(dropped));
+	__m128d d = _mm_mul_pd(_mm_add_pd(_mm_castsi128_pd(x), _mm_castsi128_pd(adj)), keep);
+	__m128d d2 = _mm_mul_pd(d, d);
+	acc[0] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[0]), d));
+	acc[1] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[1]), d2));
+	acc[2] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[2]), _mm_mul_pd(d2, d)));
+	acc[3] = _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(acc[3]), _mm_mul_pd(d2, d2)));
+}
+
+LANE_OP("avx2")
+__m256i vecAVX2Load(const void* p) { return _mm256_loadu_si256((const __m256i*)p); }
+LANE_OP("avx2")
+void vecAVX2Store(void* p, __m256i v) { _mm256_storeu_si256((__m256i*)p, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Zero(void) { return _mm256_setzero_si256(); }
+LANE_OP("avx2")
+__m256i vecAVX2Xor(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+LANE_OP("avx2")
+__m256i vecAVX2Blend(__m256i a, __m256i b, __m256i m) { return _mm256_blendv_epi8(a, b, m); }
+LANE_OP("avx2")
+unsigned vecAVX2CountBytes(__m256i m) { return popcount32((unsigned)_mm256_movemask_epi8(m)); }
+
+LANE_OP("avx2")
+__m256i vecAVX2Cmpeq8(__m256i a, __m256i b) { return _mm256_cmpeq_epi8(a, b); }
+LANE_OP("avx2")
+__m256i vecAVX2Cmpeq16(__m256i a, __m256i b) { return _mm256_cmpeq_epi16(a, b); }
+LANE_OP("avx2")
+__m256i vecAVX2Cmpeq32(__m256i a, __m256i b) { return _mm256_cmpeq_epi32(a, b); }
+LANE_OP("avx2")
+__m256i vecAVX2Cmpeq64(__m256i a, __m256i b) { return _mm256_cmpeq_epi64(a, b); }
+LANE_OP("avx2")
+__m256i vecAVX2CmpeqF32(__m256i a, __m256i b) { return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_EQ_OQ)); }
+LANE_OP("avx2")
+__m256i vecAVX2CmpeqF64(__m256i a, __m256i b) { return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_EQ_OQ)); }
+
+LANE_OP("avx2")
+__m256i vecAVX2Min8(__m256i cur, __m256i v) { return _mm256_min_epi8(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Max8(__m256i cur, __m256i v) { return _mm256_max_epi8(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Min16(__m256i cur, __m256i v) { return _mm256_min_epi16(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Max16(__m256i cur, __m256i v) { return _mm256_max_epi16(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Min32(__m256i cur, __m256i v) { return _mm256_min_epi32(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Max32(__m256i cur, __m256i v) { return _mm256_max_epi32(cur, v); }
+LANE_OP("avx2")
+__m256i vecAVX2Min64(__m256i cur, __m256i v) { return _mm256_blendv_epi8(cur, v, _mm256_cmpgt_epi64(cur, v)); }
+LANE_OP("avx2")
+__m256i vecAVX2Max64(__m256i cur, __m256i v) { return _mm256_blendv_epi8(cur, v, _mm256_cmpgt_epi64(v, cur)); }
+LANE_OP("avx2")
+__m256i vecAVX2MinF32(__m256i cur, __m256i v) { return _mm256_castps_si256(_mm256_min_ps(_mm256_castsi256_ps(v), _mm256_castsi256_ps(cur))); }
+LANE_OP("avx2")
+__m256i vecAVX2MaxF32(__m256i cur, __m256i v) { return _mm256_castps_si256(_mm256_max_ps(_mm256_castsi256_ps(v), _mm256_castsi256_ps(cur))); }
+LANE_OP("avx2")
+__m256i vecAVX2MinF64(__m256i cur, __m256i v) { return _mm256_castpd_si256(_mm256_min_pd(_mm256_castsi256_pd(v), _mm256_castsi256_pd(cur))); }
+LANE_OP("avx2")
+__m256i vecAVX2MaxF64(__m256i cur, __m256i v) { return _mm256_castpd_si256(_mm256_max_pd(_mm256_castsi256_pd(v), _mm256_castsi256_pd(cur))); }
+
+LANE_OP("avx2")
+void vecAVX2Sum8(__m256i* acc, __m256i s)
+{
+	__m256i sums = _mm256_sad_epu8(_mm256_xor_si256(s, _mm256_set1_epi8((char)0x80)), _mm256_setzero_si256());
+	acc[0] = _mm256_add_epi64(acc[0], _mm256_sub_epi64(sums, _mm256_set1_epi64x(8 * 128)));
+}
+
+LANE_OP("avx2")
+void vecAVX2Sum32(__m256i* acc, __m256i s)
+{
+	acc[0] = _mm256_add_epi64(acc[0], _mm256_cvtepi32_epi64(_mm256_castsi256_si128(s)));
+	acc[1] = _mm256_add_epi64(acc[1], _mm256_cvtepi32_epi64(_mm256_extracti128_si256(s, 1)));
+}
+
+LANE_OP("avx2")
+void vecAVX2Sum16(__m256i* acc, __m256i s)
+{
+	vecAVX2Sum32(acc, _mm256_madd_epi16(s, _mm256_set1_epi16(1)));
+}
+
+// nothing converts 64-bit integers to doubles before AVX-512, but the high
+// half times 2^32 plus the low half is exact until the one rounding add
+LANE_OP("avx2")
+void vecAVX2Widen64(__m256i v, __m256i* out)
+{
+	__m256i halves = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+	__m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(halves, 1));
+	__m256d lo = _mm256_cvtepi32_pd(_mm_xor_si128(_mm256_castsi256_si128(halves), _mm_set1_epi32((int)0x80000000)));
+	lo = _mm256_add_pd(lo, _mm256_set1_pd(2147483648.0));
+	out[0] = _mm256_castpd_si256(_mm256_add_pd(_mm256_mul_pd(hi, _mm256_set1_pd(4294967296.0)), lo));
+}
+
+LANE_OP("avx2")
+void vecAVX2Sum64(__m256i* acc, __m256i s)
+{
+	__m256i d;
+	vecAVX2Widen64(s, &d);
+	acc[0] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[0]), _mm256_castsi256_pd(d)));
+}
+
+LANE_OP("avx2")
+void vecAVX2SumF32(__m256i* acc, __m256i s)
+{
+	__m256 f = _mm256_castsi256_ps(s);
+	acc[0] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[0]), _mm256_cvtps_pd(_mm256_castps256_ps128(f))));
+	acc[1] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[1]), _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1))));
+}
+
+LANE_OP("avx2")
+void vecAVX2SumF64(__m256i* acc, __m256i s)
+{
+	acc[0] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[0]), _mm256_castsi256_pd(s)));
+}
+
+LANE_OP("avx2")
+void vecAVX2Widen32(__m256i v, __m256i* out)
+{
+	out[0] = _mm256_castpd_si256(_mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+	out[1] = _mm256_castpd_si256(_mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+}
+
+LANE_OP("avx2")
+void vecAVX2Widen16(__m256i v, __m256i* out)
+{
+	vecAVX2Widen32(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)), out);
+	vecAVX2Widen32(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)), out + 2);
+}
+
+LANE_OP("avx2")
+void vecAVX2Widen8(__m256i v, __m256i* out)
+{
+	__m128i lo = _mm256_castsi256_si128(v);
+	__m128i hi = _mm256_extracti128_si256(v, 1);
+	vecAVX2Widen32(_mm256_cvtepi8_epi32(lo), out);
+	vecAVX2Widen32(_mm256_cvtepi8_epi32(_mm_srli_si128(lo, 8)), out + 2);
+	vecAVX2Widen32(_mm256_cvtepi8_epi32(hi), out + 4);
+	vecAVX2Widen32(_mm256_cvtepi8_epi32(_mm_srli_si128(hi, 8)), out + 6);
+}
+
+LANE_OP("avx2")
+void vecAVX2WidenF32(__m256i v, __m256i* out)
+{
+	__m256 f = _mm256_castsi256_ps(v);
+	out[0] = _mm256_castpd_si256(_mm256_cvtps_pd(_mm256_castps256_ps128(f)));
+	out[1] = _mm256_castpd_si256(_mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)));
+}
+
+LANE_OP("avx2")
+void vecAVX2WidenF64(__m256i v, __m256i* out) { out[0] = v; }
+LANE_OP("avx2")
+void vecAVX2WidenM64(__m256i v, __m256i* out) { out[0] = _mm256_and_si256(v, _mm256_castpd_si256(_mm256_set1_pd(-1.0))); }
+
+LANE_OP("avx2")
+void vecAVX2Powers(__m256i* acc, __m256i x, __m256i dropped, __m256i adj, __m256i one)
+{
+	__m256d keep = _mm256_add_pd(_mm256_castsi256_pd(one), _mm256_castsi256_pd(dropped));
+	__m256d d = _mm256_mul_pd(_mm256_add_pd(_mm256_castsi256_pd(x), _mm256_castsi256_pd(adj)), keep);
+	__m256d d2 = _mm256_mul_pd(d, d);
+	acc[0] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[0]), d));
+	acc[1] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[1]), d2));
+	acc[2] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[2]), _mm256_mul_pd(d2, d)));
+	acc[3] = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(acc[3]), _mm256_mul_pd(d2, d2)));
+}
+
+#ifdef SIMD_HAVE_AVX512
+
+// compare results are widened from mask registers to lanes so the body stays the same
+#define AVX512_ISA "avx512f,avx512bw,avx512dq"
+
+static unsigned popcount64(unsigned long long x)
+{
+	return popcount32((unsigned)x) + popcount32((unsigned)(x >> 32));
+}
+
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Load(const void* p) { return _mm512_loadu_si512(p); }
+LANE_OP(AVX512_ISA)
+void vecAVX512Store(void* p, __m512i v) { _mm512_storeu_si512(p, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Zero(void) { return _mm512_setzero_si512(); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Xor(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Blend(__m512i a, __m512i b, __m512i m) { return _mm512_ternarylogic_epi64(m, b, a, 0xCA); }
+LANE_OP(AVX512_ISA)
+unsigned vecAVX512CountBytes(__m512i m) { return popcount64(_mm512_movepi8_mask(m)); }
+
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Cmpeq8(__m512i a, __m512i b) { return _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(a, b)); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Cmpeq16(__m512i a, __m512i b) { return _mm512_movm_epi16(_mm512_cmpeq_epi16_mask(a, b)); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Cmpeq32(__m512i a, __m512i b) { return _mm512_movm_epi32(_mm512_cmpeq_epi32_mask(a, b)); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Cmpeq64(__m512i a, __m512i b) { return _mm512_movm_epi64(_mm512_cmpeq_epi64_mask(a, b)); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512CmpeqF32(__m512i a, __m512i b) { return _mm512_movm_epi32(_mm512_cmp_ps_mask(_mm512_castsi512_ps(a), _mm512_castsi512_ps(b), _CMP_EQ_OQ)); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512CmpeqF64(__m512i a, __m512i b) { return _mm512_movm_epi64(_mm512_cmp_pd_mask(_mm512_castsi512_pd(a), _mm512_castsi512_pd(b), _CMP_EQ_OQ)); }
+
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Min8(__m512i cur, __m512i v) { return _mm512_min_epi8(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Max8(__m512i cur, __m512i v) { return _mm512_max_epi8(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Min16(__m512i cur, __m512i v) { return _mm512_min_epi16(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Max16(__m512i cur, __m512i v) { return _mm512_max_epi16(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Min32(__m512i cur, __m512i v) { return _mm512_min_epi32(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Max32(__m512i cur, __m512i v) { return _mm512_max_epi32(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Min64(__m512i cur, __m512i v) { return _mm512_min_epi64(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512Max64(__m512i cur, __m512i v) { return _mm512_max_epi64(cur, v); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512MinF32(__m512i cur, __m512i v) { return _mm512_castps_si512(_mm512_min_ps(_mm512_castsi512_ps(v), _mm512_castsi512_ps(cur))); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512MaxF32(__m512i cur, __m512i v) { return _mm512_castps_si512(_mm512_max_ps(_mm512_castsi512_ps(v), _mm512_castsi512_ps(cur))); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512MinF64(__m512i cur, __m512i v) { return _mm512_castpd_si512(_mm512_min_pd(_mm512_castsi512_pd(v), _mm512_castsi512_pd(cur))); }
+LANE_OP(AVX512_ISA)
+__m512i vecAVX512MaxF64(__m512i cur, __m512i v) { return _mm512_castpd_si512(_mm512_max_pd(_mm512_castsi512_pd(v), _mm512_castsi512_pd(cur))); }
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Sum8(__m512i* acc, __m512i s)
+{
+	__m512i sums = _mm512_sad_epu8(_mm512_xor_si512(s, _mm512_set1_epi8((char)0x80)), _mm512_setzero_si512());
+	acc[0] = _mm512_add_epi64(acc[0], _mm512_sub_epi64(sums, _mm512_set1_epi64(8 * 128)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Sum32(__m512i* acc, __m512i s)
+{
+	acc[0] = _mm512_add_epi64(acc[0], _mm512_cvtepi32_epi64(_mm512_castsi512_si256(s)));
+	acc[1] = _mm512_add_epi64(acc[1], _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(s, 1)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Sum16(__m512i* acc, __m512i s)
+{
+	vecAVX512Sum32(acc, _mm512_madd_epi16(s, _mm512_set1_epi16(1)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Sum64(__m512i* acc, __m512i s)
+{
+	acc[0] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[0]), _mm512_cvtepi64_pd(s)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512SumF32(__m512i* acc, __m512i s)
+{
+	__m512 f = _mm512_castsi512_ps(s);
+	__m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(f), 1));
+	acc[0] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[0]), _mm512_cvtps_pd(_mm512_castps512_ps256(f))));
+	acc[1] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[1]), _mm512_cvtps_pd(hi)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512SumF64(__m512i* acc, __m512i s)
+{
+	acc[0] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[0]), _mm512_castsi512_pd(s)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Widen32(__m512i v, __m512i* out)
+{
+	out[0] = _mm512_castpd_si512(_mm512_cvtepi32_pd(_mm512_castsi512_si256(v)));
+	out[1] = _mm512_castpd_si512(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1)));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Widen16(__m512i v, __m512i* out)
+{
+	vecAVX512Widen32(_mm512_cvtepi16_epi32(_mm512_castsi512_si256(v)), out);
+	vecAVX512Widen32(_mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(v, 1)), out + 2);
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Widen8(__m512i v, __m512i* out)
+{
+	vecAVX512Widen32(_mm512_cvtepi8_epi32(_mm512_extracti32x4_epi32(v, 0)), out);
+	vecAVX512Widen32(_mm512_cvtepi8_epi32(_mm512_extracti32x4_epi32(v, 1)), out + 2);
+	vecAVX512Widen32(_mm512_cvtepi8_epi32(_mm512_extracti32x4_epi32(v, 2)), out + 4);
+	vecAVX512Widen32(_mm512_cvtepi8_epi32(_mm512_extracti32x4_epi32(v, 3)), out + 6);
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Widen64(__m512i v, __m512i* out) { out[0] = _mm512_castpd_si512(_mm512_cvtepi64_pd(v)); }
+
+LANE_OP(AVX512_ISA)
+void vecAVX512WidenF32(__m512i v, __m512i* out)
+{
+	__m512 f = _mm512_castsi512_ps(v);
+	__m256 hi = _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(f), 1));
+	out[0] = _mm512_castpd_si512(_mm512_cvtps_pd(_mm512_castps512_ps256(f)));
+	out[1] = _mm512_castpd_si512(_mm512_cvtps_pd(hi));
+}
+
+LANE_OP(AVX512_ISA)
+void vecAVX512WidenF64(__m512i v, __m512i* out) { out[0] = v; }
+LANE_OP(AVX512_ISA)
+void vecAVX512WidenM64(__m512i v, __m512i* out) { out[0] = _mm512_and_si512(v, _mm512_castpd_si512(_mm512_set1_pd(-1.0))); }
+
+LANE_OP(AVX512_ISA)
+void vecAVX512Powers(__m512i* acc, __m512i x, __m512i dropped, __m512i adj, __m512i one)
+{
+	__m512d keep = _mm512_add_pd(_mm512_castsi512_pd(one), _mm512_castsi512_pd(dropped));
+	__m512d d = _mm512_mul_pd(_mm512_add_pd(_mm512_castsi512_pd(x), _mm512_castsi512_pd(adj)), keep);
+	__m512d d2 = _mm512_mul_pd(d, d);
+	acc[0] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[0]), d));
+	acc[1] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[1]), d2));
+	acc[2] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[2]), _mm512_mul_pd(d2, d)));
+	acc[3] = _mm512_castpd_si512(_mm512_add_pd(_mm512_castsi512_pd(acc[3]), _mm512_mul_pd(d2, d2)));
+}
+
+#endif // SIMD_HAVE_AVX512
+
+#define VEC_SSE2 __m128i
+#define VEC_AVX2 __m256i
+#define VEC_AVX512 __m512i
+
+// undoing the flip that put unsigned values in signed order
+#define UNFLIP_NONE(T, x) ((T)(x))
+#define UNFLIP_TOP(T, x) ((T)((T)(x) ^ ((T)1 << (sizeof(T) * 8 - 1))))
+
+// S is the signed type of T's width (T itself for floating point), SMIN/SMAX
+// its extremes, MKIND the lane kind its compare results widen as, UNFLIP
+// UNFLIP_TOP for unsigned types and FLOATSUM whether the kind sums into
+// doubles. Fill values are masked out before anything else. With moments,
+// the kept lanes are widened to doubles in the same pass and their powers
+// summed over two sets of accumulators, which halves the add chains.
+#define DEFINE_VECTOR_KERNEL(NAME, LEVEL, ATTRS, T, S, KIND, MKIND, ACC, SMIN, SMAX, UNFLIP, FLOATSUM, EXACT) \
+ATTRS \
+ALWAYS_INLINE void NAME##Body(const void* data, size_t n, const void* fill, bool moments, double shift, MinMaxSum* out) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)fill : (T)0; \
+	const bool flipped = UNFLIP(T, 0) != 0; \
+	const size_t width = sizeof(VEC_##LEVEL) / sizeof(T); \
+	const size_t doubles = sizeof(VEC_##LEVEL) / sizeof(double); \
+	/* each flipped value is its own less 2^(bits - 1) */ \
+	const double flipOffset = flipped ? (double)((unsigned long long)1 << (sizeof(T) * 8 - 1)) : 0.0; \
+	\
+	/* constants are built in memory, which works alike for every lane type */ \
+	T fills[64 / sizeof(T)]; \
+	S highs[64 / sizeof(T)], lows[64 / sizeof(T)], flips[64 / sizeof(T)]; \
+	double adjs[8], ones[8]; \
+	for (size_t j = 0; j < width; ++j) \
+	{ \
+		fills[j] = fillVal; \
+		highs[j] = SMAX; \
+		lows[j] = SMIN; \
+		flips[j] = flipped ? SMIN : (S)0; \
+	} \
+	for (size_t j = 0; j < doubles; ++j) \
+	{ \
+		adjs[j] = flipOffset - shift; \
+		ones[j] = 1.0; \
+	} \
+	\
+	const VEC_##LEVEL vfill = vec##LEVEL##Load(fills); \
+	const VEC_##LEVEL high = vec##LEVEL##Load(highs); \
+	const VEC_##LEVEL low = vec##LEVEL##Load(lows); \
+	const VEC_##LEVEL flip = vec##LEVEL##Load(flips); \
+	const VEC_##LEVEL adj = vec##LEVEL##Load(adjs); \
+	const VEC_##LEVEL one = vec##LEVEL##Load(ones); \
+	const VEC_##LEVEL zero = vec##LEVEL##Zero(); \
+	VEC_##LEVEL vmin = high, vmax = low; \
+	VEC_##LEVEL acc[2] = { zero, zero }; \
+	VEC_##LEVEL pw[8] = { zero, zero, zero, zero, zero, zero, zero, zero }; \
+	unsigned long long droppedBytes = 0; \
+	size_t i = 0; \
+	\
+	for (; i + width <= n; i += width) \
+	{ \
+		VEC_##LEVEL v = vec##LEVEL##Load(vals + i); \
+		VEC_##LEVEL drop = hasFill ? vec##LEVEL##Cmpeq##KIND(v, vfill) : zero; \
+		VEC_##LEVEL s = vec##LEVEL##Xor(v, flip); \
+		VEC_##LEVEL kept = vec##LEVEL##Blend(s, zero, drop); \
+		\
+		VEC_##LEVEL lo = vec##LEVEL##Blend(s, high, drop); \
+		VEC_##LEVEL hi = vec##LEVEL##Blend(s, low, drop); \
+		vmin = vec##LEVEL##Min##KIND(vmin, lo); \
+		vmax = vec##LEVEL##Max##KIND(vmax, hi); \
+		vec##LEVEL##Sum##KIND(acc, kept); \
+		droppedBytes += vec##LEVEL##CountBytes(drop); \
+		\
+		if (moments) \
+		{ \
+			VEC_##LEVEL xs[8], ds[8]; \
+			vec##LEVEL##Widen##KIND(kept, xs); \
+			if (hasFill) \
+				vec##LEVEL##Widen##MKIND(drop, ds); \
+			for (size_t p = 0; p < 8 / sizeof(T); ++p) \
+				vec##LEVEL##Powers(pw + 4 * (p & 1), xs[p], hasFill ? ds[p] : zero, adj, one); \
+		} \
+	} \
+	\
+	S mins[64 / sizeof(T)], maxs[64 / sizeof(T)]; \
+	vec##LEVEL##Store(mins, vmin); \
+	vec##LEVEL##Store(maxs, vmax); \
+	\
+	S minS = SMAX, maxS = SMIN; \
+	for (size_t j = 0; j < width; ++j) \
+	{ \
+		if (mins[j] < minS) minS = mins[j]; \
+		if (maxs[j] > maxS) maxS = maxs[j]; \
+	} \
+	\
+	unsigned long long valid = i - droppedBytes / sizeof(T); \
+	ACC sum; \
+	if (FLOATSUM) \
+	{ \
+		double sums[16]; \
+		vec##LEVEL##Store(sums, acc[0]); \
+		vec##LEVEL##Store(sums + doubles, acc[1]); \
+		double total = 0.0; \
+		for (size_t j = 0; j < 2 * doubles; ++j) \
+			total += sums[j]; \
+		sum = (ACC)(total + flipOffset * (double)valid); \
+	} \
+	else \
+	{ \
+		unsigned long long sums[16]; \
+		vec##LEVEL##Store(sums, acc[0]); \
+		vec##LEVEL##Store(sums + sizeof(VEC_##LEVEL) / sizeof(long long), acc[1]); \
+		unsigned long long total = flipped ? ((unsigned long long)1 << (sizeof(T) * 8 - 1)) * valid : 0; \
+		for (size_t j = 0; j < 2 * sizeof(VEC_##LEVEL) / sizeof(long long); ++j) \
+			total += sums[j]; \
+		sum = (ACC)(long long)total; \
+	} \
+	\
+	double powers[4] = { 0.0, 0.0, 0.0, 0.0 }; \
+	if (moments) \
+	{ \
+		double lanes[16]; \
+		for (int p = 0; p < 4; ++p) \
+		{ \
+			vec##LEVEL##Store(lanes, pw[p]); \
+			vec##LEVEL##Store(lanes + doubles, pw[4 + p]); \
+			for (size_t j = 0; j < 2 * doubles; ++j) \
+				powers[p] += lanes[j]; \
+		} \
+	} \
+	\
+	T minVal = UNFLIP(T, minS); \
+	T maxVal = UNFLIP(T, maxS); \
+	\
+	SCALAR_LOOP(T, ACC, i) \
+	SCALAR_RESULT(EXACT) \
+} \
+\
+DEFINE_KERNEL_ENTRIES(NAME, ATTRS)
+
+// the atomic types at one instruction set, the 64-bit integers apart
+#define DEFINE_VECTOR_KERNELS(LEVEL, ATTRS) \
+	DEFINE_VECTOR_KERNEL(minMaxSumByte##LEVEL, LEVEL, ATTRS, signed char, signed char, 8, 8, long long, NC_MIN_BYTE, NC_MAX_BYTE, UNFLIP_NONE, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumUByte##LEVEL, LEVEL, ATTRS, unsigned char, signed char, 8, 8, unsigned long long, NC_MIN_BYTE, NC_MAX_BYTE, UNFLIP_TOP, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumShort##LEVEL, LEVEL, ATTRS, short, short, 16, 16, long long, NC_MIN_SHORT, NC_MAX_SHORT, UNFLIP_NONE, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumUShort##LEVEL, LEVEL, ATTRS, unsigned short, short, 16, 16, unsigned long long, NC_MIN_SHORT, NC_MAX_SHORT, UNFLIP_TOP, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumInt##LEVEL, LEVEL, ATTRS, int, int, 32, 32, long long, NC_MIN_INT, NC_MAX_INT, UNFLIP_NONE, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumUInt##LEVEL, LEVEL, ATTRS, unsigned int, int, 32, 32, unsigned long long, NC_MIN_INT, NC_MAX_INT, UNFLIP_TOP, false, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumFloat##LEVEL, LEVEL, ATTRS, float, float, F32, 32, double, NC_MIN_FLOAT, NC_MAX_FLOAT, UNFLIP_NONE, true, EXACT_NONE) \
+	DEFINE_VECTOR_KERNEL(minMaxSumDouble##LEVEL, LEVEL, ATTRS, double, double, F64, M64, double, NC_MIN_DOUBLE, NC_MAX_DOUBLE, UNFLIP_NONE, true, EXACT_NONE)
+
+#define DEFINE_VECTOR_KERNELS_64(LEVEL, ATTRS) \
+	DEFINE_VECTOR_KERNEL(minMaxSumInt64##LEVEL, LEVEL, ATTRS, long long, long long, 64, M64, double, NC_MIN_INT64, NC_MAX_INT64, UNFLIP_NONE, true, EXACT_SIGNED) \
+	DEFINE_VECTOR_KERNEL(minMaxSumUInt64##LEVEL, LEVEL, ATTRS, unsigned long long, long long, 64, M64, double, NC_MIN_INT64, NC_MAX_INT64, UNFLIP_TOP, true, EXACT_UNSIGNED)
+
+DEFINE_VECTOR_KERNELS(SSE2, SIMD_TARGET("sse2"))
+DEFINE_VECTOR_KERNELS(AVX2, SIMD_TARGET("avx2"))
+DEFINE_VECTOR_KERNELS_64(AVX2, SIMD_TARGET("avx2"))
+#ifdef SIMD_HAVE_AVX512
+DEFINE_VECTOR_KERNELS(AVX512, SIMD_TARGET(AVX512_ISA))
+DEFINE_VECTOR_KERNELS_64(AVX512, SIMD_TARGET(AVX512_ISA))
+#endif
+
+#endif // SIMD_X86
+
+/* ---------------------------------------------------------------------------
+ * Runtime dispatch
+ * ------------------------------------------------------------------------- */
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+static bool cpuHasFeatures(SimdLevel level)
+{
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+
+	if (level == SIMD_SSE2) return sse2;
+	if (!osxsave || maxLeaf < 7) return false;
+
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+
+	if (level == SIMD_AVX2)
+		return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+
+	// AVX-512 F, DQ and BW, plus opmask/ZMM state enabled by the OS
+	return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 17)) != 0 && (info[1] & (1 << 30)) != 0;
+}
+#elif defined(SIMD_X86) && defined(__GNUC__)
+static bool cpuHasFeatures(SimdLevel level)
+{
+	__builtin_cpu_init();
+
+	switch (level)
+	{
+	case SIMD_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case SIMD_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case SIMD_AVX512:
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw");
+	default:
+		return true;
+	}
+}
+#else
+static bool cpuHasFeatures(SimdLevel level)
+{
+	return level == SIMD_SCALAR;
+}
+#endif
+
+static bool kernelsReady = false;
+static SimdLevel activeLevel = SIMD_SCALAR;
+static MinMaxSumKernel kernels[NC_MAX_ATOMIC_TYPE + 1];
+static MomentsKernel momentsKernels[NC_MAX_ATOMIC_TYPE + 1];
+
+SimdLevel simdDetect(void)
+{
+	if (cpuHasFeatures(SIMD_AVX512))
+	{
+#ifdef SIMD_HAVE_AVX512
+		return SIMD_AVX512;
+#else
+		return SIMD_AVX2;
+#endif
+	}
+	if (cpuHasFeatures(SIMD_AVX2)) return SIMD_AVX2;
+	if (cpuHasFeatures(SIMD_SSE2)) return SIMD_SSE2;
+	return SIMD_SCALAR;
+}
+
+#define SET_KERNEL(TYPE, NAME) \
+	{ \
+		kernels[TYPE] = NAME; \
+		momentsKernels[TYPE] = NAME##Moments; \
+	}
+
+#define SET_KERNELS(LEVEL, LEVEL64) \
+	{ \
+		SET_KERNEL(NC_BYTE, minMaxSumByte##LEVEL); \
+		SET_KERNEL(NC_UBYTE, minMaxSumUByte##LEVEL); \
+		SET_KERNEL(NC_SHORT, minMaxSumShort##LEVEL); \
+		SET_KERNEL(NC_USHORT, minMaxSumUShort##LEVEL); \
+		SET_KERNEL(NC_INT, minMaxSumInt##LEVEL); \
+		SET_KERNEL(NC_UINT, minMaxSumUInt##LEVEL); \
+		SET_KERNEL(NC_INT64, minMaxSumInt64##LEVEL64); \
+		SET_KERNEL(NC_UINT64, minMaxSumUInt64##LEVEL64); \
+		SET_KERNEL(NC_FLOAT, minMaxSumFloat##LEVEL); \
+		SET_KERNEL(NC_DOUBLE, minMaxSumDouble##LEVEL); \
+	}
+
+void simdSetLevel(SimdLevel maxLevel)
+{
+	SimdLevel level = simdDetect();
+	if (level > maxLevel) level = maxLevel;
+
+	memset(kernels, 0, sizeof(kernels));
+	memset(momentsKernels, 0, sizeof(momentsKernels));
+
+	switch (level)
+	{
+#ifdef SIMD_X86
+#ifdef SIMD_HAVE_AVX512
+	case SIMD_AVX512:
+		SET_KERNELS(AVX512, AVX512);
+		break;
+#endif
+	case SIMD_AVX2:
+		SET_KERNELS(AVX2, AVX2);
+		break;
+	case SIMD_SSE2:
+		SET_KERNELS(SSE2, Scalar);
+		break;
+#endif
+	default:
+		SET_KERNELS(Scalar, Scalar);
+		level = SIMD_SCALAR;
+		break;
+	}
+
+	activeLevel = level;
+	kernelsReady = true;
+}
+
+SimdLevel simdGetLevel(void)
+{
+	if (!kernelsReady) simdSetLevel(SIMD_AVX512);
+	return activeLevel;
+}
+
+const char* simdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_SSE2:
+		return "sse2";
+	case SIMD_AVX2:
+		return "avx2";
+	case SIMD_AVX512:
+		return "avx512";
+	default:
+		return "scalar";
+	}
+}
+
+bool simdParseLevel(const char* name, SimdLevel* level)
+{
+	for (int i = SIMD_SCALAR; i <= SIMD_AVX512; ++i)
+	{
+		if (strcmp(name, simdLevelName((SimdLevel)i)) == 0)
+		{
+			*level = (SimdLevel)i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MinMaxSumKernel simdKernel(nc_type type)
+{
+	if (!kernelsReady) simdSetLevel(SIMD_AVX512);
+
+	if (type < 0 || type > NC_MAX_ATOMIC_TYPE) return NULL;
+
+	return kernels[type];
+}
+
+MomentsKernel simdMomentsKernel(nc_type type)
+{
+	if (!kernelsReady) simdSetLevel(SIMD_AVX512);
+
+	if (type < 0 || type > NC_MAX_ATOMIC_TYPE) return NULL;
+
+	return momentsKernels[type];
+}
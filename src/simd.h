@@ -0,0 +1,72 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "netcdf.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// per-function instruction sets, so one binary carries every kernel level
+#ifdef __GNUC__
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+// AVX-512 intrinsics need GCC or VS2017 15.3+
+#if defined(SIMD_X86) && (defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1911))
+#define SIMD_HAVE_AVX512
+#endif
+
+typedef enum SimdLevel
+{
+	SIMD_SCALAR,
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512
+} SimdLevel;
+
+typedef union ExactInt
+{
+	long long s;
+	unsigned long long u;
+} ExactInt;
+
+// Result of one masked min/max/sum/count pass over a buffer
+typedef struct MinMaxSum
+{
+	double min;
+	double max;
+	double sum;
+	unsigned long long valid; // values that did not match the fill value
+	ExactInt minExact;        // lossless extrema, only set for NC_INT64/NC_UINT64
+	ExactInt maxExact;
+	double powers[4];         // sums of d, d^2, d^3 and d^4 with d = value - shift, moments kernels only
+} MinMaxSum;
+
+// fill may be NULL when the variable has no _FillValue
+typedef void (*MinMaxSumKernel)(const void* vals, size_t n, const void* fill, MinMaxSum* out);
+
+// The same pass, also summing the powers of every value's distance from
+// shift, so the central moments need no second sweep (see momentsFromPowerSums)
+typedef void (*MomentsKernel)(const void* vals, size_t n, const void* fill, double shift, MinMaxSum* out);
+
+SimdLevel simdDetect(void);
+void simdSetLevel(SimdLevel maxLevel);
+SimdLevel simdGetLevel(void);
+const char* simdLevelName(SimdLevel level);
+bool simdParseLevel(const char* name, SimdLevel* level);
+
+// returns NULL for types without a kernel
+MinMaxSumKernel simdKernel(nc_type type);
+MomentsKernel simdMomentsKernel(nc_type type);
+
+#endif
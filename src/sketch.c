@@ -0,0 +1,480 @@
+#include "sketch.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+/* ---------------------------------------------------------------------------
+ * KLL sketch
+ * ------------------------------------------------------------------------- */
+
+static unsigned kllRandom(KllSketch* sketch)
+{
+	// xorshift32
+	unsigned x = sketch->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sketch->rng = x;
+	return x;
+}
+
+static int kllCapacity(const KllSketch* sketch, int level)
+{
+	int height = sketch->numLevels - level - 1;
+	return (int)ceil(sketch->k * pow(2.0 / 3.0, height)) + 1;
+}
+
+static void kllGrow(KllSketch* sketch)
+{
+	if (sketch->numLevels == KLL_MAX_LEVELS) return;
+
+	sketch->numLevels++;
+	sketch->maxSize = 0;
+	for (int h = 0; h < sketch->numLevels; ++h)
+		sketch->maxSize += kllCapacity(sketch, h);
+}
+
+static bool kllReserve(KllSketch* sketch, int level, int items)
+{
+	if (items <= sketch->allocated[level]) return true;
+
+	int allocated = sketch->allocated[level] > 0 ? sketch->allocated[level] : 16;
+	while (allocated < items)
+		allocated *= 2;
+
+	double* grown = (double*)realloc(sketch->levels[level], allocated * sizeof(double));
+	if (grown == NULL) return false;
+
+	sketch->levels[level] = grown;
+	sketch->allocated[level] = allocated;
+	return true;
+}
+
+static bool kllAppend(KllSketch* sketch, int level, const double* vals, int n)
+{
+	if (!kllReserve(sketch, level, sketch->sizes[level] + n)) return false;
+
+	memcpy(sketch->levels[level] + sketch->sizes[level], vals, n * sizeof(double));
+	sketch->sizes[level] += n;
+	sketch->size += n;
+	return true;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+// Sorts a level and promotes every other item (random parity) to the level above
+static bool kllCompactLevel(KllSketch* sketch, int level)
+{
+	int m = sketch->sizes[level];
+	int pairs = m / 2;
+
+	if (!kllReserve(sketch, level + 1, sketch->sizes[level + 1] + pairs)) return false;
+
+	double* items = sketch->levels[level];
+	qsort(items, m, sizeof(double), compareDoubles);
+
+	int offset = (int)(kllRandom(sketch) & 1);
+
+	double* dst = sketch->levels[level + 1] + sketch->sizes[level + 1];
+	for (int i = 0; i < pairs; ++i)
+		dst[i] = items[2 * i + offset];
+
+	sketch->sizes[level + 1] += pairs;
+
+	// an odd item out stays behind
+	if (m & 1)
+		items[0] = items[m - 1];
+
+	sketch->sizes[level] = m & 1;
+	sketch->size -= m - pairs - (m & 1);
+	return true;
+}
+
+static bool kllCompress(KllSketch* sketch)
+{
+	for (int h = 0; h < sketch->numLevels; ++h)
+	{
+		if (sketch->sizes[h] < kllCapacity(sketch, h)) continue;
+
+		if (h + 1 >= sketch->numLevels) kllGrow(sketch);
+		if (h + 1 >= sketch->numLevels) return true;
+
+		if (!kllCompactLevel(sketch, h)) return false;
+
+		if (sketch->size < sketch->maxSize) return true;
+	}
+
+	return true;
+}
+
+void kllInit(KllSketch* sketch, int k, unsigned seed)
+{
+	memset(sketch, 0, sizeof(KllSketch));
+	sketch->k = k;
+	sketch->rng = seed != 0 ? seed : 0x9E3779B9u;
+	kllGrow(sketch);
+}
+
+void kllFree(KllSketch* sketch)
+{
+	for (int h = 0; h < KLL_MAX_LEVELS; ++h)
+		free(sketch->levels[h]);
+
+	memset(sketch, 0, sizeof(KllSketch));
+}
+
+bool kllAdd(KllSketch* sketch, const double* vals, size_t n)
+{
+	while (n > 0)
+	{
+		if (sketch->size >= sketch->maxSize && !kllCompress(sketch))
+			return false;
+
+		// appended in bulk up to the point where a compaction is due
+		size_t space = sketch->size < sketch->maxSize ? (size_t)(sketch->maxSize - sketch->size) : n;
+		size_t take = n < space ? n : space;
+
+		if (!kllAppend(sketch, 0, vals, (int)take)) return false;
+
+		sketch->n += take;
+		vals += take;
+		n -= take;
+	}
+
+	return true;
+}
+
+bool kllMerge(KllSketch* dst, const KllSketch* src)
+{
+	while (dst->numLevels < src->numLevels)
+		kllGrow(dst);
+
+	for (int h = 0; h < src->numLevels; ++h)
+	{
+		if (src->sizes[h] > 0 && !kllAppend(dst, h, src->levels[h], src->sizes[h]))
+			return false;
+	}
+
+	dst->n += src->n;
+
+	while (dst->size >= dst->maxSize)
+	{
+		int before = dst->size;
+		if (!kllCompress(dst)) return false;
+		if (dst->size >= before) break;
+	}
+
+	return true;
+}
+
+typedef struct WeightedItem
+{
+	double value;
+	double weight;
+} WeightedItem;
+
+static int compareWeightedItems(const void* a, const void* b)
+{
+	return compareDoubles(&((const WeightedItem*)a)->value, &((const WeightedItem*)b)->value);
+}
+
+bool kllQuantiles(const KllSketch* sketch, const double* qs, int nq, double* out)
+{
+	if (sketch->size == 0) return false;
+
+	WeightedItem* items = (WeightedItem*)malloc(sketch->size * sizeof(WeightedItem));
+	if (items == NULL) return false;
+
+	int count = 0;
+	double total = 0.0;
+
+	for (int h = 0; h < sketch->numLevels; ++h)
+	{
+		double weight = ldexp(1.0, h);
+
+		for (int i = 0; i < sketch->sizes[h]; ++i)
+		{
+			items[count].value = sketch->levels[h][i];
+			items[count].weight = weight;
+			++count;
+		}
+
+		total += weight * sketch->sizes[h];
+	}
+
+	qsort(items, count, sizeof(WeightedItem), compareWeightedItems);
+
+	double cumulative = 0.0;
+	int j = 0;
+
+	for (int i = 0; i < count && j < nq; ++i)
+	{
+		cumulative += items[i].weight;
+
+		while (j < nq && cumulative >= qs[j] * total)
+			out[j++] = items[i].value;
+	}
+
+	while (j < nq)
+		out[j++] = items[count - 1].value;
+
+	free(items);
+	return true;
+}
+
+// normalized rank error for a single quantile query (empirical fit used by DataSketches)
+double kllRankError(const KllSketch* sketch)
+{
+	return 2.296 / pow((double)sketch->k, 0.9723);
+}
+
+bool kllRestore(KllSketch* sketch, int k, int numLevels, unsigned long long n, unsigned rng, const int* sizes, const void* items)
+{
+	if (numLevels < 1 || numLevels > KLL_MAX_LEVELS) return false;
+
+	kllInit(sketch, k, rng);
+	while (sketch->numLevels < numLevels)
+		kllGrow(sketch);
+
+	const char* src = (const char*)items;
+
+	for (int h = 0; h < numLevels; ++h)
+	{
+		if (sizes[h] <= 0) continue;
+
+		if (!kllReserve(sketch, h, sizes[h]))
+		{
+			kllFree(sketch);
+			return false;
+		}
+
+		memcpy(sketch->levels[h], src, sizes[h] * sizeof(double));
+		src += sizes[h] * sizeof(double);
+
+		sketch->sizes[h] = sizes[h];
+		sketch->size += sizes[h];
+	}
+
+	sketch->n = n;
+	return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Histogram
+ * ------------------------------------------------------------------------- */
+
+bool histogramInit(Histogram* hist, int nBins)
+{
+	hist->nBins = nBins;
+	hist->lo = 0.0;
+	hist->width = 0.0;
+	hist->total = 0;
+	hist->dataMin = NC_MAX_DOUBLE;
+	hist->dataMax = NC_MIN_DOUBLE;
+	hist->counts = (unsigned long long*)calloc(nBins, sizeof(unsigned long long));
+	return hist->counts != NULL;
+}
+
+void histogramFree(Histogram* hist)
+{
+	free(hist->counts);
+	hist->counts = NULL;
+}
+
+// smallest power of two >= x
+static double powerOfTwoAtLeast(double x)
+{
+	int e;
+	double m = frexp(x, &e);
+	return m == 0.5 ? x : ldexp(1.0, e);
+}
+
+static int histogramBin(const Histogram* hist, double x)
+{
+	double pos = (x - hist->lo) / hist->width;
+	if (pos < 0.0) return 0;
+	if (pos >= hist->nBins) return hist->nBins - 1;
+	return (int)pos;
+}
+
+// Widens the bins until [min, max] fits, never going below minWidth;
+// returns false when out of memory
+static bool histogramCover(Histogram* hist, double min, double max, double minWidth)
+{
+	if (hist->total > 0)
+	{
+		if (hist->width >= minWidth && min >= hist->lo && max < hist->lo + hist->nBins * hist->width)
+			return true;
+
+		if (hist->dataMin < min) min = hist->dataMin;
+		if (hist->dataMax > max) max = hist->dataMax;
+	}
+
+	double width = hist->width > minWidth ? hist->width : minWidth;
+	if (width <= 0.0)
+	{
+		double span = max - min;
+		width = powerOfTwoAtLeast(span > 0.0 ? span / hist->nBins : (fabs(min) + 1.0) / hist->nBins);
+	}
+
+	double lo = floor(min / width) * width;
+	while (lo + hist->nBins * width <= max)
+	{
+		width *= 2.0;
+		lo = floor(min / width) * width;
+	}
+
+	if (hist->total > 0 && (lo != hist->lo || width != hist->width))
+	{
+		// old bins nest exactly inside the wider ones
+		unsigned long long* counts = (unsigned long long*)calloc(hist->nBins, sizeof(unsigned long long));
+		if (!counts) return false;
+
+		Histogram rebinned = *hist;
+		rebinned.lo = lo;
+		rebinned.width = width;
+
+		for (int j = 0; j < hist->nBins; ++j)
+		{
+			if (hist->counts[j] > 0)
+				counts[histogramBin(&rebinned, hist->lo + (j + 0.5) * hist->width)] += hist->counts[j];
+		}
+
+		free(hist->counts);
+		hist->counts = counts;
+	}
+
+	hist->lo = lo;
+	hist->width = width;
+	return true;
+}
+
+bool histogramAdd(Histogram* hist, const double* vals, size_t n)
+{
+	if (n == 0) return true;
+
+	double min = vals[0], max = vals[0];
+	for (size_t i = 1; i < n; ++i)
+	{
+		if (vals[i] < min) min = vals[i];
+		if (vals[i] > max) max = vals[i];
+	}
+
+	if (!histogramCover(hist, min, max, 0.0)) return false;
+
+	const double lo = hist->lo;
+	const double scale = 1.0 / hist->width;
+	const int last = hist->nBins - 1;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		int bin = (int)((vals[i] - lo) * scale);
+		hist->counts[bin > last ? last : (bin < 0 ? 0 : bin)]++;
+	}
+
+	hist->total += n;
+	if (min < hist->dataMin) hist->dataMin = min;
+	if (max > hist->dataMax) hist->dataMax = max;
+	return true;
+}
+
+bool histogramMerge(Histogram* dst, const Histogram* src)
+{
+	if (src->total == 0) return true;
+
+	if (!histogramCover(dst, src->dataMin, src->dataMax, src->width)) return false;
+
+	for (int j = 0; j < src->nBins; ++j)
+	{
+		if (src->counts[j] > 0)
+			dst->counts[histogramBin(dst, src->lo + (j + 0.5) * src->width)] += src->counts[j];
+	}
+
+	dst->total += src->total;
+	if (src->dataMin < dst->dataMin) dst->dataMin = src->dataMin;
+	if (src->dataMax > dst->dataMax) dst->dataMax = src->dataMax;
+	return true;
+}
+
+void histogramPrint(const Histogram* hist, int barWidth)
+{
+	if (hist->total == 0) return;
+
+	int first = 0, last = hist->nBins - 1;
+	while (first < last && hist->counts[first] == 0) ++first;
+	while (last > first && hist->counts[last] == 0) --last;
+
+	unsigned long long peak = 0;
+	for (int j = first; j <= last; ++j)
+		if (hist->counts[j] > peak) peak = hist->counts[j];
+
+	for (int j = first; j <= last; ++j)
+	{
+		double lo = hist->lo + j * hist->width;
+		int bar = (int)((double)hist->counts[j] / (double)peak * barWidth + 0.5);
+
+		printf("%12.6g - %-12.6g %12llu |", lo, lo + hist->width, hist->counts[j]);
+		for (int b = 0; b < bar; ++b)
+			printf("#");
+		printf("\n");
+	}
+}
+
+/* ---------------------------------------------------------------------------
+ * Typed buffer conversion
+ * ------------------------------------------------------------------------- */
+
+#define DEFINE_GATHER(NAME, T) \
+static size_t NAME(const void* data, size_t n, const void* fill, double* out) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)fill : (T)0; \
+	size_t m = 0; \
+	\
+	for (size_t i = 0; i < n; ++i) \
+	{ \
+		if (hasFill && vals[i] == fillVal) continue; \
+		double x = (double)vals[i]; \
+		if (!isfinite(x)) continue; \
+		out[m++] = x; \
+	} \
+	\
+	return m; \
+}
+
+DEFINE_GATHER(gatherByte, signed char)
+DEFINE_GATHER(gatherUByte, unsigned char)
+DEFINE_GATHER(gatherShort, short)
+DEFINE_GATHER(gatherUShort, unsigned short)
+DEFINE_GATHER(gatherInt, int)
+DEFINE_GATHER(gatherUInt, unsigned int)
+DEFINE_GATHER(gatherInt64, long long)
+DEFINE_GATHER(gatherUInt64, unsigned long long)
+DEFINE_GATHER(gatherFloat, float)
+DEFINE_GATHER(gatherDouble, double)
+
+size_t gatherValid(nc_type type, const void* vals, size_t n, const void* fill, double* out)
+{
+	switch (type)
+	{
+	case NC_BYTE: return gatherByte(vals, n, fill, out);
+	case NC_UBYTE: return gatherUByte(vals, n, fill, out);
+	case NC_SHORT: return gatherShort(vals, n, fill, out);
+	case NC_USHORT: return gatherUShort(vals, n, fill, out);
+	case NC_INT: return gatherInt(vals, n, fill, out);
+	case NC_UINT: return gatherUInt(vals, n, fill, out);
+	case NC_INT64: return gatherInt64(vals, n, fill, out);
+	case NC_UINT64: return gatherUInt64(vals, n, fill, out);
+	case NC_FLOAT: return gatherFloat(vals, n, fill, out);
+	case NC_DOUBLE: return gatherDouble(vals, n, fill, out);
+	default: return 0;
+	}
+}
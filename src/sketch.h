@@ -0,0 +1,62 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include "netcdf.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define KLL_DEFAULT_K 200
+#define KLL_MAX_LEVELS 48
+
+// KLL quantile sketch (Karnin, Lang, Liberty 2016). Level h holds items of
+// weight 2^h; memory stays O(k log(n / k)) and sketches merge losslessly.
+typedef struct KllSketch
+{
+	int k;
+	int numLevels;
+	double* levels[KLL_MAX_LEVELS];
+	int sizes[KLL_MAX_LEVELS];
+	int allocated[KLL_MAX_LEVELS];
+	int size;      // items held across all levels
+	int maxSize;   // sum of level capacities
+	unsigned long long n;
+	unsigned rng;
+} KllSketch;
+
+void kllInit(KllSketch* sketch, int k, unsigned seed);
+void kllFree(KllSketch* sketch);
+// Both return false when out of memory
+bool kllAdd(KllSketch* sketch, const double* vals, size_t n);
+bool kllMerge(KllSketch* dst, const KllSketch* src);
+// qs must be ascending; returns false when the sketch is empty
+bool kllQuantiles(const KllSketch* sketch, const double* qs, int nq, double* out);
+double kllRankError(const KllSketch* sketch);
+// Rebuilds a saved sketch; items holds each level's sizes[h] values back to back
+bool kllRestore(KllSketch* sketch, int k, int numLevels, unsigned long long n, unsigned rng, const int* sizes, const void* items);
+
+// Histogram with a fixed number of power-of-two-wide bins. The range grows by
+// doubling the bin width, so bin edges always line up and partial histograms
+// from different slabs or threads merge exactly.
+typedef struct Histogram
+{
+	int nBins;
+	double lo;      // left edge of bin 0, a multiple of width
+	double width;   // always a power of two
+	unsigned long long* counts;
+	unsigned long long total;
+	double dataMin;
+	double dataMax;
+} Histogram;
+
+bool histogramInit(Histogram* hist, int nBins);
+void histogramFree(Histogram* hist);
+// Both return false when out of memory
+bool histogramAdd(Histogram* hist, const double* vals, size_t n);
+bool histogramMerge(Histogram* dst, const Histogram* src);
+void histogramPrint(const Histogram* hist, int barWidth);
+
+// Converts the non-fill, non-NaN values of a typed buffer to doubles; returns how many were written
+size_t gatherValid(nc_type type, const void* vals, size_t n, const void* fill, double* out);
+
+#endif
@@ -0,0 +1,231 @@
+#include "slab.h"
+#include "aggregate.h"
+
+#include <string.h>
+
+int getVarInfo(int ncid, int varID, VarInfo* info)
+{
+	memset(info, 0, sizeof(VarInfo));
+	info->ncid = ncid;
+	info->varID = varID;
+
+	int status = nc_inq_var(ncid, varID, info->name, &info->type, &info->nDims, info->dimIDs, NULL);
+	if (status != NC_NOERR) return status;
+
+	status = nc_inq_type(ncid, info->type, NULL, &info->typeSize);
+	if (status != NC_NOERR) return status;
+
+	info->valueCount = 1;
+
+	for (int i = 0; i < info->nDims; ++i)
+	{
+		status = nc_inq_dimlen(ncid, info->dimIDs[i], &info->dimLens[i]);
+		if (status != NC_NOERR) return status;
+		info->valueCount *= (unsigned long long)info->dimLens[i];
+		info->step[i] = 1;
+	}
+
+	int storage;
+	if (info->nDims > 0 && nc_inq_var_chunking(ncid, varID, &storage, info->chunkLens) == NC_NOERR)
+		info->chunked = storage == NC_CHUNKED;
+
+	int nUnlimDims, unlimDimIDs[NC_MAX_DIMS];
+
+	if (info->nDims > 0 && nc_inq_unlimdims(ncid, &nUnlimDims, unlimDimIDs) == NC_NOERR)
+	{
+		for (int i = 0; i < nUnlimDims; ++i)
+		{
+			if (unlimDimIDs[i] == info->dimIDs[0])
+				info->recordVar = true;
+		}
+	}
+
+	Aggregate* aggregate = info->recordVar ? aggregateFind(ncid) : NULL;
+	if (aggregate != NULL && aggregate->recordDim == info->dimIDs[0])
+	{
+		info->aggregate = aggregate;
+		info->dimLens[0] = aggregate->records;
+
+		info->valueCount = 1;
+		for (int i = 0; i < info->nDims; ++i)
+			info->valueCount *= (unsigned long long)info->dimLens[i];
+	}
+
+	return NC_NOERR;
+}
+
+// Grows a block of whole chunks from the fastest-varying dimension outward
+static unsigned long long chunkedShape(SlabPlan* plan, const VarInfo* var, unsigned long long budget)
+{
+	unsigned long long values = 1;
+
+	for (int i = 0; i < var->nDims; ++i)
+	{
+		plan->shape[i] = var->chunkLens[i] < var->dimLens[i] ? var->chunkLens[i] : var->dimLens[i];
+		values *= plan->shape[i];
+	}
+
+	// never split a chunk, even if one is bigger than the ceiling
+	if (budget < values) budget = values;
+
+	for (int i = var->nDims - 1; i >= 0; --i)
+	{
+		size_t unit = plan->shape[i];
+		unsigned long long others = values / unit;
+		unsigned long long fit = budget / others;
+
+		if (fit >= var->dimLens[i])
+		{
+			plan->shape[i] = var->dimLens[i];
+			values = others * plan->shape[i];
+			continue;
+		}
+
+		plan->shape[i] = (size_t)(fit / unit * unit);
+		values = others * plan->shape[i];
+		break;
+	}
+
+	return values;
+}
+
+// Chunk boundaries in the file are chunk boundaries of the selection
+static bool chunkAligned(const VarInfo* var)
+{
+	for (int i = 0; var->subset && i < var->nDims; ++i)
+	{
+		if (var->step[i] != 1 || var->offset[i] % var->chunkLens[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+void slabPlanInit(SlabPlan* plan, const VarInfo* var, size_t memLimit)
+{
+	memset(plan, 0, sizeof(SlabPlan));
+	plan->var = var;
+
+	size_t budget = memLimit / (var->typeSize > 0 ? var->typeSize : 1);
+	if (budget == 0) budget = 1;
+
+	unsigned long long values = 1;
+
+	if (var->chunked && var->valueCount > 0 && chunkAligned(var))
+	{
+		values = chunkedShape(plan, var, budget);
+	}
+	else
+	{
+		// grow the slab from the fastest-varying dimension outward until the budget is spent
+		bool full = true;
+
+		for (int i = var->nDims - 1; i >= 0; --i)
+		{
+			size_t len = var->dimLens[i];
+
+			if (!full || len == 0)
+			{
+				plan->shape[i] = len == 0 ? 0 : 1;
+				continue;
+			}
+
+			if (values * len <= budget)
+			{
+				plan->shape[i] = len;
+				values *= len;
+			}
+			else
+			{
+				plan->shape[i] = (size_t)(budget / values);
+				if (plan->shape[i] == 0) plan->shape[i] = 1;
+				values *= plan->shape[i];
+				full = false;
+			}
+		}
+	}
+
+	plan->slabValues = values;
+	plan->slabCount = var->valueCount == 0 ? 0 : 1;
+
+	for (int i = 0; i < var->nDims; ++i)
+	{
+		plan->slabsPerDim[i] = plan->shape[i] == 0 ? 0 : (var->dimLens[i] + plan->shape[i] - 1) / plan->shape[i];
+		plan->slabCount *= plan->slabsPerDim[i];
+	}
+}
+
+// Fills start/count for the slab at the given row-major index and returns its value count
+unsigned long long slabPlanGet(const SlabPlan* plan, unsigned long long index, size_t* start, size_t* count)
+{
+	const VarInfo* var = plan->var;
+	unsigned long long values = 1;
+
+	for (int i = var->nDims - 1; i >= 0; --i)
+	{
+		size_t pos = (size_t)(index % plan->slabsPerDim[i]);
+		index /= plan->slabsPerDim[i];
+
+		start[i] = pos * plan->shape[i];
+		count[i] = plan->shape[i];
+		if (start[i] + count[i] > var->dimLens[i])
+			count[i] = var->dimLens[i] - start[i];
+
+		values *= count[i];
+	}
+
+	return values;
+}
+
+// Translates a block of the selection into file coordinates; true when the result is strided
+static bool mapSelection(const VarInfo* var, const size_t* start, const ptrdiff_t* stride, size_t* fileStart, ptrdiff_t* fileStride)
+{
+	bool strided = false;
+
+	for (int i = 0; i < var->nDims; ++i)
+	{
+		fileStart[i] = var->offset[i] + start[i] * var->step[i];
+		fileStride[i] = (stride != NULL ? stride[i] : 1) * var->step[i];
+		if (fileStride[i] != 1) strided = true;
+	}
+
+	return strided;
+}
+
+int readSlab(const VarInfo* var, const size_t* start, const size_t* count, void* buffer)
+{
+	return readSlabStrided(var, start, count, NULL, buffer);
+}
+
+int readSlabStrided(const VarInfo* var, const size_t* start, const size_t* count, const ptrdiff_t* stride, void* buffer)
+{
+	size_t fileStart[NC_MAX_VAR_DIMS];
+	ptrdiff_t fileStride[NC_MAX_VAR_DIMS];
+
+	bool strided = mapSelection(var, start, stride, fileStart, fileStride);
+
+	if (var->aggregate)
+		return aggregateRead(var, fileStart, count, fileStride, strided, false, buffer);
+
+	if (strided)
+		return nc_get_vars(var->ncid, var->varID, fileStart, count, fileStride, buffer);
+
+	return nc_get_vara(var->ncid, var->varID, fileStart, count, buffer);
+}
+
+// lets libnetcdf convert any numeric type on the way in
+int readSlabDouble(const VarInfo* var, const size_t* start, const size_t* count, double* buffer)
+{
+	size_t fileStart[NC_MAX_VAR_DIMS];
+	ptrdiff_t fileStride[NC_MAX_VAR_DIMS];
+
+	bool strided = mapSelection(var, start, NULL, fileStart, fileStride);
+
+	if (var->aggregate)
+		return aggregateRead(var, fileStart, count, fileStride, strided, true, buffer);
+
+	if (strided)
+		return nc_get_vars_double(var->ncid, var->varID, fileStart, count, fileStride, buffer);
+
+	return nc_get_vara_double(var->ncid, var->varID, fileStart, count, buffer);
+}
@@ -0,0 +1,63 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "netcdf.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+struct Aggregate;
+
+// default ceiling for a single slab read buffer (bytes)
+#define SLAB_DEFAULT_MEM_LIMIT ((size_t)64 * 1024 * 1024)
+
+typedef struct VarInfo
+{
+	int ncid;
+	int varID;
+	char name[NC_MAX_NAME + 1];
+	nc_type type;
+	size_t typeSize;
+	int nDims;
+	int dimIDs[NC_MAX_VAR_DIMS];
+	size_t dimLens[NC_MAX_VAR_DIMS];
+	unsigned long long valueCount; // 64-bit so huge variables don't wrap
+	bool recordVar;                // leading dimension is unlimited, so the variable can grow along it
+	bool chunked;                  // stored as HDF5 chunks of chunkLens
+	size_t chunkLens[NC_MAX_VAR_DIMS];
+	// When subset is set, dimLens and valueCount describe a hyperslab: index i
+	// along dimension d is file index offset[d] + i * step[d]. Every slab read
+	// goes through this mapping.
+	bool subset;
+	size_t offset[NC_MAX_VAR_DIMS];
+	ptrdiff_t step[NC_MAX_VAR_DIMS];
+	// Set when ncid presents several files concatenated along the leading
+	// (record) dimension; dimLens[0] then counts the records of all of them.
+	struct Aggregate* aggregate;
+} VarInfo;
+
+// Splits a variable into row-major hyperslabs that each fit under a memory ceiling.
+// Slabs are addressed by index so they can be visited in any order. For chunked
+// variables every slab is a block of whole chunks (a row of chunks when a row fits),
+// so index order follows chunk storage order and each chunk is inflated once per
+// pass; such a slab may exceed the ceiling when a single chunk does.
+typedef struct SlabPlan
+{
+	const VarInfo* var;
+	size_t shape[NC_MAX_VAR_DIMS];      // slab extent along each dimension
+	size_t slabsPerDim[NC_MAX_VAR_DIMS];
+	unsigned long long slabCount;
+	unsigned long long slabValues;      // values in a full slab (buffer size)
+} SlabPlan;
+
+int getVarInfo(int ncid, int varID, VarInfo* info);
+
+void slabPlanInit(SlabPlan* plan, const VarInfo* var, size_t memLimit);
+unsigned long long slabPlanGet(const SlabPlan* plan, unsigned long long index, size_t* start, size_t* count);
+
+// start and count (and stride, which may be NULL) are in selection coordinates
+int readSlab(const VarInfo* var, const size_t* start, const size_t* count, void* buffer);
+int readSlabStrided(const VarInfo* var, const size_t* start, const size_t* count, const ptrdiff_t* stride, void* buffer);
+int readSlabDouble(const VarInfo* var, const size_t* start, const size_t* count, double* buffer);
+
+#endif
@@ -0,0 +1,792 @@
+#include "statcache.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define CACHE_MAGIC "NCXSTATS"
+#define CACHE_VERSION 3 // 3: sketches of packed or masked variables hold physical values
+#define CACHE_BYTE_ORDER 0x01020304u
+
+/* ---------------------------------------------------------------------------
+ * File identity and cache location
+ * ------------------------------------------------------------------------- */
+
+bool fileIdentityGet(const char* path, FileIdentity* id)
+{
+	memset(id, 0, sizeof(FileIdentity));
+
+#ifdef _WIN32
+	if (_fullpath(id->path, path, sizeof(id->path)) == NULL) return false;
+
+	struct _stat64 st;
+	if (_stat64(id->path, &st) != 0) return false;
+#else
+	char* full = realpath(path, NULL);
+	if (full == NULL) return false;
+
+	bool fits = strlen(full) < sizeof(id->path);
+	if (fits) strcpy(id->path, full);
+	free(full);
+	if (!fits) return false;
+
+	struct stat st;
+	if (stat(id->path, &st) != 0) return false;
+
+#if defined(__APPLE__)
+	id->mtimeNsec = (long long)st.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	id->mtimeNsec = (long long)st.st_mtim.tv_nsec;
+#endif
+#endif
+
+	id->size = (unsigned long long)st.st_size;
+	id->mtime = (long long)st.st_mtime;
+	id->inode = (unsigned long long)st.st_ino;
+	id->device = (unsigned long long)st.st_dev;
+
+	return true;
+}
+
+bool statsCacheDefaultDir(char* buffer, size_t size)
+{
+	int written;
+
+#ifdef _WIN32
+	const char* base = getenv("LOCALAPPDATA");
+	if (base == NULL || base[0] == '\0') return false;
+	written = snprintf(buffer, size, "%s\\netCDFExplorer\\cache", base);
+#else
+	const char* base = getenv("XDG_CACHE_HOME");
+	if (base != NULL && base[0] != '\0')
+	{
+		written = snprintf(buffer, size, "%s/netcdf-explorer", base);
+	}
+	else
+	{
+		base = getenv("HOME");
+		if (base == NULL || base[0] == '\0') return false;
+		written = snprintf(buffer, size, "%s/.cache/netcdf-explorer", base);
+	}
+#endif
+
+	return written > 0 && (size_t)written < size;
+}
+
+static bool isSeparator(char c)
+{
+#ifdef _WIN32
+	return c == '/' || c == '\\';
+#else
+	return c == '/';
+#endif
+}
+
+static bool makeDir(const char* path)
+{
+#ifdef _WIN32
+	return _mkdir(path) == 0 || errno == EEXIST;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// mkdir -p
+static bool makeDirs(const char* dir)
+{
+	char path[STATS_CACHE_MAX_PATH];
+	if (strlen(dir) >= sizeof(path)) return false;
+	strcpy(path, dir);
+
+	for (char* p = path + 1; *p; ++p)
+	{
+		if (!isSeparator(*p) || isSeparator(p[-1]) || p[-1] == ':') continue;
+
+		char c = *p;
+		*p = '\0';
+		bool ok = makeDir(path);
+		*p = c;
+
+		if (!ok) return false;
+	}
+
+	return makeDir(path);
+}
+
+static unsigned long long fnv1a(const void* data, size_t n, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+
+	return hash;
+}
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+
+// entries are named by path and variable, so a changed file overwrites its stale entry
+static bool entryPath(const char* dir, const FileIdentity* id, int varID, const char* ext, char* buffer, size_t size)
+{
+	unsigned long long hash = fnv1a(id->path, strlen(id->path), FNV_OFFSET);
+	size_t dirLen = strlen(dir);
+	const char* sep = dirLen > 0 && isSeparator(dir[dirLen - 1]) ? "" : "/";
+
+	int written = snprintf(buffer, size, "%s%s%016llx-%d.%s", dir, sep, hash, varID, ext);
+	return written > 0 && (size_t)written < size;
+}
+
+/* ---------------------------------------------------------------------------
+ * Entry encoding: a fixed header followed by a checksummed payload, all in
+ * host byte order since the cache never leaves the machine that wrote it
+ * ------------------------------------------------------------------------- */
+
+typedef struct Encoder
+{
+	unsigned char* data;
+	size_t size;
+	size_t allocated;
+	bool failed;
+} Encoder;
+
+typedef struct Decoder
+{
+	const unsigned char* data;
+	size_t size;
+	size_t pos;
+	bool failed;
+} Decoder;
+
+static void put(Encoder* enc, const void* src, size_t n)
+{
+	if (enc->failed) return;
+
+	if (enc->size + n > enc->allocated)
+	{
+		size_t allocated = enc->allocated > 0 ? enc->allocated : 1024;
+		while (allocated < enc->size + n)
+			allocated *= 2;
+
+		unsigned char* grown = (unsigned char*)realloc(enc->data, allocated);
+		if (grown == NULL)
+		{
+			enc->failed = true;
+			return;
+		}
+
+		enc->data = grown;
+		enc->allocated = allocated;
+	}
+
+	memcpy(enc->data + enc->size, src, n);
+	enc->size += n;
+}
+
+static void get(Decoder* dec, void* dst, size_t n)
+{
+	if (dec->failed || dec->size - dec->pos < n)
+	{
+		dec->failed = true;
+		memset(dst, 0, n);
+		return;
+	}
+
+	memcpy(dst, dec->data + dec->pos, n);
+	dec->pos += n;
+}
+
+#define PUT(enc, value) put(enc, &(value), sizeof(value))
+#define GET(dec, value) get(dec, &(value), sizeof(value))
+
+static void putMoments(Encoder* enc, const Moments* m)
+{
+	PUT(enc, m->n);
+	PUT(enc, m->mean);
+	PUT(enc, m->m2);
+	PUT(enc, m->m3);
+	PUT(enc, m->m4);
+}
+
+static void getMoments(Decoder* dec, Moments* m)
+{
+	GET(dec, m->n);
+	GET(dec, m->mean);
+	GET(dec, m->m2);
+	GET(dec, m->m3);
+	GET(dec, m->m4);
+}
+
+// what must match exactly: the file, the variable and its fixed dimensions
+static void putKey(Encoder* enc, const FileIdentity* id, const VarInfo* var)
+{
+	unsigned pathLen = (unsigned)strlen(id->path);
+	PUT(enc, pathLen);
+	put(enc, id->path, pathLen);
+	PUT(enc, id->inode);
+	PUT(enc, id->device);
+	PUT(enc, var->varID);
+	PUT(enc, var->type);
+	PUT(enc, var->nDims);
+
+	unsigned char recordVar = var->recordVar ? 1 : 0;
+	PUT(enc, recordVar);
+
+	for (int d = var->recordVar ? 1 : 0; d < var->nDims; ++d)
+	{
+		unsigned long long len = var->dimLens[d];
+		PUT(enc, len);
+	}
+}
+
+// what may legitimately change when records are appended
+typedef struct EntryVersion
+{
+	unsigned long long size;
+	long long mtime;
+	long long mtimeNsec;
+	unsigned long long records;
+} EntryVersion;
+
+static void versionOf(const FileIdentity* id, const VarInfo* var, EntryVersion* version)
+{
+	version->size = id->size;
+	version->mtime = id->mtime;
+	version->mtimeNsec = id->mtimeNsec;
+	version->records = var->recordVar ? (unsigned long long)var->dimLens[0] : 0;
+}
+
+static void putVersion(Encoder* enc, const EntryVersion* version)
+{
+	PUT(enc, version->size);
+	PUT(enc, version->mtime);
+	PUT(enc, version->mtimeNsec);
+	PUT(enc, version->records);
+}
+
+static void getVersion(Decoder* dec, EntryVersion* version)
+{
+	GET(dec, version->size);
+	GET(dec, version->mtime);
+	GET(dec, version->mtimeNsec);
+	GET(dec, version->records);
+}
+
+static void encodeStats(Encoder* enc, const VarStats* stats)
+{
+	PUT(enc, stats->count);
+	PUT(enc, stats->validCount);
+	PUT(enc, stats->min);
+	PUT(enc, stats->max);
+	PUT(enc, stats->sum.sum);
+	PUT(enc, stats->sum.comp);
+	putMoments(enc, &stats->moments);
+	PUT(enc, stats->minExact.u);
+	PUT(enc, stats->maxExact.u);
+
+	unsigned char flag = stats->unpack ? 1 : 0;
+	PUT(enc, flag);
+	if (stats->unpack)
+	{
+		PUT(enc, stats->physical.valid);
+		PUT(enc, stats->physical.min);
+		PUT(enc, stats->physical.max);
+		PUT(enc, stats->physical.sum.sum);
+		PUT(enc, stats->physical.sum.comp);
+		putMoments(enc, &stats->physical.moments);
+	}
+
+	flag = stats->sketch ? 1 : 0;
+	PUT(enc, flag);
+	if (stats->sketch)
+	{
+		const KllSketch* s = stats->sketch;
+		PUT(enc, s->k);
+		PUT(enc, s->numLevels);
+		PUT(enc, s->n);
+		PUT(enc, s->rng);
+		put(enc, s->sizes, s->numLevels * sizeof(int));
+		for (int h = 0; h < s->numLevels; ++h)
+			put(enc, s->levels[h], s->sizes[h] * sizeof(double));
+	}
+
+	flag = stats->hist ? 1 : 0;
+	PUT(enc, flag);
+	if (stats->hist)
+	{
+		const Histogram* h = stats->hist;
+		PUT(enc, h->nBins);
+		PUT(enc, h->lo);
+		PUT(enc, h->width);
+		PUT(enc, h->total);
+		PUT(enc, h->dataMin);
+		PUT(enc, h->dataMax);
+		put(enc, h->counts, h->nBins * sizeof(unsigned long long));
+	}
+}
+
+static bool decodeSketch(Decoder* dec, KllSketch* sketch)
+{
+	int k, numLevels;
+	unsigned long long n;
+	unsigned rng;
+	int sizes[KLL_MAX_LEVELS];
+
+	GET(dec, k);
+	GET(dec, numLevels);
+	GET(dec, n);
+	GET(dec, rng);
+	if (dec->failed || k <= 0 || numLevels < 1 || numLevels > KLL_MAX_LEVELS) return false;
+
+	get(dec, sizes, numLevels * sizeof(int));
+
+	size_t items = 0;
+	for (int h = 0; h < numLevels; ++h)
+	{
+		if (sizes[h] < 0) return false;
+		items += (size_t)sizes[h];
+	}
+
+	if (dec->failed || items > (dec->size - dec->pos) / sizeof(double)) return false;
+
+	const double* data = (const double*)(dec->data + dec->pos);
+	dec->pos += items * sizeof(double);
+
+	return kllRestore(sketch, k, numLevels, n, rng, sizes, data);
+}
+
+static bool decodeStats(Decoder* dec, VarStats* stats)
+{
+	GET(dec, stats->count);
+	GET(dec, stats->validCount);
+	GET(dec, stats->min);
+	GET(dec, stats->max);
+	GET(dec, stats->sum.sum);
+	GET(dec, stats->sum.comp);
+	getMoments(dec, &stats->moments);
+	GET(dec, stats->minExact.u);
+	GET(dec, stats->maxExact.u);
+
+	unsigned char flag;
+	GET(dec, flag);
+	if (flag)
+	{
+		GET(dec, stats->physical.valid);
+		GET(dec, stats->physical.min);
+		GET(dec, stats->physical.max);
+		GET(dec, stats->physical.sum.sum);
+		GET(dec, stats->physical.sum.comp);
+		getMoments(dec, &stats->physical.moments);
+	}
+
+	if (dec->failed || (flag != 0) != stats->unpack) return false;
+
+	GET(dec, flag);
+	if (flag)
+	{
+		stats->sketch = (KllSketch*)malloc(sizeof(KllSketch));
+		if (stats->sketch == NULL) return false;
+
+		if (!decodeSketch(dec, stats->sketch))
+		{
+			kllFree(stats->sketch);
+			free(stats->sketch);
+			stats->sketch = NULL;
+			return false;
+		}
+	}
+
+	GET(dec, flag);
+	if (flag)
+	{
+		int nBins;
+		GET(dec, nBins);
+		if (dec->failed || nBins <= 0 || (size_t)nBins > (dec->size - dec->pos) / sizeof(unsigned long long)) return false;
+
+		stats->hist = (Histogram*)malloc(sizeof(Histogram));
+		if (stats->hist == NULL) return false;
+
+		if (!histogramInit(stats->hist, nBins))
+		{
+			free(stats->hist);
+			stats->hist = NULL;
+			return false;
+		}
+
+		GET(dec, stats->hist->lo);
+		GET(dec, stats->hist->width);
+		GET(dec, stats->hist->total);
+		GET(dec, stats->hist->dataMin);
+		GET(dec, stats->hist->dataMax);
+		get(dec, stats->hist->counts, nBins * sizeof(unsigned long long));
+	}
+
+	return !dec->failed;
+}
+
+// Partial results handed between processes carry the zones too; they were
+// laid out by zoneMapInit on the same variable at both ends
+bool varStatsEncode(const VarStats* stats, unsigned char** data, size_t* size)
+{
+	Encoder enc = { NULL, 0, 0, false };
+	encodeStats(&enc, stats);
+
+	unsigned char flag = stats->zones ? 1 : 0;
+	PUT(&enc, flag);
+	if (stats->zones)
+	{
+		PUT(&enc, stats->zones->nZones);
+		put(&enc, stats->zones->zones, (size_t)stats->zones->nZones * sizeof(Zone));
+	}
+
+	if (enc.failed)
+	{
+		free(enc.data);
+		return false;
+	}
+
+	*data = enc.data;
+	*size = enc.size;
+	return true;
+}
+
+bool varStatsDecode(const unsigned char* data, size_t size, VarStats* stats)
+{
+	Decoder dec = { data, size, 0, false };
+	if (!decodeStats(&dec, stats)) return false;
+
+	unsigned char flag;
+	GET(&dec, flag);
+	if (dec.failed || (flag != 0) != (stats->zones != NULL)) return false;
+
+	if (stats->zones)
+	{
+		unsigned long long nZones;
+		GET(&dec, nZones);
+		if (dec.failed || nZones != stats->zones->nZones) return false;
+
+		get(&dec, stats->zones->zones, (size_t)nZones * sizeof(Zone));
+	}
+
+	return !dec.failed && dec.pos == dec.size;
+}
+
+typedef struct EntryHeader
+{
+	char magic[8];
+	unsigned version;
+	unsigned byteOrder;
+	unsigned long long payloadSize;
+	unsigned long long checksum;
+} EntryHeader;
+
+static unsigned char* readWholeFile(const char* path, size_t* size)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) return NULL;
+
+	unsigned char* data = NULL;
+	long length = -1;
+
+	if (fseek(file, 0, SEEK_END) == 0)
+		length = ftell(file);
+
+	if (length > 0 && fseek(file, 0, SEEK_SET) == 0)
+	{
+		data = (unsigned char*)malloc((size_t)length);
+
+		if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+
+	fclose(file);
+	*size = data != NULL ? (size_t)length : 0;
+	return data;
+}
+
+// Reads an entry, checks its header, checksum and key, and leaves dec at the stored version
+static unsigned char* openEntry(const char* path, const FileIdentity* id, const VarInfo* var, Decoder* dec)
+{
+	size_t size;
+	unsigned char* data = readWholeFile(path, &size);
+	if (data == NULL) return NULL;
+
+	EntryHeader header;
+	bool ok = size >= sizeof(EntryHeader);
+
+	if (ok)
+	{
+		memcpy(&header, data, sizeof(EntryHeader));
+		ok = memcmp(header.magic, CACHE_MAGIC, 8) == 0 && header.version == CACHE_VERSION && header.byteOrder == CACHE_BYTE_ORDER &&
+			header.payloadSize == size - sizeof(EntryHeader) &&
+			header.checksum == fnv1a(data + sizeof(EntryHeader), (size_t)header.payloadSize, FNV_OFFSET);
+	}
+
+	// the stored key must match the file and variable byte for byte
+	Encoder key = { NULL, 0, 0, false };
+	putKey(&key, id, var);
+
+	ok = ok && !key.failed && header.payloadSize >= key.size && memcmp(data + sizeof(EntryHeader), key.data, key.size) == 0;
+
+	if (ok)
+	{
+		dec->data = data + sizeof(EntryHeader);
+		dec->size = (size_t)header.payloadSize;
+		dec->pos = key.size;
+		dec->failed = false;
+	}
+
+	free(key.data);
+
+	if (!ok)
+	{
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+// appended records are taken on trust, but a rewrite in place starts over
+static CacheLookup compareVersions(const EntryVersion* stored, const EntryVersion* current, const VarInfo* var)
+{
+	if (memcmp(stored, current, sizeof(EntryVersion)) == 0)
+		return CACHE_HIT;
+	if (var->recordVar && stored->records > 0 && stored->records < current->records)
+		return CACHE_PARTIAL;
+	return CACHE_MISS;
+}
+
+CacheLookup statsCacheLoad(const char* dir, const FileIdentity* id, const VarInfo* var, const StatsConfig* config, VarStats* stats, unsigned long long* records)
+{
+	char path[STATS_CACHE_MAX_PATH];
+	if (!entryPath(dir, id, var->varID, "stats", path, sizeof(path))) return CACHE_MISS;
+
+	Decoder dec;
+	unsigned char* data = openEntry(path, id, var, &dec);
+	bool ok = data != NULL;
+
+	VarStats loaded;
+	varStatsInit(&loaded, stats->type);
+	loaded.unpack = stats->unpack;
+	loaded.pack = stats->pack;
+
+	EntryVersion stored, current;
+	versionOf(id, var, &current);
+	CacheLookup lookup = CACHE_MISS;
+
+	if (ok)
+	{
+		getVersion(&dec, &stored);
+		ok = decodeStats(&dec, &loaded) && dec.pos == dec.size;
+	}
+
+	if (ok)
+	{
+		lookup = compareVersions(&stored, &current, var);
+		ok = lookup != CACHE_MISS;
+	}
+
+	free(data);
+
+	// the entry must hold at least the sketches asked for
+	ok = ok && (!config->quantiles || loaded.sketch != NULL) && (config->histBins <= 0 || (loaded.hist != NULL && loaded.hist->nBins == config->histBins));
+
+	if (!ok)
+	{
+		varStatsFree(&loaded);
+		return CACHE_MISS;
+	}
+
+	if (!config->quantiles && loaded.sketch)
+	{
+		kllFree(loaded.sketch);
+		free(loaded.sketch);
+		loaded.sketch = NULL;
+	}
+
+	if (config->histBins <= 0 && loaded.hist)
+	{
+		histogramFree(loaded.hist);
+		free(loaded.hist);
+		loaded.hist = NULL;
+	}
+
+	varStatsFree(stats);
+	*stats = loaded;
+	*records = stored.records;
+	return lookup;
+}
+
+CacheLookup zoneMapCacheLoad(const char* dir, const FileIdentity* id, const VarInfo* var, ZoneMap* map)
+{
+	char path[STATS_CACHE_MAX_PATH];
+	if (!entryPath(dir, id, var->varID, "zones", path, sizeof(path))) return CACHE_MISS;
+
+	Decoder dec;
+	unsigned char* data = openEntry(path, id, var, &dec);
+	if (data == NULL) return CACHE_MISS;
+
+	EntryVersion stored, current;
+	versionOf(id, var, &current);
+	getVersion(&dec, &stored);
+
+	CacheLookup lookup = compareVersions(&stored, &current, var);
+
+	// the stored grid must be the one the variable gets now, over the records it had then
+	ZoneMap loaded;
+	bool ok = lookup != CACHE_MISS && zoneMapInit(&loaded, var);
+
+	if (ok && var->recordVar) loaded.dimLens[0] = (size_t)stored.records;
+
+	int nDims;
+	GET(&dec, nDims);
+	ok = ok && !dec.failed && nDims == loaded.nDims;
+
+	unsigned long long expected = 1;
+	for (int d = 0; ok && d < nDims; ++d)
+	{
+		unsigned long long block, len;
+		GET(&dec, block);
+		GET(&dec, len);
+		ok = !dec.failed && block == loaded.block[d] && len == loaded.dimLens[d];
+
+		loaded.blocksPerDim[d] = (loaded.dimLens[d] + loaded.block[d] - 1) / loaded.block[d];
+		expected *= loaded.blocksPerDim[d];
+	}
+
+	// zoneMapInit sized the zones for the current records, which is never fewer
+	unsigned long long nZones;
+	GET(&dec, nZones);
+	ok = ok && !dec.failed && nZones == expected && nZones <= loaded.nZones && dec.size - dec.pos == nZones * sizeof(Zone);
+
+	if (ok)
+	{
+		get(&dec, loaded.zones, (size_t)nZones * sizeof(Zone));
+		loaded.nZones = nZones;
+	}
+	else if (lookup != CACHE_MISS)
+	{
+		zoneMapFree(&loaded);
+	}
+
+	free(data);
+
+	if (!ok) return CACHE_MISS;
+
+	zoneMapFree(map);
+	*map = loaded;
+	return lookup;
+}
+
+static bool replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+// Fills in the header and writes the entry beside its final name, then renames it
+// over that, so readers never see a partial entry
+static bool writeEntry(const char* dir, const char* path, Encoder* enc)
+{
+	if (enc->failed || !makeDirs(dir))
+	{
+		free(enc->data);
+		return false;
+	}
+
+	EntryHeader header;
+	memset(&header, 0, sizeof(EntryHeader));
+	memcpy(header.magic, CACHE_MAGIC, 8);
+	header.version = CACHE_VERSION;
+	header.byteOrder = CACHE_BYTE_ORDER;
+	header.payloadSize = enc->size - sizeof(EntryHeader);
+	header.checksum = fnv1a(enc->data + sizeof(EntryHeader), enc->size - sizeof(EntryHeader), FNV_OFFSET);
+	memcpy(enc->data, &header, sizeof(EntryHeader));
+
+	char tmpPath[STATS_CACHE_MAX_PATH + 32];
+	static unsigned counter = 0;
+	snprintf(tmpPath, sizeof(tmpPath), "%s.%ld.%u.tmp", path, (long)getpid(), counter++);
+
+	FILE* file = fopen(tmpPath, "wb");
+	bool ok = file != NULL;
+
+	if (ok)
+	{
+		ok = fwrite(enc->data, 1, enc->size, file) == enc->size;
+		ok = fclose(file) == 0 && ok;
+		ok = ok && replaceFile(tmpPath, path);
+		if (!ok) remove(tmpPath);
+	}
+
+	free(enc->data);
+	return ok;
+}
+
+// space for the header, then what identifies the entry
+static void beginEntry(Encoder* enc, const FileIdentity* id, const VarInfo* var)
+{
+	EntryHeader header;
+	memset(&header, 0, sizeof(EntryHeader));
+	PUT(enc, header);
+
+	EntryVersion version;
+	versionOf(id, var, &version);
+
+	putKey(enc, id, var);
+	putVersion(enc, &version);
+}
+
+bool statsCacheStore(const char* dir, const FileIdentity* id, const VarInfo* var, const VarStats* stats)
+{
+	char path[STATS_CACHE_MAX_PATH];
+	if (!entryPath(dir, id, var->varID, "stats", path, sizeof(path))) return false;
+
+	Encoder enc = { NULL, 0, 0, false };
+	beginEntry(&enc, id, var);
+	encodeStats(&enc, stats);
+
+	return writeEntry(dir, path, &enc);
+}
+
+bool zoneMapCacheStore(const char* dir, const FileIdentity* id, const VarInfo* var, const ZoneMap* map)
+{
+	char path[STATS_CACHE_MAX_PATH];
+	if (!entryPath(dir, id, var->varID, "zones", path, sizeof(path))) return false;
+
+	Encoder enc = { NULL, 0, 0, false };
+	beginEntry(&enc, id, var);
+
+	PUT(&enc, map->nDims);
+	for (int d = 0; d < map->nDims; ++d)
+	{
+		unsigned long long block = map->block[d], len = map->dimLens[d];
+		PUT(&enc, block);
+		PUT(&enc, len);
+	}
+
+	PUT(&enc, map->nZones);
+	put(&enc, map->zones, (size_t)map->nZones * sizeof(Zone));
+
+	return writeEntry(dir, path, &enc);
+}
@@ -0,0 +1,51 @@
+#ifndef STATCACHE_H
+#define STATCACHE_H
+
+#include "stats.h"
+#include "zonemap.h"
+
+#define STATS_CACHE_MAX_PATH 4096
+
+// Identity of a file on disk; a cache entry is only trusted while all of it still matches
+typedef struct FileIdentity
+{
+	char path[STATS_CACHE_MAX_PATH]; // canonical absolute path
+	unsigned long long size;
+	long long mtime;                 // seconds
+	long long mtimeNsec;             // 0 where the platform has no sub-second times
+	unsigned long long inode;
+	unsigned long long device;
+} FileIdentity;
+
+bool fileIdentityGet(const char* path, FileIdentity* id);
+
+// Per-user default: $XDG_CACHE_HOME or ~/.cache on POSIX, %LOCALAPPDATA% on Windows.
+// Returns false when no suitable location exists.
+bool statsCacheDefaultDir(char* buffer, size_t size);
+
+typedef enum CacheLookup
+{
+	CACHE_MISS,
+	CACHE_HIT,
+	CACHE_PARTIAL // file grew along the record dimension; stats cover only the first *records records
+} CacheLookup;
+
+// One entry per (file, variable). Entries are written to a temporary file and
+// renamed into place, so concurrent processes only ever see whole entries.
+// A hit needs at least the sketches the config asks for; extra ones are dropped.
+// Records already reduced are assumed not to change once later ones are appended.
+CacheLookup statsCacheLoad(const char* dir, const FileIdentity* id, const VarInfo* var, const StatsConfig* config, VarStats* stats, unsigned long long* records);
+bool statsCacheStore(const char* dir, const FileIdentity* id, const VarInfo* var, const VarStats* stats);
+
+// Zone maps sit beside the statistics entry and follow the same rules; on
+// CACHE_PARTIAL the map covers only the records the entry was written with.
+CacheLookup zoneMapCacheLoad(const char* dir, const FileIdentity* id, const VarInfo* var, ZoneMap* map);
+bool zoneMapCacheStore(const char* dir, const FileIdentity* id, const VarInfo* var, const ZoneMap* map);
+
+// The statistics encoding alone, zones included, for partial results sent
+// between processes. Decoding fills a fresh varStatsInit'd stats whose unpack
+// flag, and zones when the sender had them, are set up as the sender's were.
+bool varStatsEncode(const VarStats* stats, unsigned char** data, size_t* size);
+bool varStatsDecode(const unsigned char* data, size_t size, VarStats* stats);
+
+#endif
@@ -0,0 +1,738 @@
+#include "stats.h"
+#include "procs.h"
+#include "statcache.h"
+#include "threads.h"
+#include "netcdf_mem.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// keep at least this many slabs per thread so uneven slabs still balance
+#define SLABS_PER_THREAD 4
+#define MIN_THREAD_SLAB_BYTES ((size_t)1024 * 1024)
+// buffers in flight per reduction thread in pipelined mode: one being reduced, one being filled
+#define PIPELINE_BUFFERS_PER_WORKER 2
+
+void varStatsInit(VarStats* stats, nc_type type)
+{
+	stats->type = type;
+	stats->count = 0;
+	stats->validCount = 0;
+	stats->min = NC_MAX_DOUBLE;
+	stats->max = NC_MIN_DOUBLE;
+	stats->sum.sum = 0.0;
+	stats->sum.comp = 0.0;
+	momentsInit(&stats->moments);
+	stats->minExact.u = 0;
+	stats->maxExact.u = 0;
+	stats->sketch = NULL;
+	stats->hist = NULL;
+	stats->unpack = false;
+	unpackedStatsInit(&stats->physical);
+	stats->cached = false;
+	stats->cachedRecords = 0;
+	memset(&stats->chunkCache, 0, sizeof(ChunkCacheEstimate));
+	stats->zones = NULL;
+}
+
+bool varStatsEnableSketches(VarStats* stats, bool quantiles, int histBins, unsigned seed)
+{
+	if (quantiles)
+	{
+		stats->sketch = (KllSketch*)malloc(sizeof(KllSketch));
+		if (stats->sketch == NULL) return false;
+		kllInit(stats->sketch, KLL_DEFAULT_K, seed);
+	}
+
+	if (histBins > 0)
+	{
+		stats->hist = (Histogram*)malloc(sizeof(Histogram));
+		if (stats->hist == NULL) return false;
+
+		if (!histogramInit(stats->hist, histBins))
+		{
+			free(stats->hist);
+			stats->hist = NULL;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void varStatsFree(VarStats* stats)
+{
+	if (stats->sketch)
+	{
+		kllFree(stats->sketch);
+		free(stats->sketch);
+		stats->sketch = NULL;
+	}
+
+	if (stats->hist)
+	{
+		histogramFree(stats->hist);
+		free(stats->hist);
+		stats->hist = NULL;
+	}
+
+	if (stats->zones)
+	{
+		zoneMapFree(stats->zones);
+		free(stats->zones);
+		stats->zones = NULL;
+	}
+}
+
+static void mergeExtrema(VarStats* dst, double min, double max, ExactInt minExact, ExactInt maxExact)
+{
+	bool first = dst->validCount == 0;
+
+	if (min < dst->min) dst->min = min;
+	if (max > dst->max) dst->max = max;
+
+	if (dst->type == NC_INT64)
+	{
+		if (first || minExact.s < dst->minExact.s) dst->minExact.s = minExact.s;
+		if (first || maxExact.s > dst->maxExact.s) dst->maxExact.s = maxExact.s;
+	}
+	else if (dst->type == NC_UINT64)
+	{
+		if (first || minExact.u < dst->minExact.u) dst->minExact.u = minExact.u;
+		if (first || maxExact.u > dst->maxExact.u) dst->maxExact.u = maxExact.u;
+	}
+}
+
+bool varStatsMerge(VarStats* dst, const VarStats* src)
+{
+	dst->count += src->count;
+
+	bool ok = !(src->sketch && dst->sketch) || kllMerge(dst->sketch, src->sketch);
+	if (src->hist && dst->hist && !histogramMerge(dst->hist, src->hist)) ok = false;
+	if (src->unpack && dst->unpack) unpackedStatsMerge(&dst->physical, &src->physical);
+	if (src->zones && dst->zones) zoneMapMerge(dst->zones, src->zones);
+
+	if (src->validCount == 0) return ok;
+
+	mergeExtrema(dst, src->min, src->max, src->minExact, src->maxExact);
+	compensatedAdd(&dst->sum, src->sum.sum);
+	compensatedAdd(&dst->sum, src->sum.comp);
+	momentsMerge(&dst->moments, &src->moments);
+	dst->validCount += src->validCount;
+	return ok;
+}
+
+void varStatsAddResult(VarStats* stats, const MinMaxSum* part)
+{
+	if (part->valid == 0) return;
+
+	mergeExtrema(stats, part->min, part->max, part->minExact, part->maxExact);
+	compensatedAdd(&stats->sum, part->sum);
+	stats->validCount += part->valid;
+}
+
+double varStatsSum(const VarStats* stats)
+{
+	return compensatedValue(&stats->sum);
+}
+
+const void* varFillValue(const VarInfo* var, long long* storage)
+{
+	nc_type fillType;
+	size_t fillLen;
+
+	if (nc_inq_att(var->ncid, var->varID, "_FillValue", &fillType, &fillLen) != NC_NOERR || fillType != var->type || fillLen != 1)
+		return NULL;
+
+	return nc_get_att(var->ncid, var->varID, "_FillValue", storage) == NC_NOERR ? storage : NULL;
+}
+
+int reduceSlab(const VarInfo* var, const void* vals, unsigned long long n, const void* fillval, VarStats* stats)
+{
+	MomentsKernel kernel = simdMomentsKernel(var->type);
+	if (kernel == NULL) return NC_EBADTYPE;
+
+	// the power sums are kept small by shifting them to the running mean, or
+	// before there is one to the slab's first finite value
+	double shift = stats->moments.n > 0 ? stats->moments.mean : 0.0;
+	if (stats->moments.n == 0)
+	{
+		double first[64];
+		if (gatherValid(var->type, vals, n < 64 ? (size_t)n : 64, fillval, first) > 0) shift = first[0];
+	}
+	if (!isfinite(shift)) shift = 0.0;
+
+	// central moments come out of the same pass as the extrema and sum
+	MinMaxSum part;
+	kernel(vals, (size_t)n, fillval, shift, &part);
+
+	stats->count += n;
+	varStatsAddResult(stats, &part);
+
+	if (part.valid > 0)
+	{
+		double sums[5] = { (double)part.valid, part.powers[0], part.powers[1], part.powers[2], part.powers[3] };
+		Moments slabMoments;
+		momentsFromPowerSums(sums, shift, &slabMoments);
+		momentsMerge(&stats->moments, &slabMoments);
+	}
+
+	// physical units: once values have been seen the running mean is the best shift
+	if (part.valid > 0 && stats->unpack)
+	{
+		double shift = stats->physical.valid > 0 ? stats->physical.moments.mean : part.sum / (double)part.valid * stats->pack.scale + stats->pack.offset;
+		unpackReduce(var->type, vals, (size_t)n, fillval, &stats->pack, shift, &stats->physical);
+	}
+
+	if (part.valid > 0 && (stats->sketch || stats->hist))
+	{
+		double converted[4096];
+		const char* bytes = (const char*)vals;
+
+		for (unsigned long long i = 0; i < n; i += 4096)
+		{
+			size_t block = n - i < 4096 ? (size_t)(n - i) : 4096;
+			const void* slab = bytes + i * var->typeSize;
+
+			// packed or masked variables are summarised in physical units, like the PHYSICAL section
+			size_t m = stats->unpack ? unpackGather(var->type, slab, block, fillval, &stats->pack, converted) : gatherValid(var->type, slab, block, fillval, converted);
+
+			if (stats->sketch && !kllAdd(stats->sketch, converted, m)) return NC_ENOMEM;
+			if (stats->hist && !histogramAdd(stats->hist, converted, m)) return NC_ENOMEM;
+		}
+	}
+
+	return NC_NOERR;
+}
+
+typedef struct StatsJob
+{
+	const VarInfo* var;
+	SlabPlan plan;
+	const void* fillval;
+	ChunkCacheEstimate cache;
+	volatile unsigned long long* nextSlab; // shared by every worker process
+} StatsJob;
+
+typedef struct StatsWorker
+{
+	StatsJob* job;
+	const char* path;
+	const void* image; // preloaded file the worker opens instead of path
+	size_t imageSize;
+	int ncid;
+	VarStats stats;
+	int status;
+} StatsWorker;
+
+// Pulls slabs off the shared counter until the plan is exhausted
+static void reduceSlabs(StatsWorker* worker)
+{
+	StatsJob* job = worker->job;
+
+	VarInfo var = *job->var;
+	var.ncid = worker->ncid;
+
+	void* vals = malloc((size_t)job->plan.slabValues * var.typeSize);
+	if (vals == NULL)
+	{
+		worker->status = NC_ENOMEM;
+		return;
+	}
+
+	ncLock();
+	chunkCacheApply(var.ncid, var.varID, &job->cache);
+	ncUnlock();
+
+	size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+
+	while (true)
+	{
+		unsigned long long s = atomicFetchAdd(job->nextSlab, 1);
+		if (s >= job->plan.slabCount) break;
+
+		unsigned long long n = slabPlanGet(&job->plan, s, start, count);
+
+		ncLock();
+		worker->status = readSlab(&var, start, count, vals);
+		ncUnlock();
+
+		if (worker->status == NC_NOERR)
+			worker->status = reduceSlab(&var, vals, n, job->fillval, &worker->stats);
+
+		if (worker->status != NC_NOERR) break;
+
+		if (worker->stats.zones) zoneMapAdd(worker->stats.zones, &var, start, count, vals, job->fillval);
+	}
+
+	free(vals);
+}
+
+static void statsWorkerOpen(StatsWorker* worker)
+{
+
+	ncLock();
+	if (worker->image != NULL)
+		worker->status = nc_open_mem(worker->path, NC_NOWRITE, worker->imageSize, (void*)worker->image, &worker->ncid);
+	else
+		worker->status = nc_open(worker->path, NC_NOWRITE, &worker->ncid);
+	ncUnlock();
+
+	if (worker->status != NC_NOERR) return;
+
+	reduceSlabs(worker);
+
+	ncLock();
+	nc_close(worker->ncid);
+	ncUnlock();
+}
+
+// A worker process reduces its share of the slabs on its own handle and
+// sends back its status followed by its partial results
+static void statsProcMain(int index, ProcChannel* channel, void* user)
+{
+	StatsWorker* worker = &((StatsWorker*)user)[index];
+	statsWorkerOpen(worker);
+
+	unsigned char* encoded = NULL;
+	size_t size = 0;
+	if (worker->status == NC_NOERR && !varStatsEncode(&worker->stats, &encoded, &size))
+		worker->status = NC_ENOMEM;
+
+	unsigned char* message = (unsigned char*)malloc(sizeof(int) + size);
+	if (message == NULL)
+	{
+		int status = NC_ENOMEM;
+		procSend(channel, &status, sizeof(int));
+	}
+	else
+	{
+		memcpy(message, &worker->status, sizeof(int));
+		if (size > 0) memcpy(message + sizeof(int), encoded, size);
+		procSend(channel, message, sizeof(int) + size);
+	}
+
+	free(message);
+	free(encoded);
+}
+
+static void statsProcReceive(int index, const void* data, size_t size, void* user)
+{
+	StatsWorker* worker = &((StatsWorker*)user)[index];
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	if (size < sizeof(int))
+	{
+		worker->status = NC_EIO;
+		return;
+	}
+
+	memcpy(&worker->status, bytes, sizeof(int));
+	if (worker->status != NC_NOERR) return;
+
+	// the empty partial set up before the workers started is replaced by the one sent
+	VarStats part;
+	varStatsInit(&part, worker->stats.type);
+	part.unpack = worker->stats.unpack;
+	part.pack = worker->stats.pack;
+	part.zones = worker->stats.zones;
+	worker->stats.zones = NULL;
+	varStatsFree(&worker->stats);
+
+	if (!varStatsDecode(bytes + sizeof(int), size - sizeof(int), &part))
+	{
+		// what was decoded must not be merged, and an unfilled map would skip matching blocks
+		varStatsFree(&part);
+		varStatsInit(&part, worker->stats.type);
+		worker->status = NC_EIO;
+	}
+
+	worker->stats = part;
+}
+
+typedef struct PipelineSlot
+{
+	void* vals;
+	unsigned long long index; // slab in the plan
+	unsigned long long n;
+} PipelineSlot;
+
+typedef struct PipelineWorker
+{
+	StatsWorker* worker;
+	SpscRing full;       // filled buffers, reader to worker; NULL means stop
+	SpscRing empty;      // reduced buffers on their way back to the reader
+	Semaphore filled;    // one count per item pushed to full
+	Semaphore* returned; // shared by every worker, one count per buffer pushed to empty
+} PipelineWorker;
+
+static void pipelineWorkerMain(void* arg)
+{
+	PipelineWorker* pw = (PipelineWorker*)arg;
+	StatsWorker* worker = pw->worker;
+	const VarInfo* var = worker->job->var;
+
+	while (true)
+	{
+		// every count is posted after its push, so the pop cannot come up empty
+		void* item = NULL;
+		semWait(&pw->filled);
+		spscPop(&pw->full, &item);
+
+		if (item == NULL) break;
+
+		PipelineSlot* slot = (PipelineSlot*)item;
+
+		// after a failure the buffers still go back, so the reader is never left waiting
+		if (worker->status == NC_NOERR)
+			worker->status = reduceSlab(var, slot->vals, slot->n, worker->job->fillval, &worker->stats);
+
+		if (worker->stats.zones && worker->status == NC_NOERR)
+		{
+			size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+			slabPlanGet(&worker->job->plan, slot->index, start, count);
+			zoneMapAdd(worker->stats.zones, var, start, count, slot->vals, worker->job->fillval);
+		}
+
+		// the ring has room for every buffer, so the push always succeeds
+		spscPush(&pw->empty, slot);
+		semPost(pw->returned);
+	}
+}
+
+// The calling thread reads slabs in plan order into a fixed pool of buffers and
+// hands them to the reduction threads through SPSC rings, so storage latency
+// overlaps with reduction. Only the reader calls into libnetcdf. Either side
+// sleeps on a semaphore when it has nothing to do.
+static int reducePipelined(StatsJob* job, StatsWorker* workers, int nWorkers)
+{
+	int nSlots = nWorkers * PIPELINE_BUFFERS_PER_WORKER;
+	size_t slabBytes = (size_t)job->plan.slabValues * job->var->typeSize;
+
+	PipelineWorker* pws = (PipelineWorker*)calloc(nWorkers, sizeof(PipelineWorker));
+	PipelineSlot* slots = (PipelineSlot*)calloc(nSlots, sizeof(PipelineSlot));
+	PipelineSlot** idle = (PipelineSlot**)malloc(nSlots * sizeof(PipelineSlot*));
+	Thread* handles = (Thread*)malloc(nWorkers * sizeof(Thread));
+	int status = pws && slots && idle && handles ? NC_NOERR : NC_ENOMEM;
+	int nIdle = 0, started = 0, rings = 0;
+	Semaphore returned;
+	semInit(&returned, 0);
+
+	for (int i = 0; status == NC_NOERR && i < nSlots; ++i)
+	{
+		slots[i].vals = malloc(slabBytes);
+		if (slots[i].vals == NULL) status = NC_ENOMEM;
+		idle[nIdle++] = &slots[i];
+	}
+
+	for (; status == NC_NOERR && rings < nWorkers; ++rings)
+	{
+		pws[rings].worker = &workers[rings];
+		pws[rings].returned = &returned;
+		if (!spscInit(&pws[rings].full, nSlots + 1) || !spscInit(&pws[rings].empty, nSlots + 1))
+		{
+			spscFree(&pws[rings].full);
+			status = NC_ENOMEM;
+			break;
+		}
+		semInit(&pws[rings].filled, 0);
+	}
+
+	for (; status == NC_NOERR && started < nWorkers; ++started)
+	{
+		if (threadCreate(&handles[started], pipelineWorkerMain, &pws[started]) != 0)
+			break;
+	}
+
+	if (status == NC_NOERR && started == 0)
+	{
+		// no threads to hand off to
+		reduceSlabs(&workers[0]);
+		status = workers[0].status;
+	}
+	else if (status == NC_NOERR)
+	{
+		VarInfo var = *job->var;
+		size_t start[NC_MAX_VAR_DIMS], count[NC_MAX_VAR_DIMS];
+		int next = 0;
+
+		chunkCacheApply(var.ncid, var.varID, &job->cache);
+
+		for (unsigned long long s = 0; s < job->plan.slabCount; ++s)
+		{
+			// with every buffer out, sleep until a worker returns one; each count
+			// stands for a buffer sitting in one of the empty rings
+			if (nIdle == 0)
+			{
+				semWait(&returned);
+				for (int w = 0; nIdle == 0; w = (w + 1) % started)
+				{
+					void* item;
+					if (spscPop(&pws[w].empty, &item))
+						idle[nIdle++] = (PipelineSlot*)item;
+				}
+			}
+
+			PipelineSlot* slot = idle[--nIdle];
+			slot->index = s;
+			slot->n = slabPlanGet(&job->plan, s, start, count);
+
+			ncLock();
+			status = readSlab(&var, start, count, slot->vals);
+			ncUnlock();
+
+			if (status != NC_NOERR) break;
+
+			// round robin; the rings have room for every buffer and the stop marker
+			spscPush(&pws[next].full, slot);
+			semPost(&pws[next].filled);
+			next = (next + 1) % started;
+		}
+
+		for (int w = 0; w < started; ++w)
+		{
+			spscPush(&pws[w].full, NULL);
+			semPost(&pws[w].filled);
+		}
+	}
+
+	for (int i = 0; i < started; ++i)
+		threadJoin(handles[i]);
+
+	for (int i = 0; i < rings; ++i)
+	{
+		spscFree(&pws[i].full);
+		spscFree(&pws[i].empty);
+		semDestroy(&pws[i].filled);
+	}
+
+	semDestroy(&returned);
+
+	for (int i = 0; slots != NULL && i < nSlots; ++i)
+		free(slots[i].vals);
+
+	free(handles);
+	free(idle);
+	free(slots);
+	free(pws);
+
+	return status;
+}
+
+int computeVarStats(const VarInfo* var, const StatsConfig* config, VarStats* stats)
+{
+	varStatsInit(stats, var->type);
+
+	if (simdKernel(var->type) == NULL)
+		return NC_EBADTYPE;
+
+	if (!varStatsEnableSketches(stats, config->quantiles, config->histBins, 1))
+		return NC_ENOMEM;
+
+	PackInfo pack;
+	ncLock();
+	int status = getPackInfo(var->ncid, var->varID, var->type, &pack);
+	ncUnlock();
+	if (status != NC_NOERR) return status;
+
+	stats->unpack = packInfoActive(&pack);
+	stats->pack = pack;
+
+	// the identity is taken before reading, so a file that changes underneath gets a stale key
+	FileIdentity id;
+	// entries describe whole variables, so a hyperslab neither uses nor feeds the cache
+	bool cacheable = config->cacheDir != NULL && config->path != NULL && !var->subset && fileIdentityGet(config->path, &id);
+
+	unsigned long long firstRecord = 0;
+	CacheLookup lookup = cacheable ? statsCacheLoad(config->cacheDir, &id, var, config, stats, &firstRecord) : CACHE_MISS;
+
+	// the zone map comes from the same pass, so it must cover exactly the records the statistics do
+	if (config->zoneMap && cacheable)
+	{
+		ZoneMap* zones = (ZoneMap*)calloc(1, sizeof(ZoneMap));
+		if (zones == NULL) return NC_ENOMEM;
+
+		CacheLookup zoneLookup = zoneMapCacheLoad(config->cacheDir, &id, var, zones);
+		bool sameRecords = zoneLookup == lookup && (lookup != CACHE_PARTIAL || zones->dimLens[0] == firstRecord);
+
+		if (!sameRecords && lookup != CACHE_MISS)
+		{
+			// rebuild both with one full pass
+			varStatsFree(stats);
+			varStatsInit(stats, var->type);
+			if (!varStatsEnableSketches(stats, config->quantiles, config->histBins, 1))
+			{
+				zoneMapFree(zones);
+				free(zones);
+				return NC_ENOMEM;
+			}
+			stats->unpack = packInfoActive(&pack);
+			stats->pack = pack;
+			lookup = CACHE_MISS;
+			firstRecord = 0;
+		}
+
+		bool ok;
+		if (lookup == CACHE_MISS)
+		{
+			zoneMapFree(zones);
+			ok = zoneMapInit(zones, var);
+		}
+		else
+		{
+			ok = zoneMapGrow(zones, var->nDims > 0 ? var->dimLens[0] : 0);
+		}
+
+		if (!ok)
+		{
+			zoneMapFree(zones);
+			free(zones);
+			return NC_ENOMEM;
+		}
+
+		stats->zones = zones;
+	}
+
+	if (lookup == CACHE_HIT)
+	{
+		stats->cached = true;
+		return NC_NOERR;
+	}
+
+	// only the records appended since the entry was written need reading
+	VarInfo region = *var;
+	if (lookup == CACHE_PARTIAL)
+	{
+		stats->cachedRecords = firstRecord;
+		region.subset = true;
+		region.offset[0] = (size_t)firstRecord;
+		region.dimLens[0] -= (size_t)firstRecord;
+		region.valueCount = var->valueCount / var->dimLens[0] * region.dimLens[0];
+	}
+
+	long long fillStorage;
+	ncLock();
+	const void* fillval = varFillValue(var, &fillStorage);
+	ncUnlock();
+
+	int threads = config->threads > 0 ? config->threads : cpuCount();
+	if (config->path == NULL) threads = 1;
+
+	// shrink slabs when the variable is too small to give every thread several of them
+	size_t memLimit = config->memLimit;
+	if (threads > 1 || config->pipeline)
+	{
+		unsigned long long bytes = region.valueCount * var->typeSize;
+		unsigned long long share = bytes / ((unsigned long long)threads * SLABS_PER_THREAD);
+		if (share < MIN_THREAD_SLAB_BYTES) share = MIN_THREAD_SLAB_BYTES;
+		if (share < memLimit) memLimit = (size_t)share;
+	}
+
+	StatsJob job;
+	job.var = &region;
+	job.fillval = fillval;
+	unsigned long long nextSlab = 0;
+	job.nextSlab = &nextSlab;
+	slabPlanInit(&job.plan, &region, memLimit);
+	ncLock();
+	chunkCachePlan(&job.plan, config->chunkCache, &job.cache);
+	ncUnlock();
+	stats->chunkCache = job.cache;
+
+	if ((unsigned long long)threads > job.plan.slabCount)
+		threads = job.plan.slabCount > 0 ? (int)job.plan.slabCount : 1;
+
+	// worker processes pull slabs off one counter they all see
+	bool procs = !config->pipeline && threads > 1;
+	if (procs)
+	{
+		job.nextSlab = (volatile unsigned long long*)procsSharedAlloc(sizeof(unsigned long long));
+		if (job.nextSlab == NULL) return NC_ENOMEM;
+	}
+
+	StatsWorker* workers = (StatsWorker*)malloc(threads * sizeof(StatsWorker));
+	if (workers == NULL)
+	{
+		if (procs) procsSharedFree((void*)job.nextSlab, sizeof(unsigned long long));
+		return NC_ENOMEM;
+	}
+
+	bool sketched = true;
+	for (int i = 0; i < threads; ++i)
+	{
+		workers[i].job = &job;
+		workers[i].path = config->path;
+		workers[i].image = config->image;
+		workers[i].imageSize = config->imageSize;
+		workers[i].ncid = var->ncid;
+		workers[i].status = NC_NOERR;
+		varStatsInit(&workers[i].stats, var->type);
+		if (!varStatsEnableSketches(&workers[i].stats, config->quantiles, config->histBins, (unsigned)i + 2))
+			sketched = false;
+		workers[i].stats.unpack = stats->unpack;
+		workers[i].stats.pack = pack;
+
+		if (stats->zones)
+		{
+			workers[i].stats.zones = (ZoneMap*)calloc(1, sizeof(ZoneMap));
+			if (workers[i].stats.zones == NULL || !zoneMapInit(workers[i].stats.zones, var))
+				status = NC_ENOMEM;
+		}
+	}
+
+	// a map missing any worker's slabs would skip blocks that match, so go without one
+	if (status == NC_ENOMEM)
+	{
+		for (int i = 0; i < threads; ++i)
+		{
+			if (workers[i].stats.zones)
+			{
+				zoneMapFree(workers[i].stats.zones);
+				free(workers[i].stats.zones);
+				workers[i].stats.zones = NULL;
+			}
+		}
+
+		zoneMapFree(stats->zones);
+		free(stats->zones);
+		stats->zones = NULL;
+		status = NC_NOERR;
+	}
+
+	if (!sketched)
+	{
+		status = NC_ENOMEM;
+	}
+	else if (config->pipeline && job.plan.slabCount > 1)
+	{
+		status = reducePipelined(&job, workers, threads);
+	}
+	else if (threads == 1)
+	{
+		reduceSlabs(&workers[0]);
+	}
+	else
+	{
+		status = procsRun(threads, statsProcMain, workers, statsProcReceive, workers);
+	}
+
+	for (int i = 0; i < threads; ++i)
+	{
+		if (workers[i].status != NC_NOERR) status = workers[i].status;
+		if (!varStatsMerge(stats, &workers[i].stats) && status == NC_NOERR) status = NC_ENOMEM;
+		varStatsFree(&workers[i].stats);
+	}
+
+	free(workers);
+
+	if (procs) procsSharedFree((void*)job.nextSlab, sizeof(unsigned long long));
+
+	if (status == NC_NOERR && cacheable)
+	{
+		statsCacheStore(config->cacheDir, &id, var, stats);
+		if (stats->zones) zoneMapCacheStore(config->cacheDir, &id, var, stats->zones);
+	}
+
+	return status;
+}
@@ -0,0 +1,66 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "chunkcache.h"
+#include "moments.h"
+#include "simd.h"
+#include "sketch.h"
+#include "slab.h"
+#include "unpack.h"
+#include "zonemap.h"
+
+// Partial results of a reduction; partials from different slabs or threads can be merged
+typedef struct VarStats
+{
+	nc_type type;
+	unsigned long long count;      // values examined
+	unsigned long long validCount; // values that were not _FillValue
+	double min;
+	double max;
+	CompensatedSum sum;
+	Moments moments;               // mean, variance, skewness and kurtosis
+	ExactInt minExact;             // lossless extrema for NC_INT64/NC_UINT64
+	ExactInt maxExact;
+	KllSketch* sketch;             // optional, NULL unless quantiles were requested
+	Histogram* hist;               // optional, NULL unless a histogram was requested
+	bool unpack;                   // variable carries CF packing or validity attributes
+	PackInfo pack;
+	UnpackedStats physical;        // masked, unpacked values; only filled when unpack is set
+	bool cached;                   // loaded from the statistics cache rather than computed
+	unsigned long long cachedRecords; // leading records taken from the cache, the rest were read
+	ChunkCacheEstimate chunkCache; // how the HDF5 chunk cache was sized for the read
+	ZoneMap* zones;                // optional per-block extremes, built when StatsConfig.zoneMap is set
+} VarStats;
+
+typedef struct StatsConfig
+{
+	const char* path; // file the workers open their own handles on
+	size_t memLimit;  // per-thread slab buffer ceiling
+	int threads;
+	bool quantiles;   // build a KLL sketch alongside the moments
+	int histBins;     // 0 for no histogram
+	const char* cacheDir; // persistent statistics cache, NULL to always recompute
+	size_t chunkCache;    // per-variable HDF5 chunk cache bytes, 0 to size it from the access pattern
+	bool pipeline;        // one reader thread feeds the reduction threads instead of each reading its own slabs
+	const void* image;    // whole file preloaded in memory, NULL to open path from disk
+	size_t imageSize;
+	bool zoneMap;         // build and cache a zone map alongside the statistics (needs cacheDir)
+} StatsConfig;
+
+void varStatsInit(VarStats* stats, nc_type type);
+bool varStatsEnableSketches(VarStats* stats, bool quantiles, int histBins, unsigned seed);
+void varStatsFree(VarStats* stats);
+// false when the merged sketch ran out of memory
+bool varStatsMerge(VarStats* dst, const VarStats* src);
+void varStatsAddResult(VarStats* stats, const MinMaxSum* part);
+double varStatsSum(const VarStats* stats);
+
+// The variable's _FillValue read into storage, or NULL when it has none of its own type
+const void* varFillValue(const VarInfo* var, long long* storage);
+
+// NC_NOERR, NC_EBADTYPE for a type without a kernel or NC_ENOMEM when a sketch cannot grow
+int reduceSlab(const VarInfo* var, const void* vals, unsigned long long n, const void* fillval, VarStats* stats);
+
+int computeVarStats(const VarInfo* var, const StatsConfig* config, VarStats* stats);
+
+#endif
@@ -0,0 +1,248 @@
+#include "threads.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <time.h>
+#endif
+
+typedef struct ThreadStart
+{
+	ThreadFunc func;
+	void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI threadTrampoline(LPVOID param)
+#else
+static void* threadTrampoline(void* param)
+#endif
+{
+	ThreadStart start = *(ThreadStart*)param;
+	free(param);
+
+	start.func(start.arg);
+
+	return 0;
+}
+
+int threadCreate(Thread* thread, ThreadFunc func, void* arg)
+{
+	ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+	if (start == NULL) return -1;
+
+	start->func = func;
+	start->arg = arg;
+
+#ifdef _WIN32
+	*thread = CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+	if (*thread == NULL)
+#else
+	if (pthread_create(thread, NULL, threadTrampoline, start) != 0)
+#endif
+	{
+		free(start);
+		return -1;
+	}
+
+	return 0;
+}
+
+void threadJoin(Thread thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, NULL);
+#endif
+}
+
+void mutexInit(Mutex* mutex)
+{
+#ifdef _WIN32
+	InitializeSRWLock(mutex);
+#else
+	pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutexDestroy(Mutex* mutex)
+{
+#ifndef _WIN32
+	pthread_mutex_destroy(mutex);
+#endif
+}
+
+void mutexLock(Mutex* mutex)
+{
+#ifdef _WIN32
+	AcquireSRWLockExclusive(mutex);
+#else
+	pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutexUnlock(Mutex* mutex)
+{
+#ifdef _WIN32
+	ReleaseSRWLockExclusive(mutex);
+#else
+	pthread_mutex_unlock(mutex);
+#endif
+}
+
+void semInit(Semaphore* sem, unsigned long long count)
+{
+	mutexInit(&sem->mutex);
+#ifdef _WIN32
+	InitializeConditionVariable(&sem->cond);
+#else
+	pthread_cond_init(&sem->cond, NULL);
+#endif
+	sem->count = count;
+}
+
+void semDestroy(Semaphore* sem)
+{
+#ifndef _WIN32
+	pthread_cond_destroy(&sem->cond);
+#endif
+	mutexDestroy(&sem->mutex);
+}
+
+void semPost(Semaphore* sem)
+{
+	mutexLock(&sem->mutex);
+	++sem->count;
+	mutexUnlock(&sem->mutex);
+
+#ifdef _WIN32
+	WakeConditionVariable(&sem->cond);
+#else
+	pthread_cond_signal(&sem->cond);
+#endif
+}
+
+void semWait(Semaphore* sem)
+{
+	mutexLock(&sem->mutex);
+
+	while (sem->count == 0)
+	{
+#ifdef _WIN32
+		SleepConditionVariableSRW(&sem->cond, &sem->mutex, INFINITE, 0);
+#else
+		pthread_cond_wait(&sem->cond, &sem->mutex);
+#endif
+	}
+
+	--sem->count;
+	mutexUnlock(&sem->mutex);
+}
+
+unsigned long long atomicFetchAdd(volatile unsigned long long* value, unsigned long long amount)
+{
+#ifdef _WIN32
+	return (unsigned long long)InterlockedExchangeAdd64((volatile LONGLONG*)value, (LONGLONG)amount);
+#else
+	return __sync_fetch_and_add(value, amount);
+#endif
+}
+
+unsigned long long atomicLoad(volatile unsigned long long* value)
+{
+#ifdef _WIN32
+	return (unsigned long long)InterlockedCompareExchange64((volatile LONGLONG*)value, 0, 0);
+#else
+	return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+void atomicStore(volatile unsigned long long* value, unsigned long long amount)
+{
+#ifdef _WIN32
+	InterlockedExchange64((volatile LONGLONG*)value, (LONGLONG)amount);
+#else
+	__atomic_store_n(value, amount, __ATOMIC_RELEASE);
+#endif
+}
+
+int cpuCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+double wallClock(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+bool spscInit(SpscRing* ring, size_t capacity)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size *= 2;
+
+	ring->items = (void**)malloc(size * sizeof(void*));
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+
+	return ring->items != NULL;
+}
+
+void spscFree(SpscRing* ring)
+{
+	free(ring->items);
+	ring->items = NULL;
+}
+
+bool spscPush(SpscRing* ring, void* item)
+{
+	unsigned long long tail = ring->tail;
+	if (tail - atomicLoad(&ring->head) > ring->mask) return false;
+
+	ring->items[tail & ring->mask] = item;
+	atomicStore(&ring->tail, tail + 1);
+	return true;
+}
+
+bool spscPop(SpscRing* ring, void** item)
+{
+	unsigned long long head = ring->head;
+	if (head == atomicLoad(&ring->tail)) return false;
+
+	*item = ring->items[head & ring->mask];
+	atomicStore(&ring->head, head + 1);
+	return true;
+}
+
+static Mutex ncMutex = MUTEX_INITIALIZER;
+
+void ncLock(void)
+{
+	mutexLock(&ncMutex);
+}
+
+void ncUnlock(void)
+{
+	mutexUnlock(&ncMutex);
+}
@@ -0,0 +1,77 @@
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE Thread;
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#define MUTEX_INITIALIZER SRWLOCK_INIT
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#define MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#endif
+
+typedef void (*ThreadFunc)(void* arg);
+
+int threadCreate(Thread* thread, ThreadFunc func, void* arg);
+void threadJoin(Thread thread);
+
+void mutexInit(Mutex* mutex);
+void mutexDestroy(Mutex* mutex);
+void mutexLock(Mutex* mutex);
+void mutexUnlock(Mutex* mutex);
+
+// Counting semaphore, so a thread with nothing to do sleeps instead of spinning
+typedef struct Semaphore
+{
+	Mutex mutex;
+	CondVar cond;
+	unsigned long long count;
+} Semaphore;
+
+void semInit(Semaphore* sem, unsigned long long count);
+void semDestroy(Semaphore* sem);
+void semPost(Semaphore* sem);
+void semWait(Semaphore* sem); // blocks until the count is positive, then takes one
+
+// returns the value before the addition
+unsigned long long atomicFetchAdd(volatile unsigned long long* value, unsigned long long amount);
+unsigned long long atomicLoad(volatile unsigned long long* value);              // acquire
+void atomicStore(volatile unsigned long long* value, unsigned long long amount); // release
+
+int cpuCount(void);
+double wallClock(void); // monotonic seconds from an arbitrary origin
+
+// Bounded lock-free queue for exactly one producer thread and one consumer
+// thread. head and tail sit on separate cache lines so the two sides do not
+// fight over one line.
+typedef struct SpscRing
+{
+	void** items;
+	unsigned long long mask;              // capacity - 1, capacity a power of two
+	char pad0[64];
+	volatile unsigned long long head;     // next slot to pop, written by the consumer
+	char pad1[64];
+	volatile unsigned long long tail;     // next slot to push, written by the producer
+	char pad2[64];
+} SpscRing;
+
+bool spscInit(SpscRing* ring, size_t capacity);
+void spscFree(SpscRing* ring);
+bool spscPush(SpscRing* ring, void* item); // false when full
+bool spscPop(SpscRing* ring, void** item); // false when empty
+
+// libnetcdf (and the HDF5 it is built on) keeps global state, so every call
+// into it must be serialised. Threads share one lock; work that reads and
+// inflates in parallel runs in worker processes instead (see procs.h).
+void ncLock(void);
+void ncUnlock(void);
+
+#endif
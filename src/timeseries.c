@@ -0,0 +1,389 @@
+#include "timeseries.h"
+#include "coords.h"
+#include "selection.h"
+#include "threads.h"
+#include "unpack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// A point and the chunk tile it falls in, for sorting points into groups
+typedef struct TiledPoint
+{
+	unsigned long long tile;
+	int point;
+} TiledPoint;
+
+// Points read as one block: the box spanning them within their tile
+typedef struct PointGroup
+{
+	int first; // into the sorted order
+	int count;
+	size_t low[NC_MAX_VAR_DIMS];
+	size_t high[NC_MAX_VAR_DIMS];
+	unsigned long long boxValues; // per record
+} PointGroup;
+
+static int compareTiles(const void* a, const void* b)
+{
+	const TiledPoint* x = (const TiledPoint*)a;
+	const TiledPoint* y = (const TiledPoint*)b;
+
+	if (x->tile != y->tile) return x->tile < y->tile ? -1 : 1;
+	return x->point - y->point;
+}
+
+static bool parsePoint(const VarInfo* var, const char* spec, SeriesPoint* point, char* error, size_t errorLen)
+{
+	VarInfo view = *var;
+	bool ok = true;
+
+	if (strncmp(spec, "where ", 6) == 0)
+		ok = coordSelectionApply(&view, spec + 6, false, error, errorLen);
+	else if (spec[0] != '\0')
+		ok = selectionApply(&view, spec, false, error, errorLen);
+
+	if (!ok) return false;
+
+	if (view.dimLens[0] != var->dimLens[0] || view.offset[0] != var->offset[0] || view.step[0] != var->step[0])
+	{
+		snprintf(error, errorLen, "point %s selects along the leading dimension; every point shares its records", spec);
+		return false;
+	}
+
+	for (int d = 1; d < var->nDims; ++d)
+	{
+		if (view.dimLens[d] != 1)
+		{
+			char name[NC_MAX_NAME + 1];
+			if (nc_inq_dimname(var->ncid, var->dimIDs[d], name) != NC_NOERR) snprintf(name, sizeof(name), "%d", var->dimIDs[d]);
+			snprintf(error, errorLen, "point %s leaves %zu indices of dimension %s; give a single index", spec, view.dimLens[d], name);
+			return false;
+		}
+
+		point->index[d] = view.offset[d];
+	}
+
+	point->index[0] = 0;
+	return true;
+}
+
+bool seriesParsePoints(const VarInfo* var, const char* text, SeriesPoint** points, int* nPoints, char* error, size_t errorLen)
+{
+	*points = NULL;
+	*nPoints = 0;
+
+	if (var->nDims == 0)
+	{
+		snprintf(error, errorLen, "variable %s has no dimensions", var->name);
+		return false;
+	}
+
+	size_t len = strlen(text);
+	char* copy = (char*)malloc(len + 1);
+	SeriesPoint* list = (SeriesPoint*)malloc((len / 2 + 1) * sizeof(SeriesPoint));
+
+	if (copy == NULL || list == NULL)
+	{
+		free(copy);
+		free(list);
+		snprintf(error, errorLen, "out of memory");
+		return false;
+	}
+
+	memcpy(copy, text, len + 1);
+
+	int n = 0;
+	bool ok = true;
+	char* spec = copy;
+
+	while (ok && spec != NULL)
+	{
+		char* next = strchr(spec, ';');
+		if (next) *next++ = '\0';
+
+		while (*spec == ' ' || *spec == '\t') ++spec;
+		size_t specLen = strlen(spec);
+		while (specLen > 0 && (spec[specLen - 1] == ' ' || spec[specLen - 1] == '\t'))
+			spec[--specLen] = '\0';
+
+		// stray separators are skipped, but a lone empty spec is the single point of a 1D variable
+		if (spec[0] != '\0' || (n == 0 && next == NULL))
+			ok = parsePoint(var, spec, &list[n++], error, errorLen);
+
+		spec = next;
+	}
+
+	free(copy);
+
+	if (!ok)
+	{
+		free(list);
+		return false;
+	}
+
+	*points = list;
+	*nPoints = n;
+	return true;
+}
+
+static double physicalValue(double x, const double* fill, const PackInfo* pack)
+{
+	if ((fill && x == *fill) || x != x) return NAN;
+
+	if (pack->masked)
+	{
+		if (x < pack->validMin || x > pack->validMax) return NAN;
+		for (int i = 0; i < pack->nMissing; ++i)
+			if (x == pack->missing[i]) return NAN;
+	}
+
+	return pack->packed ? x * pack->scale + pack->offset : x;
+}
+
+// Sorts the points by chunk tile and boxes each tile's points. Contiguous
+// variables have no tiles worth sharing, so each distinct point is its own group.
+static int groupPoints(const VarInfo* var, const size_t* fileLens, const SeriesPoint* points, int nPoints, TiledPoint* order, PointGroup* groups)
+{
+	for (int i = 0; i < nPoints; ++i)
+	{
+		unsigned long long tile = 0;
+
+		for (int d = 1; d < var->nDims; ++d)
+		{
+			size_t block = var->chunked && var->chunkLens[d] > 0 ? var->chunkLens[d] : 1;
+			tile = tile * ((fileLens[d] + block - 1) / block) + points[i].index[d] / block;
+		}
+
+		order[i].tile = tile;
+		order[i].point = i;
+	}
+
+	qsort(order, (size_t)nPoints, sizeof(TiledPoint), compareTiles);
+
+	int nGroups = 0;
+
+	for (int i = 0; i < nPoints; ++i)
+	{
+		const SeriesPoint* p = &points[order[i].point];
+
+		if (i == 0 || order[i].tile != order[i - 1].tile)
+		{
+			PointGroup* g = &groups[nGroups++];
+			g->first = i;
+			g->count = 0;
+			for (int d = 1; d < var->nDims; ++d)
+				g->low[d] = g->high[d] = p->index[d];
+		}
+
+		PointGroup* g = &groups[nGroups - 1];
+		++g->count;
+
+		for (int d = 1; d < var->nDims; ++d)
+		{
+			if (p->index[d] < g->low[d]) g->low[d] = p->index[d];
+			if (p->index[d] > g->high[d]) g->high[d] = p->index[d];
+		}
+	}
+
+	for (int i = 0; i < nGroups; ++i)
+	{
+		groups[i].boxValues = 1;
+		for (int d = 1; d < var->nDims; ++d)
+			groups[i].boxValues *= groups[i].high[d] - groups[i].low[d] + 1;
+	}
+
+	return nGroups;
+}
+
+static void writeHeader(FILE* out, const VarInfo* var, const SeriesPoint* points, int nPoints, bool haveAxis)
+{
+	char name[NC_MAX_NAME + 1];
+	if (nc_inq_dimname(var->ncid, var->dimIDs[0], name) != NC_NOERR) snprintf(name, sizeof(name), "record");
+
+	fprintf(out, "%s_index", name);
+	if (haveAxis) fprintf(out, ",%s", name);
+
+	for (int i = 0; i < nPoints; ++i)
+	{
+		fprintf(out, ",\"");
+		for (int d = 1; d < var->nDims; ++d)
+		{
+			if (nc_inq_dimname(var->ncid, var->dimIDs[d], name) != NC_NOERR) snprintf(name, sizeof(name), "%d", var->dimIDs[d]);
+			fprintf(out, "%s%s=%zu", d > 1 ? "," : "", name, points[i].index[d]);
+		}
+		if (var->nDims == 1) fprintf(out, "%s", var->name);
+		fprintf(out, "\"");
+	}
+
+	fprintf(out, "\n");
+}
+
+int extractSeries(const VarInfo* var, const SeriesPoint* points, int nPoints, const char* outPath, bool raw, size_t memLimit, SeriesResult* result)
+{
+	memset(result, 0, sizeof(SeriesResult));
+	double began = wallClock();
+
+	if (var->nDims == 0 || nPoints <= 0) return NC_EINVAL;
+
+	// blocks are read in file coordinates, whatever var's selection is
+	VarInfo whole;
+	int status = getVarInfo(var->ncid, var->varID, &whole);
+	if (status != NC_NOERR) return status;
+
+	PackInfo pack;
+	status = getPackInfo(var->ncid, var->varID, var->type, &pack);
+	if (status != NC_NOERR) return status;
+
+	double fillStorage;
+	const double* fill = nc_get_att_double(var->ncid, var->varID, "_FillValue", &fillStorage) == NC_NOERR ? &fillStorage : NULL;
+
+	TiledPoint* order = (TiledPoint*)malloc((size_t)nPoints * sizeof(TiledPoint));
+	PointGroup* groups = (PointGroup*)malloc((size_t)nPoints * sizeof(PointGroup));
+
+	if (order == NULL || groups == NULL)
+	{
+		free(order);
+		free(groups);
+		return NC_ENOMEM;
+	}
+
+	int nGroups = groupPoints(var, whole.dimLens, points, nPoints, order, groups);
+
+	unsigned long long maxBox = 1;
+	for (int g = 0; g < nGroups; ++g)
+		if (groups[g].boxValues > maxBox) maxBox = groups[g].boxValues;
+
+	// runs of records span whole leading chunks, as many as the memory ceiling allows
+	size_t records = var->dimLens[0];
+	size_t step = (size_t)var->step[0];
+	size_t chunk = var->chunked && var->chunkLens[0] > 0 ? var->chunkLens[0] : 1;
+	size_t chunksPerRun = (size_t)(memLimit / ((unsigned long long)chunk * maxBox * sizeof(double)));
+	if (chunksPerRun == 0) chunksPerRun = 1;
+
+	size_t runFile = chunk * chunksPerRun;
+	size_t runRecords = runFile / step + 1;
+	if (runRecords > records) runRecords = records;
+
+	double* vals = (double*)malloc((size_t)(runRecords * maxBox) * sizeof(double));
+	double* rows = (double*)malloc(runRecords * (size_t)nPoints * sizeof(double));
+	FILE* out = fopen(outPath, raw ? "wb" : "w");
+
+	if (vals == NULL || rows == NULL || out == NULL)
+	{
+		status = out == NULL ? NC_ECANTCREATE : NC_ENOMEM;
+		if (out) fclose(out);
+		free(vals);
+		free(rows);
+		free(order);
+		free(groups);
+		return status;
+	}
+
+	setvbuf(out, NULL, _IOFBF, 1 << 20);
+
+	int axisStatus;
+	const CoordAxis* axis = coordAxisGet(var->ncid, var->dimIDs[0], &axisStatus);
+
+	if (!raw) writeHeader(out, var, points, nPoints, axis != NULL);
+
+	size_t start[NC_MAX_VAR_DIMS] = { 0 };
+	size_t count[NC_MAX_VAR_DIMS];
+
+	for (size_t first = 0; first < records && status == NC_NOERR; )
+	{
+		// end the run where its file indices cross into the next run of chunks
+		size_t fileFirst = var->offset[0] + first * step;
+		size_t boundary = (fileFirst / runFile + 1) * runFile;
+		size_t last = (boundary - var->offset[0] + step - 1) / step;
+		if (last > records) last = records;
+		if (last - first > runRecords) last = first + runRecords;
+
+		size_t n = last - first;
+
+		for (int g = 0; g < nGroups && status == NC_NOERR; ++g)
+		{
+			const PointGroup* group = &groups[g];
+
+			VarInfo box = whole;
+			box.subset = true;
+			box.offset[0] = fileFirst;
+			box.step[0] = (ptrdiff_t)step;
+			count[0] = n;
+
+			for (int d = 1; d < var->nDims; ++d)
+			{
+				box.offset[d] = group->low[d];
+				box.step[d] = 1;
+				count[d] = group->high[d] - group->low[d] + 1;
+			}
+
+			status = readSlabDouble(&box, start, count, vals);
+			++result->reads;
+
+			for (int i = 0; status == NC_NOERR && i < group->count; ++i)
+			{
+				int p = order[group->first + i].point;
+
+				unsigned long long at = 0;
+				for (int d = 1; d < var->nDims; ++d)
+					at = at * count[d] + (points[p].index[d] - group->low[d]);
+
+				for (size_t r = 0; r < n; ++r)
+					rows[r * nPoints + p] = physicalValue(vals[r * group->boxValues + at], fill, &pack);
+			}
+		}
+
+		if (status != NC_NOERR) break;
+
+		if (raw)
+		{
+			if (fwrite(rows, sizeof(double), n * nPoints, out) != n * nPoints)
+				status = NC_ECANTWRITE;
+		}
+		else
+		{
+			const char* format = var->type == NC_FLOAT && !pack.packed ? ",%.9g" : ",%.17g";
+
+			for (size_t r = 0; r < n; ++r)
+			{
+				size_t fileIndex = var->offset[0] + (first + r) * step;
+				fprintf(out, "%zu", fileIndex);
+
+				if (axis != NULL)
+				{
+					if (fileIndex < axis->len) fprintf(out, ",%.17g", axis->values[fileIndex]);
+					else fprintf(out, ",");
+				}
+
+				// fill and masked values are left empty
+				for (int p = 0; p < nPoints; ++p)
+				{
+					double x = rows[r * nPoints + p];
+					if (x != x) fprintf(out, ",");
+					else fprintf(out, format, x);
+				}
+
+				fprintf(out, "\n");
+			}
+		}
+
+		first = last;
+	}
+
+	if (fclose(out) != 0 && status == NC_NOERR)
+		status = NC_ECANTWRITE;
+
+	free(vals);
+	free(rows);
+	free(order);
+	free(groups);
+
+	result->records = records;
+	result->groups = nGroups;
+	result->seconds = wallClock() - began;
+
+	return status;
+}
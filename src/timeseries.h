@@ -0,0 +1,34 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include "slab.h"
+
+// One grid point: a file index along every dimension but the leading one
+typedef struct SeriesPoint
+{
+	size_t index[NC_MAX_VAR_DIMS]; // index[0] is unused
+} SeriesPoint;
+
+typedef struct SeriesResult
+{
+	size_t records;
+	int groups;               // points sharing a chunk tile are read together
+	unsigned long long reads; // hyperslab reads issued
+	double seconds;
+} SeriesResult;
+
+// Parses points separated by ';', each a selection (dim=index,...) or, after
+// "where ", coordinate values (dim=value,... for the nearest cell), relative
+// to var's current selection. Every dimension but the leading one must come
+// down to a single index. Returns false with a message in error otherwise.
+bool seriesParsePoints(const VarInfo* var, const char* text, SeriesPoint** points, int* nPoints, char* error, size_t errorLen);
+
+// Writes the values of each point at every record of var's selection along its
+// leading dimension, unpacked to physical units with fill and masked values as
+// NaN. CSV has one row per record (index, coordinate value when there is one,
+// then a column per point); raw is native-endian doubles, record-major. Points
+// in the same chunk tile are read as one block per run of chunks, so every
+// chunk is inflated once however many points fall in it.
+int extractSeries(const VarInfo* var, const SeriesPoint* points, int nPoints, const char* outPath, bool raw, size_t memLimit, SeriesResult* result);
+
+#endif
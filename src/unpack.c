@@ -0,0 +1,447 @@
+#include "unpack.h"
+#include "simd.h"
+
+#include <string.h>
+#include <math.h>
+
+// running state of one fused pass: count, extrema and power sums around the shift
+typedef struct UnpackAcc
+{
+	double count;
+	double min;
+	double max;
+	double s1;
+	double s2;
+	double s3;
+	double s4;
+} UnpackAcc;
+
+typedef void (*UnpackKernel)(const void* vals, size_t n, const void* fill, const PackInfo* pack, double shift, UnpackAcc* acc);
+
+// Reads a numeric attribute of up to maxLen values as double
+static bool getDoubleAtt(int ncid, int varID, const char* name, double* out, size_t maxLen, size_t* len, nc_type* type)
+{
+	if (nc_inq_att(ncid, varID, name, type, len) != NC_NOERR) return false;
+	if (*type == NC_CHAR || *type == NC_STRING || *type > NC_MAX_ATOMIC_TYPE) return false;
+	if (*len == 0 || *len > maxLen) return false;
+
+	return nc_get_att_double(ncid, varID, name, out) == NC_NOERR;
+}
+
+int getPackInfo(int ncid, int varID, nc_type type, PackInfo* info)
+{
+	memset(info, 0, sizeof(PackInfo));
+	info->scale = 1.0;
+	info->offset = 0.0;
+	info->validMin = NC_MIN_DOUBLE;
+	info->validMax = NC_MAX_DOUBLE;
+
+	double vals[PACK_MAX_MISSING];
+	size_t len;
+	nc_type attType, packType = type;
+
+	if (getDoubleAtt(ncid, varID, "scale_factor", vals, 1, &len, &attType))
+	{
+		info->scale = vals[0];
+		info->packed = true;
+		packType = attType;
+	}
+
+	if (getDoubleAtt(ncid, varID, "add_offset", vals, 1, &len, &attType))
+	{
+		info->offset = vals[0];
+		info->packed = true;
+		packType = attType;
+	}
+
+	nc_type rangeType = type;
+	bool hasRange = false;
+
+	if (getDoubleAtt(ncid, varID, "valid_range", vals, 2, &len, &attType) && len == 2)
+	{
+		info->validMin = vals[0];
+		info->validMax = vals[1];
+		rangeType = attType;
+		hasRange = true;
+	}
+	else
+	{
+		if (getDoubleAtt(ncid, varID, "valid_min", vals, 1, &len, &attType))
+		{
+			info->validMin = vals[0];
+			rangeType = attType;
+			hasRange = true;
+		}
+
+		if (getDoubleAtt(ncid, varID, "valid_max", vals, 1, &len, &attType))
+		{
+			info->validMax = vals[0];
+			rangeType = attType;
+			hasRange = true;
+		}
+	}
+
+	// a range stored in the unpacked type rather than the packed one is in physical units
+	if (hasRange && info->packed && rangeType != type && rangeType == packType && info->scale != 0.0)
+	{
+		bool hasMin = info->validMin != NC_MIN_DOUBLE, hasMax = info->validMax != NC_MAX_DOUBLE;
+		double lo = (info->validMin - info->offset) / info->scale;
+		double hi = (info->validMax - info->offset) / info->scale;
+
+		// a negative scale flips which bound is which
+		if (info->scale < 0.0)
+		{
+			info->validMin = hasMax ? hi : NC_MIN_DOUBLE;
+			info->validMax = hasMin ? lo : NC_MAX_DOUBLE;
+		}
+		else
+		{
+			info->validMin = hasMin ? lo : NC_MIN_DOUBLE;
+			info->validMax = hasMax ? hi : NC_MAX_DOUBLE;
+		}
+	}
+
+	if (getDoubleAtt(ncid, varID, "missing_value", info->missing, PACK_MAX_MISSING, &len, &attType))
+		info->nMissing = (int)len;
+
+	info->masked = hasRange || info->nMissing > 0;
+
+	return NC_NOERR;
+}
+
+bool packInfoActive(const PackInfo* info)
+{
+	return info->packed || info->masked;
+}
+
+void unpackedStatsInit(UnpackedStats* stats)
+{
+	stats->valid = 0;
+	stats->min = NC_MAX_DOUBLE;
+	stats->max = NC_MIN_DOUBLE;
+	stats->sum.sum = 0.0;
+	stats->sum.comp = 0.0;
+	momentsInit(&stats->moments);
+}
+
+void unpackedStatsMerge(UnpackedStats* dst, const UnpackedStats* src)
+{
+	if (src->valid == 0) return;
+
+	if (src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+	compensatedAdd(&dst->sum, src->sum.sum);
+	compensatedAdd(&dst->sum, src->sum.comp);
+	momentsMerge(&dst->moments, &src->moments);
+	dst->valid += src->valid;
+}
+
+static void accInit(UnpackAcc* acc)
+{
+	memset(acc, 0, sizeof(UnpackAcc));
+	acc->min = NC_MAX_DOUBLE;
+	acc->max = NC_MIN_DOUBLE;
+}
+
+/* ---------------------------------------------------------------------------
+ * Scalar kernels. The fill value is compared in the native type like the raw
+ * kernels; the CF masks are compared as double.
+ * ------------------------------------------------------------------------- */
+
+#define DEFINE_UNPACK_SCALAR(NAME, T) \
+static void NAME(const void* data, size_t n, const void* fill, const PackInfo* pack, double shift, UnpackAcc* acc) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)fill : (T)0; \
+	\
+	for (size_t i = 0; i < n; ++i) \
+	{ \
+		if (hasFill && vals[i] == fillVal) continue; \
+		\
+		double x = (double)vals[i]; \
+		if (!(x >= pack->validMin && x <= pack->validMax)) continue; \
+		\
+		bool missing = false; \
+		for (int m = 0; m < pack->nMissing; ++m) \
+			missing |= x == pack->missing[m]; \
+		if (missing) continue; \
+		\
+		double y = x * pack->scale + pack->offset; \
+		double d = y - shift; \
+		double d2 = d * d; \
+		if (y < acc->min) acc->min = y; \
+		if (y > acc->max) acc->max = y; \
+		acc->count += 1.0; \
+		acc->s1 += d; \
+		acc->s2 += d2; \
+		acc->s3 += d2 * d; \
+		acc->s4 += d2 * d2; \
+	} \
+}
+
+DEFINE_UNPACK_SCALAR(unpackByteScalar, signed char)
+DEFINE_UNPACK_SCALAR(unpackUByteScalar, unsigned char)
+DEFINE_UNPACK_SCALAR(unpackShortScalar, short)
+DEFINE_UNPACK_SCALAR(unpackUShortScalar, unsigned short)
+DEFINE_UNPACK_SCALAR(unpackIntScalar, int)
+DEFINE_UNPACK_SCALAR(unpackUIntScalar, unsigned int)
+DEFINE_UNPACK_SCALAR(unpackInt64Scalar, long long)
+DEFINE_UNPACK_SCALAR(unpackUInt64Scalar, unsigned long long)
+DEFINE_UNPACK_SCALAR(unpackFloatScalar, float)
+DEFINE_UNPACK_SCALAR(unpackDoubleScalar, double)
+
+#ifdef SIMD_X86
+
+/* ---------------------------------------------------------------------------
+ * AVX2 kernels: four values are widened to double per step, masked, unpacked
+ * and folded into the extrema and power sums without leaving registers.
+ * ------------------------------------------------------------------------- */
+
+SIMD_TARGET("avx2")
+static __m256d loadByte4(const signed char* p)
+{
+	int bytes;
+	memcpy(&bytes, p, sizeof(int));
+	return _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(bytes)));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadUByte4(const unsigned char* p)
+{
+	int bytes;
+	memcpy(&bytes, p, sizeof(int));
+	return _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadShort4(const short* p)
+{
+	return _mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadUShort4(const unsigned short* p)
+{
+	return _mm256_cvtepi32_pd(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)p)));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadInt4(const int* p)
+{
+	return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)p));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadFloat4(const float* p)
+{
+	return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+SIMD_TARGET("avx2")
+static __m256d loadDouble4(const double* p)
+{
+	return _mm256_loadu_pd(p);
+}
+
+SIMD_TARGET("avx2")
+static double horizontalSum(__m256d v)
+{
+	double lanes[4];
+	_mm256_storeu_pd(lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#define DEFINE_UNPACK_AVX2(NAME, T, LOAD4, SCALAR) \
+SIMD_TARGET("avx2") \
+static void NAME(const void* data, size_t n, const void* fill, const PackInfo* pack, double shift, UnpackAcc* acc) \
+{ \
+	const T* vals = (const T*)data; \
+	const __m256d vfill = _mm256_set1_pd(fill ? (double)*(const T*)fill : 0.0); \
+	const __m256d noFill = _mm256_castsi256_pd(_mm256_set1_epi64x(fill ? 0 : -1)); \
+	const __m256d lo = _mm256_set1_pd(pack->validMin); \
+	const __m256d hi = _mm256_set1_pd(pack->validMax); \
+	const __m256d scale = _mm256_set1_pd(pack->scale); \
+	const __m256d offset = _mm256_set1_pd(pack->offset); \
+	const __m256d vshift = _mm256_set1_pd(shift); \
+	const __m256d big = _mm256_set1_pd(NC_MAX_DOUBLE); \
+	const __m256d small = _mm256_set1_pd(NC_MIN_DOUBLE); \
+	const __m256d one = _mm256_set1_pd(1.0); \
+	__m256d vmin = big, vmax = small, c = _mm256_setzero_pd(); \
+	__m256d s1 = _mm256_setzero_pd(), s2 = _mm256_setzero_pd(); \
+	__m256d s3 = _mm256_setzero_pd(), s4 = _mm256_setzero_pd(); \
+	size_t i = 0; \
+	\
+	for (; i + 4 <= n; i += 4) \
+	{ \
+		__m256d x = LOAD4(vals + i); \
+		\
+		/* ordered compares, so NaN lanes drop out with the range test */ \
+		__m256d ok = _mm256_and_pd(_mm256_cmp_pd(x, lo, _CMP_GE_OQ), _mm256_cmp_pd(x, hi, _CMP_LE_OQ)); \
+		ok = _mm256_and_pd(ok, _mm256_or_pd(_mm256_cmp_pd(x, vfill, _CMP_NEQ_UQ), noFill)); \
+		for (int m = 0; m < pack->nMissing; ++m) \
+			ok = _mm256_and_pd(ok, _mm256_cmp_pd(x, _mm256_set1_pd(pack->missing[m]), _CMP_NEQ_UQ)); \
+		\
+		__m256d y = _mm256_add_pd(_mm256_mul_pd(x, scale), offset); \
+		vmin = _mm256_min_pd(_mm256_blendv_pd(big, y, ok), vmin); \
+		vmax = _mm256_max_pd(_mm256_blendv_pd(small, y, ok), vmax); \
+		\
+		__m256d d = _mm256_and_pd(ok, _mm256_sub_pd(y, vshift)); \
+		__m256d d2 = _mm256_mul_pd(d, d); \
+		c = _mm256_add_pd(c, _mm256_and_pd(ok, one)); \
+		s1 = _mm256_add_pd(s1, d); \
+		s2 = _mm256_add_pd(s2, d2); \
+		s3 = _mm256_add_pd(s3, _mm256_mul_pd(d2, d)); \
+		s4 = _mm256_add_pd(s4, _mm256_mul_pd(d2, d2)); \
+	} \
+	\
+	double mins[4], maxs[4]; \
+	_mm256_storeu_pd(mins, vmin); \
+	_mm256_storeu_pd(maxs, vmax); \
+	for (int j = 0; j < 4; ++j) \
+	{ \
+		if (mins[j] < acc->min) acc->min = mins[j]; \
+		if (maxs[j] > acc->max) acc->max = maxs[j]; \
+	} \
+	acc->count += horizontalSum(c); \
+	acc->s1 += horizontalSum(s1); \
+	acc->s2 += horizontalSum(s2); \
+	acc->s3 += horizontalSum(s3); \
+	acc->s4 += horizontalSum(s4); \
+	\
+	SCALAR(vals + i, n - i, fill, pack, shift, acc); \
+}
+
+DEFINE_UNPACK_AVX2(unpackByteAVX2, signed char, loadByte4, unpackByteScalar)
+DEFINE_UNPACK_AVX2(unpackUByteAVX2, unsigned char, loadUByte4, unpackUByteScalar)
+DEFINE_UNPACK_AVX2(unpackShortAVX2, short, loadShort4, unpackShortScalar)
+DEFINE_UNPACK_AVX2(unpackUShortAVX2, unsigned short, loadUShort4, unpackUShortScalar)
+DEFINE_UNPACK_AVX2(unpackIntAVX2, int, loadInt4, unpackIntScalar)
+DEFINE_UNPACK_AVX2(unpackFloatAVX2, float, loadFloat4, unpackFloatScalar)
+DEFINE_UNPACK_AVX2(unpackDoubleAVX2, double, loadDouble4, unpackDoubleScalar)
+
+#endif // SIMD_X86
+
+static UnpackKernel unpackKernel(nc_type type)
+{
+#ifdef SIMD_X86
+	if (simdGetLevel() >= SIMD_AVX2)
+	{
+		switch (type)
+		{
+		case NC_BYTE: return unpackByteAVX2;
+		case NC_UBYTE: return unpackUByteAVX2;
+		case NC_SHORT: return unpackShortAVX2;
+		case NC_USHORT: return unpackUShortAVX2;
+		case NC_INT: return unpackIntAVX2;
+		case NC_FLOAT: return unpackFloatAVX2;
+		case NC_DOUBLE: return unpackDoubleAVX2;
+		default: break;
+		}
+	}
+#endif
+
+	switch (type)
+	{
+	case NC_BYTE: return unpackByteScalar;
+	case NC_UBYTE: return unpackUByteScalar;
+	case NC_SHORT: return unpackShortScalar;
+	case NC_USHORT: return unpackUShortScalar;
+	case NC_INT: return unpackIntScalar;
+	case NC_UINT: return unpackUIntScalar;
+	case NC_INT64: return unpackInt64Scalar;
+	case NC_UINT64: return unpackUInt64Scalar;
+	case NC_FLOAT: return unpackFloatScalar;
+	case NC_DOUBLE: return unpackDoubleScalar;
+	default: return NULL;
+	}
+}
+
+bool unpackReduce(nc_type type, const void* vals, size_t n, const void* fill, const PackInfo* pack, double shift, UnpackedStats* stats)
+{
+	UnpackKernel kernel = unpackKernel(type);
+	if (kernel == NULL) return false;
+
+	UnpackAcc acc;
+	accInit(&acc);
+	kernel(vals, n, fill, pack, shift, &acc);
+
+	if (acc.count == 0.0) return true;
+
+	UnpackedStats part;
+	part.valid = (unsigned long long)acc.count;
+	part.min = acc.min;
+	part.max = acc.max;
+	part.sum.sum = 0.0;
+	part.sum.comp = 0.0;
+	compensatedAdd(&part.sum, acc.count * shift);
+	compensatedAdd(&part.sum, acc.s1);
+
+	double sums[5] = { acc.count, acc.s1, acc.s2, acc.s3, acc.s4 };
+	momentsFromPowerSums(sums, shift, &part.moments);
+
+	unpackedStatsMerge(stats, &part);
+
+	return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Gathering physical values for the sketch and histogram, masked the way the
+ * kernels above mask them
+ * ------------------------------------------------------------------------- */
+
+#define DEFINE_UNPACK_GATHER(NAME, T) \
+static size_t NAME(const void* data, size_t n, const void* fill, const PackInfo* pack, double* out) \
+{ \
+	const T* vals = (const T*)data; \
+	const bool hasFill = fill != NULL; \
+	const T fillVal = hasFill ? *(const T*)fill : (T)0; \
+	size_t m = 0; \
+	\
+	for (size_t i = 0; i < n; ++i) \
+	{ \
+		if (hasFill && vals[i] == fillVal) continue; \
+		\
+		double x = (double)vals[i]; \
+		if (!(x >= pack->validMin && x <= pack->validMax)) continue; \
+		\
+		bool missing = false; \
+		for (int k = 0; k < pack->nMissing; ++k) \
+			missing |= x == pack->missing[k]; \
+		if (missing) continue; \
+		\
+		double y = x * pack->scale + pack->offset; \
+		if (isfinite(y)) out[m++] = y; \
+	} \
+	\
+	return m; \
+}
+
+DEFINE_UNPACK_GATHER(gatherByte, signed char)
+DEFINE_UNPACK_GATHER(gatherUByte, unsigned char)
+DEFINE_UNPACK_GATHER(gatherShort, short)
+DEFINE_UNPACK_GATHER(gatherUShort, unsigned short)
+DEFINE_UNPACK_GATHER(gatherInt, int)
+DEFINE_UNPACK_GATHER(gatherUInt, unsigned int)
+DEFINE_UNPACK_GATHER(gatherInt64, long long)
+DEFINE_UNPACK_GATHER(gatherUInt64, unsigned long long)
+DEFINE_UNPACK_GATHER(gatherFloat, float)
+DEFINE_UNPACK_GATHER(gatherDouble, double)
+
+size_t unpackGather(nc_type type, const void* vals, size_t n, const void* fill, const PackInfo* pack, double* out)
+{
+	switch (type)
+	{
+	case NC_BYTE: return gatherByte(vals, n, fill, pack, out);
+	case NC_UBYTE: return gatherUByte(vals, n, fill, pack, out);
+	case NC_SHORT: return gatherShort(vals, n, fill, pack, out);
+	case NC_USHORT: return gatherUShort(vals, n, fill, pack, out);
+	case NC_INT: return gatherInt(vals, n, fill, pack, out);
+	case NC_UINT: return gatherUInt(vals, n, fill, pack, out);
+	case NC_INT64: return gatherInt64(vals, n, fill, pack, out);
+	case NC_UINT64: return gatherUInt64(vals, n, fill, pack, out);
+	case NC_FLOAT: return gatherFloat(vals, n, fill, pack, out);
+	case NC_DOUBLE: return gatherDouble(vals, n, fill, pack, out);
+	default: return 0;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef UNPACK_H
+#define UNPACK_H
+
+#include "moments.h"
+
+#define PACK_MAX_MISSING 8
+
+// CF packing and validity attributes of a variable. Everything is held as double
+// whatever type the attributes were stored in; the valid range and missing values
+// are in packed (on-disk) units.
+typedef struct PackInfo
+{
+	bool packed;      // scale_factor or add_offset present
+	double scale;
+	double offset;
+	bool masked;      // valid_min, valid_max, valid_range or missing_value present
+	double validMin;  // widest finite range when unset, so non-finite values never count
+	double validMax;
+	int nMissing;
+	double missing[PACK_MAX_MISSING];
+} PackInfo;
+
+// Physical-unit statistics of the values that survive the masks
+typedef struct UnpackedStats
+{
+	unsigned long long valid;
+	double min;
+	double max;
+	CompensatedSum sum;
+	Moments moments;
+} UnpackedStats;
+
+int getPackInfo(int ncid, int varID, nc_type type, PackInfo* info);
+bool packInfoActive(const PackInfo* info);
+
+void unpackedStatsInit(UnpackedStats* stats);
+void unpackedStatsMerge(UnpackedStats* dst, const UnpackedStats* src);
+
+// Masks, unpacks (x * scale + offset) and reduces one buffer in a single pass,
+// taking power sums around shift, which should be close to the physical mean.
+// Returns false for types without a kernel.
+bool unpackReduce(nc_type type, const void* vals, size_t n, const void* fill, const PackInfo* pack, double shift, UnpackedStats* stats);
+
+// Writes the unpacked values that survive the same masks to out, which has
+// room for n, and returns how many there were
+size_t unpackGather(nc_type type, const void* vals, size_t n, const void* fill, const PackInfo* pack, double* out);
+
+#endif
@@ -0,0 +1,216 @@
+#include "zonemap.h"
+#include "simd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static void zoneInit(Zone* zone)
+{
+	zone->min = NC_MAX_DOUBLE;
+	zone->max = NC_MIN_DOUBLE;
+	zone->count = 0;
+	zone->valid = 0;
+	zone->nonFinite = 0;
+}
+
+static void zoneMerge(Zone* dst, const Zone* src)
+{
+	if (src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+	dst->count += src->count;
+	dst->valid += src->valid;
+	dst->nonFinite |= src->nonFinite;
+}
+
+static void countZones(ZoneMap* map)
+{
+	map->nZones = 1;
+
+	for (int d = 0; d < map->nDims; ++d)
+	{
+		map->blocksPerDim[d] = (map->dimLens[d] + map->block[d] - 1) / map->block[d];
+		map->nZones *= map->blocksPerDim[d];
+	}
+}
+
+bool zoneMapInit(ZoneMap* map, const VarInfo* var)
+{
+	memset(map, 0, sizeof(ZoneMap));
+	map->nDims = var->nDims;
+
+	unsigned long long values = 1;
+	bool full = true;
+
+	for (int d = var->nDims - 1; d >= 0; --d)
+	{
+		size_t len = var->dimLens[d] > 0 ? var->dimLens[d] : 1;
+		map->dimLens[d] = var->dimLens[d];
+
+		if (var->chunked)
+		{
+			map->block[d] = var->chunkLens[d] > 0 ? var->chunkLens[d] : 1;
+		}
+		else if (!full)
+		{
+			map->block[d] = 1;
+		}
+		else if (d == 0 || values * len <= ZONE_BLOCK_VALUES)
+		{
+			// the leading dimension is not clamped, so appending records keeps the block shape
+			size_t fit = (size_t)(ZONE_BLOCK_VALUES / values);
+			map->block[d] = d == 0 ? (fit > 0 ? fit : 1) : len;
+			values *= map->block[d];
+		}
+		else
+		{
+			map->block[d] = (size_t)(ZONE_BLOCK_VALUES / values);
+			if (map->block[d] == 0) map->block[d] = 1;
+			full = false;
+		}
+	}
+
+	countZones(map);
+
+	map->zones = (Zone*)malloc((map->nZones > 0 ? map->nZones : 1) * sizeof(Zone));
+	if (map->zones == NULL) return false;
+
+	for (unsigned long long z = 0; z < map->nZones; ++z)
+		zoneInit(&map->zones[z]);
+
+	return true;
+}
+
+void zoneMapFree(ZoneMap* map)
+{
+	free(map->zones);
+	map->zones = NULL;
+	map->nZones = 0;
+}
+
+bool zoneMapGrow(ZoneMap* map, size_t records)
+{
+	if (map->nDims == 0 || records <= map->dimLens[0]) return true;
+
+	unsigned long long before = map->nZones;
+	map->dimLens[0] = records;
+	countZones(map);
+
+	Zone* grown = (Zone*)realloc(map->zones, map->nZones * sizeof(Zone));
+	if (grown == NULL) return false;
+
+	map->zones = grown;
+	for (unsigned long long z = before; z < map->nZones; ++z)
+		zoneInit(&map->zones[z]);
+
+	return true;
+}
+
+void zoneMapMerge(ZoneMap* dst, const ZoneMap* src)
+{
+	unsigned long long n = dst->nZones < src->nZones ? dst->nZones : src->nZones;
+
+	for (unsigned long long z = 0; z < n; ++z)
+		zoneMerge(&dst->zones[z], &src->zones[z]);
+}
+
+// Rows of the slab run along the last dimension; each is cut where it crosses
+// into the next block and the pieces go through the min/max kernel
+void zoneMapAdd(ZoneMap* map, const VarInfo* var, const size_t* start, const size_t* count, const void* vals, const void* fillval)
+{
+	MinMaxSumKernel kernel = simdKernel(var->type);
+	if (kernel == NULL || map->zones == NULL) return;
+
+	int last = var->nDims - 1;
+	const char* bytes = (const char*)vals;
+
+	if (last < 0)
+	{
+		MinMaxSum part;
+		kernel(vals, 1, fillval, &part);
+
+		Zone piece;
+		zoneInit(&piece);
+		piece.count = 1;
+		piece.valid = part.valid;
+		if (part.valid > 0)
+		{
+			piece.min = part.min;
+			piece.max = part.max;
+			piece.nonFinite = !isfinite(part.sum);
+		}
+		zoneMerge(&map->zones[0], &piece);
+		return;
+	}
+
+	unsigned long long rows = 1;
+	for (int d = 0; d < last; ++d)
+		rows *= count[d];
+
+	size_t idx[NC_MAX_VAR_DIMS] = { 0 };
+	size_t rowLen = count[last];
+
+	for (unsigned long long r = 0; r < rows; ++r)
+	{
+		// zone of the row's first block, before the last dimension is added in
+		unsigned long long zoneBase = 0;
+		for (int d = 0; d < last; ++d)
+		{
+			size_t file = var->offset[d] + start[d] + idx[d];
+			zoneBase = zoneBase * map->blocksPerDim[d] + file / map->block[d];
+		}
+		zoneBase *= map->blocksPerDim[last];
+
+		size_t file = var->offset[last] + start[last];
+		size_t done = 0;
+
+		while (done < rowLen)
+		{
+			size_t col = (file + done) / map->block[last];
+			size_t end = (col + 1) * map->block[last] - file;
+			size_t n = (end < rowLen ? end : rowLen) - done;
+
+			MinMaxSum part;
+			kernel(bytes + (r * rowLen + done) * var->typeSize, n, fillval, &part);
+
+			Zone* zone = &map->zones[zoneBase + col];
+			zone->count += n;
+			zone->valid += part.valid;
+			if (part.valid > 0)
+			{
+				if (part.min < zone->min) zone->min = part.min;
+				if (part.max > zone->max) zone->max = part.max;
+				// NaN drops out of min/max but poisons the sum
+				if (!isfinite(part.sum)) zone->nonFinite = 1;
+			}
+
+			done += n;
+		}
+
+		for (int d = last - 1; d >= 0; --d)
+		{
+			if (++idx[d] < count[d]) break;
+			idx[d] = 0;
+		}
+	}
+}
+
+unsigned long long zoneMapBlock(const ZoneMap* map, unsigned long long index, size_t* start, size_t* count)
+{
+	unsigned long long values = 1;
+
+	for (int d = map->nDims - 1; d >= 0; --d)
+	{
+		size_t pos = (size_t)(index % map->blocksPerDim[d]);
+		index /= map->blocksPerDim[d];
+
+		start[d] = pos * map->block[d];
+		count[d] = map->block[d];
+		if (start[d] + count[d] > map->dimLens[d])
+			count[d] = map->dimLens[d] - start[d];
+
+		values *= count[d];
+	}
+
+	return values;
+}
@@ -0,0 +1,51 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include "slab.h"
+
+// target values per block for variables stored contiguously
+#define ZONE_BLOCK_VALUES 65536
+
+typedef struct Zone
+{
+	double min;               // over valid values; NaN never lands here
+	double max;
+	unsigned long long count; // values covered so far
+	unsigned long long valid; // of which were not _FillValue
+	unsigned char nonFinite;  // may hold NaN or infinity
+} Zone;
+
+// Extremes and fill counts per block of a variable, for skipping blocks that
+// cannot match a query. Blocks are the HDF5 chunks of chunked variables and
+// runs of about ZONE_BLOCK_VALUES values otherwise, so reading a block never
+// costs more than its own chunk. Zones are kept in row-major block order with
+// the leading dimension outermost, and everything in them merges, so maps
+// built by different threads or over appended records simply combine.
+typedef struct ZoneMap
+{
+	int nDims;
+	size_t dimLens[NC_MAX_VAR_DIMS]; // file extent covered
+	size_t block[NC_MAX_VAR_DIMS];
+	size_t blocksPerDim[NC_MAX_VAR_DIMS];
+	unsigned long long nZones;
+	Zone* zones;
+} ZoneMap;
+
+// var is the whole variable; any selection on it is ignored
+bool zoneMapInit(ZoneMap* map, const VarInfo* var);
+void zoneMapFree(ZoneMap* map);
+
+// Extends the leading dimension to records, adding empty zones
+bool zoneMapGrow(ZoneMap* map, size_t records);
+
+// dst and src must cover the same blocks
+void zoneMapMerge(ZoneMap* dst, const ZoneMap* src);
+
+// Folds a slab read through var (start and count in var's selection, which must
+// have unit steps) into the zones it overlaps
+void zoneMapAdd(ZoneMap* map, const VarInfo* var, const size_t* start, const size_t* count, const void* vals, const void* fillval);
+
+// File start/count of a zone's block, clipped to the variable; returns its value count
+unsigned long long zoneMapBlock(const ZoneMap* map, unsigned long long index, size_t* start, size_t* count);
+
+#endif